@@ -0,0 +1,279 @@
+#include "App.hpp"
+#include "Pipeline.hpp"
+#include "Renderer.hpp"
+#include "ResourceManager.hpp"
+#include "Texture.hpp"
+#include "common.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <numeric>
+#include <span>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//------------------------------------------------------------------------
+// Replays a scripted camera path through sponza for a fixed number of frames and reports load time, first-frame time
+// and the frame time distribution as JSON. Frame n samples the path at n / (frames - 1) of its duration, so runs are
+// deterministic regardless of how fast they go. Headless by default, so it runs on llvmpipe. --cold-cache empties the
+// program binary cache first, so that comparing the load time of a run with and without it shows what the cache saves.
+// --dump-graph writes the render graph of the last frame in the Graphviz DOT language. --visibility-buffer renders with
+// the visibility buffer instead of the forward path, so that comparing the pass timings of both shows what it saves.
+// --dynamic-resolution scales the resolution to fit the GPU time of a frame into the given budget, and reports the
+// distribution of the scales it picked. --texture-arrays samples mesh textures from texture arrays even where bindless
+// textures are supported, to compare both.
+// Usage: ZhadeFlythroughBench [--path keyframes.txt] [--frames N] [--out results.json] [--windowed] [--cold-cache]
+//                             [--dump-graph graph.dot] [--visibility-buffer] [--dynamic-resolution budgetMs]
+//                             [--texture-arrays]
+
+namespace
+{
+
+//------------------------------------------------------------------------
+
+using namespace Zhade;
+using Clock = std::chrono::steady_clock;
+
+struct Keyframe
+{
+    float time;
+    glm::vec3 center;
+    glm::vec3 target;
+};
+
+struct BenchOptions
+{
+    fs::path keyframePath = BENCH_PATH / "paths" / "sponza.txt";
+    fs::path outPath = "flythrough.json";
+    fs::path graphPath{};
+    uint32_t numFrames = 600;
+    bool windowed = false;
+    bool coldCache = false;
+    bool textureArrays = false;
+    RenderPath::Type renderPath = RenderPath::FORWARD;
+    DynamicResolutionDescriptor dynamicResolutionDesc{};
+};
+
+//------------------------------------------------------------------------
+
+BenchOptions parseArgs(int argc, char* argv[])
+{
+    BenchOptions options;
+
+    for (int idx = 1; idx < argc; ++idx) {
+        const std::string_view arg{argv[idx]};
+        const bool hasValue = idx + 1 < argc;
+
+        if (arg == "--path" and hasValue) {
+            options.keyframePath = argv[++idx];
+        } else if (arg == "--frames" and hasValue) {
+            const std::string_view value{argv[++idx]};
+            std::from_chars(value.data(), value.data() + value.size(), options.numFrames);
+        } else if (arg == "--out" and hasValue) {
+            options.outPath = argv[++idx];
+        } else if (arg == "--windowed") {
+            options.windowed = true;
+        } else if (arg == "--cold-cache") {
+            options.coldCache = true;
+        } else if (arg == "--dump-graph" and hasValue) {
+            options.graphPath = argv[++idx];
+        } else if (arg == "--texture-arrays") {
+            options.textureArrays = true;
+        } else if (arg == "--visibility-buffer") {
+            options.renderPath = RenderPath::VISIBILITY_BUFFER;
+        } else if (arg == "--dynamic-resolution" and hasValue) {
+            const std::string_view value{argv[++idx]};
+            options.dynamicResolutionDesc.enabled = true;
+            std::from_chars(value.data(), value.data() + value.size(), options.dynamicResolutionDesc.targetMs);
+        } else {
+            fmt::println("Ignoring unknown argument {}", arg);
+        }
+    }
+    options.numFrames = std::max(options.numFrames, 2u);
+
+    return options;
+}
+
+//------------------------------------------------------------------------
+
+// Blank lines and lines starting with '#' are skipped, keyframes must be sorted by time.
+std::vector<Keyframe> loadKeyframes(const fs::path& path)
+{
+    std::ifstream file{path};
+    if (not file) {
+        fmt::println("Error opening keyframes {}", path.string());
+        return {};
+    }
+
+    std::vector<Keyframe> keyframes;
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() or line.front() == '#') continue;
+
+        std::istringstream stream{line};
+        Keyframe keyframe{};
+        stream >> keyframe.time
+               >> keyframe.center.x >> keyframe.center.y >> keyframe.center.z
+               >> keyframe.target.x >> keyframe.target.y >> keyframe.target.z;
+        if (not stream) {
+            fmt::println("Skipping malformed keyframe \"{}\"", line);
+            continue;
+        }
+        keyframes.push_back(keyframe);
+    }
+
+    return keyframes;
+}
+
+//------------------------------------------------------------------------
+
+// Linear in position, normalized linear in direction, which is plenty for a benchmark path.
+Keyframe samplePath(std::span<const Keyframe> keyframes, float time)
+{
+    const auto next = stdr::upper_bound(keyframes, time, {}, &Keyframe::time);
+    if (next == keyframes.begin()) return keyframes.front();
+    if (next == keyframes.end()) return keyframes.back();
+
+    const Keyframe& a = *std::prev(next);
+    const Keyframe& b = *next;
+    const float t = (time - a.time) / (b.time - a.time);
+    return {
+        .time = time,
+        .center = glm::mix(a.center, b.center, t),
+        .target = glm::normalize(glm::mix(a.target, b.target, t))
+    };
+}
+
+//------------------------------------------------------------------------
+
+double msSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+//------------------------------------------------------------------------
+
+std::string distributionJSON(std::vector<double> samples)
+{
+    stdr::sort(samples);
+    const auto percentile = [&](double p) {
+        return samples[implicit_cast<size_t>(std::ceil(p * samples.size())) - 1];
+    };
+    const double avg = std::reduce(samples.begin(), samples.end()) / samples.size();
+    return fmt::format(
+        R"({{"min":{:.4f},"avg":{:.4f},"p50":{:.4f},"p95":{:.4f},"p99":{:.4f},"max":{:.4f}}})",
+        samples.front(), avg, percentile(0.5), percentile(0.95), percentile(0.99), samples.back()
+    );
+}
+
+//------------------------------------------------------------------------
+
+}  // namespace
+
+//------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+    const BenchOptions options = parseArgs(argc, argv);
+
+    const std::vector<Keyframe> keyframes = loadKeyframes(options.keyframePath);
+    if (keyframes.empty()) return 1;
+
+    if (options.coldCache) {
+        std::error_code error;
+        fs::remove_all(PROGRAM_CACHE_PATH, error);
+    }
+
+    App app;
+    if (not app.init({.headless = not options.windowed, .textureArrays = options.textureArrays})) return 1;
+
+    // Declared after the app, so that whatever is still alive is freed while its GL context is current.
+    ResourceManager mngr;
+    {
+        const auto loadStart = Clock::now();
+        RendererDescriptor rendererDesc = RendererDescriptor::makeDefault(&mngr, &app, app.isHeadless());
+        rendererDesc.renderPath = options.renderPath;
+        rendererDesc.dynamicResolutionDesc = options.dynamicResolutionDesc;
+        Renderer renderer{rendererDesc};
+        renderer.scene().addModelFromFile(SPONZA_PATH);
+        glFinish();
+        const double loadMs = msSince(loadStart);
+
+        const float duration = keyframes.back().time - keyframes.front().time;
+        std::vector<double> frameMs;
+        std::vector<double> scales;
+        frameMs.reserve(options.numFrames);
+        scales.reserve(options.numFrames);
+
+        // Every frame is finished before the next, so that the measurement covers the GPU work of that frame only.
+        for (uint32_t frame = 0; frame < options.numFrames; ++frame) {
+            const auto frameStart = Clock::now();
+
+            const float time = keyframes.front().time + duration * frame / (options.numFrames - 1);
+            const Keyframe pose = samplePath(keyframes, time);
+            renderer.camera().setPose(pose.center, pose.target);
+            renderer.render();
+            if (not app.isHeadless()) glfwSwapBuffers(app.glCtx());
+            glFinish();
+
+            frameMs.push_back(msSince(frameStart));
+            scales.push_back(renderer.dynamicResolution().scale());
+        }
+
+        if (not options.graphPath.empty()) renderer.dumpRenderGraph(options.graphPath);
+
+        const double firstFrameMs = frameMs.front();
+        const std::vector<double> steadyFrameMs(frameMs.begin() + 1, frameMs.end());
+
+        std::string passes;
+        for (const auto& [name, gpu, stats] : renderer.profiler().report()) {
+            passes += fmt::format(
+                R"({}{{"name":"{}","clock":"{}","avg":{:.4f},"min":{:.4f},"p99":{:.4f}}})",
+                passes.empty() ? "" : ",", name, gpu ? "GPU" : "CPU", stats.avg, stats.min, stats.p99
+            );
+        }
+
+        const std::string json = fmt::format(
+            "{{\n"
+            R"(  "keyframes":"{}",)" "\n"
+            R"(  "frames":{},)" "\n"
+            R"(  "resolution":[{},{}],)" "\n"
+            R"(  "headless":{},)" "\n"
+            R"(  "renderer":"{}",)" "\n"
+            R"(  "renderPath":"{}",)" "\n"
+            R"(  "bindless":{},)" "\n"
+            R"(  "dynamicResolution":{{"enabled":{},"targetMs":{:.4f}}},)" "\n"
+            R"(  "resolutionScale":{},)" "\n"
+            R"(  "loadMs":{:.4f},)" "\n"
+            R"(  "programCache":{{"cold":{},"hits":{},"misses":{}}},)" "\n"
+            R"(  "firstFrameMs":{:.4f},)" "\n"
+            R"(  "frameMs":{},)" "\n"
+            R"(  "passesMs":[{}])" "\n"
+            "}}\n",
+            options.keyframePath.generic_string(), options.numFrames, App::s_windowWidth, App::s_windowHeight,
+            app.isHeadless(), std::bit_cast<const char*>(glGetString(GL_RENDERER)),
+            RenderPath2Name[options.renderPath], Texture::s_useBindless, options.dynamicResolutionDesc.enabled,
+            options.dynamicResolutionDesc.targetMs, distributionJSON(scales), loadMs, options.coldCache,
+            Pipeline::s_numProgramCacheHits, Pipeline::s_numProgramCacheMisses, firstFrameMs,
+            distributionJSON(steadyFrameMs), passes
+        );
+
+        std::ofstream file{options.outPath};
+        file << json;
+        if (not file) {
+            fmt::println("Error writing results to {}", options.outPath.string());
+            return 1;
+        }
+        fmt::print("{}", json);
+    }
+
+    return 0;
+}
+
+//------------------------------------------------------------------------
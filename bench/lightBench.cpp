@@ -0,0 +1,242 @@
+#include "App.hpp"
+#include "LocalLights.hpp"
+#include "Renderer.hpp"
+#include "ResourceManager.hpp"
+#include "common.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <numbers>
+#include <random>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+//------------------------------------------------------------------------
+// Scatters 10 to 10k moving point and spot lights through sponza and reports, per light count, the GPU time of binning
+// them into the froxel grid apart from the GPU time of shading with them. A run without local lights gives the
+// shading baseline. Headless by default.
+// Usage: ZhadeLightBench [--frames N] [--out results.json] [--windowed] [--visibility-buffer]
+
+namespace
+{
+
+//------------------------------------------------------------------------
+
+using namespace Zhade;
+using Clock = std::chrono::steady_clock;
+
+struct BenchOptions
+{
+    fs::path outPath = "lights.json";
+    uint32_t numFrames = 200;  // Per light count, at most PROFILER_HISTORY_SIZE.
+    bool windowed = false;
+    RenderPath::Type renderPath = RenderPath::FORWARD;
+};
+
+struct AnimatedLight
+{
+    glm::vec3 base;
+    float phase;
+};
+
+inline constexpr uint32_t s_lightCounts[] {0, 10, 100, 1'000, 10'000};
+inline constexpr std::string_view s_binningPasses[] {"Clear light clusters", "Light binning", "Light compaction"};
+inline constexpr uint32_t s_warmupFrames = 16;  // Also covers the pipelines compiling on the first frames.
+
+//------------------------------------------------------------------------
+
+BenchOptions parseArgs(int argc, char* argv[])
+{
+    BenchOptions options;
+
+    for (int idx = 1; idx < argc; ++idx) {
+        const std::string_view arg{argv[idx]};
+        const bool hasValue = idx + 1 < argc;
+
+        if (arg == "--frames" and hasValue) {
+            const std::string_view value{argv[++idx]};
+            std::from_chars(value.data(), value.data() + value.size(), options.numFrames);
+        } else if (arg == "--out" and hasValue) {
+            options.outPath = argv[++idx];
+        } else if (arg == "--windowed") {
+            options.windowed = true;
+        } else if (arg == "--visibility-buffer") {
+            options.renderPath = RenderPath::VISIBILITY_BUFFER;
+        } else {
+            fmt::println("Ignoring unknown argument {}", arg);
+        }
+    }
+    options.numFrames = std::clamp(options.numFrames, 1u, implicit_cast<uint32_t>(PROFILER_HISTORY_SIZE));
+
+    return options;
+}
+
+//------------------------------------------------------------------------
+
+// Slightly shrunk, so that lights rather end up inside the building than in its walls.
+std::pair<glm::vec3, glm::vec3> sceneBounds(Renderer& renderer)
+{
+    glm::vec3 boundsMin{std::numeric_limits<float>::max()};
+    glm::vec3 boundsMax{std::numeric_limits<float>::lowest()};
+    for (const Vertex& vertex : renderer.rasterizerInput().vertices) {
+        boundsMin = glm::min(boundsMin, vertex.pos);
+        boundsMax = glm::max(boundsMax, vertex.pos);
+    }
+    const glm::vec3 margin = 0.05f * (boundsMax - boundsMin);
+    return {boundsMin + margin, boundsMax - margin};
+}
+
+//------------------------------------------------------------------------
+
+// Deterministic for a count, every fourth light is a spot light pointing down.
+std::vector<AnimatedLight> scatterLights(LocalLights& lights, uint32_t numLights,
+    const std::pair<glm::vec3, glm::vec3>& bounds)
+{
+    std::mt19937 rng{numLights};
+    std::uniform_real_distribution<float> unit{0.0f, 1.0f};
+    const auto [boundsMin, boundsMax] = bounds;
+
+    lights.clear();
+    std::vector<AnimatedLight> animated;
+    animated.reserve(numLights);
+    for (uint32_t idx = 0; idx < numLights; ++idx) {
+        const glm::vec3 position = glm::mix(boundsMin, boundsMax, glm::vec3{unit(rng), unit(rng), unit(rng)});
+        const glm::vec3 color{0.2f + 0.8f * unit(rng), 0.2f + 0.8f * unit(rng), 0.2f + 0.8f * unit(rng)};
+        const float range = 150.0f + 150.0f * unit(rng);
+        const float intensity = 0.25f * range * range;  // Roughly full strength at half the range.
+
+        const bool added = idx % 4 == 3
+            ? lights.add(LocalLights::makeSpotLight(position, {0.0f, -1.0f, 0.0f}, 2.0f * range, color,
+                4.0f * intensity, 0.3f, 0.5f))
+            : lights.add(LocalLights::makePointLight(position, range, color, intensity));
+        if (not added) break;
+        animated.push_back({.base = position, .phase = 2.0f * std::numbers::pi_v<float> * unit(rng)});
+    }
+    return animated;
+}
+
+//------------------------------------------------------------------------
+
+// Small circles, so that the lights stay where they were scattered but are binned anew every frame.
+void animateLights(LocalLights& lights, std::span<const AnimatedLight> animated, float time)
+{
+    static constexpr float radius = 50.0f;
+    const std::span<LocalLight> moved = lights.lights();
+    for (size_t idx = 0; idx < animated.size(); ++idx) {
+        const float angle = time + animated[idx].phase;
+        moved[idx].position = animated[idx].base + radius * glm::vec3{std::cos(angle), 0.0f, std::sin(angle)};
+    }
+}
+
+//------------------------------------------------------------------------
+
+double msSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+//------------------------------------------------------------------------
+
+std::string statsJSON(const TimerStats& stats)
+{
+    return fmt::format(R"({{"avg":{:.4f},"min":{:.4f},"p99":{:.4f}}})", stats.avg, stats.min, stats.p99);
+}
+
+//------------------------------------------------------------------------
+
+}  // namespace
+
+//------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+    const BenchOptions options = parseArgs(argc, argv);
+
+    App app;
+    if (not app.init({.headless = not options.windowed})) return 1;
+
+    // Declared after the app, so that whatever is still alive is freed while its GL context is current.
+    ResourceManager mngr;
+    {
+        RendererDescriptor rendererDesc = RendererDescriptor::makeDefault(&mngr, &app, app.isHeadless());
+        rendererDesc.renderPath = options.renderPath;
+        Renderer renderer{rendererDesc};
+        renderer.scene().addModelFromFile(SPONZA_PATH);
+        const auto bounds = sceneBounds(renderer);
+
+        LocalLights& lights = renderer.scene().localLights();
+        Profiler& profiler = renderer.profiler();
+        const std::string_view shadingPass =
+            options.renderPath == RenderPath::VISIBILITY_BUFFER ? "Visibility resolve" : "Main pass";
+
+        std::string results;
+        for (uint32_t numLights : s_lightCounts) {
+            const std::vector<AnimatedLight> animated = scatterLights(lights, numLights, bounds);
+
+            // Every frame is finished before the next, so that the frame time covers the GPU work of that frame only.
+            double frameMs = 0.0;
+            for (uint32_t frame = 0; frame < s_warmupFrames + options.numFrames; ++frame) {
+                if (frame == s_warmupFrames) profiler.resetStats();
+                const auto frameStart = Clock::now();
+
+                animateLights(lights, animated, 0.05f * frame);
+                renderer.render();
+                if (not app.isHeadless()) glfwSwapBuffers(app.glCtx());
+                glFinish();
+
+                if (frame >= s_warmupFrames) frameMs += msSince(frameStart);
+            }
+
+            float binningMs = 0.0f;
+            std::string passes;
+            for (std::string_view pass : s_binningPasses) {
+                const TimerStats stats = profiler.stats(pass, true).value_or(TimerStats{});
+                binningMs += stats.avg;
+                passes += fmt::format(R"({}"{}":{})", passes.empty() ? "" : ",", pass, statsJSON(stats));
+            }
+            const TimerStats shading = profiler.stats(shadingPass, true).value_or(TimerStats{});
+            passes += fmt::format(R"(,"{}":{})", shadingPass, statsJSON(shading));
+
+            results += fmt::format(
+                "{}\n" R"(    {{"lights":{},"binningMs":{:.4f},"shadingMs":{:.4f},)"
+                R"("frameMs":{:.4f},"passesMs":{{{}}}}})",
+                results.empty() ? "" : ",", lights.numLights(), binningMs, shading.avg,
+                frameMs / options.numFrames, passes
+            );
+        }
+
+        const std::string json = fmt::format(
+            "{{\n"
+            R"(  "frames":{},)" "\n"
+            R"(  "resolution":[{},{}],)" "\n"
+            R"(  "headless":{},)" "\n"
+            R"(  "renderer":"{}",)" "\n"
+            R"(  "renderPath":"{}",)" "\n"
+            R"(  "lightCounts":[{})" "\n"
+            "  ]\n"
+            "}}\n",
+            options.numFrames, App::s_windowWidth, App::s_windowHeight, app.isHeadless(),
+            std::bit_cast<const char*>(glGetString(GL_RENDERER)), RenderPath2Name[options.renderPath], results
+        );
+
+        std::ofstream file{options.outPath};
+        file << json;
+        if (not file) {
+            fmt::println("Error writing results to {}", options.outPath.string());
+            return 1;
+        }
+        fmt::print("{}", json);
+    }
+
+    return 0;
+}
+
+//------------------------------------------------------------------------
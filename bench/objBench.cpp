@@ -0,0 +1,95 @@
+#include "ObjLoader.hpp"
+#include "common.hpp"
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <limits>
+#include <span>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+//------------------------------------------------------------------------
+// Compares loading sponza with ObjLoader against Assimp's OBJ importer, in ms (best of the iterations). Both include
+// triangulation and smooth normals; ObjLoader also writes the vertices and indices, as Scene does.
+// Usage: ZhadeObjBench [iterations] [path]
+
+namespace
+{
+
+//------------------------------------------------------------------------
+
+using namespace Zhade;
+using Clock = std::chrono::steady_clock;
+
+//------------------------------------------------------------------------
+
+// Returns the best time and the number of vertices of the last load.
+template<typename F>
+std::pair<double, size_t> bestMs(uint32_t numIterations, F&& load)
+{
+    double best = std::numeric_limits<double>::max();
+    size_t numVertices = 0;
+    for ([[maybe_unused]] uint32_t iteration : stdv::iota(0u, numIterations)) {
+        const auto start = Clock::now();
+        numVertices = load();
+        const std::chrono::duration<double, std::milli> elapsed = Clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+    return {best, numVertices};
+}
+
+//------------------------------------------------------------------------
+
+}  // namespace
+
+//------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+    uint32_t numIterations = 5;
+    if (argc > 1) {
+        const std::string_view arg{argv[1]};
+        std::from_chars(arg.data(), arg.data() + arg.size(), numIterations);
+    }
+    numIterations = std::max(numIterations, 1u);
+    const fs::path path = argc > 2 ? fs::path{argv[2]} : SPONZA_PATH;
+
+    fmt::println("{:<20} {:>8} {:>12} {:>12}", "Loader", "Threads", "ms", "Vertices");
+
+    const auto [assimpMs, assimpVertices] = bestMs(numIterations, [&] {
+        Assimp::Importer importer{};
+        const aiScene* aiScenePtr = importer.ReadFile(path.string().c_str(), ASSIMP_LOAD_FLAGS);
+        if (aiScenePtr == nullptr) return size_t{0};
+        size_t numVertices = 0;
+        for (const aiMesh* aiMeshPtr : std::span{aiScenePtr->mMeshes, aiScenePtr->mNumMeshes}) {
+            numVertices += aiMeshPtr->mNumVertices;
+        }
+        return numVertices;
+    });
+    fmt::println("{:<20} {:>8} {:>12.2f} {:>12}", "Assimp", 1, assimpMs, assimpVertices);
+
+    std::vector<Vertex> vertices;
+    std::vector<GLuint> indices;
+    const uint32_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    for (uint32_t numThreads = 1; numThreads <= maxThreads; numThreads *= 2) {
+        const auto [objMs, objVertices] = bestMs(numIterations, [&] {
+            ObjLoader loader{path, numThreads};
+            if (not loader.valid()) return size_t{0};
+            vertices.resize(loader.numVertices());
+            indices.resize(loader.numVertices());
+            loader.write(vertices, indices);
+            return vertices.size();
+        });
+        fmt::println("{:<20} {:>8} {:>12.2f} {:>12}", "ObjLoader", numThreads, objMs, objVertices);
+    }
+
+    return 0;
+}
+
+//------------------------------------------------------------------------
@@ -0,0 +1,527 @@
+#include "Handle.hpp"
+#include "ObjectPool.hpp"
+#include "ResourceManager.hpp"
+#include "Stack.hpp"
+#include "common.hpp"
+
+#include <algorithm>
+#include <array>
+#include <barrier>
+#include <charconv>
+#include <chrono>
+#include <limits>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+//------------------------------------------------------------------------
+// Measures ObjectPool, Stack and ResourceManager against plain std::vector and std::unordered_map baselines, in
+// nanoseconds per operation (best of several runs). The vector baseline has no generation checks and no slot reuse,
+// the map baseline is keyed by a running id, so both bound what a handle-based pool can cost.
+// The concurrent cases divide wall time by the operations of all threads, so perfect scaling halves them per doubling.
+// The main thread constructs their pools and takes part, so that one thread takes the owner's path as the GL thread
+// does. The pending case counts each object that loader threads reserve and the main thread publishes and deallocates.
+// Usage: ZhadePoolBench [numObjects]
+
+namespace
+{
+
+//------------------------------------------------------------------------
+
+using namespace Zhade;
+using Clock = std::chrono::steady_clock;
+
+// The size of a typical resource, i.e. a cache line.
+struct Payload
+{
+    std::array<uint64_t, 8> data{};
+};
+
+struct Result
+{
+    double pool = 0.0;
+    std::optional<double> vector{};
+    std::optional<double> map{};
+};
+
+inline constexpr uint32_t NUM_RUNS = 5;
+inline constexpr uint64_t RNG_SEED = 0x5eed;
+
+// Keeps the optimizer from dropping the measured work.
+volatile uint64_t g_sink = 0;
+
+//------------------------------------------------------------------------
+
+template<typename F>
+double nsPerOp(size_t numOps, F&& fn)
+{
+    double best = std::numeric_limits<double>::max();
+    for ([[maybe_unused]] uint32_t run : stdv::iota(0u, NUM_RUNS)) {
+        const auto start = Clock::now();
+        g_sink = g_sink + fn();
+        const std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+        best = std::min(best, elapsed.count() / numOps);
+    }
+    return best;
+}
+
+void printResult(std::string_view name, const Result& result)
+{
+    const auto format = [](std::optional<double> ns) { return ns ? fmt::format("{:.2f}", *ns) : "-"; };
+    fmt::println("{:<32} {:>12.2f} {:>12} {:>14}", name, result.pool, format(result.vector), format(result.map));
+}
+
+std::vector<uint32_t> shuffledIndices(size_t count, std::mt19937_64& rng)
+{
+    std::vector<uint32_t> indices(count);
+    std::iota(indices.begin(), indices.end(), 0u);
+    stdr::shuffle(indices, rng);
+    return indices;
+}
+
+//------------------------------------------------------------------------
+
+// Fills up to numObjects and empties again, with the pool already grown by a previous run.
+Result benchAllocateDeallocate(size_t numObjects)
+{
+    ObjectPool<Payload> pool{numObjects};
+    std::vector<Handle<Payload>> handles(numObjects);
+    std::vector<Payload> vector;
+    vector.reserve(numObjects);
+    std::unordered_map<uint32_t, Payload> map;
+    map.reserve(numObjects);
+
+    return {
+        .pool = nsPerOp(2 * numObjects, [&] {
+            for (Handle<Payload>& handle : handles) handle = pool.allocate();
+            for (const Handle<Payload>& handle : handles) pool.deallocate(handle);
+            return handles.size();
+        }),
+        .vector = nsPerOp(2 * numObjects, [&] {
+            for ([[maybe_unused]] size_t idx : stdv::iota(0u, numObjects)) vector.emplace_back();
+            const size_t size = vector.size();
+            while (not vector.empty()) vector.pop_back();
+            return size;
+        }),
+        .map = nsPerOp(2 * numObjects, [&] {
+            for (uint32_t id : stdv::iota(0u, implicit_cast<uint32_t>(numObjects))) map.try_emplace(id);
+            const size_t size = map.size();
+            for (uint32_t id : stdv::iota(0u, implicit_cast<uint32_t>(numObjects))) map.erase(id);
+            return size;
+        })
+    };
+}
+
+//------------------------------------------------------------------------
+
+// Random-order lookups of live objects, touching one word of each.
+Result benchGet(size_t numObjects, std::mt19937_64& rng)
+{
+    ObjectPool<Payload> pool{numObjects};
+    std::vector<Handle<Payload>> handles;
+    std::vector<Payload> vector(numObjects);
+    std::unordered_map<uint32_t, Payload> map;
+    for (uint32_t id : stdv::iota(0u, implicit_cast<uint32_t>(numObjects))) {
+        handles.push_back(pool.allocate());
+        map.try_emplace(id);
+    }
+    const std::vector<uint32_t> order = shuffledIndices(numObjects, rng);
+
+    return {
+        .pool = nsPerOp(numObjects, [&] {
+            uint64_t sum = 0;
+            for (uint32_t idx : order) sum += pool.get(handles[idx])->data[0];
+            return sum;
+        }),
+        .vector = nsPerOp(numObjects, [&] {
+            uint64_t sum = 0;
+            for (uint32_t idx : order) sum += vector[idx].data[0];
+            return sum;
+        }),
+        .map = nsPerOp(numObjects, [&] {
+            uint64_t sum = 0;
+            for (uint32_t idx : order) sum += map.find(idx)->second.data[0];
+            return sum;
+        })
+    };
+}
+
+//------------------------------------------------------------------------
+
+// Visits every live object after a random half has been replaced, i.e. with holes in the pool.
+Result benchIterate(size_t numObjects, std::mt19937_64& rng)
+{
+    ObjectPool<Payload> pool{numObjects};
+    std::vector<Handle<Payload>> handles;
+    std::vector<Payload> vector(numObjects);
+    std::unordered_map<uint32_t, Payload> map;
+    for (uint32_t id : stdv::iota(0u, implicit_cast<uint32_t>(numObjects))) {
+        handles.push_back(pool.allocate());
+        map.try_emplace(id);
+    }
+    for (uint32_t idx : shuffledIndices(numObjects, rng) | stdv::take(numObjects / 2)) {
+        pool.deallocate(handles[idx]);
+        handles[idx] = pool.allocate();
+    }
+
+    return {
+        .pool = nsPerOp(numObjects, [&] {
+            uint64_t sum = 0;
+            for (const Payload& item : pool.alive()) sum += item.data[0];
+            return sum;
+        }),
+        .vector = nsPerOp(numObjects, [&] {
+            uint64_t sum = 0;
+            for (const Payload& item : vector) sum += item.data[0];
+            return sum;
+        }),
+        .map = nsPerOp(numObjects, [&] {
+            uint64_t sum = 0;
+            for (const auto& [id, item] : map) sum += item.data[0];
+            return sum;
+        })
+    };
+}
+
+//------------------------------------------------------------------------
+
+// Steady state: replace a random live object, then look up both the stale and the fresh handle. The stale lookup
+// must fail, which the pool checks through generations and the map through the missing key.
+Result benchChurn(size_t numObjects, std::mt19937_64& rng)
+{
+    const size_t numOps = numObjects;
+    std::vector<uint32_t> victims(numOps);
+    std::uniform_int_distribution<uint32_t> distribution{0, implicit_cast<uint32_t>(numObjects - 1)};
+    stdr::generate(victims, [&] { return distribution(rng); });
+
+    ObjectPool<Payload> pool{numObjects};
+    std::vector<Handle<Payload>> handles;
+    for ([[maybe_unused]] size_t idx : stdv::iota(0u, numObjects)) handles.push_back(pool.allocate());
+
+    std::vector<Payload> vector(numObjects);
+
+    std::unordered_map<uint32_t, Payload> map;
+    std::vector<uint32_t> ids(numObjects);
+    uint32_t nextId = 0;
+    for (uint32_t& id : ids) map.try_emplace(id = nextId++);
+
+    size_t numStaleHits = 0;
+    const Result result{
+        .pool = nsPerOp(numOps, [&] {
+            uint64_t sum = 0;
+            for (uint32_t victim : victims) {
+                const Handle<Payload> stale = handles[victim];
+                pool.deallocate(stale);
+                handles[victim] = pool.allocate();
+                numStaleHits += pool.get(stale) != nullptr;
+                sum += pool.get(handles[victim])->data[0];
+            }
+            return sum;
+        }),
+        .vector = nsPerOp(numOps, [&] {
+            uint64_t sum = 0;
+            for (uint32_t victim : victims) {
+                vector[victim] = Payload{};
+                sum += vector[victim].data[0];
+            }
+            return sum;
+        }),
+        .map = nsPerOp(numOps, [&] {
+            uint64_t sum = 0;
+            for (uint32_t victim : victims) {
+                const uint32_t stale = ids[victim];
+                map.erase(stale);
+                map.try_emplace(ids[victim] = nextId++);
+                numStaleHits += map.contains(stale);
+                sum += map.find(ids[victim])->second.data[0];
+            }
+            return sum;
+        })
+    };
+
+    if (numStaleHits > 0) fmt::println("Error: {} stale handles resolved during churn", numStaleHits);
+    return result;
+}
+
+//------------------------------------------------------------------------
+
+// Growing from nothing, so that every doubling of the pool is part of the measurement.
+Result benchResize(size_t numObjects)
+{
+    return {
+        .pool = nsPerOp(numObjects, [&] {
+            ObjectPool<Payload> pool{1};
+            for ([[maybe_unused]] size_t idx : stdv::iota(0u, numObjects)) (void)pool.allocate();
+            return pool.size();
+        }),
+        .vector = nsPerOp(numObjects, [&] {
+            std::vector<Payload> vector;
+            for ([[maybe_unused]] size_t idx : stdv::iota(0u, numObjects)) vector.emplace_back();
+            return vector.size();
+        }),
+        .map = nsPerOp(numObjects, [&] {
+            std::unordered_map<uint32_t, Payload> map;
+            for (uint32_t id : stdv::iota(0u, implicit_cast<uint32_t>(numObjects))) map.try_emplace(id);
+            return map.size();
+        })
+    };
+}
+
+//------------------------------------------------------------------------
+
+Result benchStack(size_t numObjects)
+{
+    Stack<uint32_t> stack{numObjects};
+    std::vector<uint32_t> vector;
+    vector.reserve(numObjects);
+
+    return {
+        .pool = nsPerOp(2 * numObjects, [&] {
+            for (uint32_t idx : stdv::iota(0u, implicit_cast<uint32_t>(numObjects))) stack.push(idx);
+            uint64_t sum = 0;
+            while (stack.size() > 0) {
+                sum += stack.top();
+                stack.pop();
+            }
+            return sum;
+        }),
+        .vector = nsPerOp(2 * numObjects, [&] {
+            for (uint32_t idx : stdv::iota(0u, implicit_cast<uint32_t>(numObjects))) vector.push_back(idx);
+            uint64_t sum = 0;
+            while (not vector.empty()) {
+                sum += vector.back();
+                vector.pop_back();
+            }
+            return sum;
+        })
+    };
+}
+
+//------------------------------------------------------------------------
+
+// Models are the one managed type that owns no GL objects, so this needs no context.
+Result benchResourceManager(size_t numObjects, std::mt19937_64& rng)
+{
+    ResourceManager mngr;
+    std::vector<Handle<Model>> handles(numObjects);
+    const std::vector<uint32_t> order = shuffledIndices(numObjects, rng);
+
+    return {
+        .pool = nsPerOp(3 * numObjects, [&] {
+            for (Handle<Model>& handle : handles) handle = mngr.createModel({.mngr = &mngr});
+            uint64_t numFound = 0;
+            for (uint32_t idx : order) numFound += mngr.exists(handles[idx]);
+            for (const Handle<Model>& handle : handles) mngr.destroy(handle);
+            return numFound;
+        })
+    };
+}
+
+//------------------------------------------------------------------------
+
+// The pool side of ResourceManager's createPending*() and finalizePending(), which needs no GL context: loader threads
+// reserve in batches and queue the handles under a mutex, while the owner swaps the queue out, publishes everything in
+// it and deallocates it again.
+double benchPending(uint32_t numLoaders, size_t numObjectsPerLoader)
+{
+    static constexpr size_t batchSize = 64;
+    const size_t numBatches = std::max(implicit_cast<size_t>(1), numObjectsPerLoader / batchSize);
+    ObjectPool<Payload> pool;
+    std::mutex queueMutex;
+    std::vector<Handle<Payload>> queue;
+
+    return nsPerOp(numLoaders * numBatches * batchSize, [&] {
+        std::atomic_uint32_t numDone = 0;
+        std::vector<std::jthread> loaders;
+        for ([[maybe_unused]] uint32_t loaderIdx : stdv::iota(0u, numLoaders)) {
+            loaders.emplace_back([&] {
+                std::array<Handle<Payload>, batchSize> handles;
+                for ([[maybe_unused]] size_t batch : stdv::iota(0u, numBatches)) {
+                    for (Handle<Payload>& handle : handles) handle = pool.reserve();
+                    const std::scoped_lock lock{queueMutex};
+                    queue.insert(queue.end(), handles.begin(), handles.end());
+                }
+                ++numDone;
+            });
+        }
+
+        uint64_t numPublished = 0;
+        std::vector<Handle<Payload>> pending;
+        while (true) {
+            // Read before the swap, so that the last round finds everything queued.
+            const bool isLastRound = numDone.load() == numLoaders;
+            {
+                const std::scoped_lock lock{queueMutex};
+                std::swap(pending, queue);
+            }
+            if (pending.empty()) std::this_thread::yield();
+            for (const Handle<Payload>& handle : pending) numPublished += pool.publish(handle);
+            for (const Handle<Payload>& handle : pending) pool.deallocate(handle);
+            pending.clear();
+            if (isLastRound) break;
+        }
+        return numPublished;
+    });
+}
+
+//------------------------------------------------------------------------
+
+// The simplest thread-safe pool, for comparison: a vector and a stack of free indices behind one mutex.
+class LockedPool
+{
+public:
+    [[nodiscard]] uint32_t allocate()
+    {
+        const std::scoped_lock lock{m_mutex};
+        if (m_free.empty()) {
+            m_free.push_back(implicit_cast<uint32_t>(m_items.size()));
+            m_items.emplace_back(std::make_unique<Payload>());
+        }
+        const uint32_t idx = m_free.back();
+        m_free.pop_back();
+        *m_items[idx] = Payload{};
+        return idx;
+    }
+
+    [[nodiscard]] Payload* get(uint32_t idx)
+    {
+        const std::scoped_lock lock{m_mutex};
+        return m_items[idx].get();
+    }
+
+    void deallocate(uint32_t idx)
+    {
+        const std::scoped_lock lock{m_mutex};
+        m_free.push_back(idx);
+    }
+
+private:
+    std::mutex m_mutex;
+    std::vector<std::unique_ptr<Payload>> m_items;
+    std::vector<uint32_t> m_free;
+};
+
+//------------------------------------------------------------------------
+
+// Runs fn() on numThreads threads started together, the calling one among them, and returns the wall time per operation
+// over all threads.
+template<typename F>
+double nsPerOpConcurrent(uint32_t numThreads, size_t numOpsPerThread, F&& fn)
+{
+    return nsPerOp(numThreads * numOpsPerThread, [&] {
+        std::barrier start(numThreads);
+        std::vector<std::jthread> threads;
+        std::atomic_uint64_t sum = 0;
+        for ([[maybe_unused]] uint32_t threadIdx : stdv::iota(1u, numThreads)) {
+            threads.emplace_back([&] {
+                start.arrive_and_wait();
+                sum += fn();
+            });
+        }
+        start.arrive_and_wait();
+        sum += fn();
+        threads.clear();
+        return sum.load();
+    });
+}
+
+//------------------------------------------------------------------------
+
+// Each thread repeatedly allocates a batch, looks every object up and deallocates the batch again, as loader threads
+// creating and dropping resources would. Three operations per object.
+void benchConcurrent(size_t numObjects)
+{
+    static constexpr size_t batchSize = 64;
+    const size_t numBatches = std::max(implicit_cast<size_t>(1), numObjects / batchSize);
+    const uint32_t maxThreads = std::max(8u, std::thread::hardware_concurrency());
+
+    for (uint32_t numThreads = 1; numThreads <= maxThreads; numThreads *= 2) {
+        ObjectPool<Payload> pool;
+        LockedPool lockedPool;
+        ResourceManager mngr;
+
+        const double poolNs = nsPerOpConcurrent(numThreads, 3 * numBatches * batchSize, [&] {
+            std::array<Handle<Payload>, batchSize> handles;
+            uint64_t sum = 0;
+            for ([[maybe_unused]] size_t batch : stdv::iota(0u, numBatches)) {
+                for (Handle<Payload>& handle : handles) handle = pool.allocate();
+                for (const Handle<Payload>& handle : handles) sum += pool.get(handle)->data[0];
+                for (const Handle<Payload>& handle : handles) pool.deallocate(handle);
+            }
+            return sum;
+        });
+        const double lockedNs = nsPerOpConcurrent(numThreads, 3 * numBatches * batchSize, [&] {
+            std::array<uint32_t, batchSize> indices;
+            uint64_t sum = 0;
+            for ([[maybe_unused]] size_t batch : stdv::iota(0u, numBatches)) {
+                for (uint32_t& idx : indices) idx = lockedPool.allocate();
+                for (uint32_t idx : indices) sum += lockedPool.get(idx)->data[0];
+                for (uint32_t idx : indices) lockedPool.deallocate(idx);
+            }
+            return sum;
+        });
+        printResult(fmt::format("concurrent churn, {} threads", numThreads), {.pool = poolNs, .vector = lockedNs});
+
+        const double modelNs = nsPerOpConcurrent(numThreads, 3 * numBatches * batchSize, [&] {
+            std::array<Handle<Model>, batchSize> handles;
+            uint64_t numFound = 0;
+            for ([[maybe_unused]] size_t batch : stdv::iota(0u, numBatches)) {
+                for (Handle<Model>& handle : handles) handle = mngr.createModel({.mngr = &mngr});
+                for (const Handle<Model>& handle : handles) numFound += mngr.exists(handle);
+                for (const Handle<Model>& handle : handles) mngr.destroy(handle);
+            }
+            return numFound;
+        });
+        printResult(fmt::format("createModel churn, {} threads", numThreads), {.pool = modelNs});
+
+        if (numThreads > 1) {
+            printResult(fmt::format("pending, {} loaders", numThreads - 1),
+                {.pool = benchPending(numThreads - 1, numBatches * batchSize)});
+        }
+    }
+}
+
+//------------------------------------------------------------------------
+
+}  // namespace
+
+//------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+    size_t numObjects = 1 << 16;
+    if (argc > 1) {
+        const std::string_view arg{argv[1]};
+        std::from_chars(arg.data(), arg.data() + arg.size(), numObjects);
+    }
+
+    std::mt19937_64 rng{RNG_SEED};
+
+    fmt::println("{} objects of {} bytes, ns/op", numObjects, sizeof(Payload));
+    fmt::println("{:<32} {:>12} {:>12} {:>14}", "Benchmark", "Zhade", "std::vector", "unordered_map");
+    printResult("allocate + deallocate", benchAllocateDeallocate(numObjects));
+    printResult("get (random order)", benchGet(numObjects, rng));
+    printResult("iterate live", benchIterate(numObjects, rng));
+    printResult("churn with generation checks", benchChurn(numObjects, rng));
+    printResult("resize under load", benchResize(numObjects));
+    printResult("Stack push + pop", benchStack(numObjects));
+
+    // Lookups as the live set outgrows each cache level.
+    for (size_t numLive = 1 << 10; numLive <= (1 << 22); numLive <<= 2) {
+        printResult(fmt::format("get, {} KiB live", numLive * sizeof(Payload) / KIB_BYTES), benchGet(numLive, rng));
+    }
+
+    printResult("ResourceManager create/get/destroy", benchResourceManager(numObjects, rng));
+
+    // Against a mutex-guarded pool, which the std::vector column stands for here.
+    benchConcurrent(numObjects);
+
+    return 0;
+}
+
+//------------------------------------------------------------------------
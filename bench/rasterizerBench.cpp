@@ -0,0 +1,145 @@
+#include "Camera.hpp"
+#include "DepthRasterizer.hpp"
+#include "common.hpp"
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+
+#include <chrono>
+#include <charconv>
+#include <span>
+#include <string_view>
+#include <vector>
+
+//------------------------------------------------------------------------
+// Measures software depth rasterization throughput on sponza, for the shadow pass and a coarse camera depth buffer.
+// Usage: ZhadeRasterizerBench [iterations]
+
+namespace
+{
+
+//------------------------------------------------------------------------
+
+using namespace Zhade;
+
+struct SceneData
+{
+    std::vector<Vertex> vertices;
+    std::vector<GLuint> indices;
+    std::vector<Mesh> meshes;
+};
+
+struct BenchConfig
+{
+    std::string_view name;
+    glm::ivec2 dims;
+    ViewProjMatrices matrices;
+};
+
+//------------------------------------------------------------------------
+
+SceneData loadScene(const fs::path& path)
+{
+    Assimp::Importer importer{};
+    const aiScene* aiScenePtr = importer.ReadFile(path.string().c_str(), ASSIMP_LOAD_FLAGS);
+    if (aiScenePtr == nullptr) {
+        fmt::println("Error loading {}: {}", path.string(), importer.GetErrorString());
+        return {};
+    }
+
+    SceneData scene;
+    scene.meshes = std::vector<Mesh>(aiScenePtr->mNumMeshes);
+
+    for (uint32_t meshIdx : stdv::iota(0u, aiScenePtr->mNumMeshes)) {
+        const aiMesh* aiMeshPtr = aiScenePtr->mMeshes[meshIdx];
+        Mesh& mesh = scene.meshes[meshIdx];
+        mesh.firstIndex = implicit_cast<GLuint>(scene.indices.size());
+        mesh.baseVertex = implicit_cast<GLuint>(scene.vertices.size());
+        mesh.modelMatT = glm::mat3x4{1.0f};
+
+        for (uint32_t idx : stdv::iota(0u, aiMeshPtr->mNumVertices)) {
+            scene.vertices.push_back({.pos = util::vec3FromAiVector3D(aiMeshPtr->mVertices[idx])});
+        }
+        for (const aiFace& face : std::span{aiMeshPtr->mFaces, aiMeshPtr->mNumFaces}) {
+            scene.indices.insert(scene.indices.end(), face.mIndices, face.mIndices + face.mNumIndices);
+        }
+        mesh.numIndices = implicit_cast<GLuint>(scene.indices.size()) - mesh.firstIndex;
+    }
+
+    return scene;
+}
+
+//------------------------------------------------------------------------
+
+// Mirrors DirectionalLight::setupMatrices for the sun used by main.cpp.
+ViewProjMatrices makeShadowMatrices()
+{
+    const glm::vec3 position{-1163.729858, 4203.104980, -258.124634};
+    const glm::vec3 direction{0.273005, -0.960278, 0.057737};
+    return {
+        .viewMatT = glm::transpose(glm::lookAt(position, position + direction, util::makeUnitVec3y())),
+        .projMat = glm::ortho(-1000.0f, 1000.0f, 1000.0f, -1000.0f, 10.0f, 10'000.0f)
+    };
+}
+
+// Mirrors the initial state of Camera with default settings.
+ViewProjMatrices makeCameraMatrices()
+{
+    const CameraSettings settings{};
+    const PerspectiveSettings perspective{};
+    return {
+        .viewMatT = glm::transpose(glm::lookAt(settings.center, settings.center + settings.target, settings.up)),
+        .projMat = glm::perspective(perspective.fov, perspective.aspectRatio, settings.zNear, settings.zFar)
+    };
+}
+
+//------------------------------------------------------------------------
+
+}  // namespace
+
+//------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+    uint32_t numIterations = 20;
+    if (argc > 1) {
+        const std::string_view arg{argv[1]};
+        std::from_chars(arg.data(), arg.data() + arg.size(), numIterations);
+    }
+
+    const SceneData scene = loadScene(SPONZA_PATH);
+    const DepthRasterizerInput input{
+        .vertices = scene.vertices,
+        .indices = scene.indices,
+        .meshes = scene.meshes
+    };
+    fmt::println("{} meshes, {} triangles", scene.meshes.size(), scene.indices.size() / 3);
+
+    const BenchConfig configs[] = {
+        {.name = "Shadow map", .dims = {2048, 2048}, .matrices = makeShadowMatrices()},
+        {.name = "Coarse camera depth", .dims = {480, 270}, .matrices = makeCameraMatrices()}
+    };
+
+    fmt::println("{:<20} {:>8} {:>12} {:>14}", "Config", "Threads", "ms/frame", "Mtris/s");
+    for (const BenchConfig& config : configs) {
+        const uint32_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+        for (uint32_t numThreads = 1; numThreads <= maxThreads; numThreads *= 2) {
+            DepthRasterizer rasterizer{{.dims = config.dims, .numThreads = numThreads}};
+            rasterizer.rasterize(input, config.matrices);  // Warm-up, sizes the bins.
+
+            const auto start = std::chrono::steady_clock::now();
+            for ([[maybe_unused]] uint32_t iteration : stdv::iota(0u, numIterations)) {
+                rasterizer.rasterize(input, config.matrices);
+            }
+            const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+            const double msPerFrame = elapsed.count() / numIterations;
+            const double mtrisPerSecond = rasterizer.numSubmittedTriangles() / (msPerFrame * 1'000.0);
+            fmt::println("{:<20} {:>8} {:>12.3f} {:>14.2f}", config.name, numThreads, msPerFrame, mtrisPerSecond);
+        }
+    }
+
+    return 0;
+}
+
+//------------------------------------------------------------------------
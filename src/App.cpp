@@ -2,9 +2,23 @@
 
 #include "Buffer.hpp"
 #include "Camera.hpp"
+#include "Renderer.hpp"
+#include "ResourceManager.hpp"
 #include "StbImageResource.hpp"
+#include "Texture.hpp"
+#include "TextureResidency.hpp"
 #include "util.hpp"
 
+#include <bit>
+#include <charconv>
+#include <string_view>
+
+#ifdef ZHADE_HAS_EGL
+extern "C" {
+#include <EGL/eglext.h>
+}
+#endif
+
 //------------------------------------------------------------------------
 
 namespace Zhade
@@ -12,39 +26,73 @@ namespace Zhade
 
 //------------------------------------------------------------------------
 
-App::~App()
+LaunchOptions LaunchOptions::fromArgs(int argc, char* argv[])
 {
-    ImGui_ImplOpenGL3_Shutdown();
-    ImGui_ImplGlfw_Shutdown();
-    ImGui::DestroyContext();
-    glfwTerminate();
+    LaunchOptions options;
+
+    for (int idx = 1; idx < argc; ++idx) {
+        const std::string_view arg{argv[idx]};
+        const bool hasValue = idx + 1 < argc;
+
+        if (arg == "--headless") {
+            options.headless = true;
+        } else if (arg == "--frames" and hasValue) {
+            const std::string_view value{argv[++idx]};
+            uint32_t numFrames = 0;
+            std::from_chars(value.data(), value.data() + value.size(), numFrames);
+            options.numFrames = numFrames;
+        } else if (arg == "--dump-color" and hasValue) {
+            options.colorDumpPath = argv[++idx];
+        } else if (arg == "--dump-depth" and hasValue) {
+            options.depthDumpPath = argv[++idx];
+        } else if (arg == "--texture-arrays") {
+            options.textureArrays = true;
+        } else if (arg == "--texture-budget" and hasValue) {
+            const std::string_view value{argv[++idx]};
+            size_t budgetMiB = 0;
+            std::from_chars(value.data(), value.data() + value.size(), budgetMiB);
+            options.textureBudgetMiB = budgetMiB;
+        } else {
+            fmt::println("Ignoring unknown argument {}", arg);
+        }
+    }
+
+    return options;
 }
 
 //------------------------------------------------------------------------
 
-void App::init()
+App::~App()
 {
-    // GLFW.
-    glfwInit();
+    if (ImGui::GetCurrentContext() != nullptr) {
+        ImGui_ImplOpenGL3_Shutdown();
+        if (not m_headless) ImGui_ImplGlfw_Shutdown();
+        ImGui::DestroyContext();
+    }
 
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
-    glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
+#ifdef ZHADE_HAS_EGL
+    if (m_eglContext != EGL_NO_CONTEXT) {
+        eglMakeCurrent(m_eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext(m_eglDisplay, m_eglContext);
+        eglTerminate(m_eglDisplay);
+    }
+#endif
+    glfwTerminate();
+}
 
-    m_window = glfwCreateWindow(s_windowWidth, s_windowHeight, s_title.data(), nullptr, nullptr);
-    glfwSetInputMode(m_window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-    glfwMakeContextCurrent(m_window);
-    glfwSetKeyCallback(m_window, glfwKeyCallback);
-    glfwSetCursorPosCallback(m_window, glfwMouseCallback);
-    glfwSetScrollCallback(m_window, Camera<>::scrollCallback);
+//------------------------------------------------------------------------
 
-    glfwSwapInterval(0);
+bool App::init(const LaunchOptions& options)
+{
+    m_headless = options.headless;
+    if (not (m_headless ? initHeadlessContext() : initWindow())) return false;
 
-    // GLEW.
+    // GLEW. Without a GLX display (i.e. on an EGL context) glewInit() reports GLEW_ERROR_NO_GLX_DISPLAY after it has
+    // already loaded the core and extension entry points, so that particular error is harmless.
     glewExperimental = GL_TRUE;
-    glewInit();
+    if (const GLenum err = glewInit(); err != GLEW_OK and not (m_headless and err == GLEW_ERROR_NO_GLX_DISPLAY)) {
+        fmt::println("Error initializing GLEW: {}", std::bit_cast<const char*>(glewGetErrorString(err)));
+    }
 
     // OpenGL.
     glDebugMessageCallback(glDebugCallback, nullptr);
@@ -54,36 +102,325 @@ void App::init()
     glCullFace(GL_BACK);
     glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &BufferUsage2Alignment[BufferUsage::UNIFORM]);
     glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &BufferUsage2Alignment[BufferUsage::STORAGE]);
+    // As many threads as the driver likes, for pipelines to compile in the background until Pipeline::resolve().
+    if (GLEW_KHR_parallel_shader_compile) glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+    // Before any texture or pipeline is created, as both depend on it. Software rasterizers such as llvmpipe lack
+    // bindless textures, and fall back to texture arrays.
+    Texture::s_useBindless = not options.textureArrays and GLEW_ARB_bindless_texture;
+    if (not Texture::s_useBindless) fmt::println("Using texture arrays instead of bindless textures");
 
     // stb.
     stbi_set_flip_vertically_on_load(1);
 
-    // ImGui.
+    // ImGui. Headless runs never draw the GUI, but the context still provides the frame delta time.
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
-    ImGui_ImplGlfw_InitForOpenGL(m_window, true);
+    if (m_headless) {
+        ImGui::GetIO().DisplaySize = ImVec2(s_windowWidth, s_windowHeight);
+    } else {
+        ImGui_ImplGlfw_InitForOpenGL(m_window, true);
+    }
     ImGui_ImplOpenGL3_Init("#version 460 core");
     ImGui::StyleColorsDark();
+
+    return true;
+}
+
+//------------------------------------------------------------------------
+
+bool App::initWindow()
+{
+    if (glfwInit() == GLFW_FALSE) {
+        fmt::println("Error initializing GLFW");
+        return false;
+    }
+
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
+    glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
+
+    m_window = glfwCreateWindow(s_windowWidth, s_windowHeight, s_title.data(), nullptr, nullptr);
+    if (m_window == nullptr) {
+        fmt::println("Error creating a window with a GL 4.6 context");
+        return false;
+    }
+    glfwSetInputMode(m_window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    glfwMakeContextCurrent(m_window);
+    glfwSetKeyCallback(m_window, glfwKeyCallback);
+    glfwSetCursorPosCallback(m_window, glfwMouseCallback);
+    glfwSetScrollCallback(m_window, Camera<>::scrollCallback);
+
+    glfwSwapInterval(0);
+
+    return true;
 }
 
 //------------------------------------------------------------------------
 
-void App::updateAndRenderGUI()
+bool App::initHeadlessContext()
 {
+#ifdef ZHADE_HAS_EGL
+    // Prefer Mesa's surfaceless platform, which needs neither a display server nor a GPU (e.g. llvmpipe).
+    auto getPlatformDisplay = std::bit_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+        eglGetProcAddress("eglGetPlatformDisplayEXT")
+    );
+    if (getPlatformDisplay != nullptr) {
+        m_eglDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    }
+    if (m_eglDisplay == EGL_NO_DISPLAY) {
+        m_eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+    if (m_eglDisplay == EGL_NO_DISPLAY or eglInitialize(m_eglDisplay, nullptr, nullptr) == EGL_FALSE) {
+        fmt::println("Error initializing EGL display: {:#x}, trying a hidden window", eglGetError());
+        m_eglDisplay = EGL_NO_DISPLAY;
+        return initHiddenWindow();
+    }
+    eglBindAPI(EGL_OPENGL_API);
+
+    static constexpr EGLint configAttribs[] = {
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+    EGLConfig config = nullptr;
+    EGLint numConfigs = 0;
+    eglChooseConfig(m_eglDisplay, configAttribs, &config, 1, &numConfigs);
+
+    static constexpr EGLint contextAttribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 4,
+        EGL_CONTEXT_MINOR_VERSION, 6,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_CONTEXT_OPENGL_DEBUG, EGL_TRUE,
+        EGL_NONE
+    };
+    m_eglContext = eglCreateContext(m_eglDisplay, numConfigs > 0 ? config : EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT,
+        contextAttribs);
+    if (m_eglContext == EGL_NO_CONTEXT
+        or eglMakeCurrent(m_eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, m_eglContext) == EGL_FALSE) {
+        fmt::println("Error creating a surfaceless GL 4.6 context: {:#x}, trying a hidden window", eglGetError());
+        if (m_eglContext != EGL_NO_CONTEXT) eglDestroyContext(m_eglDisplay, m_eglContext);
+        eglTerminate(m_eglDisplay);
+        m_eglContext = EGL_NO_CONTEXT;
+        m_eglDisplay = EGL_NO_DISPLAY;
+        return initHiddenWindow();
+    }
+    return true;
+#else
+    // No EGL on this platform.
+    return initHiddenWindow();
+#endif
+}
+
+//------------------------------------------------------------------------
+
+// A context owned by a window that is never shown, for headless runs where a display server is at hand after all.
+bool App::initHiddenWindow()
+{
+    if (glfwInit() == GLFW_FALSE) {
+        fmt::println("Error initializing GLFW, no GL context left to try");
+        return false;
+    }
+
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+    m_window = glfwCreateWindow(s_windowWidth, s_windowHeight, s_title.data(), nullptr, nullptr);
+    if (m_window == nullptr) {
+        fmt::println("Error creating a hidden window with a GL 4.6 context, no GL context left to try");
+        return false;
+    }
+    glfwMakeContextCurrent(m_window);
+    return true;
+}
+
+//------------------------------------------------------------------------
+
+void App::publishInput()
+{
+    m_inputSamples.write({.state = s_state, .time = std::chrono::steady_clock::now()});
+}
+
+//------------------------------------------------------------------------
+
+void App::updateAndRenderGUI(Renderer& renderer)
+{
+    Profiler& profiler = renderer.profiler();
+    const auto cpuScope = profiler.cpuScope("GUI");
+
     ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
 
-    ImGui::Begin("Foo");
-    ImGui::Text("Bar");
+    ImGui::Begin("Zhade");
+    int shadowFilter = renderer.shadowFilter();
+    if (ImGui::Combo("Shadow filter", &shadowFilter, ShadowFilter2Name, ShadowFilter::NUM_SHADOW_FILTERS)) {
+        renderer.setShadowFilter(implicit_cast<ShadowFilter::Type>(shadowFilter));
+    }
+    int renderPath = renderer.renderPath();
+    if (ImGui::Combo("Render path", &renderPath, RenderPath2Name, RenderPath::NUM_RENDER_PATHS)) {
+        renderer.setRenderPath(implicit_cast<RenderPath::Type>(renderPath));
+    }
+    int maxFramesInFlight = implicit_cast<int>(renderer.framePacer().maxFramesInFlight());
+    if (ImGui::SliderInt("Max frames in flight", &maxFramesInFlight, 1, implicit_cast<int>(FRAMES_IN_FLIGHT))) {
+        renderer.framePacer().setMaxFramesInFlight(implicit_cast<uint32_t>(maxFramesInFlight));
+    }
+    if (ImGui::Button("Validate software shadow map")) {
+        m_depthComparison = renderer.validateSoftwareShadowMap();
+    }
+    if (m_depthComparison) {
+        const auto& [maxAbsError, meanAbsError, numMismatched, numCompared] = *m_depthComparison;
+        ImGui::Text("Max error %.2e, mean error %.2e", maxAbsError, meanAbsError);
+        ImGui::Text("%zu of %zu texels mismatch", numMismatched, numCompared);
+    }
+    if (ImGui::Button("Dump render graph")) {
+        static const fs::path graphPath = "zhade_render_graph.dot";
+        if (renderer.dumpRenderGraph(graphPath)) {
+            fmt::println("Wrote render graph to {}", fs::absolute(graphPath).string());
+        }
+    }
+    if (ImGui::CollapsingHeader("Dynamic resolution")) {
+        updateDynamicResolutionGUI(renderer.dynamicResolution());
+    }
+    if (ImGui::CollapsingHeader("Memory")) {
+        updateMemoryGUI(renderer.resourceManager());
+        if (Texture::s_useBindless) updateTextureResidencyGUI(renderer.scene().textureResidency());
+    }
+    if (ImGui::CollapsingHeader("Profiler", ImGuiTreeNodeFlags_DefaultOpen)) {
+        updateProfilerGUI(profiler);
+    }
     ImGui::End();
 
+    const auto gpuScope = profiler.gpuScope("GUI");
     ImGui::Render();
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
 
 //------------------------------------------------------------------------
 
+void App::updateDynamicResolutionGUI(DynamicResolution& dynamicResolution)
+{
+    bool enabled = dynamicResolution.enabled();
+    if (ImGui::Checkbox("Enabled", &enabled)) {
+        dynamicResolution.setEnabled(enabled);
+    }
+    float targetMs = dynamicResolution.targetMs();
+    if (ImGui::SliderFloat("GPU budget (ms)", &targetMs, 1.0f, 50.0f, "%.1f")) {
+        dynamicResolution.setTargetMs(targetMs);
+    }
+    float minScale = dynamicResolution.minScale();
+    float maxScale = dynamicResolution.maxScale();
+    const bool minChanged = ImGui::SliderFloat("Min scale", &minScale, 0.1f, 1.0f, "%.2f");
+    const bool maxChanged = ImGui::SliderFloat("Max scale", &maxScale, 0.1f, 1.0f, "%.2f");
+    if (minChanged or maxChanged) {
+        dynamicResolution.setScaleBounds(minScale, maxScale);
+    }
+    const glm::ivec2 dims = dynamicResolution.scaledDims({s_windowWidth, s_windowHeight});
+    ImGui::Text("Scale %.2f, rendering at %dx%d", dynamicResolution.scale(), dims.x, dims.y);
+}
+
+//------------------------------------------------------------------------
+
+void App::updateMemoryGUI(ResourceManager& mngr)
+{
+    static constexpr float mib = 1024.0f * 1024.0f;
+    static constexpr ImGuiTableFlags tableFlags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg;
+    const MemoryReport report = mngr.memoryReport();
+
+    if (ImGui::BeginTable("Memory", 5, tableFlags)) {
+        ImGui::TableSetupColumn("Tag");
+        ImGui::TableSetupColumn("Type");
+        ImGui::TableSetupColumn("Count");
+        ImGui::TableSetupColumn("MiB");
+        ImGui::TableSetupColumn("Wasted MiB");
+        ImGui::TableHeadersRow();
+        for (const auto& [tag, usage] : report.perTag) {
+            for (MemoryType::Type type = 0; type < MemoryType::NUM_MEMORY_TYPES; ++type) {
+                const auto& [numResources, byteSize, usedByteSize] = usage[type];
+                if (numResources == 0) continue;
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::Text("%.*s", implicit_cast<int>(tag.size()), tag.data());
+                ImGui::TableNextColumn();
+                ImGui::Text("%s", MemoryType2Name[type]);
+                ImGui::TableNextColumn();
+                ImGui::Text("%zu", numResources);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.2f", byteSize / mib);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.2f", (byteSize - usedByteSize) / mib);
+            }
+        }
+        ImGui::EndTable();
+    }
+    for (MemoryType::Type type = 0; type < MemoryType::NUM_MEMORY_TYPES; ++type) {
+        const auto& [numResources, byteSize, usedByteSize] = report.total[type];
+        ImGui::Text("%s: %zu using %.2f MiB, %.2f MiB wasted", MemoryType2Name[type], numResources,
+            byteSize / mib, (byteSize - usedByteSize) / mib);
+    }
+    if (ImGui::Button("Dump memory report")) {
+        static const fs::path reportPath = "zhade_memory.json";
+        if (mngr.dumpMemoryReport(reportPath)) {
+            fmt::println("Wrote memory report to {}", fs::absolute(reportPath).string());
+        }
+    }
+}
+
+//------------------------------------------------------------------------
+
+void App::updateTextureResidencyGUI(TextureResidency& residency)
+{
+    static constexpr float mib = 1024.0f * 1024.0f;
+    auto budgetMiB = implicit_cast<int>(residency.budgetByteSize() / MIB_BYTES);
+    if (ImGui::SliderInt("Texture budget (MiB)", &budgetMiB, 16, 4096)) {
+        residency.setBudgetByteSize(implicit_cast<size_t>(budgetMiB) * MIB_BYTES);
+    }
+    const TextureResidencyStats& stats = residency.stats();
+    ImGui::Text("Textures using %.2f MiB, %u reloading", stats.byteSize / mib, stats.numReloading);
+    for (ResidencyState::Type state = 0; state < ResidencyState::NUM_RESIDENCY_STATES; ++state) {
+        ImGui::Text("%s: %u", ResidencyState2Name[state], stats.numTextures[state]);
+    }
+}
+
+//------------------------------------------------------------------------
+
+void App::updateProfilerGUI(Profiler& profiler)
+{
+    static constexpr ImGuiTableFlags tableFlags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg;
+    if (ImGui::BeginTable("Timers", 5, tableFlags)) {
+        ImGui::TableSetupColumn("Scope (ms)");
+        ImGui::TableSetupColumn("Last");
+        ImGui::TableSetupColumn("Min");
+        ImGui::TableSetupColumn("Avg");
+        ImGui::TableSetupColumn("P99");
+        ImGui::TableHeadersRow();
+        for (const auto& [name, gpu, stats] : profiler.report()) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Text("%s %.*s", gpu ? "GPU" : "CPU", implicit_cast<int>(name.size()), name.data());
+            for (const float value : {stats.last, stats.min, stats.avg, stats.p99}) {
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", value);
+            }
+        }
+        ImGui::EndTable();
+    }
+    if (profiler.numDroppedQueries() > 0) {
+        ImGui::Text("%zu GPU timings dropped as not ready in time", profiler.numDroppedQueries());
+    }
+    if (ImGui::Button("Export Chrome trace")) {
+        static const fs::path tracePath = "zhade_trace.json";
+        if (profiler.exportChromeTrace(tracePath)) {
+            fmt::println("Wrote trace to {}", fs::absolute(tracePath).string());
+        }
+    }
+}
+
+//------------------------------------------------------------------------
+
 }  // namespace Zhade
 
 //------------------------------------------------------------------------
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "DepthRasterizer.hpp"
+#include "TripleBuffer.hpp"
 #include "util.hpp"
 
 #include <fmt/core.h>
@@ -14,9 +16,17 @@ extern "C" {
 #include <imgui_impl_opengl3.h>
 
 #include <array>
+#include <chrono>
 #include <cstdint>
+#include <optional>
 #include <string_view>
 
+#ifdef ZHADE_HAS_EGL
+extern "C" {
+#include <EGL/egl.h>
+}
+#endif
+
 //------------------------------------------------------------------------
 
 namespace Zhade
@@ -24,6 +34,24 @@ namespace Zhade
 
 //------------------------------------------------------------------------
 
+class DynamicResolution;
+class Profiler;
+class Renderer;
+class ResourceManager;
+class TextureResidency;
+
+struct LaunchOptions
+{
+    bool headless = false;
+    std::optional<uint32_t> numFrames{};
+    fs::path colorDumpPath{};
+    fs::path depthDumpPath{};
+    bool textureArrays = false;  // Even if bindless textures are supported.
+    std::optional<size_t> textureBudgetMiB{};
+
+    [[nodiscard]] static LaunchOptions fromArgs(int argc, char* argv[]);
+};
+
 class App
 {
 public:
@@ -34,6 +62,13 @@ public:
         float yaw = -glm::half_pi<float>();
     };
 
+    // The input state as of one poll of the GLFW events.
+    struct InputSample
+    {
+        GLFWState state;
+        std::chrono::steady_clock::time_point time;
+    };
+
     App() = default;
     ~App();
 
@@ -46,8 +81,13 @@ public:
     float deltaTime() { return ImGui::GetIO().DeltaTime; }
     const GLFWState& getGLFWState() { return s_state; }
 
-    void init();
-    void updateAndRenderGUI();
+    // Call right after polling the GLFW events, so that another thread can read them through latestInput().
+    void publishInput();
+    [[nodiscard]] const InputSample& latestInput() { return m_inputSamples.read(); }
+    bool isHeadless() { return m_headless; }
+
+    [[nodiscard]] bool init(const LaunchOptions& options = {});  // False without a GL context, with the reason printed.
+    void updateAndRenderGUI(Renderer& renderer);
 
     // According to the GLFW input reference.
     static void glfwKeyCallback(GLFWwindow* window, int key, [[maybe_unused]] int scancode, int action, int mode)
@@ -89,9 +129,24 @@ public:
     static constexpr uint32_t s_windowHeight = 1080u;
 
 private:
+    [[nodiscard]] bool initWindow();
+    [[nodiscard]] bool initHeadlessContext();
+    [[nodiscard]] bool initHiddenWindow();
+    void updateProfilerGUI(Profiler& profiler);
+    void updateDynamicResolutionGUI(DynamicResolution& dynamicResolution);
+    void updateMemoryGUI(ResourceManager& mngr);
+    void updateTextureResidencyGUI(TextureResidency& residency);
+
     static inline GLFWState s_state;
 
     GLFWwindow* m_window = nullptr;
+    bool m_headless = false;
+#ifdef ZHADE_HAS_EGL
+    EGLDisplay m_eglDisplay = EGL_NO_DISPLAY;
+    EGLContext m_eglContext = EGL_NO_CONTEXT;
+#endif
+    std::optional<DepthComparison> m_depthComparison;
+    TripleBuffer<InputSample> m_inputSamples;
 };
 
 //------------------------------------------------------------------------
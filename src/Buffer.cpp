@@ -10,12 +10,17 @@ namespace Zhade
 Buffer::Buffer(BufferDescriptor desc)
     : m_usage{desc.usage},
       m_wholeByteSize{desc.byteSize},
-      m_managed{desc.managed}
+      m_managed{desc.managed},
+      m_tag{desc.tag}
 {
     glCreateBuffers(1, &m_name);
 
-    glNamedBufferStorage(m_name, m_wholeByteSize, nullptr, GL_DYNAMIC_STORAGE_BIT | s_access);
-    m_ptr = std::bit_cast<uint8_t*>(glMapNamedBufferRange(m_name, 0, m_wholeByteSize, s_access));
+    if (desc.mapped) {
+        glNamedBufferStorage(m_name, m_wholeByteSize, nullptr, GL_DYNAMIC_STORAGE_BIT | s_access);
+        m_ptr = std::bit_cast<uint8_t*>(glMapNamedBufferRange(m_name, 0, m_wholeByteSize, s_access));
+    } else {
+        glNamedBufferStorage(m_name, m_wholeByteSize, nullptr, GL_DYNAMIC_STORAGE_BIT);
+    }
 
     for (BufferUsage::Type target : desc.bindings) {
         bindAs(target);
@@ -36,7 +41,7 @@ Buffer::~Buffer()
 
 void Buffer::freeResources()
 {
-    glUnmapNamedBuffer(m_name);
+    if (m_ptr != nullptr) glUnmapNamedBuffer(m_name);
     glDeleteBuffers(1, &m_name);
 }
 
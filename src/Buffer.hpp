@@ -7,6 +7,7 @@
 #include <bit>
 #include <cstring>
 #include <span>
+#include <string_view>
 
 //------------------------------------------------------------------------
 
@@ -65,6 +66,8 @@ struct BufferDescriptor
     absl::Span<const BufferUsage::Type> bindings;
     absl::Span<const IndexedBufferBinding> indexedBindings;
     bool managed = true;
+    bool mapped = true;      // Unmapped buffers may live in device-local memory, and ptr() is null for them.
+    std::string_view tag{};  // Who the memory is accounted to, see ResourceManager::memoryReport().
 };
 
 //------------------------------------------------------------------------
@@ -86,6 +89,11 @@ public:
     [[nodiscard]] GLuint name() { return m_name; }
     [[nodiscard]] GLsizei byteSize() { return m_writeOffset; }
     [[nodiscard]] GLsizei wholeByteSize() { return m_wholeByteSize; }
+    [[nodiscard]] std::string_view tag() { return m_tag; }
+
+    // Only buffers appended to through pushData() or reserveData() know how much of them is in use; others count as
+    // entirely used.
+    [[nodiscard]] GLsizeiptr usedByteSize() { return m_appended ? m_writeOffset : m_wholeByteSize; }
 
     template<typename T>
     [[nodiscard]] T* ptr() { return std::bit_cast<T*>(m_ptr); }
@@ -99,16 +107,25 @@ public:
         return byteSize() / util::roundup(sizeof(T), BufferUsage2Alignment[m_usage]);
     }
 
+    // Appends room for size elements, which the caller writes in place, e.g. straight from an importer rather than
+    // through a staging copy. Their contents are undefined until written.
     template<typename T>
-    std::span<T> pushData(const T* data, GLsizei size = 1)
+    [[nodiscard]] std::span<T> reserveData(GLsizei size = 1)
     {
         uint8_t* dst = m_ptr + m_writeOffset;
-        const GLsizei byteSize = sizeof(T) * size;
-        std::memcpy(dst, data, byteSize);
-        m_writeOffset += calculateWriteOffsetIncrement(byteSize);
+        m_writeOffset += calculateWriteOffsetIncrement(sizeof(T) * size);
+        m_appended = true;
         return std::span{std::bit_cast<T*>(dst), implicit_cast<size_t>(size)};
     }
 
+    template<typename T>
+    std::span<T> pushData(const T* data, GLsizei size = 1)
+    {
+        const std::span<T> dst = reserveData<T>(size);
+        std::memcpy(dst.data(), data, dst.size_bytes());
+        return dst;
+    }
+
     template<typename T>
     void setData(const T* data, GLintptr byteOffset = 0, GLsizei size = 1)
     {
@@ -133,6 +150,8 @@ private:
     uint8_t* m_ptr = nullptr;
     GLsizeiptr m_writeOffset = 0;
     bool m_managed = true;
+    bool m_appended = false;
+    std::string_view m_tag{};
 };
 
 //------------------------------------------------------------------------
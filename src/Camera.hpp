@@ -11,6 +11,7 @@ extern "C" {
 #include <GLFW/glfw3.h>
 }
 
+#include <atomic>
 #include <variant>
 
 //------------------------------------------------------------------------
@@ -55,7 +56,6 @@ struct CameraDescriptor
 {
     CameraSettings settings{};
     VarCameraSettings varSettings = PerspectiveSettings{};
-    Handle<Buffer> uniformBuffer{};
     ResourceManager* mngr;
     App* app;
 };
@@ -69,7 +69,6 @@ public:
     explicit Camera(CameraDescriptor desc)
         : m_settings{desc.settings},
           m_varSettings{desc.varSettings},
-          m_uniformBuffer{desc.uniformBuffer},
           m_mngr{desc.mngr},
           m_app{desc.app}
     {
@@ -84,23 +83,31 @@ public:
 
     void update()
     {
-        const bool moved = move();
-        const bool rotated = rotate();
+        update(m_app->getGLFWState(), m_app->deltaTime());
+    }
 
-        if (moved or rotated) {
-            uniformBuffer()->setData<glm::mat3x4>(&m_matrices.viewMatT, offsetof(ViewProjMatrices, viewMatT));
-        }
+    // For cameras updated apart from the thread polling input, e.g. the simulation thread.
+    void update(const App::GLFWState& input, float deltaTime)
+    {
+        move(input, deltaTime);
+        rotate(input);
+    }
+
+    // For scripted cameras, e.g. the fly-through benchmark. Input-driven update() would overwrite the target.
+    void setPose(const glm::vec3& center, const glm::vec3& target)
+    {
+        m_settings.center = center;
+        m_settings.target = glm::normalize(target);
+        updateView();
     }
 
     // According to the GLFW input reference.
     static void scrollCallback([[maybe_unused]] GLFWwindow* window, [[maybe_unused]] double xoffset, double yoffset)
     {
-        s_cameraSpeed = std::max(1.0f, s_cameraSpeed + 2.0f * implicit_cast<float>(yoffset));
+        s_cameraSpeed = std::max(1.0f, s_cameraSpeed.load() + 2.0f * implicit_cast<float>(yoffset));
     }
 
 private:
-    Buffer* uniformBuffer() { return m_mngr->get(m_uniformBuffer); }
-
     void updateView()
     {
         m_matrices.viewMatT = glm::transpose(glm::lookAt(m_settings.center, m_settings.center + m_settings.target, m_settings.up));
@@ -116,13 +123,12 @@ private:
             const auto [xmin, xmax, ymin, ymax] = std::get<OrthoSettings>(m_varSettings);
             m_matrices.projMat = glm::ortho(xmin, xmax, ymin, ymax, m_settings.zNear, m_settings.zFar);
         }
-        uniformBuffer()->setData<glm::mat4>(&m_matrices.projMat, offsetof(ViewProjMatrices, projMat));
     }
 
-    bool move()
+    bool move(const App::GLFWState& input, float deltaTime)
     {
-        [[maybe_unused]] const auto& [keys, pitch, yaw] = m_app->getGLFWState();
-        const float cameraSpeed = s_cameraSpeed * m_app->deltaTime();
+        [[maybe_unused]] const auto& [keys, pitch, yaw] = input;
+        const float cameraSpeed = s_cameraSpeed.load() * deltaTime;
 
         const glm::vec3 centerPrev = m_settings.center;
 
@@ -147,9 +153,9 @@ private:
         return false;
     }
 
-    bool rotate()
+    bool rotate(const App::GLFWState& input)
     {
-        [[maybe_unused]] const auto& [keys, pitch, yaw] = m_app->getGLFWState();
+        [[maybe_unused]] const auto& [keys, pitch, yaw] = input;
 
         const glm::vec3 tarprev = m_settings.target;
         
@@ -166,12 +172,11 @@ private:
         return false;
     }
 
-    static inline float s_cameraSpeed = 5.0f;
+    static inline std::atomic<float> s_cameraSpeed{5.0f};  // Scrolled on the thread polling input.
 
     CameraSettings m_settings;
     VarCameraSettings m_varSettings;
     ViewProjMatrices m_matrices;
-    Handle<Buffer> m_uniformBuffer;
     ResourceManager* m_mngr;
     App* m_app;
 
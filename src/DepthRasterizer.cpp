@@ -0,0 +1,443 @@
+#include "DepthRasterizer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <barrier>
+#include <cmath>
+#include <limits>
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+    #include <immintrin.h>
+#endif
+
+//------------------------------------------------------------------------
+
+namespace Zhade
+{
+
+//------------------------------------------------------------------------
+
+namespace
+{
+
+//------------------------------------------------------------------------
+
+inline constexpr uint32_t TRIANGLES_PER_BINNING_JOB = 4096;
+
+template<typename F>
+void runOnThreads(uint32_t numThreads, F&& fn)
+{
+    std::vector<std::jthread> workers;
+    workers.reserve(numThreads - 1);
+    for (uint32_t threadIdx : stdv::iota(1u, numThreads)) {
+        workers.emplace_back(fn, threadIdx);
+    }
+    fn(0u);
+}
+
+//------------------------------------------------------------------------
+// Thin wrappers so the row loop reads the same for every instruction set.
+
+#if defined(__AVX2__)
+
+inline constexpr int32_t SIMD_WIDTH = 8;
+using FloatV = __m256;
+
+inline FloatV splat(float v) { return _mm256_set1_ps(v); }
+inline FloatV laneOffsets() { return _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f); }
+inline FloatV add(FloatV a, FloatV b) { return _mm256_add_ps(a, b); }
+inline FloatV mul(FloatV a, FloatV b) { return _mm256_mul_ps(a, b); }
+inline FloatV bitAnd(FloatV a, FloatV b) { return _mm256_and_ps(a, b); }
+inline FloatV greaterEqual(FloatV a, FloatV b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+inline FloatV lessEqual(FloatV a, FloatV b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+inline FloatV less(FloatV a, FloatV b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+inline FloatV select(FloatV mask, FloatV a, FloatV b) { return _mm256_blendv_ps(b, a, mask); }
+inline FloatV load(const float* ptr) { return _mm256_loadu_ps(ptr); }
+inline void store(float* ptr, FloatV v) { _mm256_storeu_ps(ptr, v); }
+inline bool any(FloatV mask) { return _mm256_movemask_ps(mask) != 0; }
+
+#elif defined(__SSE2__) || defined(_M_X64)
+
+inline constexpr int32_t SIMD_WIDTH = 4;
+using FloatV = __m128;
+
+inline FloatV splat(float v) { return _mm_set1_ps(v); }
+inline FloatV laneOffsets() { return _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f); }
+inline FloatV add(FloatV a, FloatV b) { return _mm_add_ps(a, b); }
+inline FloatV mul(FloatV a, FloatV b) { return _mm_mul_ps(a, b); }
+inline FloatV bitAnd(FloatV a, FloatV b) { return _mm_and_ps(a, b); }
+inline FloatV greaterEqual(FloatV a, FloatV b) { return _mm_cmpge_ps(a, b); }
+inline FloatV lessEqual(FloatV a, FloatV b) { return _mm_cmple_ps(a, b); }
+inline FloatV less(FloatV a, FloatV b) { return _mm_cmplt_ps(a, b); }
+inline FloatV select(FloatV mask, FloatV a, FloatV b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+inline FloatV load(const float* ptr) { return _mm_loadu_ps(ptr); }
+inline void store(float* ptr, FloatV v) { _mm_storeu_ps(ptr, v); }
+inline bool any(FloatV mask) { return _mm_movemask_ps(mask) != 0; }
+
+#else
+
+inline constexpr int32_t SIMD_WIDTH = 1;
+using FloatV = float;
+
+inline FloatV splat(float v) { return v; }
+inline FloatV laneOffsets() { return 0.0f; }
+inline FloatV add(FloatV a, FloatV b) { return a + b; }
+inline FloatV mul(FloatV a, FloatV b) { return a * b; }
+inline FloatV bitAnd(FloatV a, FloatV b) { return (a != 0.0f and b != 0.0f) ? 1.0f : 0.0f; }
+inline FloatV greaterEqual(FloatV a, FloatV b) { return a >= b ? 1.0f : 0.0f; }
+inline FloatV lessEqual(FloatV a, FloatV b) { return a <= b ? 1.0f : 0.0f; }
+inline FloatV less(FloatV a, FloatV b) { return a < b ? 1.0f : 0.0f; }
+inline FloatV select(FloatV mask, FloatV a, FloatV b) { return mask != 0.0f ? a : b; }
+inline FloatV load(const float* ptr) { return *ptr; }
+inline void store(float* ptr, FloatV v) { *ptr = v; }
+inline bool any(FloatV mask) { return mask != 0.0f; }
+
+#endif
+
+//------------------------------------------------------------------------
+
+}  // namespace
+
+//------------------------------------------------------------------------
+
+DepthRasterizer::DepthRasterizer(DepthRasterizerDescriptor desc)
+    : m_dims{desc.dims},
+      m_numTiles{util::divup(desc.dims.x, s_tileSize), util::divup(desc.dims.y, s_tileSize)},
+      m_numBlocks{util::divup(desc.dims.x, s_blockSize), util::divup(desc.dims.y, s_blockSize)},
+      m_stride{implicit_cast<size_t>(m_numTiles.x * s_tileSize)},
+      m_numThreads{std::max(1u, desc.numThreads)},
+      m_cullBackFaces{desc.cullBackFaces}
+{
+    m_depth.resize(m_stride * m_numTiles.y * s_tileSize);
+    m_blockMaxDepth.resize(m_numBlocks.x * m_numBlocks.y);
+    m_bins.resize(m_numThreads);
+    for (auto& threadBins : m_bins) {
+        threadBins.resize(m_numTiles.x * m_numTiles.y);
+    }
+}
+
+//------------------------------------------------------------------------
+
+void DepthRasterizer::rasterize(const DepthRasterizerInput& input, const ViewProjMatrices& matrices)
+{
+    m_viewProj = matrices.projMat * glm::mat4(glm::transpose(matrices.viewMatT));
+
+    clear();
+    createJobs(input);
+
+    std::atomic_uint32_t nextJob = 0;
+    std::atomic_int32_t nextTile = 0;
+    std::atomic_uint32_t numBinned = 0;
+    std::barrier<> binningDone(m_numThreads);
+
+    runOnThreads(m_numThreads, [&](uint32_t threadIdx)
+    {
+        for (uint32_t jobIdx = nextJob++; jobIdx < m_jobs.size(); jobIdx = nextJob++) {
+            const BinningJob& job = m_jobs[jobIdx];
+            const Mesh& mesh = input.meshes[job.meshIdx];
+            const glm::mat4 mvp = m_viewProj * glm::mat4(glm::transpose(mesh.modelMatT));
+
+            for (uint32_t tri : stdv::iota(job.firstTriangle, job.firstTriangle + job.numTriangles)) {
+                std::array<glm::vec4, 3> clip;
+                for (uint32_t corner : stdv::iota(0u, 3u)) {
+                    const GLuint idx = input.indices[mesh.firstIndex + 3 * tri + corner];
+                    clip[corner] = mvp * glm::vec4(input.vertices[mesh.baseVertex + idx].pos, 1.0f);
+                }
+                binTriangle(clip, threadIdx);
+            }
+            numBinned += job.numTriangles;
+        }
+
+        binningDone.arrive_and_wait();
+
+        const int32_t numTiles = m_numTiles.x * m_numTiles.y;
+        for (int32_t tileIdx = nextTile++; tileIdx < numTiles; tileIdx = nextTile++) {
+            rasterizeTile(tileIdx % m_numTiles.x, tileIdx / m_numTiles.x);
+        }
+    });
+
+    m_numSubmittedTriangles = numBinned;
+}
+
+//------------------------------------------------------------------------
+
+bool DepthRasterizer::isOccluded(const glm::vec3& aabbMin, const glm::vec3& aabbMax)
+{
+    glm::vec2 screenMin{std::numeric_limits<float>::max()};
+    glm::vec2 screenMax{std::numeric_limits<float>::lowest()};
+    float minDepth = 1.0f;
+
+    for (uint32_t corner : stdv::iota(0u, 8u)) {
+        const glm::vec3 pos{
+            (corner & 1) ? aabbMax.x : aabbMin.x,
+            (corner & 2) ? aabbMax.y : aabbMin.y,
+            (corner & 4) ? aabbMax.z : aabbMin.z
+        };
+        const glm::vec4 clip = m_viewProj * glm::vec4(pos, 1.0f);
+        if (clip.w <= std::numeric_limits<float>::epsilon()) return false;  // Straddles the eye, assume visible.
+
+        const glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        const glm::vec2 screen = (0.5f * glm::vec2(ndc) + 0.5f) * glm::vec2(m_dims);
+        screenMin = glm::min(screenMin, screen);
+        screenMax = glm::max(screenMax, screen);
+        minDepth = glm::min(minDepth, 0.5f * ndc.z + 0.5f);
+    }
+
+    if (screenMax.x < 0.0f or screenMax.y < 0.0f or screenMin.x >= m_dims.x or screenMin.y >= m_dims.y) {
+        return false;  // Off screen, which is for frustum culling to decide.
+    }
+
+    const glm::ivec2 blockMin = glm::max(glm::ivec2(glm::floor(screenMin)) / s_blockSize, glm::ivec2(0));
+    const glm::ivec2 blockMax = glm::min(glm::ivec2(glm::floor(screenMax)) / s_blockSize, m_numBlocks - 1);
+
+    for (int32_t y : stdv::iota(blockMin.y, blockMax.y + 1)) {
+        for (int32_t x : stdv::iota(blockMin.x, blockMax.x + 1)) {
+            if (m_blockMaxDepth[y * m_numBlocks.x + x] >= minDepth) return false;
+        }
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------
+
+DepthComparison DepthRasterizer::compare(std::span<const float> reference, float tolerance)
+{
+    DepthComparison result{};
+    if (reference.size() < implicit_cast<size_t>(m_dims.x * m_dims.y)) [[unlikely]] {
+        fmt::println("Reference depth has {} texels, expected {}", reference.size(), m_dims.x * m_dims.y);
+        return result;
+    }
+
+    double errorSum = 0.0;
+    for (int32_t y : stdv::iota(0, m_dims.y)) {
+        for (int32_t x : stdv::iota(0, m_dims.x)) {
+            const float error = std::abs(depthAt(x, y) - reference[y * m_dims.x + x]);
+            result.maxAbsError = std::max(result.maxAbsError, error);
+            result.numMismatched += error > tolerance;
+            errorSum += error;
+        }
+    }
+    result.numCompared = implicit_cast<size_t>(m_dims.x * m_dims.y);
+    result.meanAbsError = implicit_cast<float>(errorSum / result.numCompared);
+
+    return result;
+}
+
+//------------------------------------------------------------------------
+
+void DepthRasterizer::clear()
+{
+    stdr::fill(m_depth, 1.0f);
+    stdr::fill(m_blockMaxDepth, 1.0f);
+    for (auto& threadBins : m_bins) {
+        for (auto& tileBin : threadBins) {
+            tileBin.clear();
+        }
+    }
+}
+
+//------------------------------------------------------------------------
+
+void DepthRasterizer::createJobs(const DepthRasterizerInput& input)
+{
+    m_jobs.clear();
+    for (uint32_t meshIdx : stdv::iota(0u, implicit_cast<uint32_t>(input.meshes.size()))) {
+        const Mesh& mesh = input.meshes[meshIdx];
+        if (mesh.refCount == 0) continue;
+
+        const uint32_t numTriangles = mesh.numIndices / 3;
+        for (uint32_t first = 0; first < numTriangles; first += TRIANGLES_PER_BINNING_JOB) {
+            m_jobs.push_back({
+                .meshIdx = meshIdx,
+                .firstTriangle = first,
+                .numTriangles = std::min(TRIANGLES_PER_BINNING_JOB, numTriangles - first)
+            });
+        }
+    }
+}
+
+//------------------------------------------------------------------------
+
+void DepthRasterizer::binTriangle(std::span<const glm::vec4, 3> clip, uint32_t threadIdx)
+{
+    // Trivially reject triangles entirely outside one of the frustum planes.
+    for (int32_t axis : stdv::iota(0, 3)) {
+        if (clip[0][axis] > clip[0].w and clip[1][axis] > clip[1].w and clip[2][axis] > clip[2].w) return;
+        if (clip[0][axis] < -clip[0].w and clip[1][axis] < -clip[1].w and clip[2][axis] < -clip[2].w) return;
+    }
+
+    auto toScreen = [this](const glm::vec4& v)
+    {
+        const glm::vec3 ndc = glm::vec3(v) / v.w;
+        return glm::vec3{
+            (0.5f * ndc.x + 0.5f) * m_dims.x,
+            (0.5f * ndc.y + 0.5f) * m_dims.y,
+            0.5f * ndc.z + 0.5f
+        };
+    };
+
+    // Only the near plane needs real clipping, the rest is handled by the bounding box and the per-pixel depth range.
+    auto nearDistance = [](const glm::vec4& v) { return v.z + v.w; };
+
+    std::array<glm::vec4, 4> clipped;
+    uint32_t numClipped = 0;
+    for (uint32_t corner : stdv::iota(0u, 3u)) {
+        const glm::vec4& cur = clip[corner];
+        const glm::vec4& next = clip[(corner + 1) % 3];
+        const float curDist = nearDistance(cur);
+        const float nextDist = nearDistance(next);
+        if (curDist >= 0.0f) clipped[numClipped++] = cur;
+        if ((curDist >= 0.0f) != (nextDist >= 0.0f)) {
+            clipped[numClipped++] = glm::mix(cur, next, curDist / (curDist - nextDist));
+        }
+    }
+
+    for (uint32_t fan : stdv::iota(2u, std::max(2u, numClipped))) {
+        setupTriangle(toScreen(clipped[0]), toScreen(clipped[fan - 1]), toScreen(clipped[fan]), threadIdx);
+    }
+}
+
+//------------------------------------------------------------------------
+
+void DepthRasterizer::setupTriangle(const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2,
+    uint32_t threadIdx)
+{
+    float area = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+    if (area == 0.0f or (m_cullBackFaces and area < 0.0f)) return;
+
+    // Make the winding counter-clockwise so that all edge functions are positive inside.
+    const bool flip = area < 0.0f;
+    const glm::vec3& a = v0;
+    const glm::vec3& b = flip ? v2 : v1;
+    const glm::vec3& c = flip ? v1 : v2;
+    area = std::abs(area);
+
+    const glm::vec2 boundsMin = glm::min(glm::min(glm::vec2(a), glm::vec2(b)), glm::vec2(c));
+    const glm::vec2 boundsMax = glm::max(glm::max(glm::vec2(a), glm::vec2(b)), glm::vec2(c));
+
+    BinnedTriangle tri{
+        .z0 = a.z,
+        .dzdx = ((b.z - a.z) * (c.y - a.y) - (c.z - a.z) * (b.y - a.y)) / area,
+        .dzdy = ((c.z - a.z) * (b.x - a.x) - (b.z - a.z) * (c.x - a.x)) / area,
+        .origin = glm::vec2(a),
+        .min = glm::max(glm::ivec2(glm::floor(boundsMin)), glm::ivec2(0)),
+        .max = glm::min(glm::ivec2(glm::ceil(boundsMax)), m_dims - 1)
+    };
+    if (tri.min.x > tri.max.x or tri.min.y > tri.max.y) return;
+
+    const std::array<const glm::vec3*, 3> verts{&a, &b, &c};
+    for (uint32_t edge : stdv::iota(0u, 3u)) {
+        const glm::vec3& from = *verts[edge];
+        const glm::vec3& to = *verts[(edge + 1) % 3];
+        tri.edgeA[edge] = from.y - to.y;
+        tri.edgeB[edge] = to.x - from.x;
+        tri.edgeC[edge] = (to.y - from.y) * from.x - (to.x - from.x) * from.y;
+    }
+
+    const glm::ivec2 tileMin = tri.min / s_tileSize;
+    const glm::ivec2 tileMax = tri.max / s_tileSize;
+    for (int32_t tileY : stdv::iota(tileMin.y, tileMax.y + 1)) {
+        for (int32_t tileX : stdv::iota(tileMin.x, tileMax.x + 1)) {
+            bin(threadIdx, tileX, tileY).push_back(tri);
+        }
+    }
+}
+
+//------------------------------------------------------------------------
+
+void DepthRasterizer::rasterizeTile(int32_t tileX, int32_t tileY)
+{
+    const glm::ivec2 tileMin{tileX * s_tileSize, tileY * s_tileSize};
+    const glm::ivec2 tileMax = glm::min(tileMin + s_tileSize - 1, m_dims - 1);
+
+    for (uint32_t threadIdx : stdv::iota(0u, m_numThreads)) {
+        for (const BinnedTriangle& tri : bin(threadIdx, tileX, tileY)) {
+            rasterizeTriangle(tri, tileMin, tileMax);
+        }
+    }
+
+    updateBlockMaxDepth(tileX, tileY);
+}
+
+//------------------------------------------------------------------------
+
+void DepthRasterizer::rasterizeTriangle(const BinnedTriangle& tri, const glm::ivec2& tileMin,
+    const glm::ivec2& tileMax)
+{
+    const glm::ivec2 min = glm::max(tri.min, tileMin);
+    const glm::ivec2 max = glm::min(tri.max, tileMax);
+
+    // Rows start on a SIMD boundary, which never leaves the tile since tiles are SIMD-aligned.
+    const int32_t startX = min.x - (min.x % SIMD_WIDTH);
+    const float px = startX + 0.5f;
+
+    const FloatV offsets = laneOffsets();
+    const FloatV zero = splat(0.0f);
+    const FloatV one = splat(1.0f);
+    const FloatV zStep = splat(tri.dzdx * SIMD_WIDTH);
+    const FloatV edgeStep[] = {
+        splat(tri.edgeA[0] * SIMD_WIDTH), splat(tri.edgeA[1] * SIMD_WIDTH), splat(tri.edgeA[2] * SIMD_WIDTH)
+    };
+
+    for (int32_t y : stdv::iota(min.y, max.y + 1)) {
+        const float py = y + 0.5f;
+        float* row = m_depth.data() + y * m_stride;
+
+        FloatV edges[3];
+        for (uint32_t edge : stdv::iota(0u, 3u)) {
+            const float start = tri.edgeA[edge] * px + tri.edgeB[edge] * py + tri.edgeC[edge];
+            edges[edge] = add(splat(start), mul(splat(tri.edgeA[edge]), offsets));
+        }
+        const float zStart = tri.z0 + tri.dzdx * (px - tri.origin.x) + tri.dzdy * (py - tri.origin.y);
+        FloatV z = add(splat(zStart), mul(splat(tri.dzdx), offsets));
+
+        for (int32_t x = startX; x <= max.x; x += SIMD_WIDTH) {
+            FloatV mask = bitAnd(greaterEqual(edges[0], zero), greaterEqual(edges[1], zero));
+            mask = bitAnd(mask, greaterEqual(edges[2], zero));
+            mask = bitAnd(mask, bitAnd(greaterEqual(z, zero), lessEqual(z, one)));
+
+            if (any(mask)) {
+                const FloatV prev = load(row + x);
+                mask = bitAnd(mask, less(z, prev));
+                store(row + x, select(mask, z, prev));
+            }
+
+            edges[0] = add(edges[0], edgeStep[0]);
+            edges[1] = add(edges[1], edgeStep[1]);
+            edges[2] = add(edges[2], edgeStep[2]);
+            z = add(z, zStep);
+        }
+    }
+}
+
+//------------------------------------------------------------------------
+
+void DepthRasterizer::updateBlockMaxDepth(int32_t tileX, int32_t tileY)
+{
+    static constexpr int32_t blocksPerTile = s_tileSize / s_blockSize;
+
+    const glm::ivec2 firstBlock = glm::ivec2{tileX, tileY} * blocksPerTile;
+    const glm::ivec2 lastBlock = glm::min(firstBlock + blocksPerTile, m_numBlocks);
+
+    for (int32_t blockY : stdv::iota(firstBlock.y, lastBlock.y)) {
+        for (int32_t blockX : stdv::iota(firstBlock.x, lastBlock.x)) {
+            const glm::ivec2 first = glm::ivec2{blockX, blockY} * s_blockSize;
+            const glm::ivec2 last = glm::min(first + s_blockSize, m_dims);
+
+            float maxDepth = 0.0f;
+            for (int32_t y : stdv::iota(first.y, last.y)) {
+                for (int32_t x : stdv::iota(first.x, last.x)) {
+                    maxDepth = std::max(maxDepth, depthAt(x, y));
+                }
+            }
+            m_blockMaxDepth[blockY * m_numBlocks.x + blockX] = maxDepth;
+        }
+    }
+}
+
+//------------------------------------------------------------------------
+
+}  // namespace Zhade
+
+//------------------------------------------------------------------------
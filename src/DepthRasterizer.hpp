@@ -0,0 +1,123 @@
+#pragma once
+
+#include "common.hpp"
+
+#include <algorithm>
+#include <span>
+#include <thread>
+#include <vector>
+
+//------------------------------------------------------------------------
+
+namespace Zhade
+{
+
+//------------------------------------------------------------------------
+
+struct DepthRasterizerDescriptor
+{
+    glm::ivec2 dims{2048, 2048};
+    uint32_t numThreads = std::max(1u, std::thread::hardware_concurrency());
+    bool cullBackFaces = true;
+};
+
+// The same data Scene keeps in its vertex, index and mesh buffers.
+struct DepthRasterizerInput
+{
+    std::span<const Vertex> vertices;
+    std::span<const GLuint> indices;
+    std::span<const Mesh> meshes;
+};
+
+struct DepthComparison
+{
+    float maxAbsError = 0.0f;
+    float meanAbsError = 0.0f;
+    size_t numMismatched = 0;
+    size_t numCompared = 0;
+};
+
+//------------------------------------------------------------------------
+// Tile-binned, multithreaded depth-only rasterizer. Produces the same depth values as GL with GL_LESS, default depth
+// range and back-face culling, up to the fill rule at triangle edges. Uses AVX2 when compiled with it, SSE2 otherwise.
+
+class DepthRasterizer
+{
+public:
+    explicit DepthRasterizer(DepthRasterizerDescriptor desc);
+
+    DepthRasterizer(const DepthRasterizer&) = delete;
+    DepthRasterizer& operator=(const DepthRasterizer&) = delete;
+    DepthRasterizer(DepthRasterizer&&) = default;
+    DepthRasterizer& operator=(DepthRasterizer&&) = default;
+
+    [[nodiscard]] const glm::ivec2& dims() { return m_dims; }
+    [[nodiscard]] size_t stride() { return m_stride; }
+    [[nodiscard]] std::span<const float> depth() { return m_depth; }
+    [[nodiscard]] float depthAt(int32_t x, int32_t y) { return m_depth[y * m_stride + x]; }
+    [[nodiscard]] size_t numSubmittedTriangles() { return m_numSubmittedTriangles; }
+
+    void rasterize(const DepthRasterizerInput& input, const ViewProjMatrices& matrices);
+
+    // Conservative: true only if every pixel the box covers is already behind rasterized depth.
+    [[nodiscard]] bool isOccluded(const glm::vec3& aabbMin, const glm::vec3& aabbMax);
+
+    // The reference is expected to be tightly packed, bottom row first, as returned by glGetTextureImage.
+    [[nodiscard]] DepthComparison compare(std::span<const float> reference, float tolerance = 1e-4f);
+
+    static constexpr int32_t s_tileSize = 64;
+    static constexpr int32_t s_blockSize = 8;
+
+private:
+    struct BinnedTriangle
+    {
+        float edgeA[3];
+        float edgeB[3];
+        float edgeC[3];
+        float z0;
+        float dzdx;
+        float dzdy;
+        glm::vec2 origin;
+        glm::ivec2 min;
+        glm::ivec2 max;
+    };
+
+    struct BinningJob
+    {
+        uint32_t meshIdx;
+        uint32_t firstTriangle;
+        uint32_t numTriangles;
+    };
+
+    [[nodiscard]] std::vector<BinnedTriangle>& bin(uint32_t threadIdx, int32_t tileX, int32_t tileY)
+    {
+        return m_bins[threadIdx][tileY * m_numTiles.x + tileX];
+    }
+
+    void clear();
+    void createJobs(const DepthRasterizerInput& input);
+    void binTriangle(std::span<const glm::vec4, 3> clip, uint32_t threadIdx);
+    void setupTriangle(const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2, uint32_t threadIdx);
+    void rasterizeTile(int32_t tileX, int32_t tileY);
+    void rasterizeTriangle(const BinnedTriangle& tri, const glm::ivec2& tileMin, const glm::ivec2& tileMax);
+    void updateBlockMaxDepth(int32_t tileX, int32_t tileY);
+
+    glm::ivec2 m_dims;
+    glm::ivec2 m_numTiles;
+    glm::ivec2 m_numBlocks;
+    size_t m_stride;
+    uint32_t m_numThreads;
+    bool m_cullBackFaces;
+    glm::mat4 m_viewProj{1.0f};
+    size_t m_numSubmittedTriangles = 0;
+    std::vector<float> m_depth;
+    std::vector<float> m_blockMaxDepth;
+    std::vector<BinningJob> m_jobs;
+    std::vector<std::vector<std::vector<BinnedTriangle>>> m_bins;
+};
+
+//------------------------------------------------------------------------
+
+}  // namespace Zhade
+
+//------------------------------------------------------------------------
@@ -3,6 +3,10 @@
 #include "ResourceManager.hpp"
 #include "Texture.hpp"
 
+#include <bit>
+#include <cmath>
+#include <string_view>
+
 //------------------------------------------------------------------------
 
 namespace Zhade
@@ -10,15 +14,25 @@ namespace Zhade
 
 //------------------------------------------------------------------------
 
+static constexpr std::string_view s_memoryTag = "DirectionalLight";
+
+//------------------------------------------------------------------------
+
 DirectionalLight::DirectionalLight(DirectionalLightDescriptor desc)
     : m_mngr{desc.mngr},
       m_props{desc.props},
-      m_shadowMapDims{desc.shadowMapDims}
+      m_shadowMapDims{desc.shadowMapDims},
+      m_filterSettings{
+          .mode = desc.shadowFilter,
+          .positiveExponent = desc.evsmDesc.positiveExponent,
+          .negativeExponent = desc.evsmDesc.negativeExponent,
+          .lightBleedReduction = desc.evsmDesc.lightBleedReduction
+      }
 {
     setupMatrices(desc);
-    setupFramebuffer();
+    setupFramebuffers();
     setupBuffers();
-    m_pipeline = m_mngr->createPipeline(desc.shadowPassDesc);
+    setupPipelines(desc);
 }
 
 //------------------------------------------------------------------------
@@ -26,26 +40,117 @@ DirectionalLight::DirectionalLight(DirectionalLightDescriptor desc)
 DirectionalLight::~DirectionalLight()
 {
     m_mngr->destroy(m_framebuffer);
+    m_mngr->destroy(m_evsmFramebuffer);
     m_mngr->destroy(m_propsBuffer);
     m_mngr->destroy(m_depthTextureBuffer);
+    m_mngr->destroy(m_shadowMatrixBuffer);
+    m_mngr->destroy(m_shadowFilterBuffer);
     m_mngr->destroy(m_pipeline);
+    m_mngr->destroy(m_evsmPipeline);
+    m_mngr->destroy(m_evsmBlurPipeline);
+}
+
+//------------------------------------------------------------------------
+
+void DirectionalLight::bindShadowTextures()
+{
+    depthTexture()->bind(SUN_DEPTH_TEXTURE_UNIT);
+    momentsTexture()->bind(SHADOW_MOMENTS_TEXTURE_UNIT);
 }
 
 //------------------------------------------------------------------------
 
-void DirectionalLight::prepareForRendering(const Handle<Buffer>& viewProjUniformBuffer)
+void DirectionalLight::setShadowFilter(ShadowFilter::Type filter)
+{
+    m_filterSettings.mode = filter;
+    buffer(m_shadowFilterBuffer)->setData(&m_filterSettings);
+}
+
+//------------------------------------------------------------------------
+
+void DirectionalLight::prepareForRendering(RingBuffer& frameData)
 {
     glViewport(0, 0, m_shadowMapDims.x, m_shadowMapDims.y);
-    framebuffer()->bind();
-    pipeline()->bind();
-    buffer(viewProjUniformBuffer)->setData(&m_matrices);
+
+    if (shadowFilter() == ShadowFilter::EVSM) {
+        // Texels not covered by any geometry must hold the moments of the far plane.
+        const GLfloat farMoments[] = {
+            std::exp(m_filterSettings.positiveExponent),
+            std::exp(2.0f * m_filterSettings.positiveExponent),
+            -std::exp(-m_filterSettings.negativeExponent),
+            std::exp(-2.0f * m_filterSettings.negativeExponent)
+        };
+        glClearNamedFramebufferfv(framebuffer(m_evsmFramebuffer)->name(), GL_COLOR, 0, farMoments);
+        framebuffer(m_evsmFramebuffer)->bind();
+        pipeline(m_evsmPipeline)->bind();
+    } else {
+        framebuffer(m_framebuffer)->bind();
+        pipeline(m_pipeline)->bind();
+    }
+
+    RingBuffer::bindRange(frameData.push(m_matrices), BufferUsage::UNIFORM, VIEW_PROJ_BINDING);
+}
+
+//------------------------------------------------------------------------
+
+void DirectionalLight::addFilterPasses(RenderGraph& graph, GraphResource moments)
+{
+    const GraphResource blurred = graph.createTexture("EVSM blur", {
+        .dims = m_shadowMapDims,
+        .levels = 1,
+        .internalFormat = GL_RGBA32F,
+        .sampler = {
+            .wrapS = GL_CLAMP_TO_EDGE,
+            .wrapT = GL_CLAMP_TO_EDGE,
+            .magFilter = GL_NEAREST,
+            .minFilter = GL_NEAREST,
+            .anisotropy = 1.0f
+        }
+    });
+
+    graph.addPass({
+        .name = "Shadow blur X",
+        .reads = {{moments, ResourceAccess::IMAGE}},
+        .writes = {{blurred, ResourceAccess::IMAGE}},
+        .execute = [this, moments, blurred](RenderGraph& graph) {
+            pipeline(m_evsmBlurPipeline)->bind();
+            blurMoments(graph.texture(moments), graph.texture(blurred), {1, 0});
+        }
+    });
+    graph.addPass({
+        .name = "Shadow blur Y",
+        .reads = {{blurred, ResourceAccess::IMAGE}},
+        .writes = {{moments, ResourceAccess::IMAGE}},
+        .execute = [this, moments, blurred](RenderGraph& graph) {
+            pipeline(m_evsmBlurPipeline)->bind();
+            blurMoments(graph.texture(blurred), graph.texture(moments), {0, 1});
+        }
+    });
+    graph.addPass({
+        .name = "Shadow mipmaps",
+        .reads = {{moments, ResourceAccess::TEXTURE_UPDATE}},
+        .writes = {{moments, ResourceAccess::TEXTURE_UPDATE}},
+        .execute = [moments](RenderGraph& graph) { graph.texture(moments)->generateMipmap(); }
+    });
 }
 
 //------------------------------------------------------------------------
 
-Framebuffer* DirectionalLight::framebuffer()
+std::vector<float> DirectionalLight::readShadowMap()
 {
-    return m_mngr->get(m_framebuffer);
+    Texture* depth = shadowFilter() == ShadowFilter::EVSM ? framebuffer(m_evsmFramebuffer)->depthTexture()
+                                                          : depthTexture();
+
+    std::vector<float> texels(m_shadowMapDims.x * m_shadowMapDims.y);
+    glGetTextureImage(depth->name(), 0, GL_DEPTH_COMPONENT, GL_FLOAT, texels.size() * sizeof(float), texels.data());
+    return texels;
+}
+
+//------------------------------------------------------------------------
+
+Framebuffer* DirectionalLight::framebuffer(const Handle<Framebuffer>& handle)
+{
+    return m_mngr->get(handle);
 }
 
 //------------------------------------------------------------------------
@@ -57,9 +162,9 @@ Buffer* DirectionalLight::buffer(const Handle<Buffer>& handle)
 
 //------------------------------------------------------------------------
 
-Pipeline* DirectionalLight::pipeline()
+Pipeline* DirectionalLight::pipeline(const Handle<Pipeline>& handle)
 {
-    return m_mngr->get(m_pipeline);
+    return m_mngr->get(handle);
 }
 
 //------------------------------------------------------------------------
@@ -87,7 +192,7 @@ void DirectionalLight::setupMatrices(const DirectionalLightDescriptor& desc)
 
 //------------------------------------------------------------------------
 
-void DirectionalLight::setupFramebuffer()
+void DirectionalLight::setupFramebuffers()
 {
     m_framebuffer = m_mngr->createFramebuffer({
         .textureDesc = {
@@ -100,11 +205,43 @@ void DirectionalLight::setupFramebuffer()
                 .magFilter = GL_LINEAR,
                 .minFilter = GL_LINEAR,
                 .anisotropy = 1.0f
-            }
+            },
+            .tag = s_memoryTag
         },
         .attachment = GL_DEPTH_ATTACHMENT,
         .mngr = m_mngr
     });
+
+    const uint32_t maxDim = glm::max(m_shadowMapDims.x, m_shadowMapDims.y);
+    const TextureDescriptor momentsDesc{
+        .dims = m_shadowMapDims,
+        .levels = implicit_cast<GLsizei>(std::bit_width(maxDim)),
+        .internalFormat = GL_RGBA32F,
+        .sampler = {
+            .wrapS = GL_CLAMP_TO_EDGE,
+            .wrapT = GL_CLAMP_TO_EDGE,
+            .magFilter = GL_LINEAR,
+            .minFilter = GL_LINEAR_MIPMAP_LINEAR,
+            .anisotropy = 16.0f
+        },
+        .tag = s_memoryTag
+    };
+    m_evsmFramebuffer = m_mngr->createFramebuffer({
+        .textureDesc = momentsDesc,
+        .attachment = GL_COLOR_ATTACHMENT0,
+        .mngr = m_mngr,
+        .depthTextureDesc = TextureDescriptor{
+            .dims = m_shadowMapDims,
+            .levels = 1,
+            .internalFormat = GL_DEPTH_COMPONENT32F,
+            .sampler = {
+                .magFilter = GL_NEAREST,
+                .minFilter = GL_NEAREST,
+                .anisotropy = 1.0f
+            },
+            .tag = s_memoryTag
+        }
+    });
 }
 
 //------------------------------------------------------------------------
@@ -116,7 +253,8 @@ void DirectionalLight::setupBuffers()
         .usage = BufferUsage::STORAGE,
         .indexedBindings = {
             {.target = BufferUsage::STORAGE, .index = DIRECTIONAL_LIGHT_PROPS_BINDING}
-        }
+        },
+        .tag = s_memoryTag
     });
     buffer(m_propsBuffer)->setData(&m_props);
 
@@ -125,9 +263,10 @@ void DirectionalLight::setupBuffers()
         .usage = BufferUsage::UNIFORM,
         .indexedBindings = {
             {.target = BufferUsage::UNIFORM, .index = DIRECTIONAL_LIGHT_DEPTH_TEXTURE_BINDING}
-        }
+        },
+        .tag = s_memoryTag
     });
-    GLuint64 depthTextureHandle = framebuffer()->texture()->handle();
+    GLuint64 depthTextureHandle = framebuffer(m_framebuffer)->texture()->handle();
     buffer(m_depthTextureBuffer)->setData(&depthTextureHandle);
 
     m_shadowMatrixBuffer = m_mngr->createBuffer({
@@ -135,7 +274,8 @@ void DirectionalLight::setupBuffers()
         .usage = BufferUsage::UNIFORM,
         .indexedBindings = {
             {.target = BufferUsage::UNIFORM, .index = DIRECTIONAL_LIGHT_SHADOW_MATRIX_BINDING}
-        }
+        },
+        .tag = s_memoryTag
     });
     glm::mat4 shadowMatrix = (
         glm::mat4{
@@ -148,6 +288,40 @@ void DirectionalLight::setupBuffers()
         * glm::mat4(glm::transpose(m_matrices.viewMatT))
     );
     buffer(m_shadowMatrixBuffer)->setData(&shadowMatrix);
+
+    m_shadowFilterBuffer = m_mngr->createBuffer({
+        .byteSize = sizeof(ShadowFilterSettings),
+        .usage = BufferUsage::UNIFORM,
+        .indexedBindings = {
+            {.target = BufferUsage::UNIFORM, .index = DIRECTIONAL_LIGHT_SHADOW_FILTER_BINDING}
+        },
+        .tag = s_memoryTag
+    });
+    m_filterSettings.momentsTexture = framebuffer(m_evsmFramebuffer)->texture()->handle();
+    buffer(m_shadowFilterBuffer)->setData(&m_filterSettings);
+}
+
+//------------------------------------------------------------------------
+
+void DirectionalLight::setupPipelines(const DirectionalLightDescriptor& desc)
+{
+    m_pipeline = m_mngr->createPipeline(desc.shadowPassDesc);
+    m_evsmPipeline = m_mngr->createPipeline(desc.evsmDesc.shadowPassDesc);
+    m_evsmBlurPipeline = m_mngr->createPipeline(desc.evsmDesc.blurDesc);
+}
+
+//------------------------------------------------------------------------
+
+void DirectionalLight::blurMoments(Texture* src, Texture* dst, glm::ivec2 direction)
+{
+    glBindImageTexture(0, src->name(), 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA32F);
+    glBindImageTexture(1, dst->name(), 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+    glProgramUniform2i(pipeline(m_evsmBlurPipeline)->program(PipelineStage::COMPUTE), 0, direction.x, direction.y);
+    glDispatchCompute(
+        util::divup(m_shadowMapDims.x, EVSM_BLUR_LOCAL_SIZE),
+        util::divup(m_shadowMapDims.y, EVSM_BLUR_LOCAL_SIZE),
+        1
+    );
 }
 
 //------------------------------------------------------------------------
@@ -4,10 +4,14 @@
 #include "Framebuffer.hpp"
 #include "Handle.hpp"
 #include "Pipeline.hpp"
+#include "RenderGraph.hpp"
+#include "RingBuffer.hpp"
 #include "common.hpp"
 
 #include <glm/glm.hpp>
 
+#include <vector>
+
 //------------------------------------------------------------------------
 
 namespace Zhade
@@ -17,6 +21,31 @@ namespace Zhade
 
 class ResourceManager;
 
+namespace ShadowFilter
+{
+    using Type = uint8_t;
+    enum : Type
+    {
+        PCF = SHADOW_FILTER_PCF,
+        EVSM = SHADOW_FILTER_EVSM,
+        NUM_SHADOW_FILTERS
+    };
+}
+
+inline constexpr const char* ShadowFilter2Name[] {
+    "PCF",
+    "EVSM"
+};
+
+struct EVSMDescriptor
+{
+    PipelineDescriptor shadowPassDesc;
+    PipelineDescriptor blurDesc;
+    float positiveExponent = 40.0f;
+    float negativeExponent = 5.0f;
+    float lightBleedReduction = 0.2f;
+};
+
 struct DirectionalLightDescriptor
 {
     ResourceManager* mngr;
@@ -24,6 +53,8 @@ struct DirectionalLightDescriptor
     glm::vec3 position{-1163.729858, 4203.104980, -258.124634};
     glm::ivec2 shadowMapDims;
     PipelineDescriptor shadowPassDesc;
+    EVSMDescriptor evsmDesc;
+    ShadowFilter::Type shadowFilter = ShadowFilter::PCF;
 };
 
 //------------------------------------------------------------------------
@@ -40,27 +71,46 @@ public:
     DirectionalLight& operator=(DirectionalLight&&) = delete;
 
     [[nodiscard]] const glm::vec3& direction() { return m_props.direction; }
+    [[nodiscard]] const glm::ivec2& shadowMapDims() { return m_shadowMapDims; }
+    [[nodiscard]] const ViewProjMatrices& matrices() { return m_matrices; }
+    [[nodiscard]] ShadowFilter::Type shadowFilter() { return implicit_cast<ShadowFilter::Type>(m_filterSettings.mode); }
+    [[nodiscard]] Texture* depthTexture() { return framebuffer(m_framebuffer)->texture(); }
+    [[nodiscard]] Texture* momentsTexture() { return framebuffer(m_evsmFramebuffer)->texture(); }
+
+    // To SUN_DEPTH_TEXTURE_UNIT and SHADOW_MOMENTS_TEXTURE_UNIT, as shading samples them through handles otherwise.
+    void bindShadowTextures();
+    void setShadowFilter(ShadowFilter::Type filter);
+    void prepareForRendering(RingBuffer& frameData);
 
-    void prepareForRendering(const Handle<Buffer>& viewProjUniformBuffer);
+    // Blurs the EVSM moments, which is culled unless a later pass samples them.
+    void addFilterPasses(RenderGraph& graph, GraphResource moments);
+    [[nodiscard]] std::vector<float> readShadowMap();
 
 private:
-    [[nodiscard]] Framebuffer* framebuffer();
+    [[nodiscard]] Framebuffer* framebuffer(const Handle<Framebuffer>& handle);
     [[nodiscard]] Buffer* buffer(const Handle<Buffer>& handle);
-    [[nodiscard]] Pipeline* pipeline();
+    [[nodiscard]] Pipeline* pipeline(const Handle<Pipeline>& handle);
 
     void setupMatrices(const DirectionalLightDescriptor& desc);
-    void setupFramebuffer();
+    void setupFramebuffers();
     void setupBuffers();
+    void setupPipelines(const DirectionalLightDescriptor& desc);
+    void blurMoments(Texture* src, Texture* dst, glm::ivec2 direction);
 
     ResourceManager* m_mngr;
     DirectionalLightProperties m_props;
     glm::ivec2 m_shadowMapDims;
     ViewProjMatrices m_matrices;
+    ShadowFilterSettings m_filterSettings;
     Handle<Framebuffer> m_framebuffer;
+    Handle<Framebuffer> m_evsmFramebuffer;
     Handle<Buffer> m_propsBuffer;
     Handle<Buffer> m_depthTextureBuffer;
     Handle<Buffer> m_shadowMatrixBuffer;
+    Handle<Buffer> m_shadowFilterBuffer;
     Handle<Pipeline> m_pipeline;
+    Handle<Pipeline> m_evsmPipeline;
+    Handle<Pipeline> m_evsmBlurPipeline;
 
     friend class Renderer;
 };
@@ -0,0 +1,71 @@
+#include "DynamicResolution.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+//------------------------------------------------------------------------
+
+namespace Zhade
+{
+
+//------------------------------------------------------------------------
+
+DynamicResolution::DynamicResolution(DynamicResolutionDescriptor desc)
+    : m_desc{desc},
+      m_scale{desc.maxScale}
+{
+    setScaleBounds(desc.minScale, desc.maxScale);
+}
+
+//------------------------------------------------------------------------
+
+void DynamicResolution::setEnabled(bool enabled)
+{
+    m_desc.enabled = enabled;
+    m_scale = m_desc.maxScale;
+}
+
+//------------------------------------------------------------------------
+
+void DynamicResolution::setTargetMs(float targetMs)
+{
+    m_desc.targetMs = std::max(targetMs, 0.1f);
+}
+
+//------------------------------------------------------------------------
+
+void DynamicResolution::setScaleBounds(float minScale, float maxScale)
+{
+    m_desc.maxScale = std::clamp(maxScale, 0.1f, 1.0f);
+    m_desc.minScale = std::clamp(minScale, 0.1f, m_desc.maxScale);
+    m_scale = m_desc.enabled ? std::clamp(m_scale, m_desc.minScale, m_desc.maxScale) : m_desc.maxScale;
+}
+
+//------------------------------------------------------------------------
+
+void DynamicResolution::update(float gpuMs)
+{
+    if (not m_desc.enabled or gpuMs <= 0.0f) return;
+
+    const float ratio = m_desc.targetMs / gpuMs;
+    if (std::abs(1.0f - ratio) <= DYNAMIC_RESOLUTION_DEAD_BAND) return;
+
+    const float ideal = m_scale * std::sqrt(ratio);
+    const float rate = ideal < m_scale ? DYNAMIC_RESOLUTION_DOWN_RATE : DYNAMIC_RESOLUTION_UP_RATE;
+    m_scale = std::clamp(m_scale + rate * (ideal - m_scale), m_desc.minScale, m_desc.maxScale);
+}
+
+//------------------------------------------------------------------------
+
+glm::ivec2 DynamicResolution::scaledDims(glm::ivec2 dims)
+{
+    static constexpr auto alignment = implicit_cast<float>(DYNAMIC_RESOLUTION_ALIGNMENT);
+    const glm::ivec2 scaled{glm::round(m_scale * glm::vec2{dims} / alignment) * alignment};
+    return glm::clamp(scaled, glm::min(glm::ivec2{DYNAMIC_RESOLUTION_ALIGNMENT}, dims), dims);
+}
+
+//------------------------------------------------------------------------
+
+}  // namespace Zhade
+
+//------------------------------------------------------------------------
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "common.hpp"
+
+#include <glm/glm.hpp>
+
+//------------------------------------------------------------------------
+
+namespace Zhade
+{
+
+//------------------------------------------------------------------------
+
+struct DynamicResolutionDescriptor
+{
+    bool enabled = false;
+    float targetMs = 1000.0f / 60.0f;  // GPU time budget of a frame.
+    float minScale = 0.5f;             // Both per axis, relative to the full resolution.
+    float maxScale = 1.0f;
+};
+
+//------------------------------------------------------------------------
+// Picks the resolution scale the scene is rendered at from the GPU time of past frames, so that it fits a budget.
+// Assumes GPU time scales with the pixel count, i.e. the square of the scale, and steps towards the scale that would
+// have hit the budget: quickly when over it, slowly when under it, and not at all within a dead band around it, so
+// that the scale neither oscillates nor drops frames for long.
+
+class DynamicResolution
+{
+public:
+    explicit DynamicResolution(DynamicResolutionDescriptor desc);
+
+    [[nodiscard]] bool enabled() { return m_desc.enabled; }
+    [[nodiscard]] float targetMs() { return m_desc.targetMs; }
+    [[nodiscard]] float minScale() { return m_desc.minScale; }
+    [[nodiscard]] float maxScale() { return m_desc.maxScale; }
+    [[nodiscard]] float scale() { return m_scale; }
+
+    // Disabling renders at the maximum scale again.
+    void setEnabled(bool enabled);
+    void setTargetMs(float targetMs);
+    void setScaleBounds(float minScale, float maxScale);
+
+    // Call with the GPU time of every frame once it is known, which lags the frame it was measured for.
+    void update(float gpuMs);
+
+    // The viewport to render at, rounded to DYNAMIC_RESOLUTION_ALIGNMENT and never beyond the full dims.
+    [[nodiscard]] glm::ivec2 scaledDims(glm::ivec2 dims);
+
+private:
+    DynamicResolutionDescriptor m_desc;
+    float m_scale;
+};
+
+//------------------------------------------------------------------------
+
+}  // namespace Zhade
+
+//------------------------------------------------------------------------
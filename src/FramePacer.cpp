@@ -0,0 +1,107 @@
+#include "FramePacer.hpp"
+
+#include "Profiler.hpp"
+
+#include <algorithm>
+
+//------------------------------------------------------------------------
+
+namespace Zhade
+{
+
+//------------------------------------------------------------------------
+
+FramePacer::FramePacer(FramePacerDescriptor desc)
+    : m_profiler{desc.profiler}
+{
+    setMaxFramesInFlight(desc.maxFramesInFlight);
+    for (Frame& frame : m_frames) {
+        glCreateQueries(GL_TIMESTAMP, 1, &frame.query);
+    }
+
+    // Pairs the two clocks once, just like the profiler does.
+    glGetInteger64v(GL_TIMESTAMP, &m_gpuStart);
+    m_cpuStart = Clock::now();
+}
+
+//------------------------------------------------------------------------
+
+FramePacer::~FramePacer()
+{
+    for (Frame& frame : m_frames) {
+        if (frame.fence != nullptr) glDeleteSync(frame.fence);
+        glDeleteQueries(1, &frame.query);
+    }
+}
+
+//------------------------------------------------------------------------
+
+void FramePacer::setMaxFramesInFlight(uint32_t maxFramesInFlight)
+{
+    m_maxFramesInFlight = std::clamp(maxFramesInFlight, 1u, implicit_cast<uint32_t>(FRAMES_IN_FLIGHT));
+}
+
+//------------------------------------------------------------------------
+
+void FramePacer::waitForFrameSlot()
+{
+    // Frames that already finished are retired without waiting, so that their latency is recorded right away.
+    while (m_numInFlight > 0 and retireOldest(false)) {}
+    while (m_numInFlight >= m_maxFramesInFlight) {
+        retireOldest(true);
+    }
+}
+
+//------------------------------------------------------------------------
+
+void FramePacer::endFrame(Clock::time_point inputTime)
+{
+    // Only without a preceding waitForFrameSlot(), as every slot may be taken then.
+    if (m_numInFlight == FRAMES_IN_FLIGHT) [[unlikely]] retireOldest(true);
+
+    Frame& frame = m_frames[(m_oldest + m_numInFlight) % FRAMES_IN_FLIGHT];
+    glQueryCounter(frame.query, GL_TIMESTAMP);
+    frame.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    frame.inputTime = inputTime;
+    ++m_numInFlight;
+}
+
+//------------------------------------------------------------------------
+
+bool FramePacer::retireOldest(bool wait)
+{
+    static constexpr GLuint64 waitNs = 1'000'000;
+
+    Frame& frame = m_frames[m_oldest];
+
+    // The first poll flushes, so that the fence can signal at all.
+    GLenum status = glClientWaitSync(frame.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    while (wait and status == GL_TIMEOUT_EXPIRED) {
+        status = glClientWaitSync(frame.fence, 0, waitNs);
+    }
+    if (status == GL_TIMEOUT_EXPIRED) return false;
+    if (status == GL_WAIT_FAILED) [[unlikely]] {
+        fmt::println("Waiting for frame in flight {} failed", m_oldest);
+    }
+    glDeleteSync(frame.fence);
+    frame.fence = nullptr;
+    m_oldest = (m_oldest + 1) % FRAMES_IN_FLIGHT;
+    --m_numInFlight;
+
+    // Available without stalling, as the fence after the query has signaled. Frames latched before any input was
+    // polled have nothing to measure.
+    if (m_profiler == nullptr or frame.inputTime == Clock::time_point{}) return true;
+    GLint64 gpuEnd = 0;
+    glGetQueryObjecti64v(frame.query, GL_QUERY_RESULT, &gpuEnd);
+    const auto cpuEnd = m_cpuStart + std::chrono::nanoseconds{gpuEnd - m_gpuStart};
+    const std::chrono::duration<float, std::milli> latency = cpuEnd - frame.inputTime;
+    m_profiler->recordSample("Input latency", latency.count());
+
+    return true;
+}
+
+//------------------------------------------------------------------------
+
+}  // namespace Zhade
+
+//------------------------------------------------------------------------
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "common.hpp"
+
+extern "C" {
+#include <GL/glew.h>
+}
+
+#include <array>
+#include <chrono>
+
+//------------------------------------------------------------------------
+
+namespace Zhade
+{
+
+//------------------------------------------------------------------------
+
+class Profiler;
+
+struct FramePacerDescriptor
+{
+    uint32_t maxFramesInFlight = FRAMES_IN_FLIGHT;  // At most FRAMES_IN_FLIGHT, as the ring buffers hold no more.
+    Profiler* profiler = nullptr;                   // Receives the "Input latency" samples if set.
+};
+
+//------------------------------------------------------------------------
+// Caps how many frames the GPU may lag behind with one fence per frame, rather than leaving it to however many the
+// driver queues, since every queued frame adds a frame of input latency. Also measures that latency: from when the
+// input a frame shows was polled to when the GPU finished the frame, read from a timestamp query so that it does not
+// depend on when the fence is waited for. Scanout is not included.
+
+class FramePacer
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit FramePacer(FramePacerDescriptor desc);
+    ~FramePacer();
+
+    FramePacer(const FramePacer&) = delete;
+    FramePacer& operator=(const FramePacer&) = delete;
+    FramePacer(FramePacer&&) = delete;
+    FramePacer& operator=(FramePacer&&) = delete;
+
+    [[nodiscard]] uint32_t maxFramesInFlight() { return m_maxFramesInFlight; }
+    [[nodiscard]] uint32_t numFramesInFlight() { return m_numInFlight; }
+
+    // Clamped to [1, FRAMES_IN_FLIGHT], where 1 never lets the CPU record a frame while the GPU renders another.
+    void setMaxFramesInFlight(uint32_t maxFramesInFlight);
+
+    // Blocks until fewer than the maximum number of frames are in flight. Returns right away if called again before
+    // endFrame(), so that it may be called early, e.g. before polling input.
+    void waitForFrameSlot();
+
+    // Call after the last command of the frame. inputTime is when the input the frame shows was polled.
+    void endFrame(Clock::time_point inputTime);
+
+private:
+    struct Frame
+    {
+        GLsync fence = nullptr;
+        GLuint query = 0;
+        Clock::time_point inputTime{};
+    };
+
+    // Returns whether the oldest frame in flight finished, which it always has after waiting.
+    bool retireOldest(bool wait);
+
+    std::array<Frame, FRAMES_IN_FLIGHT> m_frames{};
+    uint32_t m_oldest = 0;
+    uint32_t m_numInFlight = 0;
+    uint32_t m_maxFramesInFlight;
+    Profiler* m_profiler;
+    Clock::time_point m_cpuStart;
+    GLint64 m_gpuStart = 0;
+};
+
+//------------------------------------------------------------------------
+
+}  // namespace Zhade
+
+//------------------------------------------------------------------------
@@ -17,6 +17,11 @@ Framebuffer::Framebuffer(FramebufferDescriptor desc)
     m_texture = m_mngr->createTexture(desc.textureDesc);
     glNamedFramebufferTexture(m_name, desc.attachment, texture()->name(), 0);
 
+    if (desc.depthTextureDesc) {
+        m_depthTexture = m_mngr->createTexture(*desc.depthTextureDesc);
+        glNamedFramebufferTexture(m_name, GL_DEPTH_ATTACHMENT, depthTexture()->name(), 0);
+    }
+
     if (desc.attachment == GL_DEPTH_ATTACHMENT) {
         glNamedFramebufferDrawBuffer(m_name, GL_NONE);
     }
@@ -37,6 +42,7 @@ Framebuffer::~Framebuffer()
 void Framebuffer::freeResources()
 {
     m_mngr->destroy(m_texture);
+    if (m_depthTexture.isValid()) m_mngr->destroy(m_depthTexture);
     glDeleteFramebuffers(1, &m_name);
 }
 
@@ -49,6 +55,13 @@ Texture* Framebuffer::texture()
 
 //------------------------------------------------------------------------
 
+Texture* Framebuffer::depthTexture()
+{
+    return m_mngr->get(m_depthTexture);
+}
+
+//------------------------------------------------------------------------
+
 }  // namespace Zhade
 
 //------------------------------------------------------------------------
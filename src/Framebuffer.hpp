@@ -4,6 +4,8 @@
 #include "Texture.hpp"
 #include "common.hpp"
 
+#include <optional>
+
 //------------------------------------------------------------------------
 
 namespace Zhade
@@ -18,6 +20,7 @@ struct FramebufferDescriptor
     TextureDescriptor textureDesc;
     GLenum attachment;
     ResourceManager* mngr;
+    std::optional<TextureDescriptor> depthTextureDesc{};  // Depth attachment to accompany a color attachment.
     bool managed = true;
 };
 
@@ -37,6 +40,7 @@ public:
 
     [[nodiscard]] GLuint name() { return m_name; }
     [[nodiscard]] Texture* texture();
+    [[nodiscard]] Texture* depthTexture();
 
     void bind(GLenum target = GL_FRAMEBUFFER) { glBindFramebuffer(target, m_name); }
     void freeResources();
@@ -45,6 +49,7 @@ private:
 
     GLuint m_name = 0;
     Handle<Texture> m_texture{};
+    Handle<Texture> m_depthTexture{};
     ResourceManager* m_mngr = nullptr;
     bool m_managed = true;
 };
@@ -0,0 +1,481 @@
+#include "GltfLoader.hpp"
+
+#include "VertexStreams.hpp"
+
+#define CGLTF_IMPLEMENTATION
+#include <cgltf.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdlib>
+#include <cstring>
+#include <numeric>
+#include <string_view>
+
+//------------------------------------------------------------------------
+
+namespace Zhade
+{
+
+//------------------------------------------------------------------------
+
+namespace
+{
+
+//------------------------------------------------------------------------
+
+inline constexpr std::array<std::string_view, cgltf_result_legacy_gltf + 1> s_resultNames{
+    "success", "data too short", "unknown format", "invalid JSON", "invalid glTF", "invalid options",
+    "file not found", "I/O error", "out of memory", "legacy glTF"
+};
+
+//------------------------------------------------------------------------
+
+[[nodiscard]] std::string_view resultName(cgltf_result result)
+{
+    return result < s_resultNames.size() ? s_resultNames[result] : "unknown error";
+}
+
+//------------------------------------------------------------------------
+
+// Runs fn on up to numThreads threads, each of which takes the next index below count until none are left. Joined
+// when the returned threads are destroyed.
+template<typename F>
+[[nodiscard]] std::vector<std::jthread> spawnWorkers(uint32_t numThreads, size_t count, std::atomic<size_t>& next,
+    F fn)
+{
+    std::vector<std::jthread> workers;
+    const size_t numWorkers = std::min<size_t>(numThreads, count);
+    workers.reserve(numWorkers);
+    for ([[maybe_unused]] size_t worker : stdv::iota(size_t{0}, numWorkers)) {
+        workers.emplace_back([&next, count, fn] {
+            for (size_t idx = next++; idx < count; idx = next++) fn(idx);
+        });
+    }
+    return workers;
+}
+
+//------------------------------------------------------------------------
+
+// EXT_meshopt_compression, which cgltf leaves to the application to decode.
+[[nodiscard]] bool isCompressed(const cgltf_accessor* accessor)
+{
+    const cgltf_buffer_view* view = accessor ? accessor->buffer_view : nullptr;
+    return view and view->has_meshopt_compression and view->data == nullptr;
+}
+
+//------------------------------------------------------------------------
+
+// Null where the bytes are not in memory as the accessor describes them, e.g. sparse.
+[[nodiscard]] const std::byte* accessorData(const cgltf_accessor* accessor)
+{
+    if (accessor->is_sparse or accessor->buffer_view == nullptr) return nullptr;
+    const uint8_t* viewData = cgltf_buffer_view_data(accessor->buffer_view);
+    return viewData ? std::bit_cast<const std::byte*>(viewData + accessor->offset) : nullptr;
+}
+
+//------------------------------------------------------------------------
+
+// Points straight into the buffer where the accessor holds plain floats, otherwise unpacks them into storage.
+[[nodiscard]] VertexStream floatStream(const cgltf_accessor* accessor, std::vector<float>& storage)
+{
+    if (accessor == nullptr) return {};
+
+    const std::byte* data = accessorData(accessor);
+    if (data and accessor->component_type == cgltf_component_type_r_32f) {
+        return {.data = data, .stride = accessor->stride};
+    }
+
+    const size_t numComponents = cgltf_num_components(accessor->type);
+    storage.resize(accessor->count * numComponents);
+    cgltf_accessor_unpack_floats(accessor, storage.data(), storage.size());
+    return {.data = std::bit_cast<const std::byte*>(storage.data()), .stride = numComponents * sizeof(float)};
+}
+
+//------------------------------------------------------------------------
+
+// Non-indexed primitives count up from 0.
+void writeIndices(const cgltf_accessor* accessor, std::span<GLuint> dst)
+{
+    if (accessor == nullptr) {
+        std::iota(dst.begin(), dst.end(), GLuint{0});
+        return;
+    }
+
+    const std::byte* data = accessorData(accessor);
+    if (data and accessor->component_type == cgltf_component_type_r_16u and accessor->stride == sizeof(uint16_t)) {
+        widenIndices({std::bit_cast<const uint16_t*>(data), dst.size()}, dst);
+    } else if (data and accessor->component_type == cgltf_component_type_r_32u and accessor->stride == sizeof(GLuint)) {
+        std::memcpy(dst.data(), data, dst.size_bytes());
+    } else {
+        for (size_t idx = 0; idx < dst.size(); ++idx) {
+            dst[idx] = implicit_cast<GLuint>(cgltf_accessor_read_index(accessor, idx));
+        }
+    }
+}
+
+//------------------------------------------------------------------------
+
+// Area weighted, as Assimp's aiProcess_GenSmoothNormals does for the other formats.
+[[nodiscard]] std::vector<glm::vec3> smoothNormals(const cgltf_accessor* positions, const cgltf_accessor* indices,
+    size_t numIndices)
+{
+    std::vector<glm::vec3> points(positions->count);
+    cgltf_accessor_unpack_floats(positions, &points[0].x, 3 * points.size());
+
+    std::vector<glm::vec3> normals(points.size(), glm::vec3{0.0f});
+    const auto index = [&](size_t idx) { return indices ? cgltf_accessor_read_index(indices, idx) : idx; };
+    for (size_t idx = 0; idx + 2 < numIndices; idx += 3) {
+        const size_t i0 = index(idx);
+        const size_t i1 = index(idx + 1);
+        const size_t i2 = index(idx + 2);
+        const glm::vec3 normal = glm::cross(points[i1] - points[i0], points[i2] - points[i0]);
+        normals[i0] += normal;
+        normals[i1] += normal;
+        normals[i2] += normal;
+    }
+    for (glm::vec3& normal : normals) {
+        const float length = glm::length(normal);
+        normal = length > 0.0f ? normal / length : glm::vec3{0.0f, 1.0f, 0.0f};
+    }
+    return normals;
+}
+
+//------------------------------------------------------------------------
+
+[[nodiscard]] const cgltf_accessor* findAttribute(const cgltf_primitive& primitive, cgltf_attribute_type type,
+    cgltf_int index, cgltf_type elementType)
+{
+    for (const cgltf_attribute& attribute : std::span{primitive.attributes, primitive.attributes_count}) {
+        if (attribute.type == type and attribute.index == index) {
+            return attribute.data->type == elementType ? attribute.data : nullptr;
+        }
+    }
+    return nullptr;
+}
+
+//------------------------------------------------------------------------
+
+// EXT_mesh_gpu_instancing, with the instances in the space of the node.
+[[nodiscard]] std::vector<glm::mat4> instanceTransforms(const cgltf_node* node)
+{
+    const cgltf_accessor* translations = nullptr;
+    const cgltf_accessor* rotations = nullptr;
+    const cgltf_accessor* scales = nullptr;
+    size_t numInstances = 0;
+    for (const cgltf_attribute& attribute :
+        std::span{node->mesh_gpu_instancing.attributes, node->mesh_gpu_instancing.attributes_count})
+    {
+        const std::string_view name{attribute.name};
+        if (name == "TRANSLATION") translations = attribute.data;
+        else if (name == "ROTATION") rotations = attribute.data;
+        else if (name == "SCALE") scales = attribute.data;
+        else continue;
+        numInstances = attribute.data->count;
+    }
+
+    std::vector<glm::mat4> transforms(numInstances);
+    for (size_t idx = 0; idx < numInstances; ++idx) {
+        glm::vec3 translation{0.0f};
+        glm::vec4 rotation{0.0f, 0.0f, 0.0f, 1.0f};  // xyzw, as glTF stores quaternions.
+        glm::vec3 scale{1.0f};
+        if (translations) cgltf_accessor_read_float(translations, idx, &translation.x, 3);
+        if (rotations) cgltf_accessor_read_float(rotations, idx, &rotation.x, 4);
+        if (scales) cgltf_accessor_read_float(scales, idx, &scale.x, 3);
+
+        transforms[idx] = glm::translate(glm::mat4{1.0f}, translation)
+            * glm::mat4_cast(glm::quat{rotation.w, rotation.x, rotation.y, rotation.z})
+            * glm::scale(glm::mat4{1.0f}, scale);
+    }
+    return transforms;
+}
+
+//------------------------------------------------------------------------
+
+// Of a data URI, whose size cgltf needs up front. Empty if it is not base64.
+[[nodiscard]] std::vector<stbi_uc> decodeDataUri(const cgltf_options& options, std::string_view uri)
+{
+    static constexpr std::string_view marker = ";base64,";
+    const size_t start = uri.find(marker);
+    if (start == std::string_view::npos) return {};
+
+    std::string_view base64 = uri.substr(start + marker.size());
+    const size_t numPadding = base64.size() - std::min(base64.find_last_not_of('='), base64.size() - 1) - 1;
+    const size_t size = base64.size() / 4 * 3 - numPadding;
+
+    void* decoded = nullptr;
+    if (cgltf_load_buffer_base64(&options, size, base64.data(), &decoded) != cgltf_result_success) return {};
+    const auto* bytes = std::bit_cast<const stbi_uc*>(decoded);
+    std::vector<stbi_uc> data{bytes, bytes + size};
+    std::free(decoded);
+    return data;
+}
+
+//------------------------------------------------------------------------
+
+}  // namespace
+
+//------------------------------------------------------------------------
+
+GltfLoader::GltfLoader(const fs::path& path, uint32_t numThreads)
+    : m_numThreads{numThreads == 0 ? std::max(std::thread::hardware_concurrency(), 1u) : numThreads},
+      m_file{path}
+{
+    if (m_file.size() == 0) {
+        fmt::println("Error reading glTF file {}", path.string());
+        return;
+    }
+
+    const cgltf_options options{};
+    if (const cgltf_result result = cgltf_parse(&options, m_file.data(), m_file.size(), &m_data);
+        result != cgltf_result_success)
+    {
+        fmt::println("Error parsing glTF file {}: {}", path.string(), resultName(result));
+        return;
+    }
+    if (not loadExternalBuffers(path.parent_path())) return;
+
+    // Left to cgltf are the GLB binary chunk, which it points to in the mapped file, and data URIs.
+    const std::string pathStr{path.string()};
+    if (const cgltf_result result = cgltf_load_buffers(&options, m_data, pathStr.c_str());
+        result != cgltf_result_success)
+    {
+        fmt::println("Error loading the buffers of {}: {}", pathStr, resultName(result));
+        return;
+    }
+    if (const cgltf_result result = cgltf_validate(m_data); result != cgltf_result_success) {
+        fmt::println("Error validating glTF file {}: {}", pathStr, resultName(result));
+        return;
+    }
+
+    addPrimitives(path);
+    startDecoding();
+
+    const cgltf_scene* scene = m_data->scene ? m_data->scene : (m_data->scenes_count > 0 ? m_data->scenes : nullptr);
+    if (scene) {
+        for (const cgltf_node* node : std::span{scene->nodes, scene->nodes_count}) {
+            addInstances(node);
+        }
+    } else {
+        for (const cgltf_node& node : std::span{m_data->nodes, m_data->nodes_count}) {
+            if (node.parent == nullptr) addInstances(&node);
+        }
+    }
+
+    m_valid = true;
+}
+
+//------------------------------------------------------------------------
+
+GltfLoader::~GltfLoader()
+{
+    m_decoders.clear();
+    cgltf_free(m_data);
+}
+
+//------------------------------------------------------------------------
+
+void GltfLoader::write(std::span<Vertex> vertices, std::span<GLuint> indices)
+{
+    std::atomic<size_t> next = 0;
+    const auto workers = spawnWorkers(m_numThreads, m_primitives.size(), next, [&](size_t idx) {
+        writePrimitive(implicit_cast<uint32_t>(idx), vertices, indices);
+    });
+}
+
+//------------------------------------------------------------------------
+
+StbImageResource<>& GltfLoader::image(uint32_t idx)
+{
+    m_images[idx].decoded.wait(false);
+    return *m_images[idx].pixels;
+}
+
+//------------------------------------------------------------------------
+
+// Mapped rather than read by cgltf, which copies them into memory.
+bool GltfLoader::loadExternalBuffers(const fs::path& dir)
+{
+    for (cgltf_buffer& buffer : std::span{m_data->buffers, m_data->buffers_count}) {
+        if (buffer.uri == nullptr or std::strncmp(buffer.uri, "data:", 5) == 0) continue;
+        if (std::strstr(buffer.uri, "://")) {
+            fmt::println("Error loading glTF buffer {}: only local files are supported", buffer.uri);
+            return false;
+        }
+
+        cgltf_decode_uri(buffer.uri);
+        auto& file = m_buffers.emplace_back(std::make_unique<MappedFile>(dir / buffer.uri));
+        if (file->size() < buffer.size) {
+            fmt::println("Error loading glTF buffer {}: expected {} bytes, got {}", buffer.uri, buffer.size,
+                file->size());
+            return false;
+        }
+        buffer.data = std::bit_cast<void*>(file->data());
+        buffer.data_free_method = cgltf_data_free_method_none;
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------
+
+// Primitives are numbered in the order of the meshes, and vertices and indices are laid out in that order too.
+void GltfLoader::addPrimitives(const fs::path& path)
+{
+    std::vector<uint32_t> imageIndices(m_data->images_count, s_noImage);
+    uint32_t numDropped = 0;
+
+    for (const cgltf_mesh& mesh : std::span{m_data->meshes, m_data->meshes_count}) {
+        m_meshPrimitives.emplace_back(implicit_cast<uint32_t>(m_primitives.size()), 0);
+
+        for (const cgltf_primitive& primitive : std::span{mesh.primitives, mesh.primitives_count}) {
+            PrimitiveSource source{
+                .positions = findAttribute(primitive, cgltf_attribute_type_position, 0, cgltf_type_vec3),
+                .normals = findAttribute(primitive, cgltf_attribute_type_normal, 0, cgltf_type_vec3),
+                .indices = primitive.indices
+            };
+            const bool isMeshoptCompressed = isCompressed(source.positions) or isCompressed(source.normals)
+                or isCompressed(source.indices);
+            if (primitive.type != cgltf_primitive_type_triangles or primitive.has_draco_mesh_compression
+                or isMeshoptCompressed or source.positions == nullptr)
+            {
+                ++numDropped;
+                continue;
+            }
+
+            uint32_t image = s_noImage;
+            const cgltf_material* material = primitive.material;
+            if (material and material->has_pbr_metallic_roughness) {
+                const cgltf_texture_view& view = material->pbr_metallic_roughness.base_color_texture;
+                source.uvs = findAttribute(primitive, cgltf_attribute_type_texcoord, view.texcoord, cgltf_type_vec2);
+                if (view.texture and view.texture->image) {
+                    uint32_t& imageIdx = imageIndices[view.texture->image - m_data->images];
+                    if (imageIdx == s_noImage) {
+                        imageIdx = implicit_cast<uint32_t>(m_images.size());
+                        m_images.emplace_back();
+                    }
+                    image = imageIdx;
+                }
+            }
+            if (source.uvs == nullptr) {
+                source.uvs = findAttribute(primitive, cgltf_attribute_type_texcoord, 0, cgltf_type_vec2);
+            }
+            if (isCompressed(source.uvs)) source.uvs = nullptr;
+
+            const auto numVertices = implicit_cast<uint32_t>(source.positions->count);
+            const auto numIndices = implicit_cast<uint32_t>(source.indices ? source.indices->count : numVertices);
+            m_primitives.push_back({
+                .firstVertex = m_numVertices,
+                .numVertices = numVertices,
+                .firstIndex = m_numIndices,
+                .numIndices = numIndices,
+                .image = image
+            });
+            m_sources.push_back(source);
+            m_numVertices += numVertices;
+            m_numIndices += numIndices;
+            ++m_meshPrimitives.back().second;
+        }
+    }
+
+    for (size_t idx = 0; idx < imageIndices.size(); ++idx) {
+        if (imageIndices[idx] == s_noImage) continue;
+        cgltf_image& image = m_data->images[idx];
+        const bool isFile = image.buffer_view == nullptr and image.uri and std::strncmp(image.uri, "data:", 5) != 0;
+        if (isFile) cgltf_decode_uri(image.uri);
+        m_images[imageIndices[idx]].key = isFile
+            ? path.parent_path() / image.uri
+            : fs::path{fmt::format("{}#image{}", path.string(), idx)};
+        m_images[imageIndices[idx]].source = &image;
+    }
+
+    if (numDropped > 0) {
+        fmt::println("Dropped {} glTF primitives of {} that are not triangles, lack positions or are compressed",
+            numDropped, path.string());
+    }
+}
+
+//------------------------------------------------------------------------
+
+void GltfLoader::addInstances(const cgltf_node* node)
+{
+    if (node->mesh) {
+        cgltf_float world[16];
+        cgltf_node_transform_world(node, world);
+        const glm::mat4 nodeTransform = glm::make_mat4(world);
+
+        std::vector<glm::mat4> transforms{nodeTransform};
+        if (node->has_mesh_gpu_instancing) {
+            transforms = instanceTransforms(node);
+            for (glm::mat4& transform : transforms) transform = nodeTransform * transform;
+        }
+
+        const auto [firstPrimitive, numPrimitives] = m_meshPrimitives[node->mesh - m_data->meshes];
+        for (const glm::mat4& transform : transforms) {
+            for (uint32_t primitive = firstPrimitive; primitive < firstPrimitive + numPrimitives; ++primitive) {
+                m_instances.push_back({.primitive = primitive, .transform = transform});
+            }
+        }
+    }
+
+    for (const cgltf_node* child : std::span{node->children, node->children_count}) {
+        addInstances(child);
+    }
+}
+
+//------------------------------------------------------------------------
+
+// Embedded images are decoded from the mapped file, files by stb itself.
+void GltfLoader::startDecoding()
+{
+    m_decoders = spawnWorkers(m_numThreads, m_images.size(), m_nextImage, [this](size_t idx) {
+        Image& image = m_images[idx];
+        const cgltf_image* source = image.source;
+        if (source->buffer_view) {
+            const auto* data = std::bit_cast<const stbi_uc*>(cgltf_buffer_view_data(source->buffer_view));
+            image.pixels.emplace(std::span{data, source->buffer_view->size});
+        } else if (source->uri and std::strncmp(source->uri, "data:", 5) == 0) {
+            const cgltf_options options{};
+            image.pixels.emplace(decodeDataUri(options, source->uri));
+        } else {
+            image.pixels.emplace(image.key);
+        }
+        image.decoded.test_and_set();
+        image.decoded.notify_all();
+    });
+}
+
+//------------------------------------------------------------------------
+
+void GltfLoader::writePrimitive(uint32_t idx, std::span<Vertex> vertices, std::span<GLuint> indices)
+{
+    const GltfPrimitive& primitive = m_primitives[idx];
+    const PrimitiveSource& source = m_sources[idx];
+
+    std::vector<float> positions;
+    std::vector<float> normals;
+    std::vector<float> uvs;
+    std::vector<glm::vec3> smoothed;
+    VertexStreams streams{
+        .positions = floatStream(source.positions, positions),
+        .normals = floatStream(source.normals, normals),
+        .uvs = floatStream(source.uvs, uvs),
+        .flipV = true
+    };
+    if (source.normals == nullptr) {
+        smoothed = smoothNormals(source.positions, source.indices, primitive.numIndices);
+        streams.normals = {.data = std::bit_cast<const std::byte*>(smoothed.data()), .stride = sizeof(glm::vec3)};
+    }
+
+    interleaveVertices(streams, vertices.subspan(primitive.firstVertex, primitive.numVertices));
+    writeIndices(source.indices, indices.subspan(primitive.firstIndex, primitive.numIndices));
+}
+
+//------------------------------------------------------------------------
+
+}  // namespace Zhade
+
+//------------------------------------------------------------------------
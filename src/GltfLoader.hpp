@@ -0,0 +1,127 @@
+#pragma once
+
+#include "MappedFile.hpp"
+#include "StbImageResource.hpp"
+#include "common.hpp"
+
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <span>
+#include <thread>
+#include <vector>
+
+struct cgltf_accessor;
+struct cgltf_data;
+struct cgltf_image;
+struct cgltf_node;
+struct cgltf_primitive;
+
+//------------------------------------------------------------------------
+
+namespace Zhade
+{
+
+//------------------------------------------------------------------------
+
+// Indexed triangles, whose indices are relative to the first vertex.
+struct GltfPrimitive
+{
+    uint32_t firstVertex;
+    uint32_t numVertices;
+    uint32_t firstIndex;
+    uint32_t numIndices;
+    uint32_t image;  // Of the base color texture, GltfLoader::s_noImage without one.
+};
+
+// One per node and primitive of its mesh, and per instance of EXT_mesh_gpu_instancing.
+struct GltfInstance
+{
+    uint32_t primitive;
+    glm::mat4 transform;  // From the primitive to the file's world space.
+};
+
+//------------------------------------------------------------------------
+// glTF 2.0 and GLB loader, as going through Assimp converts the already GPU-shaped buffers into aiMeshes and back.
+// cgltf parses the JSON and the GLB container, and the file and its external buffers are mapped, so that write() copies
+// float accessors straight from them, or converts them with SIMD, and unpacks the rest. The base color images start
+// decoding on worker threads as soon as the file is parsed. Only triangle primitives with POSITION, NORMAL and
+// TEXCOORD_n are loaded; normals are smoothed from the triangles where a primitive has none.
+
+class GltfLoader
+{
+public:
+    static constexpr uint32_t s_noImage = ~0u;
+
+    // Parses and decodes on up to numThreads threads, all hardware threads if 0. Failures leave the loader invalid.
+    explicit GltfLoader(const fs::path& path, uint32_t numThreads = 0);
+    ~GltfLoader();
+
+    GltfLoader(const GltfLoader&) = delete;
+    GltfLoader& operator=(const GltfLoader&) = delete;
+    GltfLoader(GltfLoader&&) = delete;
+    GltfLoader& operator=(GltfLoader&&) = delete;
+
+    [[nodiscard]] bool valid() { return m_valid; }
+    [[nodiscard]] uint32_t numVertices() { return m_numVertices; }
+    [[nodiscard]] uint32_t numIndices() { return m_numIndices; }
+    [[nodiscard]] uint32_t numImages() { return implicit_cast<uint32_t>(m_images.size()); }
+    [[nodiscard]] std::span<const GltfPrimitive> primitives() { return m_primitives; }
+    [[nodiscard]] std::span<const GltfInstance> instances() { return m_instances; }
+
+    // The spans hold numVertices() and numIndices() elements, e.g. ranges reserved in mapped buffers.
+    void write(std::span<Vertex> vertices, std::span<GLuint> indices);
+
+    // Blocks until the image is decoded, whose data is null if it could not be.
+    [[nodiscard]] StbImageResource<>& image(uint32_t idx);
+    // The image file, or the model file and the index for images embedded in it, so that textures can be cached.
+    [[nodiscard]] const fs::path& imageKey(uint32_t idx) { return m_images[idx].key; }
+
+private:
+    // The accessors of a primitive, the ones it lacks or that have the wrong type are null.
+    struct PrimitiveSource
+    {
+        const cgltf_accessor* positions = nullptr;
+        const cgltf_accessor* normals = nullptr;
+        const cgltf_accessor* uvs = nullptr;
+        const cgltf_accessor* indices = nullptr;
+    };
+
+    struct Image
+    {
+        fs::path key;
+        const cgltf_image* source;
+        std::optional<StbImageResource<>> pixels;
+        std::atomic_flag decoded;
+    };
+
+    [[nodiscard]] bool loadExternalBuffers(const fs::path& dir);
+    void addPrimitives(const fs::path& path);
+    void addInstances(const cgltf_node* node);
+    void startDecoding();
+    void writePrimitive(uint32_t idx, std::span<Vertex> vertices, std::span<GLuint> indices);
+
+    bool m_valid = false;
+    uint32_t m_numThreads;
+    uint32_t m_numVertices = 0;
+    uint32_t m_numIndices = 0;
+    MappedFile m_file;
+    std::vector<std::unique_ptr<MappedFile>> m_buffers;  // External ones, which cgltf then leaves alone.
+    cgltf_data* m_data = nullptr;
+    std::vector<GltfPrimitive> m_primitives;
+    std::vector<PrimitiveSource> m_sources;
+    std::vector<std::pair<uint32_t, uint32_t>> m_meshPrimitives;  // First primitive and count per glTF mesh.
+    std::vector<GltfInstance> m_instances;
+    std::deque<Image> m_images;  // In place, as the decoders signal through them.
+    std::atomic<size_t> m_nextImage = 0;
+    std::vector<std::jthread> m_decoders;  // Joined before the data is freed, as they read embedded images from it.
+};
+
+//------------------------------------------------------------------------
+
+}  // namespace Zhade
+
+//------------------------------------------------------------------------
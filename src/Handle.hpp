@@ -2,6 +2,7 @@
 
 #include <concepts>
 #include <cstdint>
+#include <functional>
 
 //------------------------------------------------------------------------
 
@@ -17,6 +18,7 @@ class [[nodiscard]] Handle
 public:
     Handle() = default;
     [[nodiscard]] bool isValid() { return m_generation != 0; }
+    [[nodiscard]] bool operator==(const Handle&) const = default;
 
 private:
     Handle(uint32_t index, uint32_t generation) : m_index{index}, m_generation{generation} {}
@@ -27,6 +29,8 @@ private:
     template<typename U>
     requires (std::default_initializable<U>)
     friend class ObjectPool;
+
+    friend struct std::hash<Handle>;
 };
 
 //------------------------------------------------------------------------
@@ -34,3 +38,14 @@ private:
 }  // namespace Zhade
 
 //------------------------------------------------------------------------
+
+template<typename T>
+struct std::hash<Zhade::Handle<T>>
+{
+    [[nodiscard]] size_t operator()(const Zhade::Handle<T>& handle) const noexcept
+    {
+        return std::hash<uint64_t>{}(uint64_t{handle.m_generation} << 32 | handle.m_index);
+    }
+};
+
+//------------------------------------------------------------------------
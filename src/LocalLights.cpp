@@ -0,0 +1,181 @@
+#include "LocalLights.hpp"
+
+#include "ResourceManager.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+//------------------------------------------------------------------------
+
+namespace Zhade
+{
+
+//------------------------------------------------------------------------
+
+LocalLights::LocalLights(LocalLightsDescriptor desc)
+    : m_mngr{desc.mngr},
+      m_binningPipeline{desc.mngr->createPipeline(desc.binningDesc)},
+      m_compactionPipeline{desc.mngr->createPipeline(desc.compactionDesc)}
+{}
+
+//------------------------------------------------------------------------
+
+LocalLights::~LocalLights()
+{
+    m_mngr->destroy(m_binningPipeline);
+    m_mngr->destroy(m_compactionPipeline);
+}
+
+//------------------------------------------------------------------------
+
+bool LocalLights::add(const LocalLight& light)
+{
+    if (m_lights.size() >= MAX_LOCAL_LIGHTS) {
+        fmt::println("Cannot add more than {} local lights", MAX_LOCAL_LIGHTS);
+        return false;
+    }
+    m_lights.push_back(light);
+    return true;
+}
+
+//------------------------------------------------------------------------
+
+LocalLight LocalLights::makePointLight(const glm::vec3& position, float range, const glm::vec3& color,
+    float intensity)
+{
+    return {
+        .position = position,
+        .range = range,
+        .color = color,
+        .intensity = intensity,
+        .type = LocalLightType::POINT
+    };
+}
+
+//------------------------------------------------------------------------
+
+LocalLight LocalLights::makeSpotLight(const glm::vec3& position, const glm::vec3& direction, float range,
+    const glm::vec3& color, float intensity, float innerAngle, float outerAngle)
+{
+    return {
+        .position = position,
+        .range = range,
+        .color = color,
+        .intensity = intensity,
+        .direction = glm::normalize(direction),
+        .cosOuterAngle = std::cos(outerAngle),
+        .cosInnerAngle = std::cos(std::min(innerAngle, outerAngle)),
+        .type = LocalLightType::SPOT
+    };
+}
+
+//------------------------------------------------------------------------
+
+// The froxel lists are transient, as nothing reads them beyond the frame. Binning appends to fixed capacity slots per
+// froxel through atomics, and compaction packs the slots densely, which is what shading reads.
+LightClusterResources LocalLights::addCullingPasses(RenderGraph& graph, RingBuffer& frameData,
+    RingBuffer& lightData, const LightCullingView& view)
+{
+    static constexpr GLsizei numSlots = NUM_LIGHT_CLUSTERS * MAX_LIGHTS_PER_CLUSTER;
+    const auto numLights = implicit_cast<GLuint>(m_lights.size());
+
+    // Bound even without lights, and empty ranges cannot be.
+    m_lightsSlice = lightData.allocate(std::max(numLights, 1u) * sizeof(LocalLight));
+    std::memcpy(m_lightsSlice.ptr, m_lights.data(), numLights * sizeof(LocalLight));
+
+    const float logDepthRatio = std::log(view.zFar / view.zNear);
+    m_settingsSlice = frameData.push(LightClusterSettings{
+        .tileSize = glm::vec2{view.dims} / glm::vec2{LIGHT_CLUSTER_GRID_X, LIGHT_CLUSTER_GRID_Y},
+        .zNear = view.zNear,
+        .zFar = view.zFar,
+        .sliceScale = LIGHT_CLUSTER_GRID_Z / logDepthRatio,
+        .sliceBias = -LIGHT_CLUSTER_GRID_Z * std::log(view.zNear) / logDepthRatio,
+        .numLights = numLights
+    });
+    m_viewSlice = frameData.push(view.matrices);
+
+    const GraphResource counts = graph.createBuffer(
+        "Light cluster counts", NUM_LIGHT_CLUSTERS * sizeof(GLuint), BufferUsage::STORAGE
+    );
+    const GraphResource slots = graph.createBuffer(
+        "Light cluster slots", numSlots * sizeof(GLuint), BufferUsage::STORAGE
+    );
+    const LightClusterResources resources{
+        .clusters = graph.createBuffer("Light clusters", NUM_LIGHT_CLUSTERS * sizeof(glm::uvec2), BufferUsage::STORAGE),
+        .indices = graph.createBuffer("Light indices", (1 + numSlots) * sizeof(GLuint), BufferUsage::STORAGE)
+    };
+
+    graph.addPass({
+        .name = "Clear light clusters",
+        .writes = {{counts, ResourceAccess::BUFFER_UPDATE}, {resources.indices, ResourceAccess::BUFFER_UPDATE}},
+        .execute = [counts, resources](RenderGraph& graph) {
+            static constexpr GLuint zero = 0;
+            glClearNamedBufferData(graph.buffer(counts)->name(), GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+            glClearNamedBufferSubData(graph.buffer(resources.indices)->name(), GL_R32UI, 0, sizeof(GLuint),
+                GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+        }
+    });
+    graph.addPass({
+        .name = "Light binning",
+        .reads = {{counts, ResourceAccess::STORAGE}},
+        .writes = {{counts, ResourceAccess::STORAGE}, {slots, ResourceAccess::STORAGE}},
+        .execute = [this, counts, slots, numLights](RenderGraph& graph) {
+            pipeline(m_binningPipeline)->bind();
+            bindLights();
+            RingBuffer::bindRange(m_viewSlice, BufferUsage::UNIFORM, VIEW_PROJ_BINDING);
+            graph.buffer(counts)->bindBaseAs(LIGHT_CLUSTER_COUNTS_BINDING, BufferUsage::STORAGE);
+            graph.buffer(slots)->bindBaseAs(LIGHT_CLUSTER_SLOTS_BINDING, BufferUsage::STORAGE);
+            glDispatchCompute(util::divup(numLights, WORK_GROUP_LOCAL_SIZE_X), 1, 1);
+        }
+    });
+    graph.addPass({
+        .name = "Light compaction",
+        .reads = {
+            {counts, ResourceAccess::STORAGE},
+            {slots, ResourceAccess::STORAGE},
+            {resources.indices, ResourceAccess::STORAGE}
+        },
+        .writes = {{resources.clusters, ResourceAccess::STORAGE}, {resources.indices, ResourceAccess::STORAGE}},
+        .execute = [this, counts, slots, resources](RenderGraph& graph) {
+            pipeline(m_compactionPipeline)->bind();
+            graph.buffer(counts)->bindBaseAs(LIGHT_CLUSTER_COUNTS_BINDING, BufferUsage::STORAGE);
+            graph.buffer(slots)->bindBaseAs(LIGHT_CLUSTER_SLOTS_BINDING, BufferUsage::STORAGE);
+            graph.buffer(resources.clusters)->bindBaseAs(LIGHT_CLUSTERS_BINDING, BufferUsage::STORAGE);
+            graph.buffer(resources.indices)->bindBaseAs(LIGHT_INDICES_BINDING, BufferUsage::STORAGE);
+            glDispatchCompute(util::divup(NUM_LIGHT_CLUSTERS, WORK_GROUP_LOCAL_SIZE_X), 1, 1);
+        }
+    });
+
+    return resources;
+}
+
+//------------------------------------------------------------------------
+
+void LocalLights::bindClusters(RenderGraph& graph, const LightClusterResources& resources)
+{
+    bindLights();
+    graph.buffer(resources.clusters)->bindBaseAs(LIGHT_CLUSTERS_BINDING, BufferUsage::STORAGE);
+    graph.buffer(resources.indices)->bindBaseAs(LIGHT_INDICES_BINDING, BufferUsage::STORAGE);
+}
+
+//------------------------------------------------------------------------
+
+Pipeline* LocalLights::pipeline(const Handle<Pipeline>& handle)
+{
+    return m_mngr->get(handle);
+}
+
+//------------------------------------------------------------------------
+
+void LocalLights::bindLights()
+{
+    RingBuffer::bindRange(m_lightsSlice, BufferUsage::STORAGE, LOCAL_LIGHTS_BINDING);
+    RingBuffer::bindRange(m_settingsSlice, BufferUsage::UNIFORM, LIGHT_CLUSTER_SETTINGS_BINDING);
+}
+
+//------------------------------------------------------------------------
+
+}  // namespace Zhade
+
+//------------------------------------------------------------------------
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "Handle.hpp"
+#include "Pipeline.hpp"
+#include "RenderGraph.hpp"
+#include "RingBuffer.hpp"
+#include "common.hpp"
+
+#include <glm/glm.hpp>
+
+#include <span>
+#include <vector>
+
+//------------------------------------------------------------------------
+
+namespace Zhade
+{
+
+//------------------------------------------------------------------------
+
+class ResourceManager;
+
+namespace LocalLightType
+{
+    using Type = uint8_t;
+    enum : Type
+    {
+        POINT = LOCAL_LIGHT_POINT,
+        SPOT = LOCAL_LIGHT_SPOT,
+        NUM_LOCAL_LIGHT_TYPES
+    };
+}
+
+struct LocalLightsDescriptor
+{
+    ResourceManager* mngr;
+    PipelineDescriptor binningDesc;
+    PipelineDescriptor compactionDesc;
+};
+
+// The camera of the frame the lights are binned for.
+struct LightCullingView
+{
+    ViewProjMatrices matrices;
+    float zNear;
+    float zFar;
+    glm::ivec2 dims;
+};
+
+// The per-froxel light lists of the frame, which the shading passes read.
+struct LightClusterResources
+{
+    GraphResource clusters;
+    GraphResource indices;
+};
+
+//------------------------------------------------------------------------
+// Point and spot lights shaded through clustered forward shading: every frame, a compute pass bins the lights into a
+// grid of froxels, and another compacts the per-froxel lists, so that shading only iterates the lights of its froxel.
+
+class LocalLights
+{
+public:
+    explicit LocalLights(LocalLightsDescriptor desc);
+    ~LocalLights();
+
+    LocalLights(const LocalLights&) = delete;
+    LocalLights& operator=(const LocalLights&) = delete;
+    LocalLights(LocalLights&&) = delete;
+    LocalLights& operator=(LocalLights&&) = delete;
+
+    [[nodiscard]] size_t numLights() { return m_lights.size(); }
+
+    // May be changed freely, as the lights are uploaded anew every frame.
+    [[nodiscard]] std::span<LocalLight> lights() { return m_lights; }
+
+    // Fails once MAX_LOCAL_LIGHTS are added.
+    bool add(const LocalLight& light);
+    void clear() { m_lights.clear(); }
+
+    // Angles are half angles of the cone in radians, light falls off between the inner and the outer one.
+    [[nodiscard]] static LocalLight makePointLight(const glm::vec3& position, float range, const glm::vec3& color,
+        float intensity);
+    [[nodiscard]] static LocalLight makeSpotLight(const glm::vec3& position, const glm::vec3& direction, float range,
+        const glm::vec3& color, float intensity, float innerAngle, float outerAngle);
+
+    // Uploads the lights into lightData and bins them for the view.
+    [[nodiscard]] LightClusterResources addCullingPasses(RenderGraph& graph, RingBuffer& frameData,
+        RingBuffer& lightData, const LightCullingView& view);
+
+    // Within a pass reading the resources, binds everything shading.glsl needs for the local lights.
+    void bindClusters(RenderGraph& graph, const LightClusterResources& resources);
+
+private:
+    [[nodiscard]] Pipeline* pipeline(const Handle<Pipeline>& handle);
+
+    void bindLights();
+
+    ResourceManager* m_mngr;
+    std::vector<LocalLight> m_lights;
+    Handle<Pipeline> m_binningPipeline;
+    Handle<Pipeline> m_compactionPipeline;
+    RingSlice m_lightsSlice{};  // All three only valid for the frame that allocated them.
+    RingSlice m_settingsSlice{};
+    RingSlice m_viewSlice{};
+};
+
+//------------------------------------------------------------------------
+
+}  // namespace Zhade
+
+//------------------------------------------------------------------------
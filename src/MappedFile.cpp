@@ -0,0 +1 @@
+#include "MappedFile.hpp"
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "common.hpp"
+
+#include <bit>
+#include <string>
+#include <string_view>
+
+#if defined(__unix__) || defined(__APPLE__)
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#else
+    #include <fstream>
+    #include <iterator>
+#endif
+
+//------------------------------------------------------------------------
+
+namespace Zhade
+{
+
+//------------------------------------------------------------------------
+// A whole file, read-only. Mapped where the platform allows, read into memory elsewhere. Empty if it cannot be read.
+
+class MappedFile
+{
+public:
+    explicit MappedFile(const fs::path& path)
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        const int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        struct stat info{};
+        if (fstat(fd, &info) == 0 and info.st_size > 0) {
+            const auto size = implicit_cast<size_t>(info.st_size);
+            void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED) {
+                madvise(data, size, MADV_WILLNEED);
+                m_text = {std::bit_cast<const char*>(data), size};
+            }
+        }
+        close(fd);
+#else
+        std::ifstream file{path, std::ios::binary};
+        m_buffer.assign(std::istreambuf_iterator<char>{file}, {});
+        m_text = m_buffer;
+#endif
+    }
+
+    ~MappedFile()
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        if (not m_text.empty()) munmap(std::bit_cast<void*>(m_text.data()), m_text.size());
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&&) = delete;
+    MappedFile& operator=(MappedFile&&) = delete;
+
+    [[nodiscard]] std::string_view text() const { return m_text; }
+    [[nodiscard]] const std::byte* data() const { return std::bit_cast<const std::byte*>(m_text.data()); }
+    [[nodiscard]] size_t size() const { return m_text.size(); }
+
+private:
+    std::string_view m_text;
+#if !(defined(__unix__) || defined(__APPLE__))
+    std::string m_buffer;
+#endif
+};
+
+//------------------------------------------------------------------------
+
+}  // namespace Zhade
+
+//------------------------------------------------------------------------
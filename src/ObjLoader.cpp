@@ -0,0 +1,503 @@
+#include "ObjLoader.hpp"
+
+#include "MappedFile.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cstring>
+#include <numeric>
+#include <thread>
+
+//------------------------------------------------------------------------
+
+namespace Zhade
+{
+
+//------------------------------------------------------------------------
+
+namespace
+{
+
+//------------------------------------------------------------------------
+
+// What the first pass finds in a chunk.
+struct ChunkSummary
+{
+    glm::uvec3 numAttributes{};  // Positions, texture coordinates and normals.
+    std::string_view lastMaterial;
+    std::vector<std::string_view> libraries;
+};
+
+inline constexpr double s_powersOf10[] {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+//------------------------------------------------------------------------
+
+// One thread per chunk, the calling one included.
+template<typename F>
+void forEachChunk(size_t numChunks, F&& fn)
+{
+    if (numChunks == 0) return;
+
+    std::vector<std::jthread> workers;
+    workers.reserve(numChunks - 1);
+    for (size_t idx = 1; idx < numChunks; ++idx) {
+        workers.emplace_back(fn, idx);
+    }
+    fn(size_t{0});
+}
+
+//------------------------------------------------------------------------
+
+[[nodiscard]] bool isBlank(char c)
+{
+    return c == ' ' or c == '\t' or c == '\r';
+}
+
+[[nodiscard]] bool isDigit(char c)
+{
+    return c >= '0' and c <= '9';
+}
+
+[[nodiscard]] std::string_view trim(std::string_view str)
+{
+    while (not str.empty() and isBlank(str.front())) str.remove_prefix(1);
+    while (not str.empty() and isBlank(str.back())) str.remove_suffix(1);
+    return str;
+}
+
+// Consumes the token along with the blanks before it.
+[[nodiscard]] std::string_view nextToken(std::string_view& str)
+{
+    str = trim(str);
+    const size_t end = std::min(str.find_first_of(" \t"), str.size());
+    const std::string_view token = str.substr(0, end);
+    str.remove_prefix(end);
+    return token;
+}
+
+// With blanks trimmed, including the carriage returns of files written on Windows.
+template<typename F>
+void forEachLine(std::string_view text, F&& fn)
+{
+    while (not text.empty()) {
+        const size_t end = std::min(text.find('\n'), text.size());
+        fn(trim(text.substr(0, end)));
+        text.remove_prefix(std::min(end + 1, text.size()));
+    }
+}
+
+// The keyword and its arguments.
+[[nodiscard]] std::pair<std::string_view, std::string_view> splitLine(std::string_view line)
+{
+    const std::string_view keyword = nextToken(line);
+    return {keyword, trim(line)};
+}
+
+// At line boundaries, so that no line straddles two chunks.
+[[nodiscard]] std::vector<std::string_view> splitIntoChunks(std::string_view text, size_t numChunks)
+{
+    const size_t chunkSize = text.size() / numChunks;
+    std::vector<std::string_view> chunks;
+    while (not text.empty()) {
+        const size_t end = chunks.size() + 1 < numChunks ? text.find('\n', chunkSize) : std::string_view::npos;
+        const size_t size = end == std::string_view::npos ? text.size() : end + 1;
+        chunks.push_back(text.substr(0, size));
+        text.remove_prefix(size);
+    }
+    return chunks;
+}
+
+//------------------------------------------------------------------------
+// Floats are parsed as in fast_float [https://github.com/fastfloat/fast_float]: digits are gathered into an integer
+// mantissa, 8 at a time in a 64-bit word, which one multiplication or division by an exact power of 10 turns into the
+// value. Anything beyond that fast path, i.e. more than 19 digits or a power of 10 beyond 1e22, goes through
+// std::from_chars.
+
+[[nodiscard]] bool areEightDigits(uint64_t word)
+{
+    return (((word + 0x4646464646464646) | (word - 0x3030303030303030)) & 0x8080808080808080) == 0;
+}
+
+[[nodiscard]] uint32_t parseEightDigits(uint64_t word)
+{
+    static constexpr uint64_t mask = 0x000000ff000000ff;
+    static constexpr uint64_t mul1 = 0x000f424000000064;  // 100 + (1000000 << 32).
+    static constexpr uint64_t mul2 = 0x0000271000000001;  // 1 + (10000 << 32).
+    word -= 0x3030303030303030;
+    word = (word * 10) + (word >> 8);
+    word = (((word & mask) * mul1) + (((word >> 16) & mask) * mul2)) >> 32;
+    return implicit_cast<uint32_t>(word);
+}
+
+[[nodiscard]] float parseFloatSlow(std::string_view& str)
+{
+    if (str.starts_with('+')) str.remove_prefix(1);
+    float value = 0.0f;
+    const auto [end, error] = std::from_chars(str.data(), str.data() + str.size(), value);
+    if (error != std::errc{}) {
+        str.remove_prefix(std::min(str.find_first_of(" \t"), str.size()));
+        return 0.0f;
+    }
+    str.remove_prefix(end - str.data());
+    return value;
+}
+
+// Consumes the float along with the blanks before it. Malformed ones are skipped and read as 0.
+[[nodiscard]] float parseFloat(std::string_view& str)
+{
+    str = trim(str);
+    const char* ptr = str.data();
+    const char* end = ptr + str.size();
+
+    const bool negative = ptr != end and *ptr == '-';
+    if (ptr != end and (*ptr == '-' or *ptr == '+')) ++ptr;
+
+    uint64_t mantissa = 0;
+    int32_t exponent = 0;
+    const char* integerStart = ptr;
+    while (ptr != end and isDigit(*ptr)) {
+        mantissa = 10 * mantissa + implicit_cast<uint64_t>(*ptr++ - '0');
+    }
+    ptrdiff_t numDigits = ptr - integerStart;
+
+    if (ptr != end and *ptr == '.') {
+        const char* fractionStart = ++ptr;
+        if constexpr (std::endian::native == std::endian::little) {
+            while (end - ptr >= 8) {
+                uint64_t word = 0;
+                std::memcpy(&word, ptr, sizeof(word));
+                if (not areEightDigits(word)) break;
+                mantissa = 100'000'000 * mantissa + parseEightDigits(word);
+                ptr += 8;
+            }
+        }
+        while (ptr != end and isDigit(*ptr)) {
+            mantissa = 10 * mantissa + implicit_cast<uint64_t>(*ptr++ - '0');
+        }
+        exponent = -implicit_cast<int32_t>(ptr - fractionStart);
+        numDigits += ptr - fractionStart;
+    }
+
+    if (ptr != end and (*ptr == 'e' or *ptr == 'E')) {
+        int32_t explicitExponent = 0;
+        const char* exponentStart = ptr + 1 + (ptr + 1 != end and *(ptr + 1) == '+');
+        const auto [exponentEnd, error] = std::from_chars(exponentStart, end, explicitExponent);
+        if (error != std::errc{}) return parseFloatSlow(str);
+        exponent += explicitExponent;
+        ptr = exponentEnd;
+    }
+
+    // Only up to 2^53 do doubles hold every integer.
+    const bool fastPath = numDigits > 0 and numDigits <= 19 and mantissa <= (uint64_t{1} << 53)
+        and exponent >= -22 and exponent <= 22;
+    if (not fastPath) return parseFloatSlow(str);
+
+    double value = implicit_cast<double>(mantissa);
+    value = exponent < 0 ? value / s_powersOf10[-exponent] : value * s_powersOf10[exponent];
+    str.remove_prefix(ptr - str.data());
+    return implicit_cast<float>(negative ? -value : value);
+}
+
+[[nodiscard]] glm::vec3 parseVec3(std::string_view str)
+{
+    const float x = parseFloat(str);
+    const float y = parseFloat(str);
+    return {x, y, parseFloat(str)};
+}
+
+//------------------------------------------------------------------------
+
+// OBJ indices count from 1, negative ones back from the last attribute so far. Empty ones are absent attributes.
+[[nodiscard]] bool parseIndex(std::string_view str, uint32_t numSoFar, uint32_t total, uint32_t& index)
+{
+    if (str.empty()) return true;
+
+    int64_t value = 0;
+    const auto [end, error] = std::from_chars(str.data(), str.data() + str.size(), value);
+    if (error != std::errc{} or end != str.data() + str.size()) return false;
+
+    const int64_t resolved = value < 0 ? numSoFar + value : value - 1;
+    if (value == 0 or resolved < 0 or resolved >= total) return false;
+    index = implicit_cast<uint32_t>(resolved);
+    return true;
+}
+
+// For the materials that usemtl picks, unknown ones fall back to the default.
+[[nodiscard]] uint32_t findMaterial(const robin_hood::unordered_map<std::string_view, uint32_t>& indices,
+    std::string_view name, uint32_t defaultMaterial)
+{
+    const auto it = indices.find(name);
+    return it == indices.end() ? defaultMaterial : it->second;
+}
+
+// Exporters on Windows write backslashes.
+[[nodiscard]] fs::path relativePath(std::string_view str)
+{
+    std::string path{str};
+    stdr::replace(path, '\\', '/');
+    return path;
+}
+
+//------------------------------------------------------------------------
+
+[[nodiscard]] ChunkSummary summarizeChunk(std::string_view text)
+{
+    ChunkSummary summary;
+    forEachLine(text, [&](std::string_view line) {
+        const auto [keyword, args] = splitLine(line);
+        if (keyword == "v") {
+            ++summary.numAttributes.x;
+        } else if (keyword == "vt") {
+            ++summary.numAttributes.y;
+        } else if (keyword == "vn") {
+            ++summary.numAttributes.z;
+        } else if (keyword == "usemtl") {
+            summary.lastMaterial = args;
+        } else if (keyword == "mtllib") {
+            for (std::string_view rest = args; not rest.empty(); rest = trim(rest)) {
+                summary.libraries.push_back(nextToken(rest));
+            }
+        }
+    });
+    return summary;
+}
+
+//------------------------------------------------------------------------
+
+}  // namespace
+
+//------------------------------------------------------------------------
+
+ObjLoader::ObjLoader(const fs::path& path, uint32_t numThreads)
+    : m_numThreads{numThreads == 0 ? std::max(std::thread::hardware_concurrency(), 1u) : numThreads}
+{
+    const MappedFile file{path};
+    if (file.text().empty()) {
+        fmt::println("Error reading OBJ file {}", path.string());
+        return;
+    }
+
+    const size_t numChunks = std::clamp<size_t>(file.text().size() / OBJ_MIN_CHUNK_BYTES, 1, m_numThreads);
+    const std::vector<std::string_view> texts = splitIntoChunks(file.text(), numChunks);
+    std::vector<ChunkSummary> summaries(texts.size());
+    forEachChunk(texts.size(), [&](size_t idx) { summaries[idx] = summarizeChunk(texts[idx]); });
+
+    std::vector<glm::uvec3> bases(texts.size());
+    glm::uvec3 numAttributes{};
+    std::vector<fs::path> libraries;
+    for (size_t idx = 0; idx < texts.size(); ++idx) {
+        bases[idx] = numAttributes;
+        numAttributes += summaries[idx].numAttributes;
+        for (std::string_view library : summaries[idx].libraries) {
+            const fs::path libraryPath = path.parent_path() / relativePath(library);
+            if (stdr::find(libraries, libraryPath) == libraries.end()) libraries.push_back(libraryPath);
+        }
+    }
+    m_positions.resize(numAttributes.x);
+    m_uvs.resize(numAttributes.y);
+    m_normals.resize(numAttributes.z);
+
+    for (const fs::path& library : libraries) {
+        parseMaterialLibrary(library);
+    }
+    m_materials.push_back({});
+
+    // Names are only looked at once m_materials is complete, as the views refer to its strings.
+    const auto defaultMaterial = implicit_cast<uint32_t>(m_materials.size() - 1);
+    MaterialIndices materialIndices;
+    for (uint32_t material = 0; material < defaultMaterial; ++material) {
+        materialIndices.emplace(m_materials[material].name, material);
+    }
+
+    // Each chunk starts with the material that the chunks before it switched to last.
+    std::vector<uint32_t> startMaterials(texts.size());
+    uint32_t material = defaultMaterial;
+    for (size_t idx = 0; idx < texts.size(); ++idx) {
+        startMaterials[idx] = material;
+        if (not summaries[idx].lastMaterial.empty()) {
+            material = findMaterial(materialIndices, summaries[idx].lastMaterial, defaultMaterial);
+        }
+    }
+
+    m_chunks.resize(texts.size());
+    forEachChunk(texts.size(), [&](size_t idx) {
+        parseChunk(texts[idx], bases[idx], startMaterials[idx], materialIndices, m_chunks[idx]);
+    });
+
+    // One mesh per material, in which the triangles of each chunk follow those of the chunks before it.
+    uint32_t numDropped = 0;
+    for (uint32_t meshMaterial = 0; meshMaterial <= defaultMaterial; ++meshMaterial) {
+        const uint32_t firstVertex = m_numVertices;
+        for (Chunk& chunk : m_chunks) {
+            chunk.firstVertices[meshMaterial] = m_numVertices;
+            m_numVertices += 3 * chunk.numTriangles[meshMaterial];
+        }
+        if (m_numVertices > firstVertex) {
+            m_meshes.push_back({
+                .firstVertex = firstVertex,
+                .numVertices = m_numVertices - firstVertex,
+                .material = meshMaterial
+            });
+        }
+    }
+    for (const Chunk& chunk : m_chunks) {
+        numDropped += chunk.numDropped;
+    }
+    if (numDropped > 0) {
+        fmt::println("Dropped {} faces with invalid indices from {}", numDropped, path.string());
+    }
+
+    smoothNormals();
+    m_valid = true;
+}
+
+//------------------------------------------------------------------------
+
+void ObjLoader::write(std::span<Vertex> vertices, std::span<GLuint> indices)
+{
+    forEachChunk(m_chunks.size(), [&](size_t idx) { writeChunk(m_chunks[idx], vertices); });
+
+    for (const ObjMesh& mesh : m_meshes) {
+        const std::span<GLuint> meshIndices = indices.subspan(mesh.firstVertex, mesh.numVertices);
+        std::iota(meshIndices.begin(), meshIndices.end(), GLuint{0});
+    }
+}
+
+//------------------------------------------------------------------------
+
+void ObjLoader::parseChunk(std::string_view text, glm::uvec3 bases, uint32_t material,
+    const MaterialIndices& indices, Chunk& chunk)
+{
+    const auto defaultMaterial = implicit_cast<uint32_t>(m_materials.size() - 1);
+    const glm::uvec3 totals{m_positions.size(), m_uvs.size(), m_normals.size()};
+    glm::uvec3 numSoFar = bases;
+    std::vector<Corner> polygon;
+
+    chunk.numTriangles.assign(m_materials.size(), 0);
+    chunk.firstVertices.resize(m_materials.size());
+
+    forEachLine(text, [&](std::string_view line) {
+        auto [keyword, args] = splitLine(line);
+        if (keyword == "v") {
+            m_positions[numSoFar.x++] = parseVec3(args);
+        } else if (keyword == "vt") {
+            const float u = parseFloat(args);
+            m_uvs[numSoFar.y++] = {u, parseFloat(args)};
+        } else if (keyword == "vn") {
+            m_normals[numSoFar.z++] = parseVec3(args);
+        } else if (keyword == "f") {
+            polygon.clear();
+            bool valid = true;
+            while (not trim(args).empty()) {
+                std::string_view token = nextToken(args);
+                const size_t uvStart = std::min(token.find('/'), token.size());
+                const std::string_view pos = token.substr(0, uvStart);
+                token.remove_prefix(std::min(uvStart + 1, token.size()));
+                const size_t nrmStart = std::min(token.find('/'), token.size());
+                const std::string_view uv = token.substr(0, nrmStart);
+                const std::string_view nrm = token.substr(std::min(nrmStart + 1, token.size()));
+
+                Corner& corner = polygon.emplace_back();
+                valid = valid and not pos.empty()
+                    and parseIndex(pos, numSoFar.x, totals.x, corner.pos)
+                    and parseIndex(uv, numSoFar.y, totals.y, corner.uv)
+                    and parseIndex(nrm, numSoFar.z, totals.z, corner.nrm);
+            }
+            if (not valid or polygon.size() < 3) {
+                ++chunk.numDropped;
+                return;
+            }
+            for (size_t idx = 1; idx + 1 < polygon.size(); ++idx) {
+                chunk.corners.insert(chunk.corners.end(), {polygon[0], polygon[idx], polygon[idx + 1]});
+                chunk.materials.push_back(material);
+                ++chunk.numTriangles[material];
+            }
+        } else if (keyword == "usemtl") {
+            material = findMaterial(indices, args, defaultMaterial);
+        }
+    });
+}
+
+//------------------------------------------------------------------------
+
+void ObjLoader::parseMaterialLibrary(const fs::path& path)
+{
+    const MappedFile file{path};
+    if (file.text().empty()) {
+        fmt::println("Error reading MTL file {}", path.string());
+        return;
+    }
+
+    forEachLine(file.text(), [&](std::string_view line) {
+        const auto [keyword, args] = splitLine(line);
+        if (keyword == "newmtl") {
+            m_materials.push_back({.name = std::string{args}});
+        } else if (keyword == "map_Kd" and not m_materials.empty() and not args.empty()) {
+            // Options such as -bm 0.5 precede the path, which is then taken to be the last argument, so that paths
+            // with blanks only work without options.
+            const std::string_view texture =
+                args.starts_with('-') ? args.substr(args.find_last_of(" \t") + 1) : args;
+            m_materials.back().diffusePath = path.parent_path() / relativePath(texture);
+        }
+    });
+}
+
+//------------------------------------------------------------------------
+
+// As aiProcess_GenSmoothNormals does, from the area weighted normals of the faces around each position, but only for
+// the corners that have no normal of their own.
+void ObjLoader::smoothNormals()
+{
+    const bool anyMissing = stdr::any_of(m_chunks, [](const Chunk& chunk) {
+        return stdr::any_of(chunk.corners, [](const Corner& corner) { return corner.nrm == s_noIndex; });
+    });
+    if (not anyMissing) return;
+
+    m_smoothNormals.assign(m_positions.size(), glm::vec3{0.0f});
+    for (const Chunk& chunk : m_chunks) {
+        for (size_t idx = 0; idx < chunk.corners.size(); idx += 3) {
+            const std::span<const Corner> triangle{&chunk.corners[idx], 3};
+            if (stdr::none_of(triangle, [](const Corner& corner) { return corner.nrm == s_noIndex; })) continue;
+
+            const glm::vec3& pos0 = m_positions[triangle[0].pos];
+            const glm::vec3 faceNormal = glm::cross(
+                m_positions[triangle[1].pos] - pos0,
+                m_positions[triangle[2].pos] - pos0
+            );
+            for (const Corner& corner : triangle) {
+                m_smoothNormals[corner.pos] += faceNormal;
+            }
+        }
+    }
+    for (glm::vec3& normal : m_smoothNormals) {
+        const float length = glm::length(normal);
+        normal = length > 0.0f ? normal / length : glm::vec3{0.0f, 1.0f, 0.0f};
+    }
+}
+
+//------------------------------------------------------------------------
+
+void ObjLoader::writeChunk(const Chunk& chunk, std::span<Vertex> vertices)
+{
+    std::vector<uint32_t> nextVertices = chunk.firstVertices;
+    for (size_t triangle = 0; triangle < chunk.materials.size(); ++triangle) {
+        uint32_t& nextVertex = nextVertices[chunk.materials[triangle]];
+        for (const Corner& corner : std::span{chunk.corners}.subspan(3 * triangle, 3)) {
+            vertices[nextVertex++] = {
+                .pos = m_positions[corner.pos],
+                .nrm = corner.nrm == s_noIndex ? m_smoothNormals[corner.pos] : m_normals[corner.nrm],
+                .uv = corner.uv == s_noIndex ? glm::vec2{0.0f} : m_uvs[corner.uv]
+            };
+        }
+    }
+}
+
+//------------------------------------------------------------------------
+
+}  // namespace Zhade
+
+//------------------------------------------------------------------------
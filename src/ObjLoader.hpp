@@ -0,0 +1,102 @@
+#pragma once
+
+#include "common.hpp"
+
+#include <glm/glm.hpp>
+#include <robin_hood.h>
+
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//------------------------------------------------------------------------
+
+namespace Zhade
+{
+
+//------------------------------------------------------------------------
+
+struct ObjMaterial
+{
+    std::string name;
+    fs::path diffusePath;  // Empty without a map_Kd, otherwise relative to the working directory.
+};
+
+// The triangles of one material. They are written unindexed, so its indices count up from 0.
+struct ObjMesh
+{
+    uint32_t firstVertex;
+    uint32_t numVertices;
+    uint32_t material;
+};
+
+//------------------------------------------------------------------------
+// Wavefront OBJ and MTL loader, as Assimp's importer parses on a single thread and allocates per element. The file is
+// mapped and split into one chunk per thread at line boundaries. A first pass counts each chunk's vertex attributes,
+// so that the second can resolve relative indices and parse every attribute straight into its final place. Polygons
+// are fan triangulated, and normals are smoothed from the faces around a position where the file has none.
+// Lines continued with a backslash, free-form geometry and per-vertex colors are not supported.
+
+class ObjLoader
+{
+public:
+    // Parses on up to numThreads threads, all hardware threads if 0. Failures leave the loader invalid.
+    explicit ObjLoader(const fs::path& path, uint32_t numThreads = 0);
+
+    [[nodiscard]] bool valid() { return m_valid; }
+    [[nodiscard]] uint32_t numVertices() { return m_numVertices; }
+    [[nodiscard]] std::span<const ObjMesh> meshes() { return m_meshes; }
+    [[nodiscard]] std::span<const ObjMaterial> materials() { return m_materials; }
+
+    // Both spans hold numVertices() elements, e.g. ranges reserved in mapped buffers. Each mesh's vertices and indices
+    // start at its firstVertex.
+    void write(std::span<Vertex> vertices, std::span<GLuint> indices);
+
+private:
+    static constexpr uint32_t s_noIndex = ~0u;
+
+    using MaterialIndices = robin_hood::unordered_map<std::string_view, uint32_t>;
+
+    struct Corner
+    {
+        uint32_t pos;
+        uint32_t uv = s_noIndex;
+        uint32_t nrm = s_noIndex;
+    };
+
+    // Triangles in file order, with the material of each and where the chunk's first one of a material is written.
+    struct Chunk
+    {
+        std::vector<Corner> corners;
+        std::vector<uint32_t> materials;
+        std::vector<uint32_t> numTriangles;  // Per material, as are the first vertices.
+        std::vector<uint32_t> firstVertices;
+        uint32_t numDropped = 0;  // Faces with malformed or out of range indices.
+    };
+
+    // Bases are the number of positions, texture coordinates and normals before the chunk, material is the one in use
+    // at its start.
+    void parseChunk(std::string_view text, glm::uvec3 bases, uint32_t material, const MaterialIndices& indices,
+        Chunk& chunk);
+    void parseMaterialLibrary(const fs::path& path);
+    void smoothNormals();
+    void writeChunk(const Chunk& chunk, std::span<Vertex> vertices);
+
+    bool m_valid = false;
+    uint32_t m_numThreads;
+    uint32_t m_numVertices = 0;
+    std::vector<glm::vec3> m_positions;
+    std::vector<glm::vec2> m_uvs;
+    std::vector<glm::vec3> m_normals;
+    std::vector<glm::vec3> m_smoothNormals;  // Per position, only filled if any corner lacks a normal.
+    std::vector<Chunk> m_chunks;
+    std::vector<ObjMesh> m_meshes;
+    std::vector<ObjMaterial> m_materials;  // The last one is the default for faces without a known material.
+};
+
+//------------------------------------------------------------------------
+
+}  // namespace Zhade
+
+//------------------------------------------------------------------------
@@ -4,7 +4,14 @@
 #include "Stack.hpp"
 #include "common.hpp"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <concepts>
+#include <cstdlib>
 #include <memory>
+#include <mutex>
+#include <utility>
 #include <vector>
 
 //------------------------------------------------------------------------
@@ -14,6 +21,24 @@ namespace Zhade
 
 //------------------------------------------------------------------------
 // Inspired by: https://twitter.com/SebAaltonen/status/1535176343847043072.
+// Objects live in fixed-size chunks that are never relocated, so pointers from get() stay valid until the object is
+// deallocated. Like the vector the pool used to be, objects start out default-constructed and stay in place once
+// deallocated, so a default handle resolves to slot 0 until that is first allocated.
+//
+// The owner lists what it allocates in a dense array, and drops the entries of freed slots once they could make up half
+// of it or alive() is called, so that deallocating does not touch the array.
+//
+// Generations go up by four per allocation, and are 1 modulo 4 while alive, 2 while reserved and 0 while free. Handles
+// whose generation is below their slot's are stale, which also makes get() return nullptr for a reserved slot until
+// it is published.
+//
+// get() may be called from any thread, and so may allocate(), reserve(), publish() and deallocate(). The thread that
+// constructed the pool, e.g. the GL thread for ResourceManager, owns it: it keeps its own free lists and uses neither
+// locks nor atomic read-modify-writes, but for one per batch of freed slots it hands on. Other threads pop and push
+// single slots on a lock-free stack, and flag what they allocate, for which the owner rescans the chunks on its next
+// call to alive(). Only growing takes a mutex. Each handle must be deallocated once, and not while another thread still
+// uses its object. alive(), numAlive() and the destructor are for the owner only, and must not run while other threads
+// deallocate.
 
 //template<std::default_initializable T>
 template<typename T>
@@ -22,102 +47,394 @@ class ObjectPool
 {
 public:
     explicit ObjectPool(size_t size = OBJECT_POOL_INIT_SIZE)
-        : m_size{size},
-          m_freeList{size}
+        : m_chunks{std::make_unique<std::atomic<Chunk*>[]>(OBJECT_POOL_MAX_CHUNKS)},
+          m_owner{&s_threadTag},
+          m_ownerFree{size}
     {
-        m_pool.resize(m_size);
-        m_generations.resize(m_size);
-
-        for (size_t idx : stdv::iota(0u, m_size) | stdv::reverse) {
-            m_freeList.push(idx);
-        }
+        do {
+            pushChunkOwned(appendChunk());
+        } while (this->size() < size);
     }
 
     ~ObjectPool()
     {
-        if constexpr (requires { T::freeResources(); }) {
-            for (const T& item : m_pool) {
-                item.freeResources();
-            }
+        adoptForeign();
+        for (const Live& live : m_alive | stdv::reverse) {
+            if (isCurrent(live)) freeResources(object(live.index));
+        }
+        for (uint32_t chunkIdx : stdv::iota(0u, m_numChunks.load())) {
+            delete m_chunks[chunkIdx].load();
         }
     }
 
     ObjectPool(const ObjectPool&) = delete;
     ObjectPool& operator=(const ObjectPool&) = delete;
-    ObjectPool(ObjectPool&&) = default;
-    ObjectPool& operator=(ObjectPool&&) = default;
+    ObjectPool(ObjectPool&&) = delete;
+    ObjectPool& operator=(ObjectPool&&) = delete;
+
+    [[nodiscard]] size_t size() { return m_numChunks.load(std::memory_order_acquire) * OBJECT_POOL_CHUNK_SIZE; }
+
+    // Owner only.
+    [[nodiscard]] size_t numAlive()
+    {
+        adoptForeign();
+        if (m_hasStale or m_hasForeignStale.load(std::memory_order_relaxed)) compact();
+        return m_alive.size();
+    }
 
-    [[nodiscard]] size_t size() { return m_size; }
+    // Owner only. Live objects in no particular order.
+    [[nodiscard]] auto alive()
+    {
+        adoptForeign();
+        if (m_hasStale or m_hasForeignStale.load(std::memory_order_relaxed)) compact();
+        return m_alive | stdv::transform([this](const Live& live) -> T& { return object(live.index); });
+    }
 
     template<typename... Args>
     requires std::constructible_from<T, Args...>
     [[nodiscard]] Handle<T> allocate(Args&& ...args)
     {
-        const Handle<T> handle = handleToNextFree();
-        std::construct_at(&m_pool[handle.m_index], std::forward<Args>(args)...);
-        return handle;
+        return emplace(std::forward<Args>(args)...);
     }
 
     [[nodiscard]] Handle<T> allocate(const T& item)
-    requires std::copyable<T>
+    requires std::copy_constructible<T>
     {
-        const Handle<T> handle = handleToNextFree();
-        m_pool[handle.m_index] = item;
-        return handle;
+        return emplace(item);
     }
 
     [[nodiscard]] Handle<T> allocate(T&& item)
-    requires std::movable<T>
+    requires std::move_constructible<T>
+    {
+        return emplace(std::move(item));
+    }
+
+    // Takes a slot without constructing anything in it, get() returns nullptr for the handle until publish(). Every
+    // reserved handle must be published, also once deallocated, which cancels the reservation.
+    [[nodiscard]] Handle<T> reserve()
+    {
+        const uint32_t idx = isOwner() ? popOwned() : popShared();
+        std::atomic_uint32_t& slotGeneration = this->generation(idx);
+        const uint32_t generation = slotGeneration.load(std::memory_order_relaxed) + s_alive;
+        slotGeneration.store(generation + 1, std::memory_order_relaxed);
+        return Handle<T>(idx, generation);
+    }
+
+    // Returns false without constructing anything if the handle was deallocated since reserve(), and frees its slot.
+    template<typename... Args>
+    requires std::constructible_from<T, Args...>
+    bool publish(const Handle<T>& handle, Args&& ...args)
+    {
+        const uint32_t idx = handle.m_index;
+        std::atomic_uint32_t& generation = this->generation(idx);
+        uint32_t reserved = handle.m_generation + 1;
+        if (generation.load(std::memory_order_acquire) != reserved) {
+            isOwner() ? pushOwned(idx) : pushShared(idx);
+            return false;
+        }
+
+        T& item = object(idx);
+        std::destroy_at(&item);
+        std::construct_at(&item, std::forward<Args>(args)...);
+
+        if (generation.compare_exchange_strong(reserved, handle.m_generation, std::memory_order_acq_rel)) {
+            if (isOwner()) {
+                listOwned(idx, handle.m_generation);
+            } else {
+                m_hasForeign.exchange(true, std::memory_order_release);
+            }
+            return true;
+        }
+        freeResources(item);
+        isOwner() ? pushOwned(idx) : pushShared(idx);
+        return false;
+    }
+
+    [[nodiscard]] bool isReserved(const Handle<T>& handle)
     {
-        const Handle<T> handle = handleToNextFree();
-        m_pool[handle.m_index] = item;
-        return handle;
+        return generation(handle.m_index).load(std::memory_order_acquire) == handle.m_generation + 1;
     }
 
     void deallocate(const Handle<T>& handle)
     {
-        const T* ptr = get(handle);
-        if (ptr == nullptr) [[unlikely]] return;
-        if constexpr (requires { T::freeResources(); }) ptr->freeResources();
-        const uint32_t deallocIdx = handle.m_index;
-        m_freeList.push(deallocIdx);
-        ++m_generations[deallocIdx];
+        deallocate(handle, [](T& item) { freeResources(item); });
     }
 
-    [[nodiscard]] T* get(const Handle<T>& handle)
+    // Hands the object to release instead of freeing its resources, e.g. to free them later.
+    template<std::invocable<T&> F>
+    void deallocate(const Handle<T>& handle, F&& release)
     {
         const uint32_t idx = handle.m_index;
-        if (handle.m_generation < m_generations[idx]) [[unlikely]] return nullptr;
-        return &m_pool[handle.m_index];
+        std::atomic_uint32_t& slotGeneration = this->generation(idx);
+        uint32_t generation = slotGeneration.load(std::memory_order_acquire);
+        const uint32_t freed = handle.m_generation - s_alive + s_generationStep;
+
+        // Cancels a reservation, whose slot publish() frees. Once that has published the object, it is freed below.
+        if (generation == handle.m_generation + 1) [[unlikely]] {
+            if (slotGeneration.compare_exchange_strong(generation, freed, std::memory_order_acq_rel)) return;
+        }
+        // Also rejects free slots, e.g. slot 0 for a default handle.
+        if (generation != handle.m_generation or generation % s_generationStep != s_alive) [[unlikely]] return;
+
+        std::forward<F>(release)(object(idx));
+        slotGeneration.store(freed, std::memory_order_release);
+        if (isOwner()) [[likely]] {
+            m_hasStale = true;
+            pushOwned(idx);
+        } else {
+            pushShared(idx);
+            m_hasForeignStale.exchange(true, std::memory_order_release);
+        }
+    }
+
+    [[nodiscard]] T* get(const Handle<T>& handle)
+    {
+        Chunk* chunk = this->chunk(handle.m_index);
+        const uint32_t offset = handle.m_index % OBJECT_POOL_CHUNK_SIZE;
+        if (handle.m_generation < chunk->generations[offset].load(std::memory_order_acquire)) [[unlikely]] {
+            return nullptr;
+        }
+        return &chunk->objects[offset];
     }
 
 private:
-    [[nodiscard]] Handle<T> handleToNextFree()
+    // Generations and links are packed apart from the objects, so that freeing a slot touches no object memory.
+    struct Chunk
+    {
+        std::array<std::atomic_uint32_t, OBJECT_POOL_CHUNK_SIZE> generations{};
+        std::array<std::atomic_uint32_t, OBJECT_POOL_CHUNK_SIZE> links{};
+        std::array<T, OBJECT_POOL_CHUNK_SIZE> objects{};
+    };
+
+    // An entry of the dense array of live objects, current while its generation is the slot's.
+    struct Live
+    {
+        uint32_t index;
+        uint32_t generation;
+    };
+
+    static constexpr uint32_t s_generationStep = 4;
+    static constexpr uint32_t s_alive = 1;
+
+    static constexpr uint32_t s_endOfList = UINT32_MAX;
+
+    // The owner hands freed slots on to other threads in batches of this size, once they have run out.
+    static constexpr size_t s_freeBatchSize = OBJECT_POOL_CHUNK_SIZE;
+
+    // The head of a lock-free stack packs a slot index with a tag that every change bumps, so that a pop that read a
+    // stale link fails its compare-exchange.
+    [[nodiscard]] static uint64_t tagged(uint64_t head, uint32_t idx) { return ((head >> 32) + 1) << 32 | idx; }
+    [[nodiscard]] static uint32_t index(uint64_t head) { return implicit_cast<uint32_t>(head); }
+
+    // Its address tells threads apart, more cheaply than std::this_thread::get_id().
+    static inline thread_local constinit char s_threadTag = 0;
+
+    [[nodiscard]] bool isOwner() { return &s_threadTag == m_owner; }
+
+    // Handles only come from this pool, and whoever passed one on also passed on the growth that made its chunk.
+    [[nodiscard]] Chunk* chunk(uint32_t idx)
+    {
+        return m_chunks[idx / OBJECT_POOL_CHUNK_SIZE].load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] std::atomic_uint32_t& generation(uint32_t idx)
+    {
+        return chunk(idx)->generations[idx % OBJECT_POOL_CHUNK_SIZE];
+    }
+
+    [[nodiscard]] T& object(uint32_t idx) { return chunk(idx)->objects[idx % OBJECT_POOL_CHUNK_SIZE]; }
+
+    [[nodiscard]] uint32_t link(uint32_t idx)
+    {
+        return chunk(idx)->links[idx % OBJECT_POOL_CHUNK_SIZE].load(std::memory_order_relaxed);
+    }
+
+    void setLink(uint32_t idx, uint32_t link)
+    {
+        chunk(idx)->links[idx % OBJECT_POOL_CHUNK_SIZE].store(link, std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] bool isCurrent(const Live& live)
+    {
+        return generation(live.index).load(std::memory_order_acquire) == live.generation;
+    }
+
+    static void freeResources(T& item)
+    {
+        if constexpr (requires (T& t) { t.freeResources(); }) item.freeResources();
+    }
+
+    template<typename... Args>
+    [[nodiscard]] Handle<T> emplace(Args&& ...args)
+    {
+        if (not isOwner()) [[unlikely]] {
+            const Handle<T> handle = reserve();
+            publish(handle, std::forward<Args>(args)...);
+            return handle;
+        }
+        const uint32_t idx = popOwned();
+        Chunk* chunk = this->chunk(idx);
+        const uint32_t offset = idx % OBJECT_POOL_CHUNK_SIZE;
+        std::destroy_at(&chunk->objects[offset]);
+        std::construct_at(&chunk->objects[offset], std::forward<Args>(args)...);
+        const uint32_t generation = chunk->generations[offset].load(std::memory_order_relaxed) + s_alive;
+        chunk->generations[offset].store(generation, std::memory_order_release);
+        listOwned(idx, generation);
+        return Handle<T>(idx, generation);
+    }
+
+    [[nodiscard]] uint32_t popOwned()
     {
-        if (m_freeList.size() == 0) [[unlikely]] resize();
-        const uint32_t nextFreeIdx = m_freeList.top();
-        m_freeList.pop();
-        return Handle<T>(nextFreeIdx, ++m_generations[nextFreeIdx]);
+        if (m_ownerFree.size() == 0) [[unlikely]] refillOwned();
+        const uint32_t idx = m_ownerFree.top();
+        m_ownerFree.pop();
+        return idx;
+    }
+
+    // Takes everything other threads freed, else grows.
+    void refillOwned()
+    {
+        uint64_t head = m_sharedFree.load(std::memory_order_acquire);
+        while (index(head) != s_endOfList) {
+            if (m_sharedFree.compare_exchange_weak(head, tagged(head, s_endOfList), std::memory_order_acquire)) {
+                for (uint32_t idx = index(head); idx != s_endOfList; idx = link(idx)) m_ownerFree.push(idx);
+                return;
+            }
+        }
+        const std::scoped_lock lock{m_growMutex};
+        pushChunkOwned(appendChunk());
     }
 
-    void resize()
+    void pushOwned(uint32_t idx)
     {
-        const size_t size_prev = m_size;
-        m_size = std::max(implicit_cast<size_t>(1), m_size) * DYNAMIC_STORAGE_GROWTH_FACTOR;
+        m_ownerFree.push(idx);
+        if (m_sharedWanted.load(std::memory_order_relaxed)) [[unlikely]] spillOwned();
+    }
 
-        m_pool.resize(m_size);
-        m_generations.resize(m_size);
-        m_freeList.resize(m_size);
+    // Links up to a batch of the owner's free slots and shares them.
+    void spillOwned()
+    {
+        m_sharedWanted.store(false, std::memory_order_relaxed);
+        const uint32_t first = m_ownerFree.top();
+        uint32_t last = first;
+        m_ownerFree.pop();
+        for (size_t count = 1; count < s_freeBatchSize and m_ownerFree.size() > 0; ++count) {
+            setLink(last, m_ownerFree.top());
+            last = m_ownerFree.top();
+            m_ownerFree.pop();
+        }
+        pushShared(first, last);
+    }
 
-        for (size_t idx : stdv::iota(size_prev, m_size) | stdv::reverse) {
-            m_freeList.push(idx);
+    // In order, so that the first slot is allocated first.
+    void pushChunkOwned(uint32_t first)
+    {
+        for (uint32_t offset : stdv::iota(0u, implicit_cast<uint32_t>(OBJECT_POOL_CHUNK_SIZE)) | stdv::reverse) {
+            m_ownerFree.push(first + offset);
         }
     }
 
-    size_t m_size;
-    std::vector<T> m_pool;
-    std::vector<uint32_t> m_generations;
-    Stack<uint32_t> m_freeList;
+    [[nodiscard]] uint32_t popShared()
+    {
+        uint64_t head = m_sharedFree.load(std::memory_order_acquire);
+        while (true) {
+            const uint32_t idx = index(head);
+            if (idx == s_endOfList) [[unlikely]] {
+                m_sharedWanted.store(true, std::memory_order_relaxed);
+                if (const uint32_t grown = growShared(); grown != s_endOfList) return grown;
+                head = m_sharedFree.load(std::memory_order_acquire);
+                continue;
+            }
+            // The slot may have been popped and reused meanwhile, in which case its link is garbage and the tag moved.
+            if (m_sharedFree.compare_exchange_weak(head, tagged(head, link(idx)),
+                std::memory_order_acquire)) return idx;
+        }
+    }
+
+    // Pushes the slots linked from first to last.
+    void pushShared(uint32_t first, uint32_t last)
+    {
+        uint64_t head = m_sharedFree.load(std::memory_order_relaxed);
+        do {
+            setLink(last, index(head));
+        } while (not m_sharedFree.compare_exchange_weak(head, tagged(head, first), std::memory_order_release,
+            std::memory_order_relaxed));
+    }
+
+    void pushShared(uint32_t idx) { pushShared(idx, idx); }
+
+    // Returns a slot of a new chunk and shares the others, or nothing if another thread has shared some meanwhile.
+    [[nodiscard]] uint32_t growShared()
+    {
+        const std::scoped_lock lock{m_growMutex};
+        if (index(m_sharedFree.load(std::memory_order_acquire)) != s_endOfList) return s_endOfList;
+        const uint32_t first = appendChunk();
+        const auto last = implicit_cast<uint32_t>(first + OBJECT_POOL_CHUNK_SIZE - 1);
+        for (uint32_t idx : stdv::iota(first + 1, last)) setLink(idx, idx + 1);
+        pushShared(first + 1, last);
+        return first;
+    }
+
+    // Callers hold m_growMutex, or are the constructor. Returns the first index of the new chunk.
+    [[nodiscard]] uint32_t appendChunk()
+    {
+        const uint32_t chunkIdx = m_numChunks.load(std::memory_order_relaxed);
+        if (chunkIdx == OBJECT_POOL_MAX_CHUNKS) [[unlikely]] {
+            fmt::println("ObjectPool is full at {} objects", OBJECT_POOL_MAX_CHUNKS * OBJECT_POOL_CHUNK_SIZE);
+            std::abort();
+        }
+
+        m_chunks[chunkIdx].store(new Chunk, std::memory_order_release);
+        m_numChunks.store(chunkIdx + 1, std::memory_order_release);
+        return implicit_cast<uint32_t>(chunkIdx * OBJECT_POOL_CHUNK_SIZE);
+    }
+
+    // Compacts the dense array once it has doubled, so that deallocating leaves it alone.
+    void listOwned(uint32_t idx, uint32_t generation)
+    {
+        m_alive.push_back({.index = idx, .generation = generation});
+        if (m_alive.size() == m_compactAt) [[unlikely]] compact();
+    }
+
+    void compact()
+    {
+        m_hasStale = false;
+        m_hasForeignStale.exchange(false, std::memory_order_acquire);
+        std::erase_if(m_alive, [this](const Live& live) { return not isCurrent(live); });
+        m_compactAt = std::max(2 * m_alive.size(), s_freeBatchSize);
+    }
+
+    // Owner only. Relists all live objects once other threads have allocated any, which ResourceManager avoids by
+    // publishing on the GL thread.
+    void adoptForeign()
+    {
+        if (not m_hasForeign.load(std::memory_order_relaxed)) [[likely]] return;
+        m_hasForeign.exchange(false, std::memory_order_acquire);
+        m_alive.clear();
+        for (uint32_t idx : stdv::iota(0u, implicit_cast<uint32_t>(size()))) {
+            const uint32_t generation = this->generation(idx).load(std::memory_order_acquire);
+            if (generation % s_generationStep == s_alive) m_alive.push_back({.index = idx, .generation = generation});
+        }
+        m_compactAt = std::max(2 * m_alive.size(), s_freeBatchSize);
+    }
+
+    std::unique_ptr<std::atomic<Chunk*>[]> m_chunks;
+    std::atomic_uint32_t m_numChunks = 0;
+    const char* const m_owner;
+
+    // Only the owner touches these.
+    alignas(CACHE_LINE_BYTES) Stack<uint32_t> m_ownerFree;
+    std::vector<Live> m_alive;
+    size_t m_compactAt = s_freeBatchSize;
+    bool m_hasStale = false;
+
+    // Shared with other threads, away from what the owner writes. The owner reads m_sharedWanted on every
+    // deallocation, which other threads only write once they run out.
+    alignas(CACHE_LINE_BYTES) std::atomic_uint64_t m_sharedFree = s_endOfList;
+    std::atomic_bool m_hasForeign = false;
+    std::atomic_bool m_hasForeignStale = false;
+    std::mutex m_growMutex;
+    alignas(CACHE_LINE_BYTES) std::atomic_bool m_sharedWanted = false;
 };
 
 //------------------------------------------------------------------------
@@ -1,8 +1,14 @@
 #include "Pipeline.hpp"
 
+#include "Texture.hpp"
+
+#include <algorithm>
+#include <bit>
 #include <fstream>
+#include <iterator>
 #include <sstream>
 #include <string_view>
+#include <vector>
 
 //------------------------------------------------------------------------
 
@@ -15,13 +21,18 @@ Pipeline::Pipeline(PipelineDescriptor desc)
     : m_headers{desc.headers.cbegin(), desc.headers.cend()},
       m_managed{desc.managed}
 {
+    for (size_t idx = 0; idx < desc.features.size(); ++idx) {
+        if (desc.enabledFeatures & (1u << idx)) m_defines += fmt::format("#define {}\n", desc.features[idx]);
+    }
+    // Every shader declares its mesh and shadow textures either way, see shading.glsl and common_defs.h.
+    if (not Texture::s_useBindless) m_defines += "#define USE_TEXTURE_ARRAYS\n";
+
     glCreateProgramPipelines(1, &m_name);
     setupHeaders();
-    setupStageProgram(PipelineStage::VERTEX, desc.vertPath);
-    setupStageProgram(PipelineStage::FRAGMENT, desc.fragPath);
-    setupStageProgram(PipelineStage::GEOMETRY, desc.geomPath);
-    setupStageProgram(PipelineStage::COMPUTE, desc.compPath);
-    validate();
+    submitStageProgram(PipelineStage::VERTEX, desc.vertPath, desc.specializationConstants);
+    submitStageProgram(PipelineStage::FRAGMENT, desc.fragPath, desc.specializationConstants);
+    submitStageProgram(PipelineStage::GEOMETRY, desc.geomPath, desc.specializationConstants);
+    submitStageProgram(PipelineStage::COMPUTE, desc.compPath, desc.specializationConstants);
 }
 
 //------------------------------------------------------------------------
@@ -36,21 +47,54 @@ Pipeline::~Pipeline()
 void Pipeline::freeResources()
 {
     glDeleteProgramPipelines(1, &m_name);
+    for (const PendingStage& pending : m_pendingStages) {
+        glDeleteShader(pending.shader);
+    }
     for (GLuint program : m_stages) {
         if (glIsProgram(program)) {
             glDeleteProgram(program);
         }
     }
-    for (std::string_view header : m_headers) {
-        glDeleteNamedStringARB(header.size(), header.data());
+}
+
+//------------------------------------------------------------------------
+
+bool Pipeline::isReady()
+{
+    if (m_resolved or m_pendingStages.empty()) return true;
+    // Nothing to poll, and the driver most likely compiled the stages as they were submitted.
+    if (not GLEW_KHR_parallel_shader_compile) return true;
+
+    return stdr::all_of(m_pendingStages, [this](const PendingStage& pending) {
+        GLint completed = GL_FALSE;
+        glGetProgramiv(m_stages[pending.stage], GL_COMPLETION_STATUS_KHR, &completed);
+        return completed == GL_TRUE;
+    });
+}
+
+//------------------------------------------------------------------------
+
+void Pipeline::resolve()
+{
+    if (m_resolved) [[likely]] return;
+    m_resolved = true;
+
+    for (const PendingStage& pending : m_pendingStages) {
+        m_stages[pending.stage] = resolveStageProgram(pending);
+    }
+    m_pendingStages.clear();
+
+    for (PipelineStage::Type stage = 0; stage < PipelineStage::NUM_SUPPORTED_STAGES; ++stage) {
+        if (m_stages[stage] != 0) glUseProgramStages(m_name, PipelineStage2GLShaderBit[stage], m_stages[stage]);
     }
+    validate();
 }
 
 //------------------------------------------------------------------------
 
 std::string Pipeline::readFileContents(const fs::path& path)
 {
-    std::ifstream file{path};
+    std::ifstream file{path, std::ios::binary};
     if (file.bad()) {
         fmt::println("Error reading shader from {}", path.string());
         return "";
@@ -62,61 +106,216 @@ std::string Pipeline::readFileContents(const fs::path& path)
 
 //------------------------------------------------------------------------
 
-GLuint Pipeline::createShaderProgramInclude(PipelineStage::Type stage, const fs::path& shaderPath)
+// Right after the #version line, which has to come first.
+std::string Pipeline::injectDefines(std::string source)
 {
-    const GLuint shader = glCreateShader(PipelineStage2GLShader[stage]);
-    const std::string shaderSource = readFileContents(shaderPath);
-    const char* shaderSourceRaw = shaderSource.c_str();
-    glShaderSource(shader, 1, &shaderSourceRaw, nullptr);
-    static const GLchar* virtualIncludePaths[] = { "/" };
-    glCompileShaderIncludeARB(shader, sizeof(virtualIncludePaths) / sizeof(GLchar*), virtualIncludePaths, nullptr);
-    
-    GLint compileStatus = GL_FALSE;
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &compileStatus);
-    if (compileStatus == GL_FALSE) {
-        GLchar infoLog[LOCAL_CHAR_BUF_SIZE];
-        glGetShaderInfoLog(shader, sizeof(infoLog), nullptr, infoLog);
-        fmt::println("Error compiling shader {}: {}", shaderPath.string(), infoLog);
-        return 0;
+    if (m_defines.empty()) return source;
+    const size_t versionEnd = source.find('\n');
+    source.insert(versionEnd == std::string::npos ? source.size() : versionEnd + 1, m_defines);
+    return source;
+}
+
+//------------------------------------------------------------------------
+
+uint64_t Pipeline::programCacheKey(PipelineStage::Type stage, std::string_view source,
+    absl::Span<const SpecializationConstant> constants)
+{
+    static const uint64_t driverHash = [] {
+        uint64_t hash = util::hashFNV1a("");
+        for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+            hash = util::hashFNV1a(std::bit_cast<const char*>(glGetString(name)), hash);
+        }
+        return hash;
+    }();
+
+    // Hashing every header the source may include is as good as hashing the preprocessed source, which GL does not
+    // expose. The stage and the constants are hashed as raw bytes.
+    uint64_t hash = util::hashFNV1a(std::string_view{std::bit_cast<const char*>(&stage), 1}, driverHash);
+    hash = util::hashFNV1a(source, hash);
+    hash = util::hashFNV1a(
+        {std::bit_cast<const char*>(constants.data()), sizeof(SpecializationConstant) * constants.size()}, hash
+    );
+    for (const std::string& header : m_headers) {
+        hash = util::hashFNV1a(header, hash);
+        hash = util::hashFNV1a(s_headerContents[header], hash);
     }
+    return hash;
+}
+
+//------------------------------------------------------------------------
+
+GLuint Pipeline::loadCachedProgram(uint64_t key)
+{
+    if (not s_useProgramCache) return 0;
+
+    std::ifstream file{PROGRAM_CACHE_PATH / fmt::format("{:016x}.bin", key), std::ios::binary};
+    if (not file) return 0;
+
+    GLenum format = 0;
+    file.read(std::bit_cast<char*>(&format), sizeof(format));
+    const std::string binary{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+    if (binary.empty()) return 0;
 
     const GLuint program = glCreateProgram();
     glProgramParameteri(program, GL_PROGRAM_SEPARABLE, GL_TRUE);
-    glAttachShader(program, shader);
-    glLinkProgram(program);
-    glDetachShader(program, shader);
-    glDeleteShader(shader);
-    
+    glProgramBinary(program, format, binary.data(), implicit_cast<GLsizei>(binary.size()));
+
     GLint linkStatus = GL_FALSE;
     glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
     if (linkStatus == GL_FALSE) {
-        GLchar infoLog[LOCAL_CHAR_BUF_SIZE];
-        glGetProgramInfoLog(program, sizeof(infoLog), nullptr, infoLog);
-        fmt::println("Error linking shader {}: {}", shaderPath.string(), infoLog);
+        glDeleteProgram(program);
         return 0;
     }
-
     return program;
 }
 
 //------------------------------------------------------------------------
 
+void Pipeline::storeCachedProgram(uint64_t key, GLuint program)
+{
+    if (not s_useProgramCache) return;
+
+    // Zero if the driver supports no binary formats at all.
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length == 0) return;
+
+    std::string binary(implicit_cast<size_t>(length), '\0');
+    GLenum format = 0;
+    glGetProgramBinary(program, length, nullptr, &format, binary.data());
+
+    std::error_code error;
+    fs::create_directories(PROGRAM_CACHE_PATH, error);
+    const fs::path path = PROGRAM_CACHE_PATH / fmt::format("{:016x}.bin", key);
+    std::ofstream file{path, std::ios::binary};
+    file.write(std::bit_cast<const char*>(&format), sizeof(format));
+    file.write(binary.data(), implicit_cast<std::streamsize>(binary.size()));
+    if (not file) {
+        fmt::println("Error writing program binary to {}", path.string());
+    }
+}
+
+//------------------------------------------------------------------------
+
 void Pipeline::setupHeaders()
 {
-    for (std::string_view header : m_headers) {
+    for (const std::string& header : m_headers) {
+        if (s_headerContents.contains(header)) continue;
         const fs::path path = SOURCE_PATH / fs::path{header}.filename();
-        const std::string contents = readFileContents(path);
+        const std::string& contents = s_headerContents[header] = readFileContents(path);
         glNamedStringARB(GL_SHADER_INCLUDE_ARB, header.size(), header.data(), contents.size(), contents.data());
     }
 }
 
 //------------------------------------------------------------------------
 
-void Pipeline::setupStageProgram(PipelineStage::Type stage, const fs::path& shaderPath)
+void Pipeline::submitStageProgram(PipelineStage::Type stage, const fs::path& shaderPath,
+    absl::Span<const SpecializationConstant> constants)
 {
     if (shaderPath.empty()) return;
-    m_stages[stage] = createShaderProgramInclude(stage, shaderPath);
-    glUseProgramStages(m_name, PipelineStage2GLShaderBit[stage], m_stages[stage]);
+
+    const std::string shaderSource = injectDefines(readFileContents(shaderPath));
+    const uint64_t cacheKey = programCacheKey(stage, shaderSource, constants);
+    if (const GLuint program = loadCachedProgram(cacheKey); program != 0) {
+        ++s_numProgramCacheHits;
+        m_stages[stage] = program;
+        return;
+    }
+    ++s_numProgramCacheMisses;
+
+    GLuint shader = createSpirvShader(stage, shaderPath, constants);
+    if (shader == 0) shader = createGlslShader(stage, shaderSource);
+
+    // Linking right away is fine, a failed compile just fails the link too.
+    const GLuint program = glCreateProgram();
+    glProgramParameteri(program, GL_PROGRAM_SEPARABLE, GL_TRUE);
+    glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glAttachShader(program, shader);
+    glLinkProgram(program);
+
+    m_stages[stage] = program;
+    m_pendingStages.push_back({.stage = stage, .shader = shader, .cacheKey = cacheKey, .path = shaderPath});
+}
+
+//------------------------------------------------------------------------
+
+GLuint Pipeline::createSpirvShader(PipelineStage::Type stage, const fs::path& shaderPath,
+    absl::Span<const SpecializationConstant> constants)
+{
+    if (not s_useSpirv or not m_defines.empty() or not GLEW_ARB_gl_spirv) return 0;
+
+    const fs::path modulePath = SPIRV_PATH / (shaderPath.filename().string() + ".spv");
+    if (not fs::exists(modulePath)) return 0;
+    const std::string module = readFileContents(modulePath);
+
+    std::vector<GLuint> constantIds;
+    std::vector<GLuint> constantValues;
+    for (const auto& [id, value] : constants) {
+        constantIds.push_back(id);
+        constantValues.push_back(value);
+    }
+
+    const GLuint shader = glCreateShader(PipelineStage2GLShader[stage]);
+    const auto moduleSize = implicit_cast<GLsizei>(module.size());
+    glShaderBinary(1, &shader, GL_SHADER_BINARY_FORMAT_SPIR_V_ARB, module.data(), moduleSize);
+    glSpecializeShaderARB(shader, "main", implicit_cast<GLuint>(constants.size()), constantIds.data(),
+        constantValues.data());
+
+    // Unlike compiling GLSL, specializing is done by the time it returns, so checking right away does not stall.
+    GLint status = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if (status == GL_FALSE) {
+        GLchar infoLog[LOCAL_CHAR_BUF_SIZE];
+        glGetShaderInfoLog(shader, sizeof(infoLog), nullptr, infoLog);
+        fmt::println("Error specializing {}, falling back to GLSL: {}", modulePath.string(), infoLog);
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+//------------------------------------------------------------------------
+
+GLuint Pipeline::createGlslShader(PipelineStage::Type stage, const std::string& source)
+{
+    const GLuint shader = glCreateShader(PipelineStage2GLShader[stage]);
+    const char* sourceRaw = source.c_str();
+    glShaderSource(shader, 1, &sourceRaw, nullptr);
+    static const GLchar* virtualIncludePaths[] = { "/" };
+    glCompileShaderIncludeARB(shader, sizeof(virtualIncludePaths) / sizeof(GLchar*), virtualIncludePaths, nullptr);
+    return shader;
+}
+
+//------------------------------------------------------------------------
+
+GLuint Pipeline::resolveStageProgram(const PendingStage& pending)
+{
+    const GLuint program = m_stages[pending.stage];
+
+    GLint compileStatus = GL_FALSE;
+    glGetShaderiv(pending.shader, GL_COMPILE_STATUS, &compileStatus);
+    if (compileStatus == GL_FALSE) {
+        GLchar infoLog[LOCAL_CHAR_BUF_SIZE];
+        glGetShaderInfoLog(pending.shader, sizeof(infoLog), nullptr, infoLog);
+        fmt::println("Error compiling shader {}: {}", pending.path.string(), infoLog);
+    }
+    glDetachShader(program, pending.shader);
+    glDeleteShader(pending.shader);
+
+    GLint linkStatus = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
+    if (linkStatus == GL_FALSE) {
+        if (compileStatus == GL_TRUE) {
+            GLchar infoLog[LOCAL_CHAR_BUF_SIZE];
+            glGetProgramInfoLog(program, sizeof(infoLog), nullptr, infoLog);
+            fmt::println("Error linking shader {}: {}", pending.path.string(), infoLog);
+        }
+        glDeleteProgram(program);
+        return 0;
+    }
+
+    storeCachedProgram(pending.cacheKey, program);
+    return program;
 }
 
 //------------------------------------------------------------------------
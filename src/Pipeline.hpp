@@ -3,6 +3,7 @@
 #include "common.hpp"
 
 #include <absl/types/span.h>
+#include <robin_hood.h>
 
 #include <array>
 #include <string>
@@ -42,6 +43,16 @@ inline constexpr GLenum PipelineStage2GLShaderBit[] {
     GL_COMPUTE_SHADER_BIT
 };
 
+// Bit i enables PipelineDescriptor::features[i].
+using FeatureMask = uint32_t;
+
+// Overrides the default of a specialization constant in the offline SPIR-V modules. GLSL always uses the defaults.
+struct SpecializationConstant
+{
+    GLuint id;
+    GLuint value;
+};
+
 struct PipelineDescriptor
 {
     fs::path vertPath;
@@ -49,6 +60,10 @@ struct PipelineDescriptor
     fs::path geomPath{};
     fs::path compPath{};
     absl::Span<const std::string_view> headers{"/common_defs.h"};
+    absl::Span<const SpecializationConstant> specializationConstants{};
+    // Keys of optional features, each of which is #defined in the stages' source if enabled, see PipelineVariants.
+    absl::Span<const std::string_view> features{};
+    FeatureMask enabledFeatures = 0;
     bool managed = true;
 };
 
@@ -66,21 +81,72 @@ public:
     Pipeline(Pipeline&&) = delete;
     Pipeline& operator=(Pipeline&&) = delete;
 
-    void bind() { glBindProgramPipeline(m_name); }
+    [[nodiscard]] GLuint program(PipelineStage::Type stage)
+    {
+        resolve();
+        return m_stages[stage];
+    }
+
+    void bind()
+    {
+        resolve();
+        glBindProgramPipeline(m_name);
+    }
+
     void freeResources();
 
+    // The constructor only submits the stages for compilation. Without GL_KHR_parallel_shader_compile the driver may
+    // still compile them right away, but the status queries that would wait for it are deferred to resolve(), which
+    // bind() and program() call if need be. isReady() tells without blocking whether resolve() would wait.
+    [[nodiscard]] bool isReady();
+    void resolve();
+
+    // Linked stage programs are cached on disk in PROGRAM_CACHE_PATH, keyed by their source, the headers it may
+    // include, the stage and the driver. Binaries the driver rejects, e.g. after an update, are compiled again.
+    static inline bool s_useProgramCache = true;
+    static inline size_t s_numProgramCacheHits = 0;
+    static inline size_t s_numProgramCacheMisses = 0;
+
+    // Stages load the module SPIRV_PATH / <shader file name>.spv instead of compiling GLSL if ARB_gl_spirv is
+    // supported and the module exists, i.e. was built by the ZHADE_BUILD_SPIRV target. The modules are built without
+    // features, so pipelines enabling any, or USE_TEXTURE_ARRAYS, always compile GLSL.
+    static inline bool s_useSpirv = true;
+
 private:
+    struct PendingStage
+    {
+        PipelineStage::Type stage;
+        GLuint shader;
+        uint64_t cacheKey;
+        fs::path path;
+    };
+
     [[nodiscard]] std::string readFileContents(const fs::path& path);
-    [[nodiscard]] GLuint createShaderProgramInclude(PipelineStage::Type stage, const fs::path& shaderPath);
+    [[nodiscard]] std::string injectDefines(std::string source);
+    [[nodiscard]] uint64_t programCacheKey(PipelineStage::Type stage, std::string_view source,
+        absl::Span<const SpecializationConstant> constants);
+    [[nodiscard]] GLuint createSpirvShader(PipelineStage::Type stage, const fs::path& shaderPath,
+        absl::Span<const SpecializationConstant> constants);
+    [[nodiscard]] GLuint createGlslShader(PipelineStage::Type stage, const std::string& source);
+    [[nodiscard]] GLuint loadCachedProgram(uint64_t key);
+    void storeCachedProgram(uint64_t key, GLuint program);
 
     void setupHeaders();
-    void setupStageProgram(PipelineStage::Type stage, const fs::path& shaderPath);
+    void submitStageProgram(PipelineStage::Type stage, const fs::path& shaderPath,
+        absl::Span<const SpecializationConstant> constants);
+    [[nodiscard]] GLuint resolveStageProgram(const PendingStage& pending);
     void validate();
 
     GLuint m_name = 0;
-    std::array<GLuint, PipelineStage::NUM_SUPPORTED_STAGES> m_stages;
+    std::array<GLuint, PipelineStage::NUM_SUPPORTED_STAGES> m_stages{};
     std::vector<std::string> m_headers;
+    std::string m_defines;
+    std::vector<PendingStage> m_pendingStages;
+    bool m_resolved = false;
     bool m_managed = true;
+
+    // Named strings are global to the context, so each header is read and registered once for all pipelines.
+    static inline robin_hood::unordered_map<std::string, std::string> s_headerContents;
 };
 
 //------------------------------------------------------------------------
@@ -0,0 +1,81 @@
+#include "PipelineVariants.hpp"
+
+#include <algorithm>
+
+//------------------------------------------------------------------------
+
+namespace Zhade
+{
+
+//------------------------------------------------------------------------
+
+PipelineVariants::PipelineVariants(ResourceManager* mngr, PipelineDescriptor desc)
+    : m_mngr{mngr},
+      m_desc{std::move(desc)},
+      m_headers{m_desc.headers.cbegin(), m_desc.headers.cend()},
+      m_specializationConstants{m_desc.specializationConstants.cbegin(), m_desc.specializationConstants.cend()},
+      m_featureKeys{m_desc.features.cbegin(), m_desc.features.cend()},
+      m_featureKeyViews{m_featureKeys.cbegin(), m_featureKeys.cend()}
+{
+    if (m_featureKeys.size() > 8 * sizeof(FeatureMask)) {
+        fmt::println("Pipeline {} has more features than fit a mask, ignoring the rest", m_desc.fragPath.string());
+        m_featureKeyViews.resize(8 * sizeof(FeatureMask));
+    }
+    m_desc.headers = m_headers;
+    m_desc.specializationConstants = m_specializationConstants;
+    m_desc.features = m_featureKeyViews;
+    m_desc.managed = true;
+}
+
+//------------------------------------------------------------------------
+
+PipelineVariants::~PipelineVariants()
+{
+    for (const auto& [features, handle] : m_variants) {
+        m_mngr->destroy(handle);
+    }
+}
+
+//------------------------------------------------------------------------
+
+FeatureMask PipelineVariants::feature(std::string_view key)
+{
+    const auto it = stdr::find(m_featureKeyViews, key);
+    if (it == m_featureKeyViews.end()) {
+        fmt::println("Unknown pipeline feature {}", key);
+        return 0;
+    }
+    return 1u << std::distance(m_featureKeyViews.begin(), it);
+}
+
+//------------------------------------------------------------------------
+
+Pipeline* PipelineVariants::variant(FeatureMask features)
+{
+    Pipeline* requested = m_mngr->get(handle(features));
+    if (requested->isReady()) {
+        m_lastReady = features;
+        return requested;
+    }
+    if (m_lastReady) return m_mngr->get(m_variants[*m_lastReady]);
+
+    m_lastReady = features;
+    return requested;
+}
+
+//------------------------------------------------------------------------
+
+Handle<Pipeline> PipelineVariants::handle(FeatureMask features)
+{
+    if (const auto it = m_variants.find(features); it != m_variants.end()) return it->second;
+
+    PipelineDescriptor desc = m_desc;
+    desc.enabledFeatures = features;
+    return m_variants[features] = m_mngr->createPipeline(desc);
+}
+
+//------------------------------------------------------------------------
+
+}  // namespace Zhade
+
+//------------------------------------------------------------------------
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "Handle.hpp"
+#include "Pipeline.hpp"
+#include "ResourceManager.hpp"
+#include "common.hpp"
+
+#include <robin_hood.h>
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//------------------------------------------------------------------------
+
+namespace Zhade
+{
+
+//------------------------------------------------------------------------
+// Permutations of one pipeline, one per combination of its descriptor's features, created on first use. Variants
+// compile in the background where GL_KHR_parallel_shader_compile allows, and are cached on disk like any pipeline.
+// Until a requested variant is ready, the last ready one stands in for it, so switching features never stalls a frame.
+
+class PipelineVariants
+{
+public:
+    PipelineVariants(ResourceManager* mngr, PipelineDescriptor desc);
+    ~PipelineVariants();
+
+    PipelineVariants(const PipelineVariants&) = delete;
+    PipelineVariants& operator=(const PipelineVariants&) = delete;
+    PipelineVariants(PipelineVariants&&) = delete;
+    PipelineVariants& operator=(PipelineVariants&&) = delete;
+
+    [[nodiscard]] FeatureMask feature(std::string_view key);
+    [[nodiscard]] size_t numVariants() { return m_variants.size(); }
+
+    // Submits a variant ahead of its first use, e.g. for every value of a toggle.
+    void prefetch(FeatureMask features) { (void)handle(features); }
+
+    // The variant to draw with: the requested one if it is ready, else the stand-in, else the requested one anyway.
+    [[nodiscard]] Pipeline* variant(FeatureMask features);
+
+private:
+    [[nodiscard]] Handle<Pipeline> handle(FeatureMask features);
+
+    ResourceManager* m_mngr;
+    PipelineDescriptor m_desc;
+    // The descriptor only views these, as its spans would not outlive the constructor.
+    std::vector<std::string_view> m_headers;
+    std::vector<SpecializationConstant> m_specializationConstants;
+    std::vector<std::string> m_featureKeys;
+    std::vector<std::string_view> m_featureKeyViews;
+    robin_hood::unordered_map<FeatureMask, Handle<Pipeline>> m_variants;
+    std::optional<FeatureMask> m_lastReady{};
+};
+
+//------------------------------------------------------------------------
+
+}  // namespace Zhade
+
+//------------------------------------------------------------------------
@@ -0,0 +1,250 @@
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <numeric>
+
+//------------------------------------------------------------------------
+
+namespace Zhade
+{
+
+//------------------------------------------------------------------------
+
+Profiler::CpuScope::CpuScope(Profiler* profiler, uint32_t timerIdx)
+    : m_profiler{profiler},
+      m_timerIdx{timerIdx},
+      m_start{Clock::now()}
+{}
+
+//------------------------------------------------------------------------
+
+Profiler::CpuScope::~CpuScope()
+{
+    const double startUs = m_profiler->cpuTimeUs(m_start);
+    m_profiler->addSample(m_timerIdx, startUs, m_profiler->cpuTimeUs(Clock::now()) - startUs);
+}
+
+//------------------------------------------------------------------------
+
+Profiler::GpuScope::GpuScope(Profiler* profiler, uint32_t timerIdx)
+{
+    const PendingQuery& query = profiler->beginQuery(timerIdx);
+    glQueryCounter(query.beginQuery, GL_TIMESTAMP);
+    m_endQuery = query.endQuery;
+}
+
+//------------------------------------------------------------------------
+
+Profiler::GpuScope::~GpuScope()
+{
+    glQueryCounter(m_endQuery, GL_TIMESTAMP);
+}
+
+//------------------------------------------------------------------------
+
+Profiler::Profiler()
+{
+    // Pairs the two clocks once; the drift over a session is negligible next to the pass durations.
+    glGetInteger64v(GL_TIMESTAMP, &m_gpuStart);
+    m_cpuStart = Clock::now();
+}
+
+//------------------------------------------------------------------------
+
+Profiler::~Profiler()
+{
+    for (QuerySet& set : m_querySets) {
+        glDeleteQueries(implicit_cast<GLsizei>(set.queries.size()), set.queries.data());
+    }
+}
+
+//------------------------------------------------------------------------
+
+void Profiler::beginFrame()
+{
+    const Clock::time_point now = Clock::now();
+    if (m_frameStart) {
+        const double startUs = cpuTimeUs(*m_frameStart);
+        addSample(timerIdx("Frame", false), startUs, cpuTimeUs(now) - startUs);
+    }
+    m_frameStart = now;
+
+    ++m_frameIdx;
+    resolveQueries(m_querySets[m_frameIdx % PROFILER_QUERY_LATENCY]);
+}
+
+//------------------------------------------------------------------------
+
+void Profiler::recordSample(std::string_view name, float ms, bool gpu)
+{
+    const double durationUs = 1000.0 * ms;
+    addSample(timerIdx(name, gpu), cpuTimeUs(Clock::now()) - durationUs, durationUs);
+}
+
+//------------------------------------------------------------------------
+
+void Profiler::resetStats()
+{
+    for (Timer& timer : m_timers) {
+        timer.head = 0;
+        timer.numSamples = 0;
+    }
+}
+
+//------------------------------------------------------------------------
+
+std::optional<TimerStats> Profiler::stats(std::string_view name, bool gpu)
+{
+    const auto& timerIdxs = gpu ? m_gpuTimerIdxs : m_cpuTimerIdxs;
+    const auto it = timerIdxs.find(name);
+    if (it == timerIdxs.end()) return std::nullopt;
+    return computeStats(m_timers[it->second]);
+}
+
+//------------------------------------------------------------------------
+
+std::vector<TimerReport> Profiler::report()
+{
+    std::vector<TimerReport> reports;
+    reports.reserve(m_timers.size());
+    for (const Timer& timer : m_timers) {
+        reports.push_back({.name = timer.name, .gpu = timer.gpu, .stats = computeStats(timer)});
+    }
+    return reports;
+}
+
+//------------------------------------------------------------------------
+
+bool Profiler::exportChromeTrace(const fs::path& path)
+{
+    static constexpr uint32_t cpuThreadId = 1;
+    static constexpr uint32_t gpuThreadId = 2;
+
+    std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    json += fmt::format(
+        R"({{"name":"thread_name","ph":"M","pid":0,"tid":{},"args":{{"name":"CPU"}}}},)" "\n"
+        R"({{"name":"thread_name","ph":"M","pid":0,"tid":{},"args":{{"name":"GPU"}}}})",
+        cpuThreadId, gpuThreadId
+    );
+    for (const auto& [timerIdx, startUs, durationUs] : m_traceEvents) {
+        const Timer& timer = m_timers[timerIdx];
+        json += fmt::format(
+            ",\n" R"({{"name":"{}","cat":"{}","ph":"X","pid":0,"tid":{},"ts":{:.3f},"dur":{:.3f}}})",
+            timer.name, timer.gpu ? "GPU" : "CPU", timer.gpu ? gpuThreadId : cpuThreadId, startUs, durationUs
+        );
+    }
+    json += "\n]}\n";
+
+    std::ofstream file{path, std::ios::binary};
+    file << json;
+    if (not file) {
+        fmt::println("Error writing trace to {}", path.string());
+        return false;
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------
+
+uint32_t Profiler::timerIdx(std::string_view name, bool gpu)
+{
+    auto& timerIdxs = gpu ? m_gpuTimerIdxs : m_cpuTimerIdxs;
+    if (const auto it = timerIdxs.find(name); it != timerIdxs.end()) return it->second;
+
+    const auto idx = implicit_cast<uint32_t>(m_timers.size());
+    Timer& timer = m_timers.emplace_back(Timer{
+        .name = std::string{name},
+        .gpu = gpu,
+        .history = std::vector<float>(PROFILER_HISTORY_SIZE)
+    });
+    timerIdxs.emplace(timer.name, idx);
+    return idx;
+}
+
+//------------------------------------------------------------------------
+
+Profiler::PendingQuery& Profiler::beginQuery(uint32_t timerIdx)
+{
+    QuerySet& set = m_querySets[m_frameIdx % PROFILER_QUERY_LATENCY];
+    const size_t firstQuery = 2 * set.pending.size();
+    if (firstQuery + 2 > set.queries.size()) {
+        set.queries.resize(firstQuery + 2);
+        glCreateQueries(GL_TIMESTAMP, 2, &set.queries[firstQuery]);
+    }
+    return set.pending.emplace_back(PendingQuery{
+        .timerIdx = timerIdx,
+        .beginQuery = set.queries[firstQuery],
+        .endQuery = set.queries[firstQuery + 1]
+    });
+}
+
+//------------------------------------------------------------------------
+
+double Profiler::cpuTimeUs(Clock::time_point time)
+{
+    return std::chrono::duration<double, std::micro>(time - m_cpuStart).count();
+}
+
+//------------------------------------------------------------------------
+
+TimerStats Profiler::computeStats(const Timer& timer)
+{
+    if (timer.numSamples == 0) return {};
+
+    std::vector<float> samples(timer.history.begin(), timer.history.begin() + timer.numSamples);
+    stdr::sort(samples);
+    const auto p99Idx = implicit_cast<size_t>(std::ceil(0.99 * samples.size())) - 1;
+
+    return {
+        .last = timer.history[(timer.head + PROFILER_HISTORY_SIZE - 1) % PROFILER_HISTORY_SIZE],
+        .min = samples.front(),
+        .avg = std::reduce(samples.begin(), samples.end()) / samples.size(),
+        .p99 = samples[p99Idx],
+        .numSamples = timer.numSamples,
+        .numRecorded = timer.numRecorded
+    };
+}
+
+//------------------------------------------------------------------------
+
+void Profiler::resolveQueries(QuerySet& set)
+{
+    for (const auto& [timerIdx, beginQuery, endQuery] : set.pending) {
+        GLint available = GL_FALSE;
+        glGetQueryObjectiv(endQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available == GL_FALSE) [[unlikely]] {
+            ++m_numDroppedQueries;
+            continue;
+        }
+
+        GLuint64 beginNs = 0;
+        GLuint64 endNs = 0;
+        glGetQueryObjectui64v(beginQuery, GL_QUERY_RESULT, &beginNs);
+        glGetQueryObjectui64v(endQuery, GL_QUERY_RESULT, &endNs);
+        const double startUs = 1e-3 * (implicit_cast<double>(beginNs) - implicit_cast<double>(m_gpuStart));
+        addSample(timerIdx, startUs, 1e-3 * implicit_cast<double>(endNs - beginNs));
+    }
+    set.pending.clear();
+}
+
+//------------------------------------------------------------------------
+
+void Profiler::addSample(uint32_t timerIdx, double startUs, double durationUs)
+{
+    Timer& timer = m_timers[timerIdx];
+    timer.history[timer.head] = implicit_cast<float>(1e-3 * durationUs);
+    timer.head = (timer.head + 1) % PROFILER_HISTORY_SIZE;
+    timer.numSamples = std::min(timer.numSamples + 1, PROFILER_HISTORY_SIZE);
+    ++timer.numRecorded;
+
+    if (m_traceEvents.size() == PROFILER_MAX_TRACE_EVENTS) m_traceEvents.pop_front();
+    m_traceEvents.push_back({.timerIdx = timerIdx, .startUs = startUs, .durationUs = durationUs});
+}
+
+//------------------------------------------------------------------------
+
+}  // namespace Zhade
+
+//------------------------------------------------------------------------
@@ -0,0 +1,168 @@
+#pragma once
+
+#include "common.hpp"
+
+extern "C" {
+#include <GL/glew.h>
+}
+#include <robin_hood.h>
+
+#include <array>
+#include <chrono>
+#include <deque>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//------------------------------------------------------------------------
+
+namespace Zhade
+{
+
+//------------------------------------------------------------------------
+
+struct TimerStats
+{
+    float last = 0.0f;  // All in milliseconds.
+    float min = 0.0f;
+    float avg = 0.0f;
+    float p99 = 0.0f;
+    size_t numSamples = 0;
+    size_t numRecorded = 0;  // Ever, so that it tells whether a sample arrived since it was last looked at.
+};
+
+struct TimerReport
+{
+    std::string_view name;
+    bool gpu;
+    TimerStats stats;
+};
+
+//------------------------------------------------------------------------
+// Collects CPU and GPU timings through RAII scopes. GPU scopes issue GL_TIMESTAMP queries into one of
+// PROFILER_QUERY_LATENCY query sets, which are only read back once the set comes around again, so reading never
+// stalls the pipeline. Results that still are not available by then are dropped rather than waited for.
+
+class Profiler
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    class [[nodiscard]] CpuScope
+    {
+    public:
+        CpuScope(Profiler* profiler, uint32_t timerIdx);
+        ~CpuScope();
+
+        CpuScope(const CpuScope&) = delete;
+        CpuScope& operator=(const CpuScope&) = delete;
+        CpuScope(CpuScope&&) = delete;
+        CpuScope& operator=(CpuScope&&) = delete;
+
+    private:
+        Profiler* m_profiler;
+        uint32_t m_timerIdx;
+        Clock::time_point m_start;
+    };
+
+    class [[nodiscard]] GpuScope
+    {
+    public:
+        GpuScope(Profiler* profiler, uint32_t timerIdx);
+        ~GpuScope();
+
+        GpuScope(const GpuScope&) = delete;
+        GpuScope& operator=(const GpuScope&) = delete;
+        GpuScope(GpuScope&&) = delete;
+        GpuScope& operator=(GpuScope&&) = delete;
+
+    private:
+        GLuint m_endQuery;
+    };
+
+    Profiler();
+    ~Profiler();
+
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+    Profiler(Profiler&&) = delete;
+    Profiler& operator=(Profiler&&) = delete;
+
+    [[nodiscard]] CpuScope cpuScope(std::string_view name) { return {this, timerIdx(name, false)}; }
+    [[nodiscard]] GpuScope gpuScope(std::string_view name) { return {this, timerIdx(name, true)}; }
+    [[nodiscard]] size_t numDroppedQueries() { return m_numDroppedQueries; }
+
+    // Call once per frame before any scope of that frame. Resolves the queries issued PROFILER_QUERY_LATENCY frames
+    // ago and records the CPU frame time.
+    void beginFrame();
+
+    // For timings measured elsewhere, e.g. by the benchmarks.
+    void recordSample(std::string_view name, float ms, bool gpu = false);
+
+    // Forgets the samples recorded so far, e.g. between benchmark configurations. Queries still in flight are kept.
+    void resetStats();
+
+    [[nodiscard]] std::optional<TimerStats> stats(std::string_view name, bool gpu);
+    [[nodiscard]] std::vector<TimerReport> report();
+
+    // Writes the recorded events in the Chrome trace event format, viewable in chrome://tracing or Perfetto.
+    bool exportChromeTrace(const fs::path& path);
+
+private:
+    struct Timer
+    {
+        std::string name;
+        bool gpu;
+        std::vector<float> history;
+        size_t head = 0;
+        size_t numSamples = 0;
+        size_t numRecorded = 0;
+    };
+
+    struct PendingQuery
+    {
+        uint32_t timerIdx;
+        GLuint beginQuery;
+        GLuint endQuery;
+    };
+
+    struct QuerySet
+    {
+        std::vector<GLuint> queries;
+        std::vector<PendingQuery> pending;
+    };
+
+    struct TraceEvent
+    {
+        uint32_t timerIdx;
+        double startUs;
+        double durationUs;
+    };
+
+    [[nodiscard]] uint32_t timerIdx(std::string_view name, bool gpu);
+    [[nodiscard]] PendingQuery& beginQuery(uint32_t timerIdx);
+    [[nodiscard]] double cpuTimeUs(Clock::time_point time);
+    [[nodiscard]] TimerStats computeStats(const Timer& timer);
+
+    void resolveQueries(QuerySet& set);
+    void addSample(uint32_t timerIdx, double startUs, double durationUs);
+
+    // Deque, so that the map keys viewing the timer names stay valid as timers are added.
+    std::deque<Timer> m_timers;
+    robin_hood::unordered_map<std::string_view, uint32_t> m_cpuTimerIdxs;
+    robin_hood::unordered_map<std::string_view, uint32_t> m_gpuTimerIdxs;
+    std::array<QuerySet, PROFILER_QUERY_LATENCY> m_querySets;
+    std::deque<TraceEvent> m_traceEvents;
+    size_t m_frameIdx = 0;
+    size_t m_numDroppedQueries = 0;
+    Clock::time_point m_cpuStart;
+    GLint64 m_gpuStart = 0;
+    std::optional<Clock::time_point> m_frameStart{};
+};
+
+//------------------------------------------------------------------------
+
+}  // namespace Zhade
+
+//------------------------------------------------------------------------
@@ -0,0 +1,463 @@
+#include "RenderGraph.hpp"
+
+#include "ResourceManager.hpp"
+
+#include <algorithm>
+#include <string_view>
+
+//------------------------------------------------------------------------
+
+namespace Zhade
+{
+
+//------------------------------------------------------------------------
+
+// Transients are accounted to the graph rather than the pass declaring them, as they are aliased across passes.
+static constexpr std::string_view s_memoryTag = "RenderGraph";
+
+//------------------------------------------------------------------------
+
+RenderGraph::RenderGraph(RenderGraphDescriptor desc)
+    : m_mngr{desc.mngr},
+      m_profiler{desc.profiler}
+{}
+
+//------------------------------------------------------------------------
+
+RenderGraph::~RenderGraph()
+{
+    for (const PhysicalTexture& physical : m_physicalTextures) {
+        m_mngr->destroy(physical.handle);
+    }
+    for (const PhysicalBuffer& physical : m_physicalBuffers) {
+        m_mngr->destroy(physical.handle);
+    }
+}
+
+//------------------------------------------------------------------------
+
+void RenderGraph::reset()
+{
+    m_resources.clear();
+    m_passes.clear();
+    m_order.clear();
+}
+
+//------------------------------------------------------------------------
+
+GraphResource RenderGraph::importTexture(std::string_view name, Texture* texture)
+{
+    m_resources.push_back({.name = std::string{name}, .isTexture = true, .imported = true, .texture = texture});
+    return {implicit_cast<uint32_t>(m_resources.size() - 1)};
+}
+
+//------------------------------------------------------------------------
+
+GraphResource RenderGraph::importBuffer(std::string_view name, Buffer* buffer)
+{
+    m_resources.push_back({.name = std::string{name}, .isTexture = false, .imported = true, .buffer = buffer});
+    return {implicit_cast<uint32_t>(m_resources.size() - 1)};
+}
+
+//------------------------------------------------------------------------
+
+GraphResource RenderGraph::createTexture(std::string_view name, const TextureDescriptor& desc)
+{
+    m_resources.push_back({.name = std::string{name}, .isTexture = true, .imported = false, .textureDesc = desc});
+    return {implicit_cast<uint32_t>(m_resources.size() - 1)};
+}
+
+//------------------------------------------------------------------------
+
+GraphResource RenderGraph::createBuffer(std::string_view name, GLsizei byteSize, BufferUsage::Type usage)
+{
+    m_resources.push_back({
+        .name = std::string{name},
+        .isTexture = false,
+        .imported = false,
+        .byteSize = byteSize,
+        .usage = usage
+    });
+    return {implicit_cast<uint32_t>(m_resources.size() - 1)};
+}
+
+//------------------------------------------------------------------------
+
+void RenderGraph::addPass(RenderPassDescriptor desc)
+{
+    m_passes.push_back({
+        .name = std::string{desc.name},
+        .reads = std::move(desc.reads),
+        .writes = std::move(desc.writes),
+        .execute = std::move(desc.execute),
+        .sideEffects = desc.sideEffects
+    });
+}
+
+//------------------------------------------------------------------------
+
+void RenderGraph::compile()
+{
+    findDependencies();
+    cullPasses();
+    orderPasses();
+    assignPhysicalResources();
+    placeBarriers();
+}
+
+//------------------------------------------------------------------------
+
+void RenderGraph::execute()
+{
+    for (uint32_t passIdx : m_order) {
+        Pass& pass = m_passes[passIdx];
+        if (pass.barriers != 0) glMemoryBarrier(pass.barriers);
+
+        if (m_profiler != nullptr) {
+            const auto scope = m_profiler->gpuScope(pass.name);
+            pass.execute(*this);
+        } else {
+            pass.execute(*this);
+        }
+    }
+}
+
+//------------------------------------------------------------------------
+
+std::string RenderGraph::dump()
+{
+    std::vector<uint32_t> positions(m_passes.size(), NONE);
+    for (uint32_t pos = 0; pos < m_order.size(); ++pos) {
+        positions[m_order[pos]] = pos;
+    }
+
+    std::string dot = "digraph RenderGraph {\n    rankdir=LR;\n    node [fontname=\"Helvetica\"];\n";
+
+    for (uint32_t passIdx = 0; passIdx < m_passes.size(); ++passIdx) {
+        const Pass& pass = m_passes[passIdx];
+        if (not pass.live) {
+            dot += fmt::format("    p{} [shape=box, style=dashed, label=\"{}\\n(culled)\"];\n", passIdx, pass.name);
+            continue;
+        }
+        std::string barriers;
+        for (ResourceAccess::Type access = 0; access < ResourceAccess::NUM_ACCESSES; ++access) {
+            if ((pass.barriers & ResourceAccess2Barrier[access]) == 0) continue;
+            barriers += fmt::format("{}{}", barriers.empty() ? "\\nbarrier: " : " | ", ResourceAccess2Name[access]);
+        }
+        dot += fmt::format(
+            "    p{} [shape=box, label=\"{}: {}{}\"];\n", passIdx, positions[passIdx], pass.name, barriers
+        );
+    }
+
+    for (uint32_t resourceIdx = 0; resourceIdx < m_resources.size(); ++resourceIdx) {
+        const Resource& resource = m_resources[resourceIdx];
+        std::string origin = "imported";
+        if (not resource.imported) {
+            origin = resource.physical == NONE
+                ? "transient, unused"
+                : fmt::format("transient, {} #{}", resource.isTexture ? "texture" : "buffer", resource.physical);
+        }
+        dot += fmt::format(
+            "    r{} [shape=ellipse{}, label=\"{}\\n{}\"];\n",
+            resourceIdx, resource.output ? ", peripheries=2" : "", resource.name, origin
+        );
+    }
+
+    for (uint32_t passIdx = 0; passIdx < m_passes.size(); ++passIdx) {
+        const Pass& pass = m_passes[passIdx];
+        const std::string_view style = pass.live ? "" : ", style=dashed";
+        for (const auto& [resource, access] : pass.reads) {
+            dot += fmt::format(
+                "    r{} -> p{} [label=\"{}\"{}];\n", resource.idx, passIdx, ResourceAccess2Name[access], style
+            );
+        }
+        for (const auto& [resource, access] : pass.writes) {
+            dot += fmt::format(
+                "    p{} -> r{} [label=\"{}\"{}];\n", passIdx, resource.idx, ResourceAccess2Name[access], style
+            );
+        }
+    }
+
+    dot += "}\n";
+    return dot;
+}
+
+//------------------------------------------------------------------------
+
+// Transient resources are keyed by their index while their GL objects are yet to be assigned.
+uint64_t RenderGraph::barrierKey(uint32_t resourceIdx, bool physical)
+{
+    const Resource& resource = m_resources[resourceIdx];
+    if (not resource.imported and not physical) return (uint64_t{2} << 32) | resourceIdx;
+
+    const GLuint name = resource.isTexture ? resource.texture->name() : resource.buffer->name();
+    return (uint64_t{resource.isTexture} << 32) | name;
+}
+
+//------------------------------------------------------------------------
+
+GLbitfield RenderGraph::requiredBarriers(const Pass& pass, BarrierStates& states, bool physical)
+{
+    GLbitfield barriers = 0;
+    for (const auto& uses : {std::cref(pass.reads), std::cref(pass.writes)}) {
+        for (const auto& [resource, access] : uses.get()) {
+            const BarrierState& state = states[barrierKey(resource.idx, physical)];
+            if (state.dirty) barriers |= ResourceAccess2Barrier[access] & ~state.visibleBarriers;
+        }
+    }
+    return barriers;
+}
+
+//------------------------------------------------------------------------
+
+// A barrier makes every incoherent write before it visible to its accesses, not only those of the pass's resources.
+void RenderGraph::applyBarriers(const Pass& pass, GLbitfield barriers, BarrierStates& states, bool physical)
+{
+    for (auto& [key, state] : states) {
+        if (state.dirty) state.visibleBarriers |= barriers;
+    }
+    for (const auto& [resource, access] : pass.writes) {
+        if (ResourceAccess2Incoherent[access]) states[barrierKey(resource.idx, physical)] = {.dirty = true};
+    }
+}
+
+//------------------------------------------------------------------------
+
+// Reads depend on the last pass declared before that writes the resource. Writes additionally wait for the reads and
+// writes before them, which only orders the passes but does not keep them alive.
+void RenderGraph::findDependencies()
+{
+    std::vector<uint32_t> lastWriters(m_resources.size(), NONE);
+    std::vector<std::vector<uint32_t>> readersSinceWrite(m_resources.size());
+
+    for (uint32_t passIdx = 0; passIdx < m_passes.size(); ++passIdx) {
+        Pass& pass = m_passes[passIdx];
+
+        for (const auto& [resource, access] : pass.reads) {
+            const uint32_t writer = lastWriters[resource.idx];
+            if (writer == NONE or writer == passIdx) continue;
+            pass.producers.push_back(writer);
+            pass.predecessors.push_back(writer);
+        }
+        for (const auto& [resource, access] : pass.writes) {
+            const uint32_t writer = lastWriters[resource.idx];
+            if (writer != NONE and writer != passIdx) pass.predecessors.push_back(writer);
+            for (uint32_t reader : readersSinceWrite[resource.idx]) {
+                if (reader != passIdx) pass.predecessors.push_back(reader);
+            }
+        }
+
+        for (const auto& [resource, access] : pass.reads) {
+            readersSinceWrite[resource.idx].push_back(passIdx);
+        }
+        for (const auto& [resource, access] : pass.writes) {
+            lastWriters[resource.idx] = passIdx;
+            readersSinceWrite[resource.idx].clear();
+        }
+
+        stdr::sort(pass.predecessors);
+        const auto duplicates = stdr::unique(pass.predecessors);
+        pass.predecessors.erase(duplicates.begin(), duplicates.end());
+    }
+}
+
+//------------------------------------------------------------------------
+
+void RenderGraph::cullPasses()
+{
+    std::vector<uint32_t> stack;
+    for (uint32_t passIdx = 0; passIdx < m_passes.size(); ++passIdx) {
+        Pass& pass = m_passes[passIdx];
+        pass.live = pass.sideEffects or stdr::any_of(pass.writes, [this](const ResourceUse& use) {
+            return m_resources[use.resource.idx].output;
+        });
+        if (pass.live) stack.push_back(passIdx);
+    }
+
+    while (not stack.empty()) {
+        const uint32_t passIdx = stack.back();
+        stack.pop_back();
+        for (uint32_t producer : m_passes[passIdx].producers) {
+            if (m_passes[producer].live) continue;
+            m_passes[producer].live = true;
+            stack.push_back(producer);
+        }
+    }
+}
+
+//------------------------------------------------------------------------
+
+// Of the passes whose predecessors have run, the first declared one needing no barrier runs next, else the first
+// declared one. This simulates the barriers on the resources rather than their GL objects, which are not known yet.
+void RenderGraph::orderPasses()
+{
+    const size_t numLive = stdr::count_if(m_passes, &Pass::live);
+    std::vector<bool> done(m_passes.size(), false);
+    BarrierStates states = m_barrierStates;
+
+    while (m_order.size() < numLive) {
+        uint32_t next = NONE;
+        GLbitfield nextBarriers = 0;
+
+        for (uint32_t passIdx = 0; passIdx < m_passes.size(); ++passIdx) {
+            const Pass& pass = m_passes[passIdx];
+            if (not pass.live or done[passIdx]) continue;
+            const bool ready = stdr::all_of(pass.predecessors, [&](uint32_t predecessor) {
+                return done[predecessor] or not m_passes[predecessor].live;
+            });
+            if (not ready) continue;
+
+            const GLbitfield barriers = requiredBarriers(pass, states, false);
+            if (next == NONE or barriers == 0) {
+                next = passIdx;
+                nextBarriers = barriers;
+            }
+            if (barriers == 0) break;
+        }
+
+        applyBarriers(m_passes[next], nextBarriers, states, false);
+        done[next] = true;
+        m_order.push_back(next);
+    }
+}
+
+//------------------------------------------------------------------------
+
+// Any GL object matching the resource that is free for its whole lifetime, or a new one if there is none.
+template<typename T, typename F>
+uint32_t RenderGraph::acquirePhysical(std::vector<T>& physicals, const Resource& resource, F&& matches)
+{
+    for (uint32_t physicalIdx = 0; physicalIdx < physicals.size(); ++physicalIdx) {
+        T& physical = physicals[physicalIdx];
+        if (physical.used and physical.busyUntil >= resource.firstUse) continue;
+        if (not matches(physical)) continue;
+        physical.used = true;
+        physical.busyUntil = resource.lastUse;
+        return physicalIdx;
+    }
+    return NONE;
+}
+
+//------------------------------------------------------------------------
+
+void RenderGraph::assignPhysicalResources()
+{
+    for (uint32_t pos = 0; pos < m_order.size(); ++pos) {
+        const Pass& pass = m_passes[m_order[pos]];
+        for (const auto& uses : {std::cref(pass.reads), std::cref(pass.writes)}) {
+            for (const auto& [resource, access] : uses.get()) {
+                Resource& used = m_resources[resource.idx];
+                used.firstUse = std::min(used.firstUse, pos);
+                used.lastUse = std::max(used.lastUse, pos);
+            }
+        }
+    }
+
+    for (PhysicalTexture& physical : m_physicalTextures) physical.used = false;
+    for (PhysicalBuffer& physical : m_physicalBuffers) physical.used = false;
+
+    std::vector<uint32_t> transients;
+    for (uint32_t resourceIdx = 0; resourceIdx < m_resources.size(); ++resourceIdx) {
+        const Resource& resource = m_resources[resourceIdx];
+        if (not resource.imported and resource.firstUse != NONE) transients.push_back(resourceIdx);
+    }
+    stdr::sort(transients, {}, [this](uint32_t resourceIdx) { return m_resources[resourceIdx].firstUse; });
+
+    for (uint32_t resourceIdx : transients) {
+        Resource& resource = m_resources[resourceIdx];
+
+        if (resource.isTexture) {
+            resource.physical = acquirePhysical(m_physicalTextures, resource, [&](const PhysicalTexture& physical) {
+                return physical.desc == resource.textureDesc;
+            });
+            if (resource.physical == NONE) {
+                resource.physical = implicit_cast<uint32_t>(m_physicalTextures.size());
+                TextureDescriptor desc = resource.textureDesc;
+                desc.tag = s_memoryTag;
+                m_physicalTextures.push_back({
+                    .handle = m_mngr->createTexture(desc),
+                    .desc = resource.textureDesc,
+                    .busyUntil = resource.lastUse,
+                    .used = true
+                });
+            }
+        } else {
+            resource.physical = acquirePhysical(m_physicalBuffers, resource, [&](const PhysicalBuffer& physical) {
+                return physical.usage == resource.usage and physical.byteSize >= resource.byteSize;
+            });
+            if (resource.physical == NONE) {
+                resource.physical = implicit_cast<uint32_t>(m_physicalBuffers.size());
+                m_physicalBuffers.push_back({
+                    .handle = m_mngr->createBuffer({
+                        .byteSize = resource.byteSize,
+                        .usage = resource.usage,
+                        .tag = s_memoryTag
+                    }),
+                    .byteSize = resource.byteSize,
+                    .usage = resource.usage,
+                    .busyUntil = resource.lastUse,
+                    .used = true
+                });
+            }
+        }
+    }
+
+    releaseUnusedPhysicalResources();
+
+    for (uint32_t resourceIdx : transients) {
+        Resource& resource = m_resources[resourceIdx];
+        if (resource.isTexture) {
+            resource.texture = m_mngr->get(m_physicalTextures[resource.physical].handle);
+        } else {
+            resource.buffer = m_mngr->get(m_physicalBuffers[resource.physical].handle);
+        }
+    }
+}
+
+//------------------------------------------------------------------------
+
+// Along with their barrier states, as their GL names may be reused by unrelated objects.
+void RenderGraph::releaseUnusedPhysicalResources()
+{
+    auto release = [this]<typename T>(std::vector<T>& physicals, bool isTexture) {
+        std::vector<uint32_t> remapped(physicals.size(), NONE);
+        uint32_t numKept = 0;
+        for (uint32_t physicalIdx = 0; physicalIdx < physicals.size(); ++physicalIdx) {
+            T& physical = physicals[physicalIdx];
+            if (physical.used) {
+                remapped[physicalIdx] = numKept;
+                physicals[numKept++] = physical;
+                continue;
+            }
+            m_barrierStates.erase((uint64_t{isTexture} << 32) | m_mngr->get(physical.handle)->name());
+            m_mngr->destroy(physical.handle);
+        }
+        physicals.resize(numKept);
+
+        for (Resource& resource : m_resources) {
+            if (not resource.imported and resource.isTexture == isTexture and resource.physical != NONE) {
+                resource.physical = remapped[resource.physical];
+            }
+        }
+    };
+
+    release(m_physicalTextures, true);
+    release(m_physicalBuffers, false);
+}
+
+//------------------------------------------------------------------------
+
+void RenderGraph::placeBarriers()
+{
+    for (uint32_t passIdx : m_order) {
+        Pass& pass = m_passes[passIdx];
+        pass.barriers = requiredBarriers(pass, m_barrierStates, true);
+        applyBarriers(pass, pass.barriers, m_barrierStates, true);
+    }
+}
+
+//------------------------------------------------------------------------
+
+}  // namespace Zhade
+
+//------------------------------------------------------------------------
@@ -0,0 +1,243 @@
+#pragma once
+
+#include "Buffer.hpp"
+#include "Handle.hpp"
+#include "Profiler.hpp"
+#include "Texture.hpp"
+#include "common.hpp"
+
+#include <robin_hood.h>
+
+#include <functional>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//------------------------------------------------------------------------
+
+namespace Zhade
+{
+
+//------------------------------------------------------------------------
+
+class RenderGraph;
+class ResourceManager;
+
+namespace ResourceAccess
+{
+    using Type = uint8_t;
+    enum : Type
+    {
+        UNIFORM,
+        STORAGE,
+        IMAGE,
+        ATOMIC_COUNTER,
+        INDIRECT,        // Draw and dispatch commands as well as their counts.
+        TEXTURE,
+        TEXTURE_UPDATE,  // Texture clears, transfers and mipmap generation.
+        BUFFER_UPDATE,   // Buffer clears and transfers.
+        ATTACHMENT,
+        NUM_ACCESSES
+    };
+}
+
+inline constexpr GLbitfield ResourceAccess2Barrier[] {
+    GL_UNIFORM_BARRIER_BIT,
+    GL_SHADER_STORAGE_BARRIER_BIT,
+    GL_SHADER_IMAGE_ACCESS_BARRIER_BIT,
+    GL_ATOMIC_COUNTER_BARRIER_BIT,
+    GL_COMMAND_BARRIER_BIT,
+    GL_TEXTURE_FETCH_BARRIER_BIT,
+    GL_TEXTURE_UPDATE_BARRIER_BIT,
+    GL_BUFFER_UPDATE_BARRIER_BIT,
+    GL_FRAMEBUFFER_BARRIER_BIT
+};
+
+// Shader writes through these bypass GL's implicit synchronization, so that later accesses need a barrier.
+inline constexpr bool ResourceAccess2Incoherent[] {
+    false,
+    true,
+    true,
+    true,
+    false,
+    false,
+    false,
+    false,
+    false
+};
+
+inline constexpr const char* ResourceAccess2Name[] {
+    "UNIFORM",
+    "STORAGE",
+    "IMAGE",
+    "ATOMIC_COUNTER",
+    "INDIRECT",
+    "TEXTURE",
+    "TEXTURE_UPDATE",
+    "BUFFER_UPDATE",
+    "ATTACHMENT"
+};
+
+struct GraphResource
+{
+    uint32_t idx = std::numeric_limits<uint32_t>::max();
+
+    [[nodiscard]] bool isValid() const { return idx != std::numeric_limits<uint32_t>::max(); }
+};
+
+struct ResourceUse
+{
+    GraphResource resource;
+    ResourceAccess::Type access;
+};
+
+using PassCallback = std::function<void(RenderGraph&)>;
+
+struct RenderPassDescriptor
+{
+    std::string_view name;
+    std::vector<ResourceUse> reads{};
+    std::vector<ResourceUse> writes{};
+    PassCallback execute;
+    bool sideEffects = false;  // Never culled, e.g. as it draws to the default framebuffer.
+};
+
+struct RenderGraphDescriptor
+{
+    ResourceManager* mngr;
+    Profiler* profiler = nullptr;  // Times every pass under its name if set.
+};
+
+//------------------------------------------------------------------------
+// Declared anew every frame: passes name the resources they read and write, and compile() derives the rest from that.
+// Passes whose results no live pass reads are culled, the others are ordered by their dependencies, preferring passes
+// that need no barrier so that independent work runs before one. Barriers only cover the accesses that follow
+// incoherent writes, tracked across frames per GL object. Transient resources are only alive from their first to
+// their last use, and those of equal description share one GL object if their lifetimes do not overlap. The GL
+// objects are kept for the following frames and freed once a frame no longer uses them.
+
+class RenderGraph
+{
+public:
+    explicit RenderGraph(RenderGraphDescriptor desc);
+    ~RenderGraph();
+
+    RenderGraph(const RenderGraph&) = delete;
+    RenderGraph& operator=(const RenderGraph&) = delete;
+    RenderGraph(RenderGraph&&) = delete;
+    RenderGraph& operator=(RenderGraph&&) = delete;
+
+    // Forgets the declarations of the last frame.
+    void reset();
+
+    // Imported resources must stay alive until execute() has returned.
+    [[nodiscard]] GraphResource importTexture(std::string_view name, Texture* texture);
+    [[nodiscard]] GraphResource importBuffer(std::string_view name, Buffer* buffer);
+    [[nodiscard]] GraphResource createTexture(std::string_view name, const TextureDescriptor& desc);
+    [[nodiscard]] GraphResource createBuffer(std::string_view name, GLsizei byteSize, BufferUsage::Type usage);
+
+    // Keeps the passes writing the resource alive, as it is used after the graph has run.
+    void markOutput(GraphResource resource) { m_resources[resource.idx].output = true; }
+    void addPass(RenderPassDescriptor desc);
+
+    void compile();
+    void execute();
+
+    // Only valid within the passes using the resource.
+    [[nodiscard]] Texture* texture(GraphResource resource) { return m_resources[resource.idx].texture; }
+    [[nodiscard]] Buffer* buffer(GraphResource resource) { return m_resources[resource.idx].buffer; }
+
+    [[nodiscard]] size_t numPhysicalTextures() { return m_physicalTextures.size(); }
+    [[nodiscard]] size_t numPhysicalBuffers() { return m_physicalBuffers.size(); }
+
+    // The last compiled frame in the Graphviz DOT language, including culled passes, barriers and aliasing.
+    [[nodiscard]] std::string dump();
+
+private:
+    static constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+
+    struct Resource
+    {
+        std::string name;
+        bool isTexture;
+        bool imported;
+        bool output = false;
+        TextureDescriptor textureDesc{};
+        GLsizei byteSize = 0;
+        BufferUsage::Type usage{};
+        Texture* texture = nullptr;
+        Buffer* buffer = nullptr;
+        uint32_t physical = NONE;
+        uint32_t firstUse = NONE;  // Both positions in the execution order.
+        uint32_t lastUse = 0;
+    };
+
+    struct Pass
+    {
+        std::string name;
+        std::vector<ResourceUse> reads;
+        std::vector<ResourceUse> writes;
+        PassCallback execute;
+        bool sideEffects;
+        std::vector<uint32_t> producers{};     // The passes that wrote what this one reads.
+        std::vector<uint32_t> predecessors{};  // The producers and the earlier users of what this one writes.
+        bool live = false;
+        GLbitfield barriers = 0;
+    };
+
+    // A GL object backing transient resources, each for its lifetime.
+    struct PhysicalTexture
+    {
+        Handle<Texture> handle;
+        TextureDescriptor desc;
+        uint32_t busyUntil = 0;  // Position in the execution order of the last use by its current resource.
+        bool used = false;
+    };
+
+    struct PhysicalBuffer
+    {
+        Handle<Buffer> handle;
+        GLsizei byteSize;
+        BufferUsage::Type usage;
+        uint32_t busyUntil = 0;
+        bool used = false;
+    };
+
+    struct BarrierState
+    {
+        bool dirty = false;              // Written incoherently, ...
+        GLbitfield visibleBarriers = 0;  // ... and made visible to these accesses since.
+    };
+
+    using BarrierStates = robin_hood::unordered_map<uint64_t, BarrierState>;
+
+    [[nodiscard]] uint64_t barrierKey(uint32_t resourceIdx, bool physical);
+    [[nodiscard]] GLbitfield requiredBarriers(const Pass& pass, BarrierStates& states, bool physical);
+    void applyBarriers(const Pass& pass, GLbitfield barriers, BarrierStates& states, bool physical);
+
+    template<typename T, typename F>
+    [[nodiscard]] uint32_t acquirePhysical(std::vector<T>& physicals, const Resource& resource, F&& matches);
+
+    void findDependencies();
+    void cullPasses();
+    void orderPasses();
+    void assignPhysicalResources();
+    void releaseUnusedPhysicalResources();
+    void placeBarriers();
+
+    ResourceManager* m_mngr;
+    Profiler* m_profiler;
+    std::vector<Resource> m_resources;
+    std::vector<Pass> m_passes;
+    std::vector<uint32_t> m_order;
+    std::vector<PhysicalTexture> m_physicalTextures;
+    std::vector<PhysicalBuffer> m_physicalBuffers;
+    BarrierStates m_barrierStates;
+};
+
+//------------------------------------------------------------------------
+
+}  // namespace Zhade
+
+//------------------------------------------------------------------------
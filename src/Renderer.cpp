@@ -1,5 +1,11 @@
 #include "Renderer.hpp"
 
+#include "StbImageResource.hpp"
+
+#include <fstream>
+#include <optional>
+#include <vector>
+
 //------------------------------------------------------------------------
 
 namespace Zhade
@@ -7,14 +13,131 @@ namespace Zhade
 
 //------------------------------------------------------------------------
 
+// For textures read and written texel by texel, such as framebuffer attachments.
+static constexpr SamplerDescriptor s_nearestSampler{
+    .wrapS = GL_CLAMP_TO_EDGE,
+    .wrapT = GL_CLAMP_TO_EDGE,
+    .magFilter = GL_NEAREST,
+    .minFilter = GL_NEAREST,
+    .anisotropy = 1.0f
+};
+
+static constexpr glm::ivec2 s_windowDims{App::s_windowWidth, App::s_windowHeight};
+static constexpr std::string_view s_memoryTag = "Renderer";
+
+// For the textures the scene is rendered into, always at full size so that a changing resolution scale only changes
+// the viewport into them and never reallocates them.
+static TextureDescriptor sceneTextureDesc(GLenum internalFormat)
+{
+    return {
+        .dims = s_windowDims,
+        .levels = 1,
+        .internalFormat = internalFormat,
+        .sampler = s_nearestSampler
+    };
+}
+
+//------------------------------------------------------------------------
+
+RendererDescriptor RendererDescriptor::makeDefault(ResourceManager* mngr, App* app, bool offscreen)
+{
+    return {
+        .mngr = mngr,
+        .sceneDesc = {
+            .mngr = mngr,
+            .sunLightDesc = {
+                .mngr = mngr,
+                .props = {
+                    .direction = glm::vec3{0.273005, -0.960278, 0.057737},
+                    .strength = 1.0f,
+                    .color = {1.0f, 1.0f, 1.0f},
+                    .ambient = {0.4f, 0.4f, 0.4f}
+                },
+                .shadowMapDims = {2048, 2048},
+                .shadowPassDesc = {
+                    .vertPath = SHADER_PATH / "shadowMap.vert",
+                    .fragPath = SHADER_PATH / "passthrough.frag"
+                },
+                .evsmDesc = {
+                    .shadowPassDesc = {
+                        .vertPath = SHADER_PATH / "shadowMap.vert",
+                        .fragPath = SHADER_PATH / "shadowMapEVSM.frag"
+                    },
+                    .blurDesc = {
+                        .compPath = SHADER_PATH / "evsmBlur.comp"
+                    }
+                }
+            },
+            .localLightsDesc = {
+                .mngr = mngr,
+                .binningDesc = {
+                    .compPath = SHADER_PATH / "lightBinning.comp",
+                    .headers = s_lightBinningHeaders
+                },
+                .compactionDesc = {
+                    .compPath = SHADER_PATH / "lightCompaction.comp"
+                }
+            },
+            .textureResidencyDesc = {
+                .mngr = mngr
+            }
+        },
+        .cameraDesc = {
+            .mngr = mngr,
+            .app = app
+        },
+        .populateBuffersDesc = {
+            .compPath = SHADER_PATH / "populateBuffers.comp"
+        },
+        .mainPassDesc = {
+            .vertPath = SHADER_PATH / "main.vert",
+            .fragPath = SHADER_PATH / "main.frag",
+            .headers = s_shadingHeaders,
+            .features = s_shadingFeatures
+        },
+        .visibilityPassDesc = {
+            .vertPath = SHADER_PATH / "visibility.vert",
+            .fragPath = SHADER_PATH / "visibility.frag"
+        },
+        .visibilityResolveDesc = {
+            .compPath = SHADER_PATH / "visibilityResolve.comp",
+            .headers = s_shadingHeaders,
+            .features = s_shadingFeatures
+        },
+        .offscreen = offscreen
+    };
+}
+
+//------------------------------------------------------------------------
+
 Renderer::Renderer(RendererDescriptor desc)
     : m_mngr{desc.mngr},
-      m_scene{desc.sceneDesc}
+      m_scene{desc.sceneDesc},
+      m_populateBuffersPipeline{desc.mngr->createPipeline(desc.populateBuffersDesc)},
+      m_visibilityPipeline{desc.mngr->createPipeline(desc.visibilityPassDesc)},
+      m_mainPass{desc.mngr, desc.mainPassDesc},
+      m_visibilityResolve{desc.mngr, desc.visibilityResolveDesc},
+      m_renderPath{desc.renderPath},
+      m_dynamicResolution{desc.dynamicResolutionDesc},
+      m_sceneDims{s_windowDims},
+      m_frameData{{.mngr = desc.mngr, .tag = s_memoryTag}},
+      m_lightData{{
+          .mngr = desc.mngr,
+          .frameByteSize = MAX_LOCAL_LIGHTS * sizeof(LocalLight),
+          .usage = BufferUsage::STORAGE,
+          .tag = s_memoryTag
+      }},
+      m_framePacer{{.maxFramesInFlight = desc.maxFramesInFlight, .profiler = &m_profiler}},
+      m_simulation{desc.simulation},
+      m_graph{{.mngr = desc.mngr, .profiler = &m_profiler}}
 {
     setupVAO();
     setupBuffers(desc);
     setupCamera(desc.cameraDesc);
-    setupPipeline(desc.mainPassDesc);
+    if (desc.offscreen) setupOffscreenFramebuffer();
+    glCreateFramebuffers(1, &m_visibilityFramebuffer);
+    glCreateFramebuffers(1, &m_sceneFramebuffer);
+    prefetchShading();
 }
 
 //------------------------------------------------------------------------
@@ -25,29 +148,434 @@ Renderer::~Renderer()
     m_mngr->destroy(m_commandBuffer);
     m_mngr->destroy(m_drawMetadataBuffer);
     m_mngr->destroy(m_atomicDrawCounterBuffer);
-    m_mngr->destroy(m_viewProjUniformBuffer);
-    m_mngr->destroy(m_pipeline);
+    m_mngr->destroy(m_populateBuffersPipeline);
+    m_mngr->destroy(m_visibilityPipeline);
+    if (m_offscreenFramebuffer.isValid()) m_mngr->destroy(m_offscreenFramebuffer);
+    glDeleteFramebuffers(1, &m_visibilityFramebuffer);
+    glDeleteFramebuffers(1, &m_sceneFramebuffer);
+}
+
+//------------------------------------------------------------------------
+
+void Renderer::setRenderPath(RenderPath::Type path)
+{
+    m_renderPath = path;
+    prefetchShading();
 }
 
 //------------------------------------------------------------------------
 
 void Renderer::render()
 {
-    m_scene.m_sunLight.prepareForRendering(m_viewProjUniformBuffer);
-    populateBuffers();
-    //glCullFace(GL_FRONT);
-    glClear(GL_DEPTH_BUFFER_BIT);
-    glMultiDrawElementsIndirectCount(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, 0, MAX_DRAWS, 0);
-    //glCullFace(GL_BACK);
+    m_profiler.beginFrame();
+    m_framePacer.waitForFrameSlot();
+    const auto cpuScope = m_profiler.cpuScope("Render");
+
+    // Whatever loader threads created since the last frame becomes usable from this one on.
+    m_mngr->finalizePending();
+    m_mngr->resolvePipelines();
+    m_scene.updateTextureResidency();
+    m_frameData.beginFrame();
+    m_lightData.beginFrame();
+
+    if (m_renderPath == RenderPath::VISIBILITY_BUFFER and not supportsVisibilityBuffer()) [[unlikely]] {
+        setRenderPath(RenderPath::FORWARD);
+    }
+    updateDynamicResolution();
+    const FramePacer::Clock::time_point inputTime = latchCamera();
+    buildRenderGraph();
+    m_graph.compile();
+    {
+        const auto gpuScope = m_profiler.gpuScope("Render");
+        m_graph.execute();
+    }
+
+    m_frameData.endFrame();
+    m_lightData.endFrame();
+    m_scene.endFrame();
+    m_framePacer.endFrame(inputTime);
+    m_mngr->endFrame();
+}
+
+//------------------------------------------------------------------------
+
+// The GPU time of a frame is only known PROFILER_QUERY_LATENCY frames later, and then only once, so the controller is
+// fed each sample as it arrives rather than every frame.
+void Renderer::updateDynamicResolution()
+{
+    const std::optional<TimerStats> stats = m_profiler.stats("Render", true);
+    if (stats and stats->numRecorded != m_numFrameTimesSeen) {
+        m_numFrameTimesSeen = stats->numRecorded;
+        m_dynamicResolution.update(stats->last);
+    }
+    m_sceneDims = m_dynamicResolution.scaledDims(s_windowDims);
+}
+
+//------------------------------------------------------------------------
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glViewport(0, 0, App::s_windowWidth, App::s_windowHeight);
-    pipeline()->bind();
-    buffer(m_viewProjUniformBuffer)->setData(&m_camera.m_matrices);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glMultiDrawElementsIndirectCount(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, 0, MAX_DRAWS, 0);
+// As late as possible, i.e. after waiting for a frame slot and right before recording, so that the frame shows the
+// newest pose. Without a simulation, the camera was updated before render() and the input is as old as the frame.
+FramePacer::Clock::time_point Renderer::latchCamera()
+{
+    if (m_simulation == nullptr) return FramePacer::Clock::now();
 
-    clearDrawCounter();
+    const CameraState& state = m_simulation->latestCamera();
+    m_camera.setPose(state.center, state.target);
+    return state.inputTime;
+}
+
+//------------------------------------------------------------------------
+
+// Declared anew every frame, as the passes depend on the shadow filter and the render path: only EVSM samples the
+// moments, so the passes blurring them are culled otherwise.
+void Renderer::buildRenderGraph()
+{
+    DirectionalLight& sun = m_scene.m_sunLight;
+    m_graph.reset();
+
+    const GraphResource meshes = m_graph.importBuffer("Meshes", buffer(m_scene.m_meshBuffer));
+    const GraphResource depth = m_graph.importTexture("Shadow map", sun.depthTexture());
+    const GraphResource moments = m_graph.importTexture("EVSM moments", sun.momentsTexture());
+    const SceneResources resources{
+        .commands = m_graph.importBuffer("Draw commands", buffer(m_commandBuffer)),
+        .metadata = m_graph.importBuffer("Draw metadata", buffer(m_drawMetadataBuffer)),
+        .drawCount = m_graph.importBuffer("Draw count", buffer(m_atomicDrawCounterBuffer)),
+        .shadowMap = shadowFilter() == ShadowFilter::EVSM ? moments : depth,
+        .meshUsage = m_graph.importBuffer("Mesh usage", buffer(m_scene.m_meshUsageBuffer)),
+        .lightClusters = m_scene.m_localLights.addCullingPasses(m_graph, m_frameData, m_lightData, {
+            .matrices = m_camera.m_matrices,
+            .zNear = m_camera.m_settings.zNear,
+            .zFar = m_camera.m_settings.zFar,
+            .dims = m_sceneDims
+        })
+    };
+
+    m_graph.addPass({
+        .name = "Populate buffers",
+        .reads = {{meshes, ResourceAccess::STORAGE}, {resources.drawCount, ResourceAccess::ATOMIC_COUNTER}},
+        .writes = {
+            {resources.commands, ResourceAccess::STORAGE},
+            {resources.metadata, ResourceAccess::STORAGE},
+            {resources.drawCount, ResourceAccess::ATOMIC_COUNTER}
+        },
+        .execute = [this](RenderGraph&) { populateBuffers(); }
+    });
+    m_graph.addPass({
+        .name = "Shadow pass",
+        .reads = drawReads(resources),
+        .writes = {{resources.shadowMap, ResourceAccess::ATTACHMENT}},
+        .execute = [this, &sun](RenderGraph&) {
+            sun.prepareForRendering(m_frameData);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            glMultiDrawElementsIndirectCount(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, 0, MAX_DRAWS, 0);
+        }
+    });
+    sun.addFilterPasses(m_graph, moments);
+
+    if (m_renderPath == RenderPath::VISIBILITY_BUFFER) {
+        addVisibilityPasses(resources);
+    } else {
+        addForwardPass(resources);
+    }
+    m_graph.addPass({
+        .name = "Read back mesh usage",
+        .reads = {{resources.meshUsage, ResourceAccess::BUFFER_UPDATE}},
+        .execute = [this](RenderGraph&) { m_scene.readBackMeshUsage(); },
+        .sideEffects = true
+    });
+
+    // For the next frame, which is why nothing in this one reads it.
+    m_graph.addPass({
+        .name = "Clear draw count",
+        .writes = {{resources.drawCount, ResourceAccess::BUFFER_UPDATE}},
+        .execute = [this](RenderGraph&) { clearDrawCounter(); },
+        .sideEffects = true
+    });
+}
+
+//------------------------------------------------------------------------
+
+void Renderer::addForwardPass(const SceneResources& resources)
+{
+    // Only rendered offscreen when scaled, as the upscale would be a plain copy otherwise. While dynamic resolution may
+    // scale, that copy is cheaper than the graph releasing the targets at full scale and reallocating them once scaled.
+    std::optional<SceneTargets> targets;
+    std::vector<ResourceUse> writes;
+    if (m_dynamicResolution.enabled() or m_sceneDims != s_windowDims) {
+        targets = SceneTargets{
+            .color = m_graph.createTexture("Scene color", sceneTextureDesc(GL_RGBA8)),
+            .depth = m_graph.createTexture("Scene depth", sceneTextureDesc(GL_DEPTH_COMPONENT32F))
+        };
+        writes = {{targets->color, ResourceAccess::ATTACHMENT}, {targets->depth, ResourceAccess::ATTACHMENT}};
+    }
+    writes.push_back({resources.meshUsage, ResourceAccess::STORAGE});
+
+    std::vector<ResourceUse> reads = drawReads(resources);
+    reads.push_back({resources.shadowMap, ResourceAccess::TEXTURE});
+    reads.push_back({resources.lightClusters.clusters, ResourceAccess::STORAGE});
+    reads.push_back({resources.lightClusters.indices, ResourceAccess::STORAGE});
+    m_graph.addPass({
+        .name = "Main pass",
+        .reads = std::move(reads),
+        .writes = std::move(writes),
+        .execute = [this, targets, lightClusters = resources.lightClusters](RenderGraph& graph) {
+            GLuint framebuffer = targetFramebuffer();
+            if (targets) {
+                framebuffer = m_sceneFramebuffer;
+                glNamedFramebufferTexture(framebuffer, GL_COLOR_ATTACHMENT0, graph.texture(targets->color)->name(), 0);
+                glNamedFramebufferTexture(framebuffer, GL_DEPTH_ATTACHMENT, graph.texture(targets->depth)->name(), 0);
+            }
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+            glViewport(0, 0, m_sceneDims.x, m_sceneDims.y);
+            Pipeline* pipeline = m_mainPass.variant(shadingFeatures(m_mainPass));
+            pipeline->bind();
+            bindShadingTextures();
+            const GLuint program = pipeline->program(PipelineStage::FRAGMENT);
+            glProgramUniform1ui(program, MESH_USAGE_FRAME_LOCATION, m_scene.m_textureResidency.frame());
+            m_scene.m_localLights.bindClusters(graph, lightClusters);
+            RingBuffer::bindRange(m_frameData.push(m_camera.m_matrices), BufferUsage::UNIFORM, VIEW_PROJ_BINDING);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            glMultiDrawElementsIndirectCount(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, 0, MAX_DRAWS, 0);
+        },
+        .sideEffects = not targets
+    });
+
+    if (targets) addUpscalePass(*targets);
+}
+
+//------------------------------------------------------------------------
+
+// The visibility pass only rasterizes which triangle of which draw covers a pixel, and the resolve refetches that
+// triangle to shade the pixel, so that textures are only sampled once per pixel regardless of the overdraw.
+void Renderer::addVisibilityPasses(const SceneResources& resources)
+{
+    const GraphResource vertices = m_graph.importBuffer("Vertices", buffer(m_scene.m_vertexBuffer));
+    const GraphResource indices = m_graph.importBuffer("Indices", buffer(m_scene.m_indexBuffer));
+    const GraphResource visibility = m_graph.createTexture("Visibility", sceneTextureDesc(GL_R32UI));
+    const SceneTargets targets{
+        .color = m_graph.createTexture("Resolved color", sceneTextureDesc(GL_RGBA8)),
+        .depth = m_graph.createTexture("Visibility depth", sceneTextureDesc(GL_DEPTH_COMPONENT32F))
+    };
+
+    m_graph.addPass({
+        .name = "Visibility pass",
+        .reads = drawReads(resources),
+        .writes = {{visibility, ResourceAccess::ATTACHMENT}, {targets.depth, ResourceAccess::ATTACHMENT}},
+        .execute = [this, visibility, depth = targets.depth](RenderGraph& graph) {
+            const GLuint framebuffer = m_visibilityFramebuffer;
+            glNamedFramebufferTexture(framebuffer, GL_COLOR_ATTACHMENT0, graph.texture(visibility)->name(), 0);
+            glNamedFramebufferTexture(framebuffer, GL_DEPTH_ATTACHMENT, graph.texture(depth)->name(), 0);
+            static constexpr GLuint empty[] = { VISIBILITY_EMPTY, 0, 0, 0 };
+            static constexpr GLfloat far = 1.0f;
+            glClearNamedFramebufferuiv(framebuffer, GL_COLOR, 0, empty);
+            glClearNamedFramebufferfv(framebuffer, GL_DEPTH, 0, &far);
+
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+            glViewport(0, 0, m_sceneDims.x, m_sceneDims.y);
+            m_mngr->get(m_visibilityPipeline)->bind();
+            RingBuffer::bindRange(m_frameData.push(m_camera.m_matrices), BufferUsage::UNIFORM, VIEW_PROJ_BINDING);
+            glMultiDrawElementsIndirectCount(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, 0, MAX_DRAWS, 0);
+        }
+    });
+    m_graph.addPass({
+        .name = "Visibility resolve",
+        .reads = {
+            {visibility, ResourceAccess::IMAGE},
+            {resources.commands, ResourceAccess::STORAGE},
+            {resources.metadata, ResourceAccess::STORAGE},
+            {vertices, ResourceAccess::STORAGE},
+            {indices, ResourceAccess::STORAGE},
+            {resources.shadowMap, ResourceAccess::TEXTURE},
+            {resources.lightClusters.clusters, ResourceAccess::STORAGE},
+            {resources.lightClusters.indices, ResourceAccess::STORAGE}
+        },
+        .writes = {{targets.color, ResourceAccess::IMAGE}, {resources.meshUsage, ResourceAccess::STORAGE}},
+        .execute = [this, visibility, targets, lightClusters = resources.lightClusters](RenderGraph& graph) {
+            Pipeline* pipeline = m_visibilityResolve.variant(shadingFeatures(m_visibilityResolve));
+            pipeline->bind();
+            bindShadingTextures();
+            m_scene.m_localLights.bindClusters(graph, lightClusters);
+            buffer(m_scene.m_vertexBuffer)->bindBaseAs(VERTEX_BINDING, BufferUsage::STORAGE);
+            buffer(m_scene.m_indexBuffer)->bindBaseAs(INDEX_BINDING, BufferUsage::STORAGE);
+            glBindImageTexture(0, graph.texture(visibility)->name(), 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32UI);
+            glBindImageTexture(1, graph.texture(targets.color)->name(), 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+
+            // Pixels no triangle covers get the clear color, just like in the forward path. Only the scaled viewport
+            // is resolved, which is smaller than the images when the resolution is scaled down.
+            GLfloat clearColor[4];
+            glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+            const GLuint program = pipeline->program(PipelineStage::COMPUTE);
+            glProgramUniform4fv(program, 0, 1, clearColor);
+            glProgramUniform2i(program, 1, m_sceneDims.x, m_sceneDims.y);
+            glProgramUniform1ui(program, MESH_USAGE_FRAME_LOCATION, m_scene.m_textureResidency.frame());
+
+            RingBuffer::bindRange(m_frameData.push(m_camera.m_matrices), BufferUsage::UNIFORM, VIEW_PROJ_BINDING);
+            glDispatchCompute(
+                util::divup(m_sceneDims.x, VISIBILITY_RESOLVE_LOCAL_SIZE),
+                util::divup(m_sceneDims.y, VISIBILITY_RESOLVE_LOCAL_SIZE),
+                1
+            );
+        }
+    });
+
+    addUpscalePass(targets);
+}
+
+//------------------------------------------------------------------------
+
+// The IDs of every draw and triangle have to fit a texel without aliasing. Bindless handles read from a pixel's draw
+// are not dynamically uniform either, which sampling them requires unless NV_gpu_shader5 is there, or the resolve can
+// make them uniform with ARB_shader_ballot.
+bool Renderer::supportsVisibilityBuffer()
+{
+    if (const size_t numMeshes = m_scene.numMeshes(); numMeshes > VISIBILITY_MAX_DRAWS) {
+        fmt::println("Visibility buffer holds at most {} draws, not {}, rendering forward", VISIBILITY_MAX_DRAWS,
+            numMeshes);
+        return false;
+    }
+    if (m_scene.m_maxMeshTriangles > VISIBILITY_MAX_TRIANGLES) {
+        fmt::println("Visibility buffer holds at most {} triangles per draw, not {}, rendering forward",
+            VISIBILITY_MAX_TRIANGLES, m_scene.m_maxMeshTriangles);
+        return false;
+    }
+    if (Texture::s_useBindless and not GLEW_NV_gpu_shader5 and not GLEW_ARB_shader_ballot) {
+        fmt::println("Visibility buffer needs NV_gpu_shader5 or ARB_shader_ballot with bindless textures, "
+            "rendering forward");
+        return false;
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------
+
+// Stretches the scaled viewport over the whole target framebuffer, bilinearly for color. Depth can only be blitted
+// between equal formats, which the default framebuffer need not have, and never with linear filtering.
+void Renderer::addUpscalePass(const SceneTargets& targets)
+{
+    m_graph.addPass({
+        .name = "Upscale",
+        .reads = {{targets.color, ResourceAccess::ATTACHMENT}, {targets.depth, ResourceAccess::ATTACHMENT}},
+        .execute = [this, targets](RenderGraph& graph) {
+            const GLuint framebuffer = m_sceneFramebuffer;
+            glNamedFramebufferTexture(framebuffer, GL_COLOR_ATTACHMENT0, graph.texture(targets.color)->name(), 0);
+            glNamedFramebufferTexture(framebuffer, GL_DEPTH_ATTACHMENT, graph.texture(targets.depth)->name(), 0);
+
+            const GLenum filter = m_sceneDims == s_windowDims ? GL_NEAREST : GL_LINEAR;
+            glBlitNamedFramebuffer(framebuffer, targetFramebuffer(), 0, 0, m_sceneDims.x, m_sceneDims.y,
+                0, 0, s_windowDims.x, s_windowDims.y, GL_COLOR_BUFFER_BIT, filter);
+            if (m_offscreenFramebuffer.isValid()) {
+                glBlitNamedFramebuffer(framebuffer, targetFramebuffer(), 0, 0, m_sceneDims.x, m_sceneDims.y,
+                    0, 0, s_windowDims.x, s_windowDims.y, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+            }
+        },
+        .sideEffects = true
+    });
+}
+
+//------------------------------------------------------------------------
+
+std::vector<ResourceUse> Renderer::drawReads(const SceneResources& resources)
+{
+    return {
+        {resources.commands, ResourceAccess::INDIRECT},
+        {resources.drawCount, ResourceAccess::INDIRECT},
+        {resources.metadata, ResourceAccess::STORAGE}
+    };
+}
+
+//------------------------------------------------------------------------
+
+// Every draw shares one bucket for now, as the scene has no per-material features yet.
+FeatureMask Renderer::shadingFeatures(PipelineVariants& variants)
+{
+    return shadowFilter() == ShadowFilter::EVSM ? variants.feature("USE_EVSM") : 0;
+}
+
+//------------------------------------------------------------------------
+
+// Both shadow filters of the active render path, so that switching between them never waits for a compile.
+void Renderer::prefetchShading()
+{
+    PipelineVariants& variants = m_renderPath == RenderPath::VISIBILITY_BUFFER ? m_visibilityResolve : m_mainPass;
+    variants.prefetch(0);
+    variants.prefetch(variants.feature("USE_EVSM"));
+}
+
+//------------------------------------------------------------------------
+
+GLuint Renderer::targetFramebuffer()
+{
+    return m_offscreenFramebuffer.isValid() ? m_mngr->get(m_offscreenFramebuffer)->name() : 0;
+}
+
+//------------------------------------------------------------------------
+
+bool Renderer::dumpRenderGraph(const fs::path& path)
+{
+    std::ofstream file{path};
+    file << m_graph.dump();
+    if (not file) {
+        fmt::println("Error writing render graph to {}", path.string());
+        return false;
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------
+
+void Renderer::saveFrame(const fs::path& colorPath, const fs::path& depthPath)
+{
+    static constexpr GLsizei width = App::s_windowWidth;
+    static constexpr GLsizei height = App::s_windowHeight;
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, targetFramebuffer());
+
+    if (not colorPath.empty()) {
+        std::vector<uint8_t> color(4 * width * height);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, color.data());
+        stbi_flip_vertically_on_write(1);
+        if (stbi_write_png(colorPath.string().c_str(), width, height, 4, color.data(), 4 * width) == 0) {
+            fmt::println("Error writing color to {}", colorPath.string());
+        }
+    }
+
+    if (not depthPath.empty()) {
+        std::vector<float> depth(width * height);
+        glReadPixels(0, 0, width, height, GL_DEPTH_COMPONENT, GL_FLOAT, depth.data());
+
+        // Portable float map, which stores rows bottom to top just like GL; the negative scale means little-endian.
+        std::ofstream file{depthPath, std::ios::binary};
+        file << fmt::format("Pf\n{} {}\n-1.0\n", width, height);
+        file.write(std::bit_cast<const char*>(depth.data()), depth.size() * sizeof(float));
+        if (not file) {
+            fmt::println("Error writing depth to {}", depthPath.string());
+        }
+    }
+}
+
+//------------------------------------------------------------------------
+
+DepthRasterizerInput Renderer::rasterizerInput()
+{
+    Buffer* vertices = buffer(m_scene.m_vertexBuffer);
+    Buffer* indices = buffer(m_scene.m_indexBuffer);
+    Buffer* meshes = buffer(m_scene.m_meshBuffer);
+
+    return {
+        .vertices = {vertices->ptr<Vertex>(), vertices->size<Vertex>()},
+        .indices = {indices->ptr<GLuint>(), indices->size<GLuint>()},
+        .meshes = {meshes->ptr<Mesh>(), meshes->size<Mesh>()}
+    };
+}
+
+//------------------------------------------------------------------------
+
+DepthComparison Renderer::validateSoftwareShadowMap()
+{
+    DirectionalLight& sun = m_scene.m_sunLight;
+    DepthRasterizer rasterizer{{.dims = sun.shadowMapDims()}};
+    rasterizer.rasterize(rasterizerInput(), sun.matrices());
+    return rasterizer.compare(sun.readShadowMap());
 }
 
 //------------------------------------------------------------------------
@@ -84,7 +612,8 @@ void Renderer::setupBuffers(const RendererDescriptor& desc)
         .bindings = { BufferUsage::INDIRECT },
         .indexedBindings = {
             {.target = BufferUsage::STORAGE, .index = INDIRECT_BINDING}
-        }
+        },
+        .tag = s_memoryTag
     });
 
     m_drawMetadataBuffer = m_mngr->createBuffer({
@@ -92,7 +621,8 @@ void Renderer::setupBuffers(const RendererDescriptor& desc)
         .usage = BufferUsage::STORAGE,
         .indexedBindings = {
             {.target = BufferUsage::STORAGE, .index = DRAW_METADATA_BINDING}
-        }
+        },
+        .tag = s_memoryTag
     });
 
     m_atomicDrawCounterBuffer = m_mngr->createBuffer({
@@ -101,15 +631,8 @@ void Renderer::setupBuffers(const RendererDescriptor& desc)
         .bindings = { BufferUsage::PARAMETER },
         .indexedBindings = {
             {.target = BufferUsage::ATOMIC_COUNTER, .index = ATOMIC_COUNTER_BINDING}
-        }
-    });
-
-    m_viewProjUniformBuffer = m_mngr->createBuffer({
-        .byteSize = sizeof(ViewProjMatrices),
-        .usage = BufferUsage::UNIFORM,
-        .indexedBindings = {
-            {.target = BufferUsage::UNIFORM, .index = VIEW_PROJ_BINDING}
-        }
+        },
+        .tag = s_memoryTag
     });
 }
 
@@ -117,23 +640,39 @@ void Renderer::setupBuffers(const RendererDescriptor& desc)
 
 void Renderer::setupCamera(CameraDescriptor cameraDesc)
 {
-    cameraDesc.uniformBuffer = m_viewProjUniformBuffer;
     m_camera = Camera(cameraDesc);
 }
 
+
 //------------------------------------------------------------------------
 
-void Renderer::setupPipeline(PipelineDescriptor mainPassDesc)
+void Renderer::setupOffscreenFramebuffer()
 {
-    mainPassDesc.managed = true;
-    m_pipeline = m_mngr->createPipeline(mainPassDesc);
-    pipeline()->bind();
+    m_offscreenFramebuffer = m_mngr->createFramebuffer({
+        .textureDesc = {
+            .dims = {App::s_windowWidth, App::s_windowHeight},
+            .levels = 1,
+            .internalFormat = GL_RGBA8,
+            .sampler = s_nearestSampler,
+            .tag = s_memoryTag
+        },
+        .attachment = GL_COLOR_ATTACHMENT0,
+        .mngr = m_mngr,
+        .depthTextureDesc = TextureDescriptor{
+            .dims = {App::s_windowWidth, App::s_windowHeight},
+            .levels = 1,
+            .internalFormat = GL_DEPTH_COMPONENT32F,
+            .sampler = s_nearestSampler,
+            .tag = s_memoryTag
+        }
+    });
 }
 
 //------------------------------------------------------------------------
 
 void Renderer::populateBuffers()
 {
+    m_mngr->get(m_populateBuffersPipeline)->bind();
     const size_t numMeshes = buffer(m_scene.m_meshBuffer)->size<Mesh>();
     glDispatchCompute(util::divup(numMeshes, WORK_GROUP_LOCAL_SIZE_X), 1, 1);
 }
@@ -149,6 +688,16 @@ void Renderer::clearDrawCounter()
 
 //------------------------------------------------------------------------
 
+void Renderer::bindShadingTextures()
+{
+    if (Texture::s_useBindless) return;
+
+    m_scene.m_textureArrays.bind();
+    m_scene.m_sunLight.bindShadowTextures();
+}
+
+//------------------------------------------------------------------------
+
 }  // namespace Zhade
 
 //------------------------------------------------------------------------
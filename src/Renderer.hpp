@@ -2,10 +2,18 @@
 
 #include "Buffer.hpp"
 #include "Camera.hpp"
+#include "DepthRasterizer.hpp"
+#include "DynamicResolution.hpp"
+#include "FramePacer.hpp"
 #include "Handle.hpp"
 #include "Pipeline.hpp"
+#include "PipelineVariants.hpp"
+#include "Profiler.hpp"
+#include "RenderGraph.hpp"
 #include "ResourceManager.hpp"
+#include "RingBuffer.hpp"
 #include "Scene.hpp"
+#include "Simulation.hpp"
 
 //------------------------------------------------------------------------
 
@@ -14,12 +22,43 @@ namespace Zhade
 
 //------------------------------------------------------------------------
 
+namespace RenderPath
+{
+    using Type = uint8_t;
+    enum : Type
+    {
+        FORWARD,
+        VISIBILITY_BUFFER,  // Rasterizes draw and triangle IDs only, and shades every pixel once in a compute resolve.
+        NUM_RENDER_PATHS
+    };
+}
+
+inline constexpr const char* RenderPath2Name[] {
+    "Forward",
+    "Visibility buffer"
+};
+
 struct RendererDescriptor
 {
     ResourceManager* mngr;
     SceneDescriptor sceneDesc;
     CameraDescriptor cameraDesc;
+    PipelineDescriptor populateBuffersDesc;
     PipelineDescriptor mainPassDesc;
+    PipelineDescriptor visibilityPassDesc;
+    PipelineDescriptor visibilityResolveDesc;
+    DynamicResolutionDescriptor dynamicResolutionDesc;
+    RenderPath::Type renderPath = RenderPath::FORWARD;
+    uint32_t maxFramesInFlight = FRAMES_IN_FLIGHT;
+    Simulation* simulation = nullptr;  // If set, the camera follows its newest pose instead of being updated directly.
+    bool offscreen = false;  // Renders into an owned framebuffer instead of the default one, e.g. when headless.
+
+    // The sponza setup shared by the interactive app and the benchmarks.
+    [[nodiscard]] static RendererDescriptor makeDefault(ResourceManager* mngr, App* app, bool offscreen);
+
+    static constexpr std::string_view s_shadingHeaders[] {"/common_defs.h", "/lightClusters.glsl", "/shading.glsl"};
+    static constexpr std::string_view s_lightBinningHeaders[] {"/common_defs.h", "/lightClusters.glsl"};
+    static constexpr std::string_view s_shadingFeatures[] {"USE_EVSM"};
 };
 
 //------------------------------------------------------------------------
@@ -32,19 +71,68 @@ public:
 
     [[nodiscard]] Camera<CameraType::PERSPECTIVE>& camera() { return m_camera; }
     [[nodiscard]] Scene& scene() { return m_scene; }
+    [[nodiscard]] Profiler& profiler() { return m_profiler; }
+    [[nodiscard]] RenderGraph& renderGraph() { return m_graph; }
+    [[nodiscard]] DynamicResolution& dynamicResolution() { return m_dynamicResolution; }
+    [[nodiscard]] FramePacer& framePacer() { return m_framePacer; }
+    [[nodiscard]] ResourceManager& resourceManager() { return *m_mngr; }
+    [[nodiscard]] ShadowFilter::Type shadowFilter() { return m_scene.m_sunLight.shadowFilter(); }
+    [[nodiscard]] RenderPath::Type renderPath() { return m_renderPath; }
 
+    void setShadowFilter(ShadowFilter::Type filter) { m_scene.m_sunLight.setShadowFilter(filter); }
+    void setRenderPath(RenderPath::Type path);
+
+    // Called by render() anyway, but calling it before polling input keeps the input the frame shows fresher.
+    void waitForFrameSlot() { m_framePacer.waitForFrameSlot(); }
     void render();
 
+    [[nodiscard]] GLuint targetFramebuffer();
+    void saveFrame(const fs::path& colorPath, const fs::path& depthPath);
+
+    // Writes the render graph of the last frame in the Graphviz DOT language.
+    bool dumpRenderGraph(const fs::path& path);
+
+    [[nodiscard]] DepthRasterizerInput rasterizerInput();
+    [[nodiscard]] DepthComparison validateSoftwareShadowMap();
+
 private:
+    // What the passes drawing the scene read, imported into the render graph of the frame.
+    struct SceneResources
+    {
+        GraphResource commands;
+        GraphResource metadata;
+        GraphResource drawCount;
+        GraphResource shadowMap;
+        GraphResource meshUsage;  // Written by the shading passes.
+        LightClusterResources lightClusters;
+    };
+
+    // What the scene was rendered into when not directly into the target framebuffer.
+    struct SceneTargets
+    {
+        GraphResource color;
+        GraphResource depth;
+    };
+
     [[nodiscard]] Buffer* buffer(const Handle<Buffer>& handle) { return m_mngr->get(handle); }
-    [[nodiscard]] Pipeline* pipeline() { return m_mngr->get(m_pipeline); }
+    [[nodiscard]] FeatureMask shadingFeatures(PipelineVariants& variants);
+    [[nodiscard]] std::vector<ResourceUse> drawReads(const SceneResources& resources);
 
     void setupVAO();
     void setupBuffers(const RendererDescriptor& desc);
     void setupCamera(CameraDescriptor cameraDesc);
-    void setupPipeline(PipelineDescriptor mainPassDesc);
+    void setupOffscreenFramebuffer();
+    void prefetchShading();
+    void buildRenderGraph();
+    void addForwardPass(const SceneResources& resources);
+    void addVisibilityPasses(const SceneResources& resources);
+    [[nodiscard]] bool supportsVisibilityBuffer();  // Tells why not if it does not.
+    void addUpscalePass(const SceneTargets& targets);
+    void updateDynamicResolution();
+    [[nodiscard]] FramePacer::Clock::time_point latchCamera();
     void populateBuffers();
     void clearDrawCounter();
+    void bindShadingTextures();  // Only without bindless textures.
 
     ResourceManager* m_mngr;
     Scene m_scene;
@@ -53,8 +141,23 @@ private:
     Handle<Buffer> m_commandBuffer;
     Handle<Buffer> m_drawMetadataBuffer;
     Handle<Buffer> m_atomicDrawCounterBuffer;
-    Handle<Buffer> m_viewProjUniformBuffer;
-    Handle<Pipeline> m_pipeline;
+    Handle<Pipeline> m_populateBuffersPipeline;
+    Handle<Pipeline> m_visibilityPipeline;
+    PipelineVariants m_mainPass;
+    PipelineVariants m_visibilityResolve;
+    Handle<Framebuffer> m_offscreenFramebuffer{};
+    GLuint m_visibilityFramebuffer;  // Both only hold the render graph's textures of the current frame.
+    GLuint m_sceneFramebuffer;
+    RenderPath::Type m_renderPath;
+    DynamicResolution m_dynamicResolution;
+    glm::ivec2 m_sceneDims;  // Of the current frame.
+    size_t m_numFrameTimesSeen = 0;
+    RingBuffer m_frameData;
+    RingBuffer m_lightData;
+    Profiler m_profiler;
+    FramePacer m_framePacer;
+    Simulation* m_simulation;
+    RenderGraph m_graph;
 };
 
 //------------------------------------------------------------------------
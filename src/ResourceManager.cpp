@@ -1 +1,213 @@
-#include "ResourceManager.hpp"
\ No newline at end of file
+#include "ResourceManager.hpp"
+
+#include <algorithm>
+#include <fstream>
+
+//------------------------------------------------------------------------
+
+namespace Zhade
+{
+
+//------------------------------------------------------------------------
+
+ResourceManager::~ResourceManager()
+{
+    // From here on retire() frees right away, also for whatever the pools free while being destroyed.
+    m_deferDestruction = false;
+    if (m_retired.empty() and m_retiring.empty()) return;
+
+    glFinish();
+    for (RetiredBatch& batch : m_retired) {
+        glDeleteSync(batch.fence);
+        for (const auto& release : batch.frees) release();
+    }
+    for (const auto& release : m_retiring) release();
+}
+
+//------------------------------------------------------------------------
+
+void ResourceManager::finalizePending()
+{
+    // Swapped out under the lock so that loader threads can keep queueing while the GL calls run. Textures go first,
+    // as callbacks of the others may refer to them.
+    decltype(m_pendingBuffers) buffers;
+    decltype(m_pendingFramebuffers) framebuffers;
+    decltype(m_pendingPipelines) pipelines;
+    decltype(m_pendingTextures) textures;
+    {
+        const std::scoped_lock lock{m_pendingMutex};
+        std::swap(buffers, m_pendingBuffers);
+        std::swap(framebuffers, m_pendingFramebuffers);
+        std::swap(pipelines, m_pendingPipelines);
+        std::swap(textures, m_pendingTextures);
+    }
+
+    finalize(m_textures, textures);
+    finalize(m_buffers, buffers);
+    finalize(m_framebuffers, framebuffers);
+    finalize(m_pipelines, pipelines);
+}
+
+//------------------------------------------------------------------------
+
+void ResourceManager::replaceTexture(const Handle<Texture>& handle, TextureDescriptor desc, const ReplaceCallback& fill)
+{
+    Texture* texture = m_textures.get(handle);
+    if (texture == nullptr) return;
+
+    // Copies hold the GL names, as in retire(), and managed ones free nothing when they go out of scope.
+    desc.tag = internTag(desc.tag);
+    desc.managed = true;
+    Texture original = *texture;
+    const Texture replacement{desc};
+    *texture = replacement;
+    trackMemory(*texture, true);
+    if (fill) fill(*texture, original);
+
+    if (not m_deferDestruction) {
+        trackMemory(original, false);
+        original.freeResources();
+        return;
+    }
+    const std::scoped_lock lock{m_retiredMutex};
+    m_retiring.emplace_back([this, original]() mutable {
+        trackMemory(original, false);
+        original.freeResources();
+    });
+}
+
+//------------------------------------------------------------------------
+
+void ResourceManager::endFrame()
+{
+    // Fences signal in submission order, so polling stops at the first batch still in flight. Freeing may destroy
+    // further objects, e.g. a framebuffer's textures, which go into the batch fenced below.
+    while (not m_retired.empty()) {
+        RetiredBatch& batch = m_retired.front();
+        const GLenum status = glClientWaitSync(batch.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if (status == GL_WAIT_FAILED) [[unlikely]] {
+            fmt::println("Waiting for a deferred destruction fence failed");
+            break;
+        }
+        if (status == GL_TIMEOUT_EXPIRED) break;
+
+        glDeleteSync(batch.fence);
+        const std::vector<std::function<void()>> frees = std::move(batch.frees);
+        m_retired.pop_front();
+        for (const auto& release : frees) release();
+    }
+
+    std::vector<std::function<void()>> retiring;
+    {
+        const std::scoped_lock lock{m_retiredMutex};
+        std::swap(retiring, m_retiring);
+    }
+    if (not retiring.empty()) {
+        m_retired.push_back({
+            .fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0),
+            .frees = std::move(retiring)
+        });
+    }
+}
+
+//------------------------------------------------------------------------
+
+// Buffer usage is only known to the buffers themselves, so it is gathered here rather than tracked. Buffers awaiting
+// deferred destruction are no longer alive and count as unused.
+MemoryReport ResourceManager::memoryReport()
+{
+    robin_hood::unordered_map<std::string_view, size_t> usedBufferBytes;
+    for (Buffer& buffer : m_buffers.alive()) {
+        usedBufferBytes[buffer.tag()] += buffer.usedByteSize();
+    }
+
+    MemoryReport report;
+    {
+        const std::scoped_lock lock{m_memoryMutex};
+        for (const auto& [tag, usage] : m_memoryPerTag) {
+            if (usage[MemoryType::BUFFER].numResources == 0 and usage[MemoryType::TEXTURE].numResources == 0) continue;
+            report.perTag.push_back({.tag = tag, .usage = usage});
+        }
+    }
+
+    for (TaggedMemoryUsage& tagged : report.perTag) {
+        const auto used = usedBufferBytes.find(tagged.tag);
+        tagged.usage[MemoryType::BUFFER].usedByteSize = used == usedBufferBytes.end() ? 0 : used->second;
+        for (MemoryType::Type type = 0; type < MemoryType::NUM_MEMORY_TYPES; ++type) {
+            report.total[type].numResources += tagged.usage[type].numResources;
+            report.total[type].byteSize += tagged.usage[type].byteSize;
+            report.total[type].usedByteSize += tagged.usage[type].usedByteSize;
+        }
+    }
+    stdr::sort(report.perTag, stdr::greater{}, [](const TaggedMemoryUsage& tagged) {
+        return tagged.usage[MemoryType::BUFFER].byteSize + tagged.usage[MemoryType::TEXTURE].byteSize;
+    });
+
+    return report;
+}
+
+//------------------------------------------------------------------------
+
+bool ResourceManager::dumpMemoryReport(const fs::path& path)
+{
+    const auto usageJSON = [](const MemoryUsagePerType& usage) {
+        std::string json;
+        for (MemoryType::Type type = 0; type < MemoryType::NUM_MEMORY_TYPES; ++type) {
+            const auto& [numResources, byteSize, usedByteSize] = usage[type];
+            json += fmt::format(R"({}"{}":{{"count":{},"bytes":{},"usedBytes":{},"wastedBytes":{}}})",
+                json.empty() ? "" : ",", MemoryType2Name[type], numResources, byteSize, usedByteSize,
+                byteSize - usedByteSize);
+        }
+        return json;
+    };
+
+    const MemoryReport report = memoryReport();
+    std::string tags;
+    for (const auto& [tag, usage] : report.perTag) {
+        tags += fmt::format("{}\n    {{\"tag\":\"{}\",{}}}", tags.empty() ? "" : ",", tag, usageJSON(usage));
+    }
+
+    std::ofstream file{path};
+    file << fmt::format("{{\n  \"total\":{{{}}},\n  \"tags\":[{}\n  ]\n}}\n", usageJSON(report.total), tags);
+    if (not file) {
+        fmt::println("Error writing memory report to {}", path.string());
+        return false;
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------
+
+std::string_view ResourceManager::internTag(std::string_view tag)
+{
+    if (tag.empty()) tag = "Untagged";
+
+    const std::scoped_lock lock{m_memoryMutex};
+    if (const auto it = m_memoryPerTag.find(tag); it != m_memoryPerTag.end()) return it->first;
+    const std::string_view interned = m_tags.emplace_back(tag);
+    m_memoryPerTag.emplace(interned, MemoryUsagePerType{});
+    return interned;
+}
+
+//------------------------------------------------------------------------
+
+void ResourceManager::trackMemory(MemoryType::Type type, std::string_view tag, size_t byteSize, bool created)
+{
+    const std::scoped_lock lock{m_memoryMutex};
+    MemoryUsage& usage = m_memoryPerTag[tag][type];
+    if (created) {
+        ++usage.numResources;
+        usage.byteSize += byteSize;
+    } else {
+        --usage.numResources;
+        usage.byteSize -= byteSize;
+    }
+    // Textures are entirely in use by definition, buffers are only looked at in memoryReport().
+    if (type == MemoryType::TEXTURE) usage.usedByteSize = usage.byteSize;
+}
+
+//------------------------------------------------------------------------
+
+}  // namespace Zhade
+
+//------------------------------------------------------------------------
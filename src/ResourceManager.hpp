@@ -8,6 +8,16 @@
 #include "Pipeline.hpp"
 #include "Texture.hpp"
 
+#include <robin_hood.h>
+
+#include <array>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
 //------------------------------------------------------------------------
 
 namespace Zhade
@@ -24,14 +34,69 @@ concept ManagedType = (
     or std::same_as<T, Texture>
 );
 
+// Runs on the GL thread right after a pending object has been constructed, e.g. to upload its data.
+template<typename T>
+using PendingCallback = std::function<void(T&)>;
+
+// Fills the storage replacing that of a texture, e.g. from the original's levels, before the original is freed.
+using ReplaceCallback = std::function<void(Texture& replacement, Texture& original)>;
+
+namespace MemoryType
+{
+    using Type = uint8_t;
+    enum : Type
+    {
+        BUFFER,
+        TEXTURE,
+        NUM_MEMORY_TYPES
+    };
+}
+
+inline constexpr const char* MemoryType2Name[] {
+    "Buffers",
+    "Textures"
+};
+
+struct MemoryUsage
+{
+    size_t numResources = 0;
+    size_t byteSize = 0;      // Allocated, including all mip levels.
+    size_t usedByteSize = 0;  // What appended-to buffers leave unused is the difference.
+};
+
+using MemoryUsagePerType = std::array<MemoryUsage, MemoryType::NUM_MEMORY_TYPES>;
+
+struct TaggedMemoryUsage
+{
+    std::string_view tag;
+    MemoryUsagePerType usage;
+};
+
+struct MemoryReport
+{
+    MemoryUsagePerType total{};
+    std::vector<TaggedMemoryUsage> perTag;  // Largest first.
+};
+
 //------------------------------------------------------------------------
 // Inspired by: https://twitter.com/SebAaltonen/status/1535175559067713536.
+// Everything but finalizePending() and destruction is thread-safe. The manager is constructed on the GL thread, which
+// thereby owns its pools and takes their lock-free paths. Objects whose constructors make GL calls can only be created
+// directly on the GL thread; other threads create them pending, i.e. get a handle right away that resolves once the GL
+// thread has run finalizePending(). Destroying a pending object cancels its creation. Models make no GL calls and can
+// be created anywhere.
+//
+// Destroying an object invalidates its handle right away, but its GL resources are only freed by the endFrame() that
+// finds the fence of the frame it was destroyed in signaled, as earlier frames may still be reading them.
+//
+// Buffers and textures are accounted to the tag of their descriptor from construction until their resources are
+// freed, so that memory awaiting deferred destruction still counts.
 
 class ResourceManager
 {
 public:
     ResourceManager() = default;
-    ~ResourceManager() = default;
+    ~ResourceManager();
 
     ResourceManager(const ResourceManager&) = delete;
     ResourceManager& operator=(const ResourceManager&) = delete;
@@ -40,7 +105,10 @@ public:
 
     [[nodiscard]] Handle<Buffer> createBuffer(BufferDescriptor desc)
     {
-        return m_buffers.allocate(desc);
+        desc.tag = internTag(desc.tag);
+        const Handle<Buffer> handle = m_buffers.allocate(desc);
+        trackMemory(*m_buffers.get(handle), true);
+        return handle;
     }
     
     [[nodiscard]] Handle<Framebuffer> createFramebuffer(FramebufferDescriptor desc)
@@ -60,7 +128,54 @@ public:
     
     [[nodiscard]] Handle<Texture> createTexture(TextureDescriptor desc)
     {
-        return m_textures.allocate(desc);
+        desc.tag = internTag(desc.tag);
+        const Handle<Texture> handle = m_textures.allocate(desc);
+        trackMemory(*m_textures.get(handle), true);
+        return handle;
+    }
+
+    // Tags are copied, so that they may be built on the fly, e.g. from a model's path.
+    [[nodiscard]] Handle<Buffer> createPendingBuffer(BufferDescriptor desc, PendingCallback<Buffer> onCreated = {})
+    {
+        desc.tag = internTag(desc.tag);
+        return enqueuePending(m_buffers, m_pendingBuffers, std::move(desc), std::move(onCreated));
+    }
+
+    [[nodiscard]] Handle<Framebuffer> createPendingFramebuffer(FramebufferDescriptor desc,
+        PendingCallback<Framebuffer> onCreated = {})
+    {
+        desc.textureDesc.tag = internTag(desc.textureDesc.tag);
+        if (desc.depthTextureDesc) desc.depthTextureDesc->tag = internTag(desc.depthTextureDesc->tag);
+        return enqueuePending(m_framebuffers, m_pendingFramebuffers, std::move(desc), std::move(onCreated));
+    }
+
+    [[nodiscard]] Handle<Pipeline> createPendingPipeline(PipelineDescriptor desc,
+        PendingCallback<Pipeline> onCreated = {})
+    {
+        return enqueuePending(m_pipelines, m_pendingPipelines, std::move(desc), std::move(onCreated));
+    }
+
+    [[nodiscard]] Handle<Texture> createPendingTexture(TextureDescriptor desc, PendingCallback<Texture> onCreated = {})
+    {
+        desc.tag = internTag(desc.tag);
+        return enqueuePending(m_textures, m_pendingTextures, std::move(desc), std::move(onCreated));
+    }
+
+    // GL thread only. Swaps the storage of a texture for one made from desc, e.g. with fewer mip levels, so that its
+    // handle stays valid while bindless handles and GL names change. The original storage is freed like a destroyed
+    // texture's once the frames that may still sample it are done.
+    void replaceTexture(const Handle<Texture>& handle, TextureDescriptor desc, const ReplaceCallback& fill = {});
+
+    // GL thread only. Constructs everything created pending so far, in one batch per type.
+    void finalizePending();
+
+    // GL thread only. Resolves the pipelines that have finished compiling, without waiting for the others, which
+    // keep compiling in parallel to whatever else the GL thread does until they are bound.
+    void resolvePipelines()
+    {
+        for (Pipeline& pipeline : m_pipelines.alive()) {
+            if (pipeline.isReady()) pipeline.resolve();
+        }
     }
 
     template<ManagedType T>
@@ -82,29 +197,145 @@ public:
     void destroy(const Handle<T>& handle)
     {
         if constexpr (std::same_as<T, Buffer>)
-            m_buffers.deallocate(handle);
+            retire(m_buffers, handle);
         else if constexpr (std::same_as<T, Framebuffer>)
-            m_framebuffers.deallocate(handle);
+            retire(m_framebuffers, handle);
         else if constexpr (std::same_as<T, Model>)
             m_models.deallocate(handle);
         else if constexpr (std::same_as<T, Pipeline>)
-            m_pipelines.deallocate(handle);
+            retire(m_pipelines, handle);
         else if constexpr (std::same_as<T, Texture>)
-            m_textures.deallocate(handle);
+            retire(m_textures, handle);
     }
 
+    // GL thread only, as it reads how much of each buffer is in use.
+    [[nodiscard]] MemoryReport memoryReport();
+
+    // Writes memoryReport() as JSON.
+    bool dumpMemoryReport(const fs::path& path);
+
+    // GL thread only, once per frame after its last draw. Frees what the GPU has finished with, without waiting, and
+    // fences what was destroyed since the last call.
+    void endFrame();
+
     template<ManagedType T>
     bool exists(const Handle<T>& handle)
     {
         return get(handle) != nullptr;
     }
 
+    template<ManagedType T>
+    [[nodiscard]] bool isPending(const Handle<T>& handle)
+    {
+        if constexpr (std::same_as<T, Buffer>)
+            return m_buffers.isReserved(handle);
+        else if constexpr (std::same_as<T, Framebuffer>)
+            return m_framebuffers.isReserved(handle);
+        else if constexpr (std::same_as<T, Model>)
+            return m_models.isReserved(handle);
+        else if constexpr (std::same_as<T, Pipeline>)
+            return m_pipelines.isReserved(handle);
+        else if constexpr (std::same_as<T, Texture>)
+            return m_textures.isReserved(handle);
+    }
+
 private:
+    template<typename T, typename Descriptor>
+    struct PendingCreation
+    {
+        Handle<T> handle;
+        Descriptor desc;
+        PendingCallback<T> onCreated;
+    };
+
+    template<typename T, typename Descriptor>
+    [[nodiscard]] Handle<T> enqueuePending(ObjectPool<T>& pool, std::vector<PendingCreation<T, Descriptor>>& queue,
+        Descriptor desc, PendingCallback<T> onCreated)
+    {
+        const Handle<T> handle = pool.reserve();
+        const std::scoped_lock lock{m_pendingMutex};
+        queue.push_back({.handle = handle, .desc = std::move(desc), .onCreated = std::move(onCreated)});
+        return handle;
+    }
+
+    template<typename T, typename Descriptor>
+    void finalize(ObjectPool<T>& pool, std::vector<PendingCreation<T, Descriptor>>& queue)
+    {
+        for (auto& [handle, desc, onCreated] : queue) {
+            if (not pool.publish(handle, desc)) continue;
+            trackMemory(*pool.get(handle), true);
+            if (onCreated) onCreated(*pool.get(handle));
+        }
+    }
+
+    struct RetiredBatch
+    {
+        GLsync fence;
+        std::vector<std::function<void()>> frees;
+    };
+
+    // The object is copied out of its pool, which is cheap as managed objects only hold GL names, and the copy frees
+    // them later. Once the manager is being destroyed there is no later, so this frees right away.
+    template<typename T>
+    void retire(ObjectPool<T>& pool, const Handle<T>& handle)
+    {
+        if (not m_deferDestruction) {
+            pool.deallocate(handle, [this](T& item) {
+                trackMemory(item, false);
+                item.freeResources();
+            });
+            return;
+        }
+        pool.deallocate(handle, [this](T& item) {
+            const std::scoped_lock lock{m_retiredMutex};
+            m_retiring.emplace_back([this, item]() mutable {
+                trackMemory(item, false);
+                item.freeResources();
+            });
+        });
+    }
+
+    // Returns the stored copy of the tag, which stays valid as long as the manager.
+    [[nodiscard]] std::string_view internTag(std::string_view tag);
+
+    // Buffers and textures only, other types own no memory of their own.
+    template<typename T>
+    void trackMemory(T& item, bool created)
+    {
+        if constexpr (std::same_as<T, Buffer>)
+            trackMemory(MemoryType::BUFFER, item.tag(), item.wholeByteSize(), created);
+        else if constexpr (std::same_as<T, Texture>)
+            trackMemory(MemoryType::TEXTURE, item.tag(), item.byteSize(), created);
+    }
+
+    void trackMemory(MemoryType::Type type, std::string_view tag, size_t byteSize, bool created);
+
+    // Keyed by the interned tags, which the deque keeps in place. Declared before the pools, as objects refer to the
+    // tags, and destroying them may still untrack memory.
+    std::mutex m_memoryMutex;
+    std::deque<std::string> m_tags;
+    robin_hood::unordered_map<std::string_view, MemoryUsagePerType> m_memoryPerTag;
+
+    // Read by retire(), also while the pools below are destroyed, so it has to outlive them.
+    bool m_deferDestruction = true;
+
+    // Pools free whatever is still alive when destroyed, and framebuffers and models destroy their textures, so the
+    // texture pool has to be declared first.
+    ObjectPool<Texture> m_textures;
     ObjectPool<Buffer> m_buffers;
     ObjectPool<Framebuffer> m_framebuffers;
     ObjectPool<Model> m_models;
     ObjectPool<Pipeline> m_pipelines;
-    ObjectPool<Texture> m_textures;
+
+    std::mutex m_pendingMutex;
+    std::vector<PendingCreation<Buffer, BufferDescriptor>> m_pendingBuffers;
+    std::vector<PendingCreation<Framebuffer, FramebufferDescriptor>> m_pendingFramebuffers;
+    std::vector<PendingCreation<Pipeline, PipelineDescriptor>> m_pendingPipelines;
+    std::vector<PendingCreation<Texture, TextureDescriptor>> m_pendingTextures;
+
+    std::mutex m_retiredMutex;
+    std::vector<std::function<void()>> m_retiring;
+    std::deque<RetiredBatch> m_retired;
 };
 
 //------------------------------------------------------------------------
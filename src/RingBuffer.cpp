@@ -0,0 +1,91 @@
+#include "RingBuffer.hpp"
+
+#include <cstdlib>
+
+//------------------------------------------------------------------------
+
+namespace Zhade
+{
+
+//------------------------------------------------------------------------
+
+RingBuffer::RingBuffer(RingBufferDescriptor desc)
+    : m_mngr{desc.mngr},
+      m_alignment{BufferUsage2Alignment[desc.usage]}
+{
+    m_frameByteSize = util::roundup(desc.frameByteSize, m_alignment);
+    m_buffer = m_mngr->createBuffer({
+        .byteSize = implicit_cast<GLsizei>(FRAMES_IN_FLIGHT * m_frameByteSize),
+        .usage = desc.usage,
+        .tag = desc.tag
+    });
+}
+
+//------------------------------------------------------------------------
+
+RingBuffer::~RingBuffer()
+{
+    for (GLsync fence : m_fences) {
+        if (fence != nullptr) glDeleteSync(fence);
+    }
+    m_mngr->destroy(m_buffer);
+}
+
+//------------------------------------------------------------------------
+
+void RingBuffer::beginFrame()
+{
+    m_frameIdx = (m_frameIdx + 1) % FRAMES_IN_FLIGHT;
+    m_frameOffset = m_frameIdx * m_frameByteSize;
+    m_writeOffset = 0;
+
+    static constexpr GLuint64 waitNs = 1'000'000;
+
+    GLsync& fence = m_fences[m_frameIdx];
+    if (fence == nullptr) return;
+
+    // The first poll flushes, so that the fence can signal at all. Having to wait beyond it counts as a stall.
+    GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    if (status == GL_TIMEOUT_EXPIRED) ++m_numStalls;
+    while (status == GL_TIMEOUT_EXPIRED) {
+        status = glClientWaitSync(fence, 0, waitNs);
+    }
+    if (status == GL_WAIT_FAILED) [[unlikely]] {
+        fmt::println("Waiting for ring buffer region {} failed", m_frameIdx);
+    }
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+//------------------------------------------------------------------------
+
+void RingBuffer::endFrame()
+{
+    m_fences[m_frameIdx] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+//------------------------------------------------------------------------
+
+RingSlice RingBuffer::allocate(GLsizeiptr byteSize)
+{
+    if (m_writeOffset + byteSize > m_frameByteSize) [[unlikely]] {
+        fmt::println("Ring buffer region of {} bytes is full", m_frameByteSize);
+        std::abort();
+    }
+
+    Buffer* buffer = m_mngr->get(m_buffer);
+    const RingSlice slice{
+        .buffer = buffer->name(),
+        .offset = m_frameOffset + m_writeOffset,
+        .byteSize = byteSize,
+        .ptr = buffer->ptr<uint8_t>() + m_frameOffset + m_writeOffset
+    };
+    m_writeOffset += util::roundup(byteSize, m_alignment);
+    return slice;
+}
+
+//------------------------------------------------------------------------
+
+}  // namespace Zhade
+
+//------------------------------------------------------------------------
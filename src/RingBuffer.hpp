@@ -0,0 +1,88 @@
+#pragma once
+
+#include "Buffer.hpp"
+#include "Handle.hpp"
+#include "ResourceManager.hpp"
+#include "common.hpp"
+
+#include <array>
+#include <cstring>
+#include <string_view>
+
+//------------------------------------------------------------------------
+
+namespace Zhade
+{
+
+//------------------------------------------------------------------------
+
+struct RingBufferDescriptor
+{
+    ResourceManager* mngr;
+    GLsizeiptr frameByteSize = RING_BUFFER_FRAME_SIZE;
+    BufferUsage::Type usage = BufferUsage::UNIFORM;  // Only decides the alignment of the slices.
+    std::string_view tag{};
+};
+
+// A range of the ring written this frame, valid until the frame's fence has signaled.
+struct RingSlice
+{
+    GLuint buffer = 0;
+    GLintptr offset = 0;
+    GLsizeiptr byteSize = 0;
+    uint8_t* ptr = nullptr;
+};
+
+//------------------------------------------------------------------------
+// Per-frame data without implicit synchronization: one persistently mapped buffer split into FRAMES_IN_FLIGHT regions,
+// each guarded by the fence of the frame that last wrote it. A frame only waits if the GPU is a whole ring behind.
+
+class RingBuffer
+{
+public:
+    explicit RingBuffer(RingBufferDescriptor desc);
+    ~RingBuffer();
+
+    RingBuffer(const RingBuffer&) = delete;
+    RingBuffer& operator=(const RingBuffer&) = delete;
+    RingBuffer(RingBuffer&&) = delete;
+    RingBuffer& operator=(RingBuffer&&) = delete;
+
+    [[nodiscard]] size_t numStalls() { return m_numStalls; }
+
+    // Call once per frame before any allocation, and endFrame() after the frame's last use of its slices.
+    void beginFrame();
+    void endFrame();
+
+    [[nodiscard]] RingSlice allocate(GLsizeiptr byteSize);
+
+    template<typename T>
+    [[nodiscard]] RingSlice push(const T& data)
+    {
+        const RingSlice slice = allocate(sizeof(T));
+        std::memcpy(slice.ptr, &data, sizeof(T));
+        return slice;
+    }
+
+    static void bindRange(const RingSlice& slice, BufferUsage::Type target, GLuint index)
+    {
+        glBindBufferRange(BufferUsage2GLenum[target], index, slice.buffer, slice.offset, slice.byteSize);
+    }
+
+private:
+    ResourceManager* m_mngr;
+    Handle<Buffer> m_buffer;
+    std::array<GLsync, FRAMES_IN_FLIGHT> m_fences{};
+    GLsizeiptr m_frameByteSize;
+    GLsizeiptr m_alignment;
+    GLsizeiptr m_frameOffset = 0;
+    GLsizeiptr m_writeOffset = 0;
+    uint32_t m_frameIdx = 0;
+    size_t m_numStalls = 0;
+};
+
+//------------------------------------------------------------------------
+
+}  // namespace Zhade
+
+//------------------------------------------------------------------------
@@ -1,11 +1,17 @@
 #include "Scene.hpp"
 
+#include "GltfLoader.hpp"
+#include "ObjLoader.hpp"
+#include "VertexStreams.hpp"
+
 #include <assimp/Importer.hpp>
 
-#include <array>
+#include <algorithm>
+#include <bit>
 #include <future>
-#include <memory_resource>
 #include <span>
+#include <string>
+#include <utility>
 
 //------------------------------------------------------------------------
 
@@ -16,12 +22,28 @@ namespace Zhade
 
 Scene::Scene(SceneDescriptor desc)
     : m_sunLight{desc.sunLightDesc},
-      m_mngr{desc.mngr}
+      m_localLights{desc.localLightsDesc},
+      m_mngr{desc.mngr},
+      m_meshUsageReadback{{
+          .mngr = desc.mngr,
+          .frameByteSize = desc.meshUsageBufferDesc.byteSize,
+          .usage = BufferUsage::STORAGE,
+          .tag = "Scene"
+      }},
+      m_textureArrays{desc.mngr},
+      m_textureResidency{desc.textureResidencyDesc}
 {
     m_vertexBuffer = m_mngr->createBuffer(desc.vertexBufferDesc);
     m_indexBuffer = m_mngr->createBuffer(desc.indexBufferDesc);
     m_meshBuffer = m_mngr->createBuffer(desc.meshBufferDesc);
+    m_meshUsageBuffer = m_mngr->createBuffer(desc.meshUsageBufferDesc);
+    glClearNamedBufferData(buffer(m_meshUsageBuffer)->name(), GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
     m_defaultTexture = Texture::makeDefault(m_mngr);
+    m_textureResidency.setFallback(m_defaultTexture);
+    if (not Texture::s_useBindless) {
+        // First, so that it stands in for textures that fit no array.
+        (void)m_textureArrays.add(m_defaultTexture);
+    }
 }
 
 //------------------------------------------------------------------------
@@ -34,6 +56,7 @@ Scene::~Scene()
     m_mngr->destroy(m_vertexBuffer);
     m_mngr->destroy(m_indexBuffer);
     m_mngr->destroy(m_meshBuffer);
+    m_mngr->destroy(m_meshUsageBuffer);
     m_mngr->destroy(m_defaultTexture);
 }
 
@@ -50,18 +73,21 @@ void Scene::addModelFromFile(const fs::path& path)
         return;
     }
 
-    Assimp::Importer importer{};
-    const aiScene* aiScenePtr = importer.ReadFile(path.string().c_str(), ASSIMP_LOAD_FLAGS);
-
     const Handle<Model> model = m_mngr->createModel({.mngr = m_mngr});
     Model* modelPtr = m_mngr->get(model);
 
     Mesh* meshesStart = buffer(m_meshBuffer)->writePtr<Mesh>();
-    for (const aiMesh* aiMeshPtr : std::span{aiScenePtr->mMeshes, aiScenePtr->mNumMeshes}) {
-        Mesh mesh = loadMesh(aiScenePtr, aiMeshPtr, path, modelPtr);
-        buffer(m_meshBuffer)->pushData(&mesh);
+    const std::string extension = path.extension().string();
+    const bool isObj = extension == ".obj" or extension == ".OBJ";
+    const bool isGltf = extension == ".gltf" or extension == ".glb" or extension == ".GLTF" or extension == ".GLB";
+    const bool loaded = (isObj and loadObjMeshes(path, modelPtr)) or (isGltf and loadGltfMeshes(path, modelPtr));
+    if (not loaded) {
+        loadAssimpMeshes(path, modelPtr);
+    }
+    modelPtr->m_meshes = std::span{meshesStart, buffer(m_meshBuffer)->writePtr<Mesh>()};
+    for (const Mesh& mesh : modelPtr->m_meshes) {
+        m_maxMeshTriangles = std::max(m_maxMeshTriangles, mesh.numIndices / 3);
     }
-    modelPtr->m_meshes = std::span{meshesStart, aiScenePtr->mNumMeshes};
 
     m_models.push_back(model);
     m_modelCache[path] = model;
@@ -69,6 +95,156 @@ void Scene::addModelFromFile(const fs::path& path)
 
 //------------------------------------------------------------------------
 
+// Once the ring has waited for the region this frame reuses, it holds the usage copied FRAMES_IN_FLIGHT frames ago,
+// which lags far less than the idle time of textures. It is read before this frame's copy overwrites it.
+void Scene::updateTextureResidency()
+{
+    m_meshUsageReadback.beginFrame();
+    m_meshUsageReadbackIdx = (m_meshUsageReadbackIdx + 1) % FRAMES_IN_FLIGHT;
+    const size_t meshCount = numMeshes();
+    const size_t numReadBack = std::exchange(m_numMeshesReadBack[m_meshUsageReadbackIdx], meshCount);
+    m_meshUsageSlice = m_meshUsageReadback.allocate(implicit_cast<GLsizeiptr>(meshCount * sizeof(GLuint)));
+    m_textureResidency.update(
+        std::span{buffer(m_meshBuffer)->ptr<Mesh>(), meshCount},
+        std::span{std::bit_cast<const GLuint*>(m_meshUsageSlice.ptr), numReadBack}
+    );
+}
+
+//------------------------------------------------------------------------
+
+// Meshes are only added between frames, so the slice still covers all of them.
+void Scene::readBackMeshUsage()
+{
+    if (m_meshUsageSlice.byteSize == 0) return;
+    glCopyNamedBufferSubData(buffer(m_meshUsageBuffer)->name(), m_meshUsageSlice.buffer, 0, m_meshUsageSlice.offset,
+        m_meshUsageSlice.byteSize);
+}
+
+//------------------------------------------------------------------------
+
+void Scene::endFrame()
+{
+    m_meshUsageReadback.endFrame();
+}
+
+//------------------------------------------------------------------------
+
+size_t Scene::numMeshes()
+{
+    Buffer* meshes = buffer(m_meshBuffer);
+    return implicit_cast<size_t>(meshes->writePtr<Mesh>() - meshes->ptr<Mesh>());
+}
+
+//------------------------------------------------------------------------
+
+// The loader writes the geometry straight into the mapped buffers while the textures load.
+bool Scene::loadObjMeshes(const fs::path& path, Model* modelPtr)
+{
+    ObjLoader loader{path};
+    if (not loader.valid()) return false;
+
+    const auto numVertices = implicit_cast<GLsizei>(loader.numVertices());
+    const std::span<Vertex> vertices = buffer(m_vertexBuffer)->reserveData<Vertex>(numVertices);
+    const std::span<GLuint> indices = buffer(m_indexBuffer)->reserveData<GLuint>(numVertices);
+    const auto baseVertex = implicit_cast<GLuint>(vertices.data() - buffer(m_vertexBuffer)->ptr<Vertex>());
+    const auto firstIndex = implicit_cast<GLuint>(indices.data() - buffer(m_indexBuffer)->ptr<GLuint>());
+
+    auto writeFuture = std::async(std::launch::async, [&] { loader.write(vertices, indices); });
+    for (const ObjMesh& objMesh : loader.meshes()) {
+        const fs::path& diffusePath = loader.materials()[objMesh.material].diffusePath;
+        const Handle<Texture> diffuse = loadTexture(diffusePath, path);
+        modelPtr->m_textures.push_back(diffuse);
+
+        const Mesh mesh{
+            .numIndices = objMesh.numVertices,
+            .firstIndex = firstIndex + objMesh.firstVertex,
+            .baseVertex = baseVertex + objMesh.firstVertex,
+            .modelMatT = glm::transpose(modelPtr->m_mat),
+            .normalMat = glm::transpose(glm::inverse(modelPtr->m_mat)),
+            .textures = {
+                .diffuse = meshTexture(diffuse, diffusePath)
+            }
+        };
+        buffer(m_meshBuffer)->pushData(&mesh);
+    }
+    writeFuture.get();
+
+    return true;
+}
+
+//------------------------------------------------------------------------
+
+// As for OBJ files, while the images decode on the loader's threads. Instances of a glTF mesh share its geometry, and
+// every instance of each primitive is a mesh of its own.
+bool Scene::loadGltfMeshes(const fs::path& path, Model* modelPtr)
+{
+    GltfLoader loader{path};
+    if (not loader.valid()) return false;
+
+    const std::span<Vertex> vertices =
+        buffer(m_vertexBuffer)->reserveData<Vertex>(implicit_cast<GLsizei>(loader.numVertices()));
+    const std::span<GLuint> indices =
+        buffer(m_indexBuffer)->reserveData<GLuint>(implicit_cast<GLsizei>(loader.numIndices()));
+    const auto baseVertex = implicit_cast<GLuint>(vertices.data() - buffer(m_vertexBuffer)->ptr<Vertex>());
+    const auto firstIndex = implicit_cast<GLuint>(indices.data() - buffer(m_indexBuffer)->ptr<GLuint>());
+
+    auto writeFuture = std::async(std::launch::async, [&] { loader.write(vertices, indices); });
+
+    // Uploaded on this thread, whose GL context is current, in the order the images were queued for decoding.
+    const std::string tag = fmt::format("Model {}", path.filename().string());
+    std::vector<Handle<Texture>> textures;
+    for (uint32_t idx = 0; idx < loader.numImages(); ++idx) {
+        StbImageResource<>& image = loader.image(idx);
+        if (image.data() == nullptr) {
+            textures.push_back(m_defaultTexture);
+            continue;
+        }
+        textures.push_back(Texture::fromImage(m_mngr, loader.imageKey(idx), image.dims(), image.data(), {.tag = tag}));
+        modelPtr->m_textures.push_back(textures.back());
+    }
+
+    for (const GltfInstance& instance : loader.instances()) {
+        const GltfPrimitive& primitive = loader.primitives()[instance.primitive];
+        const bool hasImage = primitive.image != GltfLoader::s_noImage;
+        const Handle<Texture> diffuse = hasImage ? textures[primitive.image] : m_defaultTexture;
+        const glm::mat4 modelMat = modelPtr->m_mat * instance.transform;
+
+        const Mesh mesh{
+            .numIndices = primitive.numIndices,
+            .firstIndex = firstIndex + primitive.firstIndex,
+            .baseVertex = baseVertex + primitive.firstVertex,
+            .modelMatT = glm::transpose(modelMat),
+            .normalMat = glm::transpose(glm::inverse(modelMat)),
+            .textures = {
+                .diffuse = meshTexture(diffuse, hasImage ? loader.imageKey(primitive.image) : fs::path{})
+            }
+        };
+        buffer(m_meshBuffer)->pushData(&mesh);
+    }
+    writeFuture.get();
+
+    return true;
+}
+
+//------------------------------------------------------------------------
+
+void Scene::loadAssimpMeshes(const fs::path& path, Model* modelPtr)
+{
+    Assimp::Importer importer{};
+    const aiScene* aiScenePtr = importer.ReadFile(path.string().c_str(), ASSIMP_LOAD_FLAGS);
+    if (aiScenePtr == nullptr) {
+        fmt::println("Error importing {}: {}", path.string(), importer.GetErrorString());
+        return;
+    }
+
+    for (const aiMesh* aiMeshPtr : std::span{aiScenePtr->mMeshes, aiScenePtr->mNumMeshes}) {
+        Mesh mesh = loadMesh(aiScenePtr, aiMeshPtr, path, modelPtr);
+        buffer(m_meshBuffer)->pushData(&mesh);
+    }
+}
+
+//------------------------------------------------------------------------
+
 Mesh Scene::loadMesh(const aiScene* aiScenePtr, const aiMesh* aiMeshPtr, const fs::path& path,
     Model* modelPtr)
 {
@@ -80,11 +256,12 @@ Mesh Scene::loadMesh(const aiScene* aiScenePtr, const aiMesh* aiMeshPtr, const f
         std::launch::async,
         [&] { return loadIndices(std::forward<decltype(aiMeshPtr)>(aiMeshPtr)); }
     );
-    const Handle<Texture> diffuse = loadTexture(
+    const fs::path diffusePath = texturePath(
         aiScenePtr->mMaterials[aiMeshPtr->mMaterialIndex],
         aiTextureType_DIFFUSE,
-        path.parent_path()
+        path
     );
+    const Handle<Texture> diffuse = loadTexture(diffusePath, path);
     modelPtr->m_textures.push_back(diffuse);
 
     const auto verticesLoadInfo = verticesFuture.get();
@@ -97,7 +274,7 @@ Mesh Scene::loadMesh(const aiScene* aiScenePtr, const aiMesh* aiMeshPtr, const f
         .modelMatT = glm::transpose(modelPtr->m_mat),
         .normalMat = glm::transpose(glm::inverse(modelPtr->m_mat)),
         .textures = {
-            .diffuse = m_mngr->get(diffuse)->handle()
+            .diffuse = meshTexture(diffuse, diffusePath)
         }
     };
 }
@@ -106,24 +283,19 @@ Mesh Scene::loadMesh(const aiScene* aiScenePtr, const aiMesh* aiMeshPtr, const f
 
 Scene::VerticesLoadInfo Scene::loadVertices(const aiMesh* aiMeshPtr)
 {
-    std::array<uint8_t, KIB_BYTES * 3> buf;
-    std::pmr::monotonic_buffer_resource rsrc{buf.data(), buf.size()};
-    std::pmr::vector<Vertex> vertices{&rsrc};
-
-    for (uint32_t idx : stdv::iota(0u, aiMeshPtr->mNumVertices)) {
-        vertices.emplace_back(
-            util::vec3FromAiVector3D(aiMeshPtr->mVertices[idx]),
-            util::vec3FromAiVector3D(aiMeshPtr->mNormals[idx]),
-            aiMeshPtr->HasTextureCoords(0) ? util::vec2FromAiVector3D(aiMeshPtr->mTextureCoords[0][idx])
-                                           : glm::vec2{}
-        );
-    }
-
-    Vertex* verticesStart = buffer(m_vertexBuffer)->writePtr<Vertex>();
-    buffer(m_vertexBuffer)->pushData(vertices.data(), vertices.size());
+    const std::span<Vertex> vertices =
+        buffer(m_vertexBuffer)->reserveData<Vertex>(implicit_cast<GLsizei>(aiMeshPtr->mNumVertices));
+    const auto stream = [](const aiVector3D* data) {
+        return VertexStream{.data = std::bit_cast<const std::byte*>(data), .stride = sizeof(aiVector3D)};
+    };
+    interleaveVertices({
+        .positions = stream(aiMeshPtr->mVertices),
+        .normals = stream(aiMeshPtr->mNormals),
+        .uvs = stream(aiMeshPtr->HasTextureCoords(0) ? aiMeshPtr->mTextureCoords[0] : nullptr)
+    }, vertices);
 
     return {
-        .base = implicit_cast<GLuint>(verticesStart - buffer(m_vertexBuffer)->ptr<Vertex>())
+        .base = implicit_cast<GLuint>(vertices.data() - buffer(m_vertexBuffer)->ptr<Vertex>())
     };
 }
 
@@ -131,38 +303,55 @@ Scene::VerticesLoadInfo Scene::loadVertices(const aiMesh* aiMeshPtr)
 
 Scene::IndicesLoadInfo Scene::loadIndices(const aiMesh* aiMeshPtr)
 {
-    std::array<uint8_t, KIB_BYTES> buf;
-    std::pmr::monotonic_buffer_resource rsrc{buf.data(), buf.size()};
-    std::pmr::vector<GLuint> indices{&rsrc};
+    // Triangulation leaves at most 3 indices per face. Point and line faces leave part of their room unused.
+    const std::span<GLuint> indices =
+        buffer(m_indexBuffer)->reserveData<GLuint>(implicit_cast<GLsizei>(aiMeshPtr->mNumFaces * 3));
 
+    GLuint* out = indices.data();
     for (const aiFace& face : std::span{aiMeshPtr->mFaces, aiMeshPtr->mNumFaces}) {
-        for (auto idx : std::span{face.mIndices, face.mNumIndices}) {
-            indices.push_back(idx);
-        }
+        out = std::copy_n(face.mIndices, face.mNumIndices, out);
     }
 
-    GLuint* indicesStart = buffer(m_indexBuffer)->writePtr<GLuint>();
-    buffer(m_indexBuffer)->pushData(indices.data(), indices.size());
-
     return {
-        .base = implicit_cast<GLuint>(indicesStart - buffer(m_indexBuffer)->ptr<GLuint>()),
-        .extent = aiMeshPtr->mNumFaces * 3
+        .base = implicit_cast<GLuint>(indices.data() - buffer(m_indexBuffer)->ptr<GLuint>()),
+        .extent = implicit_cast<GLuint>(out - indices.data())
     };
 }
 
 //------------------------------------------------------------------------
 
-Handle<Texture> Scene::loadTexture(const aiMaterial* aiMaterialPtr, aiTextureType textureType, const fs::path& dir)
+fs::path Scene::texturePath(const aiMaterial* aiMaterialPtr, aiTextureType textureType, const fs::path& modelPath)
 {
     if (aiMaterialPtr->GetTextureCount(textureType) == 0) {
-        return m_defaultTexture;
+        return {};
     }
 
     aiString tempMaterialPath;
     aiMaterialPtr->GetTexture(textureType, 0, &tempMaterialPath);
-    const fs::path materialPath = dir / tempMaterialPath.C_Str();
+    return modelPath.parent_path() / tempMaterialPath.C_Str();
+}
+
+//------------------------------------------------------------------------
+
+Handle<Texture> Scene::loadTexture(const fs::path& texturePath, const fs::path& modelPath)
+{
+    if (texturePath.empty()) {
+        return m_defaultTexture;
+    }
+
+    const std::string tag = fmt::format("Model {}", modelPath.filename().string());
+    return Texture::fromFile(m_mngr, texturePath, {.tag = tag});
+}
+
+//------------------------------------------------------------------------
+
+GLuint64 Scene::meshTexture(const Handle<Texture>& handle, const fs::path& source)
+{
+    if (not Texture::s_useBindless) return m_textureArrays.add(handle);
 
-    return Texture::fromFile(m_mngr, materialPath);
+    Buffer* meshes = buffer(m_meshBuffer);
+    const auto mesh = implicit_cast<uint32_t>(meshes->writePtr<Mesh>() - meshes->ptr<Mesh>());
+    return m_textureResidency.track(handle, source, mesh);
 }
 
 //------------------------------------------------------------------------
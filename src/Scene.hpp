@@ -3,13 +3,18 @@
 #include "Buffer.hpp"
 #include "DirectionalLight.hpp"
 #include "Handle.hpp"
+#include "LocalLights.hpp"
 #include "Model.hpp"
 #include "ResourceManager.hpp"
+#include "RingBuffer.hpp"
 #include "Texture.hpp"
+#include "TextureArrays.hpp"
+#include "TextureResidency.hpp"
 
 #include <assimp/scene.h>
 #include <robin_hood.h>
 
+#include <array>
 #include <vector>
 
 //------------------------------------------------------------------------
@@ -24,20 +29,34 @@ struct SceneDescriptor
     ResourceManager* mngr;
     BufferDescriptor vertexBufferDesc{
         .byteSize = GIB_BYTES/2,
-        .usage = BufferUsage::VERTEX
+        .usage = BufferUsage::VERTEX,
+        .tag = "Scene"
     };
     BufferDescriptor indexBufferDesc{
         .byteSize = GIB_BYTES/2,
-        .usage = BufferUsage::INDEX
+        .usage = BufferUsage::INDEX,
+        .tag = "Scene"
     };
     BufferDescriptor meshBufferDesc{
         .byteSize = GIB_BYTES/4,
         .usage = BufferUsage::STORAGE,
         .indexedBindings = {
             {.target = BufferUsage::STORAGE, .index = MESH_BINDING}
-        }
+        },
+        .tag = "Scene"
+    };
+    BufferDescriptor meshUsageBufferDesc{  // The last frame each mesh was used in, one per mesh that fits above.
+        .byteSize = GIB_BYTES/4 / sizeof(Mesh) * sizeof(GLuint),
+        .usage = BufferUsage::STORAGE,
+        .indexedBindings = {
+            {.target = BufferUsage::STORAGE, .index = MESH_USAGE_BINDING}
+        },
+        .mapped = false,  // Only the GPU touches it, the CPU reads copies of it.
+        .tag = "Scene"
     };
     DirectionalLightDescriptor sunLightDesc;
+    LocalLightsDescriptor localLightsDesc;
+    TextureResidencyDescriptor textureResidencyDesc;
 };
 
 //------------------------------------------------------------------------
@@ -54,30 +73,57 @@ public:
     Scene& operator=(Scene&&) = delete;
 
     [[nodiscard]] const DirectionalLight& sun() { return m_sunLight; }
+    [[nodiscard]] LocalLights& localLights() { return m_localLights; }
     [[nodiscard]] std::span<Handle<Model>> models() { return m_models; }
+    [[nodiscard]] TextureResidency& textureResidency() { return m_textureResidency; }
 
     void addModelFromFile(const fs::path& path);
+    void updateTextureResidency();  // GL thread only, once per frame before drawing.
+    void readBackMeshUsage();       // Likewise, after the shading passes stored this frame's usage.
+    void endFrame();                // Likewise, after the frame's last command.
 
 private:
     struct VerticesLoadInfo { GLuint base; };
     struct IndicesLoadInfo { GLuint base; GLuint extent; };
 
+    // False if the file cannot be read, so that Assimp gets to try.
+    [[nodiscard]] bool loadObjMeshes(const fs::path& path, Model* modelPtr);
+    [[nodiscard]] bool loadGltfMeshes(const fs::path& path, Model* modelPtr);
+    void loadAssimpMeshes(const fs::path& path, Model* modelPtr);
     [[nodiscard]] Mesh loadMesh(const aiScene* aiScenePtr, const aiMesh* aiMeshPtr, const fs::path& path,
         Model* model);
     [[nodiscard]] VerticesLoadInfo loadVertices(const aiMesh* aiMeshPtr);
     [[nodiscard]] IndicesLoadInfo loadIndices(const aiMesh* aiMeshPtr);
-    [[nodiscard]] Handle<Texture> loadTexture(const aiMaterial* aiMaterialPtr, aiTextureType textureType,
-        const fs::path& dir);
+    // Empty if the material has no such texture.
+    [[nodiscard]] fs::path texturePath(const aiMaterial* aiMaterialPtr, aiTextureType textureType,
+        const fs::path& modelPath);
+    // Accounted to the model that loads a texture first, later ones share it through the cache. Empty paths, i.e.
+    // materials without the texture, get the default one.
+    [[nodiscard]] Handle<Texture> loadTexture(const fs::path& texturePath, const fs::path& modelPath);
+
+    // For the mesh pushed next: the bindless handle, which TextureResidency tracks if the texture was loaded from the
+    // image file at source, or the texture array and layer it is copied into without bindless textures.
+    [[nodiscard]] GLuint64 meshTexture(const Handle<Texture>& handle, const fs::path& source = {});
 
     [[nodiscard]] Buffer* buffer(const Handle<Buffer>& handle) { return m_mngr->get(handle); }
+    [[nodiscard]] size_t numMeshes();
 
     ResourceManager* m_mngr;
     Handle<Buffer> m_vertexBuffer;
     Handle<Buffer> m_indexBuffer;
     Handle<Buffer> m_meshBuffer;
+    Handle<Buffer> m_meshUsageBuffer;
+    RingBuffer m_meshUsageReadback;
+    RingSlice m_meshUsageSlice;  // Of the current frame.
+    std::array<size_t, FRAMES_IN_FLIGHT> m_numMeshesReadBack{};  // Into each region of the ring.
+    uint32_t m_meshUsageReadbackIdx = 0;  // Of the current frame's region.
     DirectionalLight m_sunLight;
+    LocalLights m_localLights;
     Handle<Texture> m_defaultTexture;
+    TextureArrays m_textureArrays;
+    TextureResidency m_textureResidency;
     std::vector<Handle<Model>> m_models;
+    GLuint m_maxMeshTriangles = 0;  // Of all meshes ever added, which bounds the triangle IDs of the visibility buffer.
     robin_hood::unordered_map<fs::path, Handle<Model>> m_modelCache;
 
     friend class Renderer;
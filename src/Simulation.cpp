@@ -0,0 +1,53 @@
+#include "Simulation.hpp"
+
+#include <algorithm>
+
+//------------------------------------------------------------------------
+
+namespace Zhade
+{
+
+//------------------------------------------------------------------------
+
+Simulation::Simulation(SimulationDescriptor desc)
+    : m_app{desc.app},
+      m_camera{desc.cameraDesc},
+      m_tickPeriod{std::chrono::duration_cast<Clock::duration>(
+          std::chrono::duration<float>{1.0f / std::max(desc.tickRate, 1.0f)}
+      )}
+{
+    // Before the thread starts, so that there is a pose to latch from the first frame on.
+    publishCamera({});
+    m_thread = std::jthread{[this](std::stop_token stopToken) { run(stopToken); }};
+}
+
+//------------------------------------------------------------------------
+
+void Simulation::run(std::stop_token stopToken)
+{
+    Clock::time_point tickStart = Clock::now();
+    while (not stopToken.stop_requested()) {
+        const Clock::time_point now = Clock::now();
+        const float deltaTime = std::chrono::duration<float>(now - tickStart).count();
+        tickStart = now;
+
+        const App::InputSample& input = m_app->latestInput();
+        m_camera.update(input.state, deltaTime);
+        publishCamera(input.time);
+
+        std::this_thread::sleep_until(now + m_tickPeriod);
+    }
+}
+
+//------------------------------------------------------------------------
+
+void Simulation::publishCamera(Clock::time_point inputTime)
+{
+    m_cameraStates.write({.center = m_camera.center(), .target = m_camera.target(), .inputTime = inputTime});
+}
+
+//------------------------------------------------------------------------
+
+}  // namespace Zhade
+
+//------------------------------------------------------------------------
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "App.hpp"
+#include "Camera.hpp"
+#include "TripleBuffer.hpp"
+
+#include <glm/glm.hpp>
+
+#include <chrono>
+#include <stop_token>
+#include <thread>
+
+//------------------------------------------------------------------------
+
+namespace Zhade
+{
+
+//------------------------------------------------------------------------
+
+struct SimulationDescriptor
+{
+    App* app;
+    CameraDescriptor cameraDesc;
+    float tickRate = 1000.0f;  // Hz, independent of the frame rate.
+};
+
+// The camera pose after one simulation tick, and when the input it integrated was polled.
+struct CameraState
+{
+    glm::vec3 center;
+    glm::vec3 target;
+    std::chrono::steady_clock::time_point inputTime;
+};
+
+//------------------------------------------------------------------------
+// Integrates the input into the camera on a thread of its own at a fixed tick rate, so that neither waits for the
+// other: the thread polling input hands it over through App::latestInput(), and the renderer latches the newest pose
+// through latestCamera() whenever it starts recording a frame.
+
+class Simulation
+{
+public:
+    explicit Simulation(SimulationDescriptor desc);
+
+    Simulation(const Simulation&) = delete;
+    Simulation& operator=(const Simulation&) = delete;
+    Simulation(Simulation&&) = delete;
+    Simulation& operator=(Simulation&&) = delete;
+
+    // Only from one thread, usually the render thread.
+    [[nodiscard]] const CameraState& latestCamera() { return m_cameraStates.read(); }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void run(std::stop_token stopToken);
+    void publishCamera(Clock::time_point inputTime);
+
+    App* m_app;
+    Camera<CameraType::PERSPECTIVE> m_camera;  // Only touched by the simulation thread once it runs.
+    Clock::duration m_tickPeriod;
+    TripleBuffer<CameraState> m_cameraStates;
+    std::jthread m_thread;  // Last, so that it is stopped and joined before anything it uses is destroyed.
+};
+
+//------------------------------------------------------------------------
+
+}  // namespace Zhade
+
+//------------------------------------------------------------------------
@@ -4,8 +4,10 @@
 
 extern "C" {
 #include <stb_image.h>
+#include <stb_image_write.h>
 }
 
+#include <span>
 #include <utility>
 
 //------------------------------------------------------------------------
@@ -27,15 +29,21 @@ class StbImageResource
 {
 public:
     explicit StbImageResource(const fs::path& path) { load(path); }
+    explicit StbImageResource(std::span<const stbi_uc> encoded) { load(encoded); }  // E.g. embedded in a model file.
     ~StbImageResource() { stbi_image_free(m_data); }
 
     StbImageResource(const StbImageResource&) = delete;
     StbImageResource& operator=(const StbImageResource&) = delete;
 
-    StbImageResource(StbImageResource&& other) : m_data{std::exchange(other.m_data, nullptr)} {}
+    StbImageResource(StbImageResource&& other)
+        : m_dims{other.m_dims},
+          m_data{std::exchange(other.m_data, nullptr)}
+    {}
 
     StbImageResource& operator=(StbImageResource&& other)
     {
+        stbi_image_free(m_data);
+        m_dims = other.m_dims;
         m_data = std::exchange(other.m_data, nullptr);
         return *this;
     }
@@ -60,6 +68,22 @@ private:
         }
     }
 
+    void load(std::span<const stbi_uc> encoded)
+    {
+        const auto size = implicit_cast<int>(encoded.size());
+
+        if constexpr (std::same_as<T, stbi_uc>)
+            m_data = stbi_load_from_memory(encoded.data(), size, &m_dims.x, &m_dims.y, nullptr, 4);
+        else if constexpr (std::same_as<T, stbi_us>)
+            m_data = stbi_load_16_from_memory(encoded.data(), size, &m_dims.x, &m_dims.y, nullptr, 4);
+        else if constexpr (std::same_as<T, float>)
+            m_data = stbi_loadf_from_memory(encoded.data(), size, &m_dims.x, &m_dims.y, nullptr, 4);
+
+        if (m_data == nullptr) [[unlikely]] {
+            fmt::println("Error decoding image data: {}", stbi_failure_reason());
+        }
+    }
+
     glm::ivec2 m_dims{};
     T* m_data = nullptr;
 };
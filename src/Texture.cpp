@@ -3,6 +3,8 @@
 #include "ResourceManager.hpp"
 #include "StbImageResource.hpp"
 
+#include <memory>
+
 //------------------------------------------------------------------------
 
 namespace Zhade
@@ -12,17 +14,17 @@ namespace Zhade
 
 Texture::Texture(TextureDescriptor desc)
     : m_dims{desc.dims},
-      m_managed{desc.managed}
+      m_levels{desc.levels},
+      m_internalFormat{desc.internalFormat},
+      m_samplerDesc{desc.sampler},
+      m_managed{desc.managed},
+      m_tag{desc.tag}
 {
     glCreateTextures(GL_TEXTURE_2D, 1, &m_texture);
     glTextureStorage2D(m_texture, desc.levels, desc.internalFormat, m_dims.x, m_dims.y);
+    m_byteSize = queryByteSize(desc.levels);
 
-    glCreateSamplers(1, &m_sampler);
-    glSamplerParameteri(m_sampler, GL_TEXTURE_WRAP_S, desc.sampler.wrapS);
-    glSamplerParameteri(m_sampler, GL_TEXTURE_WRAP_T, desc.sampler.wrapT);
-    glSamplerParameteri(m_sampler, GL_TEXTURE_MAG_FILTER, desc.sampler.magFilter);
-    glSamplerParameteri(m_sampler, GL_TEXTURE_MIN_FILTER, desc.sampler.minFilter);
-    glSamplerParameterf(m_sampler, GL_TEXTURE_MAX_ANISOTROPY, desc.sampler.anisotropy);
+    m_sampler = createSampler(desc.sampler);
 
     if (desc.internalFormat == GL_DEPTH_COMPONENT32F) {  // Depth texture?
         glSamplerParameteri(m_sampler, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
@@ -31,8 +33,10 @@ Texture::Texture(TextureDescriptor desc)
         glSamplerParameterfv(m_sampler, GL_TEXTURE_BORDER_COLOR, ones);
     }
 
-    m_handle = glGetTextureSamplerHandleARB(m_texture, m_sampler);
-    glMakeTextureHandleResidentARB(m_handle);
+    if (s_useBindless) {
+        m_handle = glGetTextureSamplerHandleARB(m_texture, m_sampler);
+        glMakeTextureHandleResidentARB(m_handle);
+    }
 }
 
 //------------------------------------------------------------------------
@@ -46,13 +50,21 @@ Texture::~Texture()
 
 void Texture::freeResources()
 {
-    glMakeTextureHandleNonResidentARB(m_handle);
+    if (m_handle != 0) glMakeTextureHandleNonResidentARB(m_handle);
     glDeleteTextures(1, &m_texture);
     glDeleteSamplers(1, &m_sampler);
 }
 
 //------------------------------------------------------------------------
 
+void Texture::bind(GLuint unit)
+{
+    glBindTextureUnit(unit, m_texture);
+    glBindSampler(unit, m_sampler);
+}
+
+//------------------------------------------------------------------------
+
 void Texture::setData(const void* data, GLsizei depth)
 {
     glTextureSubImage2D(m_texture, 0, 0, 0, m_dims.x, m_dims.y, GL_RGBA, GL_UNSIGNED_BYTE, data);
@@ -60,21 +72,111 @@ void Texture::setData(const void* data, GLsizei depth)
 
 //------------------------------------------------------------------------
 
+Handle<Texture> Texture::upload(ResourceManager* mngr, glm::ivec2 dims, const void* data, TextureDescriptor desc)
+{
+    desc.dims = dims;
+    desc.managed = true;
+    const Handle<Texture> textureHandle = mngr->createTexture(desc);
+    Texture* texture = mngr->get(textureHandle);
+    texture->setData(data);
+    texture->generateMipmap();
+    return textureHandle;
+}
+
+//------------------------------------------------------------------------
+
+// From the format as the driver stores it, which covers every format but excludes whatever padding the driver adds.
+GLsizeiptr Texture::queryByteSize(GLsizei levels)
+{
+    static constexpr GLenum componentSizes[] {
+        GL_TEXTURE_RED_SIZE,
+        GL_TEXTURE_GREEN_SIZE,
+        GL_TEXTURE_BLUE_SIZE,
+        GL_TEXTURE_ALPHA_SIZE,
+        GL_TEXTURE_DEPTH_SIZE,
+        GL_TEXTURE_STENCIL_SIZE,
+        GL_TEXTURE_SHARED_SIZE
+    };
+
+    GLsizeiptr byteSize = 0;
+    for (GLint level = 0; level < levels; ++level) {
+        GLint compressed = GL_FALSE;
+        glGetTextureLevelParameteriv(m_texture, level, GL_TEXTURE_COMPRESSED, &compressed);
+        if (compressed == GL_TRUE) {
+            GLint levelByteSize = 0;
+            glGetTextureLevelParameteriv(m_texture, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &levelByteSize);
+            byteSize += levelByteSize;
+            continue;
+        }
+
+        GLint texelBits = 0;
+        for (GLenum componentSize : componentSizes) {
+            GLint bits = 0;
+            glGetTextureLevelParameteriv(m_texture, level, componentSize, &bits);
+            texelBits += bits;
+        }
+        const glm::ivec2 dims = glm::max(m_dims >> level, 1);
+        byteSize += GLsizeiptr{dims.x} * dims.y * texelBits / 8;
+    }
+    return byteSize;
+}
+
+//------------------------------------------------------------------------
+
 Handle<Texture> Texture::fromFile(ResourceManager* mngr, const fs::path& path, TextureDescriptor desc)
 {
+    const std::scoped_lock lock{s_cacheMutex};
     if (s_cache.contains(path) and mngr->exists(s_cache[path])) {
         return s_cache[path];
     }
 
     StbImageResource img{path};
-    desc.dims = img.dims();
+    const Handle<Texture> textureHandle = upload(mngr, img.dims(), img.data(), desc);
+
+    s_cache[path] = textureHandle;
+
+    return textureHandle;
+}
+
+//------------------------------------------------------------------------
+
+Handle<Texture> Texture::fromImage(ResourceManager* mngr, const fs::path& key, glm::ivec2 dims, const void* data,
+    TextureDescriptor desc)
+{
+    const std::scoped_lock lock{s_cacheMutex};
+    if (s_cache.contains(key) and mngr->exists(s_cache[key])) {
+        return s_cache[key];
+    }
+
+    const Handle<Texture> textureHandle = upload(mngr, dims, data, desc);
+
+    s_cache[key] = textureHandle;
+
+    return textureHandle;
+}
+
+//------------------------------------------------------------------------
+
+Handle<Texture> Texture::fromFilePending(ResourceManager* mngr, const fs::path& path, TextureDescriptor desc)
+{
+    {
+        const std::scoped_lock lock{s_cacheMutex};
+        if (s_cache.contains(path) and (mngr->exists(s_cache[path]) or mngr->isPending(s_cache[path]))) {
+            return s_cache[path];
+        }
+    }
+
+    // Decoded outside the lock. Two threads loading the same path at once both decode it, and the later one wins.
+    auto img = std::make_shared<StbImageResource<>>(path);
+    desc.dims = img->dims();
 
     desc.managed = true;
-    const Handle<Texture> textureHandle = mngr->createTexture(desc);
-    Texture* texture = mngr->get(textureHandle);
-    texture->setData(img.data());
-    texture->generateMipmap();
+    const Handle<Texture> textureHandle = mngr->createPendingTexture(desc, [img](Texture& texture) {
+        texture.setData(img->data());
+        texture.generateMipmap();
+    });
 
+    const std::scoped_lock lock{s_cacheMutex};
     s_cache[path] = textureHandle;
 
     return textureHandle;
@@ -91,7 +193,8 @@ Handle<Texture> Texture::makeDefault(ResourceManager* mngr)
             .magFilter = GL_NEAREST,
             .minFilter = GL_NEAREST,
             .anisotropy = 1.0f
-        }
+        },
+        .tag = "Scene"
     };
     static constexpr uint32_t data = 0xffffffff;
 
@@ -102,6 +205,20 @@ Handle<Texture> Texture::makeDefault(ResourceManager* mngr)
 
 //------------------------------------------------------------------------
 
+GLuint Texture::createSampler(const SamplerDescriptor& desc)
+{
+    GLuint sampler = 0;
+    glCreateSamplers(1, &sampler);
+    glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, desc.wrapS);
+    glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, desc.wrapT);
+    glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, desc.magFilter);
+    glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, desc.minFilter);
+    glSamplerParameterf(sampler, GL_TEXTURE_MAX_ANISOTROPY, desc.anisotropy);
+    return sampler;
+}
+
+//------------------------------------------------------------------------
+
 }  // namespace Zhade
 
 //------------------------------------------------------------------------
@@ -5,6 +5,9 @@
 
 #include <robin_hood.h>
 
+#include <mutex>
+#include <string_view>
+
 //------------------------------------------------------------------------
 
 namespace Zhade
@@ -21,6 +24,8 @@ struct SamplerDescriptor
     GLenum magFilter = GL_LINEAR;
     GLenum minFilter = GL_LINEAR_MIPMAP_LINEAR;
     GLfloat anisotropy = 8.0f;
+
+    bool operator==(const SamplerDescriptor&) const = default;
 };
 
 struct TextureDescriptor
@@ -30,6 +35,9 @@ struct TextureDescriptor
     GLenum internalFormat = GL_RGBA8;
     SamplerDescriptor sampler;
     bool managed = true;
+    std::string_view tag{};  // Who the memory is accounted to, see ResourceManager::memoryReport().
+
+    bool operator==(const TextureDescriptor&) const = default;
 };
 
 //------------------------------------------------------------------------
@@ -47,25 +55,53 @@ public:
     Texture& operator=(Texture&&) = delete;
 
     [[nodiscard]] GLuint name() { return m_texture; }
-    [[nodiscard]] GLuint64 handle() { return m_handle; }
+    [[nodiscard]] GLuint64 handle() { return m_handle; }  // 0 without bindless textures.
     [[nodiscard]] const glm::ivec2& dims() { return m_dims; }
+    [[nodiscard]] GLsizei levels() { return m_levels; }
+    [[nodiscard]] GLenum internalFormat() { return m_internalFormat; }
+    [[nodiscard]] const SamplerDescriptor& samplerDesc() { return m_samplerDesc; }
+    [[nodiscard]] GLsizeiptr byteSize() { return m_byteSize; }  // Of all levels.
+    [[nodiscard]] std::string_view tag() { return m_tag; }
 
     void freeResources();
+    void bind(GLuint unit);  // With its sampler, for shaders without bindless textures.
     void generateMipmap() { glGenerateTextureMipmap(m_texture); }
     void setData(const void* data, GLsizei depth = 0);
 
     [[nodiscard]] static Handle<Texture> fromFile(ResourceManager* mngr, const fs::path& path,
         TextureDescriptor desc = TextureDescriptor{});
+    // For RGBA8 images decoded elsewhere, e.g. embedded in a model file. Cached by key as fromFile() is by path.
+    [[nodiscard]] static Handle<Texture> fromImage(ResourceManager* mngr, const fs::path& key, glm::ivec2 dims,
+        const void* data, TextureDescriptor desc = TextureDescriptor{});
     [[nodiscard]] static Handle<Texture> makeDefault(ResourceManager* mngr);
+    [[nodiscard]] static GLuint createSampler(const SamplerDescriptor& desc);
+
+    // For loader threads: decodes on the calling thread and uploads once ResourceManager::finalizePending() has run.
+    [[nodiscard]] static Handle<Texture> fromFilePending(ResourceManager* mngr, const fs::path& path,
+        TextureDescriptor desc = TextureDescriptor{});
 
     static inline robin_hood::unordered_map<fs::path, Handle<Texture>> s_cache;
+    static inline std::mutex s_cacheMutex;
+
+    // Cleared by App::init() where GL_ARB_bindless_texture is missing, e.g. on Mesa llvmpipe, or on request. Textures
+    // then have no handles, and pipelines are compiled with USE_TEXTURE_ARRAYS, see TextureArrays.
+    static inline bool s_useBindless = true;
 
 private:
+    [[nodiscard]] static Handle<Texture> upload(ResourceManager* mngr, glm::ivec2 dims, const void* data,
+        TextureDescriptor desc);
+    [[nodiscard]] GLsizeiptr queryByteSize(GLsizei levels);
+
     GLuint m_texture = 0;
     GLuint m_sampler = 0;
     GLuint64 m_handle = 0;
     glm::ivec2 m_dims{};
+    GLsizei m_levels = 0;
+    GLenum m_internalFormat = 0;
+    SamplerDescriptor m_samplerDesc{};
+    GLsizeiptr m_byteSize = 0;
     bool m_managed = true;
+    std::string_view m_tag{};
 };
 
 //------------------------------------------------------------------------
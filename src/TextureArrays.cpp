@@ -0,0 +1,161 @@
+#include "TextureArrays.hpp"
+
+#include "ResourceManager.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+//------------------------------------------------------------------------
+
+namespace Zhade
+{
+
+//------------------------------------------------------------------------
+
+namespace
+{
+
+//------------------------------------------------------------------------
+
+inline constexpr GLsizei s_initialCapacity = 8;
+
+//------------------------------------------------------------------------
+
+[[nodiscard]] GLuint createArray(const glm::ivec2& dims, GLsizei levels, GLenum internalFormat, GLsizei numLayers)
+{
+    GLuint texture = 0;
+    glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &texture);
+    glTextureStorage3D(texture, levels, internalFormat, dims.x, dims.y, numLayers);
+    return texture;
+}
+
+//------------------------------------------------------------------------
+
+}  // namespace
+
+//------------------------------------------------------------------------
+
+TextureArrays::~TextureArrays()
+{
+    for (const TextureArray& array : m_arrays) {
+        glDeleteTextures(1, &array.texture);
+        glDeleteSamplers(1, &array.sampler);
+    }
+}
+
+//------------------------------------------------------------------------
+
+GLuint64 TextureArrays::add(const Handle<Texture>& handle)
+{
+    if (const auto it = m_packed.find(handle); it != m_packed.end()) {
+        return it->second;
+    }
+
+    Texture& texture = *m_mngr->get(handle);
+
+    auto it = stdr::find_if(m_arrays, [&](const TextureArray& array) { return fits(array, texture); });
+    if (it == m_arrays.end()) {
+        if (m_arrays.size() == MAX_TEXTURE_ARRAYS) {
+            fmt::println("Cannot pack textures of more than {} sizes and formats into texture arrays",
+                MAX_TEXTURE_ARRAYS);
+            return pack(0, 0);
+        }
+        m_arrays.push_back({
+            .dims = texture.dims(),
+            .levels = texture.levels(),
+            .internalFormat = texture.internalFormat(),
+            .samplerDesc = texture.samplerDesc(),
+            .sampler = Texture::createSampler(texture.samplerDesc())
+        });
+        it = std::prev(m_arrays.end());
+    }
+    if (it->freeLayers.empty() and it->numLayers == it->capacity) releaseDestroyed();
+    if (it->freeLayers.empty() and it->numLayers == it->capacity and not grow(*it)) {
+        return pack(0, 0);
+    }
+
+    GLuint layer = 0;
+    if (it->freeLayers.empty()) {
+        layer = implicit_cast<GLuint>(it->numLayers++);
+    } else {
+        layer = it->freeLayers.back();
+        it->freeLayers.pop_back();
+    }
+    for (GLint level = 0; level < it->levels; ++level) {
+        const glm::ivec2 dims = glm::max(it->dims >> level, 1);
+        glCopyImageSubData(texture.name(), GL_TEXTURE_2D, level, 0, 0, 0,
+            it->texture, GL_TEXTURE_2D_ARRAY, level, 0, 0, implicit_cast<GLint>(layer), dims.x, dims.y, 1);
+    }
+
+    const GLuint64 packed = pack(implicit_cast<GLuint>(it - m_arrays.begin()), layer);
+    m_packed[handle] = packed;
+    return packed;
+}
+
+//------------------------------------------------------------------------
+
+void TextureArrays::bind()
+{
+    for (GLuint idx = 0; idx < m_arrays.size(); ++idx) {
+        glBindTextureUnit(TEXTURE_ARRAYS_UNIT + idx, m_arrays[idx].texture);
+        glBindSampler(TEXTURE_ARRAYS_UNIT + idx, m_arrays[idx].sampler);
+    }
+}
+
+//------------------------------------------------------------------------
+
+bool TextureArrays::fits(const TextureArray& array, Texture& texture)
+{
+    return array.dims == texture.dims() and array.levels == texture.levels()
+        and array.internalFormat == texture.internalFormat() and array.samplerDesc == texture.samplerDesc();
+}
+
+//------------------------------------------------------------------------
+
+// Into a new array with twice the layers, as immutable storage cannot be resized.
+bool TextureArrays::grow(TextureArray& array)
+{
+    GLint maxLayers = 0;
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+    const GLsizei capacity = std::min(std::max(2 * array.capacity, s_initialCapacity), maxLayers);
+    if (capacity <= array.capacity) {
+        fmt::println("Cannot add more than {} layers to a texture array", maxLayers);
+        return false;
+    }
+
+    const GLuint texture = createArray(array.dims, array.levels, array.internalFormat, capacity);
+    if (array.numLayers > 0) {
+        for (GLint level = 0; level < array.levels; ++level) {
+            const glm::ivec2 dims = glm::max(array.dims >> level, 1);
+            glCopyImageSubData(array.texture, GL_TEXTURE_2D_ARRAY, level, 0, 0, 0,
+                texture, GL_TEXTURE_2D_ARRAY, level, 0, 0, 0, dims.x, dims.y, array.numLayers);
+        }
+    }
+    glDeleteTextures(1, &array.texture);
+
+    array.texture = texture;
+    array.capacity = capacity;
+    return true;
+}
+
+//------------------------------------------------------------------------
+
+// Meshes sampling a destroyed texture belong to destroyed models, which are no longer drawn, so its layer is free.
+void TextureArrays::releaseDestroyed()
+{
+    for (auto it = m_packed.begin(); it != m_packed.end();) {
+        if (m_mngr->exists(it->first)) {
+            ++it;
+            continue;
+        }
+        const GLuint64 packed = it->second;
+        m_arrays[packed & UINT32_MAX].freeLayers.push_back(implicit_cast<GLuint>(packed >> 32));
+        it = m_packed.erase(it);
+    }
+}
+
+//------------------------------------------------------------------------
+
+}  // namespace Zhade
+
+//------------------------------------------------------------------------
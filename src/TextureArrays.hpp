@@ -0,0 +1,73 @@
+#pragma once
+
+#include "Handle.hpp"
+#include "Texture.hpp"
+#include "common.hpp"
+
+#include <robin_hood.h>
+
+#include <vector>
+
+//------------------------------------------------------------------------
+
+namespace Zhade
+{
+
+//------------------------------------------------------------------------
+// Mesh textures for drivers without GL_ARB_bindless_texture. Each texture is copied into a layer of one of up to
+// MAX_TEXTURE_ARRAYS GL_TEXTURE_2D_ARRAYs, one per size, format, number of levels and sampler, and is referred to by
+// the array and layer packed where its bindless handle would be. As all arrays are bound to consecutive units at once,
+// a whole scene still draws with one multi-draw. Once an array is full, the layers of its destroyed textures are
+// reused, and only then does it double its layers, which it keeps until destroyed.
+
+class ResourceManager;
+
+class TextureArrays
+{
+public:
+    explicit TextureArrays(ResourceManager* mngr) : m_mngr{mngr} {}
+    ~TextureArrays();
+
+    TextureArrays(const TextureArrays&) = delete;
+    TextureArrays& operator=(const TextureArrays&) = delete;
+    TextureArrays(TextureArrays&&) = delete;
+    TextureArrays& operator=(TextureArrays&&) = delete;
+
+    // Textures added before share their layer. Ones that fit no array get the first layer of the first array, so
+    // that the first texture added, e.g. a default one, stands in for them.
+    [[nodiscard]] GLuint64 add(const Handle<Texture>& handle);
+    void bind();  // To TEXTURE_ARRAYS_UNIT onwards.
+
+    [[nodiscard]] size_t numArrays() { return m_arrays.size(); }
+
+    // As uvec2(array, layer) in shaders, see TextureHandle in common_defs.h.
+    [[nodiscard]] static GLuint64 pack(GLuint array, GLuint layer) { return GLuint64{layer} << 32 | array; }
+
+private:
+    struct TextureArray
+    {
+        glm::ivec2 dims;
+        GLsizei levels;
+        GLenum internalFormat;
+        SamplerDescriptor samplerDesc;
+        GLuint texture = 0;
+        GLuint sampler = 0;
+        GLsizei numLayers = 0;
+        GLsizei capacity = 0;
+        std::vector<GLuint> freeLayers{};  // Below numLayers, of destroyed textures.
+    };
+
+    [[nodiscard]] bool fits(const TextureArray& array, Texture& texture);
+    [[nodiscard]] bool grow(TextureArray& array);
+    void releaseDestroyed();
+
+    ResourceManager* m_mngr;
+    std::vector<TextureArray> m_arrays;
+    robin_hood::unordered_map<Handle<Texture>, GLuint64> m_packed;
+};
+
+//------------------------------------------------------------------------
+
+}  // namespace Zhade
+
+//------------------------------------------------------------------------
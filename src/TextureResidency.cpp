@@ -0,0 +1,226 @@
+#include "TextureResidency.hpp"
+
+#include "ResourceManager.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+
+//------------------------------------------------------------------------
+
+namespace Zhade
+{
+
+//------------------------------------------------------------------------
+
+TextureResidency::TextureResidency(TextureResidencyDescriptor desc)
+    : m_mngr{desc.mngr},
+      m_budgetByteSize{desc.budgetByteSize},
+      m_minIdleFrames{desc.minIdleFrames},
+      m_trimmedMaxDim{desc.trimmedMaxDim}
+{}
+
+//------------------------------------------------------------------------
+
+GLuint64 TextureResidency::track(const Handle<Texture>& texture, const fs::path& source, uint32_t mesh)
+{
+    Texture* texturePtr = m_mngr->get(texture);
+    if (source.empty() or not fs::is_regular_file(source)) return texturePtr->handle();
+
+    // Texture::fromFile() loads the image anew once the texture it had cached for it was destroyed.
+    const auto it = m_entries.find(source);
+    if (it == m_entries.end() or not m_mngr->exists(it->second.texture)) {
+        m_entries[source] = Entry{
+            .texture = texture,
+            .desc = {
+                .dims = texturePtr->dims(),
+                .levels = texturePtr->levels(),
+                .internalFormat = texturePtr->internalFormat(),
+                .sampler = texturePtr->samplerDesc(),
+                .tag = texturePtr->tag()
+            },
+            .byteSize = implicit_cast<size_t>(texturePtr->byteSize()),
+            .lastUsed = m_frame
+        };
+    }
+
+    Entry& entry = m_entries[source];
+    entry.meshes.push_back(mesh);
+    return entry.state == ResidencyState::EVICTED ? m_mngr->get(m_fallback)->handle() : texturePtr->handle();
+}
+
+//------------------------------------------------------------------------
+
+void TextureResidency::update(std::span<Mesh> meshes, std::span<const GLuint> usage)
+{
+    ++m_frame;
+
+    size_t byteSize = 0;
+    for (auto it = m_entries.begin(); it != m_entries.end();) {
+        auto& [source, entry] = *it;
+        if (not m_mngr->exists(entry.texture)) {  // The models using it were destroyed.
+            forgetCached(source);
+            it = m_entries.erase(it);
+            continue;
+        }
+
+        for (uint32_t mesh : entry.meshes) {
+            if (mesh < usage.size()) entry.lastUsed = std::max(entry.lastUsed, usage[mesh]);
+        }
+        if (entry.reload and entry.reload->wait_for(std::chrono::seconds{0}) == std::future_status::ready) {
+            finishReload(entry, source, meshes);
+        }
+        byteSize += implicit_cast<size_t>(m_mngr->get(entry.texture)->byteSize());
+        ++it;
+    }
+
+    // Textures used again since they were degraded come back whole, as far as the budget allows. Evicting idle ones
+    // below makes room for the next frame.
+    for (auto& [source, entry] : m_entries) {
+        if (entry.state == ResidencyState::RESIDENT or entry.reload or entry.lastUsed <= entry.degradedAt) continue;
+        const auto currentByteSize = implicit_cast<size_t>(m_mngr->get(entry.texture)->byteSize());
+        if (byteSize - currentByteSize + entry.byteSize > m_budgetByteSize) continue;
+        byteSize += entry.byteSize - currentByteSize;
+        startReload(entry, source);
+    }
+
+    if (byteSize > m_budgetByteSize) {
+        std::vector<Entry*> idle;
+        for (auto& [source, entry] : m_entries) {
+            if (entry.state != ResidencyState::EVICTED and isIdle(entry)) idle.push_back(&entry);
+        }
+        stdr::sort(idle, stdr::less{}, [](const Entry* entry) { return entry->lastUsed; });
+
+        // Every idle texture loses its top levels before any is evicted, as trimmed ones still look about right.
+        for (Entry* entry : idle) {
+            if (byteSize <= m_budgetByteSize) break;
+            if (entry->state == ResidencyState::RESIDENT) byteSize -= trim(*entry, meshes);
+        }
+        for (Entry* entry : idle) {
+            if (byteSize <= m_budgetByteSize) break;
+            byteSize -= evict(*entry, meshes);
+        }
+    }
+
+    m_stats = {};
+    for (auto& [source, entry] : m_entries) {
+        m_stats.byteSize += implicit_cast<size_t>(m_mngr->get(entry.texture)->byteSize());
+        ++m_stats.numTextures[entry.state];
+        if (entry.reload) ++m_stats.numReloading;
+    }
+}
+
+//------------------------------------------------------------------------
+
+void TextureResidency::startReload(Entry& entry, const fs::path& source)
+{
+    entry.reload = std::async(std::launch::async, [source] { return StbImageResource<>{source}; });
+}
+
+//------------------------------------------------------------------------
+
+void TextureResidency::finishReload(Entry& entry, const fs::path& source, std::span<Mesh> meshes)
+{
+    StbImageResource<> image = entry.reload->get();
+    entry.reload.reset();
+    if (image.data() == nullptr) {
+        fmt::println("Error reloading texture {}, keeping it as it is", source.string());
+        entry.degradedAt = UINT32_MAX;  // Not retried, as it would most likely fail every frame.
+        return;
+    }
+
+    TextureDescriptor desc = entry.desc;
+    desc.dims = image.dims();
+    m_mngr->replaceTexture(entry.texture, desc, [&image](Texture& replacement, Texture&) {
+        replacement.setData(image.data());
+        replacement.generateMipmap();
+    });
+    entry.state = ResidencyState::RESIDENT;
+    pointMeshesAt(entry, meshes, m_mngr->get(entry.texture)->handle());
+}
+
+//------------------------------------------------------------------------
+
+// Keeps the levels from the first no larger than m_trimmedMaxDim on, copied on the GPU. Returns the bytes freed.
+size_t TextureResidency::trim(Entry& entry, std::span<Mesh> meshes)
+{
+    Texture* texture = m_mngr->get(entry.texture);
+    const GLsizei maxDim = std::max(texture->dims().x, texture->dims().y);
+    GLint firstLevel = 0;
+    while (firstLevel + 1 < texture->levels() and (maxDim >> firstLevel) > m_trimmedMaxDim) ++firstLevel;
+    if (firstLevel == 0) return 0;
+
+    const GLsizeiptr byteSize = texture->byteSize();
+    m_mngr->replaceTexture(entry.texture, {
+        .dims = glm::max(texture->dims() >> firstLevel, 1),
+        .levels = texture->levels() - firstLevel,
+        .internalFormat = texture->internalFormat(),
+        .sampler = texture->samplerDesc(),
+        .tag = texture->tag()
+    }, [firstLevel](Texture& replacement, Texture& original) {
+        for (GLint level = 0; level < replacement.levels(); ++level) {
+            const glm::ivec2 dims = glm::max(replacement.dims() >> level, 1);
+            glCopyImageSubData(original.name(), GL_TEXTURE_2D, firstLevel + level, 0, 0, 0,
+                replacement.name(), GL_TEXTURE_2D, level, 0, 0, 0, dims.x, dims.y, 1);
+        }
+    });
+    entry.state = ResidencyState::TRIMMED;
+    entry.degradedAt = m_frame;
+    pointMeshesAt(entry, meshes, texture->handle());
+    return implicit_cast<size_t>(byteSize - texture->byteSize());
+}
+
+//------------------------------------------------------------------------
+
+// Down to a single texel, which keeps the texture valid but is never sampled. Returns the bytes freed.
+size_t TextureResidency::evict(Entry& entry, std::span<Mesh> meshes)
+{
+    Texture* texture = m_mngr->get(entry.texture);
+    const GLsizeiptr byteSize = texture->byteSize();
+    m_mngr->replaceTexture(entry.texture, {
+        .dims = {1, 1},
+        .levels = 1,
+        .internalFormat = texture->internalFormat(),
+        .sampler = texture->samplerDesc(),
+        .tag = texture->tag()
+    });
+    entry.state = ResidencyState::EVICTED;
+    entry.degradedAt = m_frame;
+    pointMeshesAt(entry, meshes, m_mngr->get(m_fallback)->handle());
+    return implicit_cast<size_t>(byteSize - texture->byteSize());
+}
+
+//------------------------------------------------------------------------
+
+// Frames already submitted may still read the old handles, whose storage ResourceManager only frees after them.
+void TextureResidency::pointMeshesAt(Entry& entry, std::span<Mesh> meshes, GLuint64 handle)
+{
+    for (uint32_t mesh : entry.meshes) {
+        meshes[mesh].textures.diffuse = handle;
+    }
+}
+
+//------------------------------------------------------------------------
+
+bool TextureResidency::isIdle(const Entry& entry)
+{
+    return not entry.reload and m_frame - entry.lastUsed >= m_minIdleFrames;
+}
+
+//------------------------------------------------------------------------
+
+// So that Texture::s_cache, which never evicts on its own, does not keep one entry per image ever loaded.
+void TextureResidency::forgetCached(const fs::path& source)
+{
+    const std::scoped_lock lock{Texture::s_cacheMutex};
+    const auto cached = Texture::s_cache.find(source);
+    if (cached == Texture::s_cache.end()) return;
+    if (m_mngr->exists(cached->second) or m_mngr->isPending(cached->second)) return;
+    Texture::s_cache.erase(cached);
+}
+
+//------------------------------------------------------------------------
+
+}  // namespace Zhade
+
+//------------------------------------------------------------------------
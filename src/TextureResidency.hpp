@@ -0,0 +1,128 @@
+#pragma once
+
+#include "Handle.hpp"
+#include "StbImageResource.hpp"
+#include "Texture.hpp"
+#include "common.hpp"
+
+#include <robin_hood.h>
+
+#include <array>
+#include <future>
+#include <optional>
+#include <span>
+#include <vector>
+
+//------------------------------------------------------------------------
+
+namespace Zhade
+{
+
+//------------------------------------------------------------------------
+
+class ResourceManager;
+
+namespace ResidencyState
+{
+    using Type = uint8_t;
+    enum : Type
+    {
+        RESIDENT,
+        TRIMMED,
+        EVICTED,
+        NUM_RESIDENCY_STATES
+    };
+}
+
+inline constexpr const char* ResidencyState2Name[] {
+    "Resident",
+    "Trimmed",
+    "Evicted"
+};
+
+struct TextureResidencyDescriptor
+{
+    ResourceManager* mngr = nullptr;
+    size_t budgetByteSize = GIB_BYTES;  // Of the tracked textures, other textures are never evicted.
+    uint32_t minIdleFrames = 300;       // Since a texture was last used, before it may be trimmed or evicted.
+    GLsizei trimmedMaxDim = 128;        // Of the largest level trimmed textures keep.
+};
+
+struct TextureResidencyStats
+{
+    size_t byteSize = 0;  // Of the tracked textures as they are now.
+    std::array<uint32_t, ResidencyState::NUM_RESIDENCY_STATES> numTextures{};
+    uint32_t numReloading = 0;
+};
+
+//------------------------------------------------------------------------
+// Keeps the mesh textures loaded from image files within a byte budget. The shading passes store the frame number as
+// the last use of each mesh they shade a visible pixel of, and a texture was last used when the last of its meshes was.
+// While over budget, the least recently used textures that have been idle for a while first lose their top mip levels,
+// and are then evicted, i.e. their meshes are pointed at the fallback texture. Either way their handles stay valid, as
+// ResourceManager::replaceTexture() swaps their storage. Once a mesh of a trimmed or evicted texture is used again, the
+// image is decoded again on a worker thread and uploaded whole, budget permitting.
+//
+// Usage is read from copies of the usage buffer and lags the GPU by the frames in flight, which is far less than the
+// idle time. Textures without an image file to reload from, e.g. embedded in glTF files, are not tracked.
+
+class TextureResidency
+{
+public:
+    explicit TextureResidency(TextureResidencyDescriptor desc);
+
+    TextureResidency(const TextureResidency&) = delete;
+    TextureResidency& operator=(const TextureResidency&) = delete;
+    TextureResidency(TextureResidency&&) = delete;
+    TextureResidency& operator=(TextureResidency&&) = delete;
+
+    [[nodiscard]] uint32_t frame() { return m_frame; }  // As stored in the usage buffer by this frame's passes.
+    [[nodiscard]] size_t budgetByteSize() { return m_budgetByteSize; }
+    [[nodiscard]] const TextureResidencyStats& stats() { return m_stats; }
+
+    void setBudgetByteSize(size_t byteSize) { m_budgetByteSize = byteSize; }
+    void setFallback(const Handle<Texture>& texture) { m_fallback = texture; }
+
+    // Returns what the mesh at the index should sample through, which is the fallback while the texture is evicted.
+    [[nodiscard]] GLuint64 track(const Handle<Texture>& texture, const fs::path& source, uint32_t mesh);
+
+    // GL thread only, once per frame before the scene is drawn. Both spans are indexed by mesh, and usage may not cover
+    // the meshes added since it was read back yet.
+    void update(std::span<Mesh> meshes, std::span<const GLuint> usage);
+
+private:
+    struct Entry
+    {
+        Handle<Texture> texture;
+        TextureDescriptor desc;  // Of the whole texture, as loaded.
+        size_t byteSize;         // Likewise.
+        std::vector<uint32_t> meshes{};
+        uint32_t lastUsed = 0;
+        uint32_t degradedAt = 0;  // The frame the texture was trimmed or evicted in.
+        ResidencyState::Type state = ResidencyState::RESIDENT;
+        std::optional<std::future<StbImageResource<>>> reload{};
+    };
+
+    void startReload(Entry& entry, const fs::path& source);
+    void finishReload(Entry& entry, const fs::path& source, std::span<Mesh> meshes);
+    [[nodiscard]] size_t trim(Entry& entry, std::span<Mesh> meshes);
+    [[nodiscard]] size_t evict(Entry& entry, std::span<Mesh> meshes);
+    void pointMeshesAt(Entry& entry, std::span<Mesh> meshes, GLuint64 handle);
+    [[nodiscard]] bool isIdle(const Entry& entry);
+    void forgetCached(const fs::path& source);
+
+    ResourceManager* m_mngr;
+    size_t m_budgetByteSize;
+    uint32_t m_minIdleFrames;
+    GLsizei m_trimmedMaxDim;
+    Handle<Texture> m_fallback;
+    uint32_t m_frame = 0;  // Counts from 1 in update(), as the usage buffer starts zeroed.
+    robin_hood::unordered_map<fs::path, Entry> m_entries;  // By image file, as Texture::s_cache is.
+    TextureResidencyStats m_stats;
+};
+
+//------------------------------------------------------------------------
+
+}  // namespace Zhade
+
+//------------------------------------------------------------------------
@@ -0,0 +1 @@
+#include "TripleBuffer.hpp"
\ No newline at end of file
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "common.hpp"
+
+#include <array>
+#include <atomic>
+#include <concepts>
+
+//------------------------------------------------------------------------
+
+namespace Zhade
+{
+
+//------------------------------------------------------------------------
+// Lock-free handoff of the newest value from one producer thread to one consumer thread. Each side owns a slot, and
+// the third is swapped with either side through one atomic, so that neither ever waits for the other and the consumer
+// skips whatever it was too slow to see.
+
+template<std::copyable T>
+class TripleBuffer
+{
+public:
+    // Producer only.
+    void write(const T& value)
+    {
+        m_slots[m_back] = value;
+        const uint8_t prev = m_middle.exchange(m_back | s_freshBit, std::memory_order_acq_rel);
+        m_back = prev & s_idxMask;
+    }
+
+    // Consumer only. The newest value written, which stays valid until the next read(), or a value-initialized one
+    // before the first write().
+    [[nodiscard]] const T& read()
+    {
+        if (m_middle.load(std::memory_order_relaxed) & s_freshBit) {
+            const uint8_t prev = m_middle.exchange(m_front, std::memory_order_acq_rel);
+            m_front = prev & s_idxMask;
+        }
+        return m_slots[m_front];
+    }
+
+private:
+    static constexpr uint8_t s_idxMask = 0b011;
+    static constexpr uint8_t s_freshBit = 0b100;
+
+    std::array<T, 3> m_slots{};
+    alignas(CACHE_LINE_BYTES) std::atomic<uint8_t> m_middle{1};
+    alignas(CACHE_LINE_BYTES) uint8_t m_back = 0;  // Apart from each other, so that the two threads never share lines.
+    alignas(CACHE_LINE_BYTES) uint8_t m_front = 2;
+};
+
+//------------------------------------------------------------------------
+
+}  // namespace Zhade
+
+//------------------------------------------------------------------------
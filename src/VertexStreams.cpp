@@ -0,0 +1,105 @@
+#include "VertexStreams.hpp"
+
+#include <bit>
+
+#if defined(__SSE2__) || defined(_M_X64)
+    #include <immintrin.h>
+#endif
+
+//------------------------------------------------------------------------
+
+namespace Zhade
+{
+
+//------------------------------------------------------------------------
+
+namespace
+{
+
+//------------------------------------------------------------------------
+
+[[nodiscard]] const float* element(const VertexStream& stream, size_t idx)
+{
+    return std::bit_cast<const float*>(stream.data + idx * stream.stride);
+}
+
+[[nodiscard]] glm::vec3 vec3At(const VertexStream& stream, size_t idx)
+{
+    const float* vec = element(stream, idx);
+    return {vec[0], vec[1], vec[2]};
+}
+
+[[nodiscard]] glm::vec2 vec2At(const VertexStream& stream, size_t idx)
+{
+    const float* vec = element(stream, idx);
+    return {vec[0], vec[1]};
+}
+
+//------------------------------------------------------------------------
+
+}  // namespace
+
+//------------------------------------------------------------------------
+
+// Two shuffles per vertex turn the three streams into the two halves of a Vertex. Loads read 16 bytes, which may
+// reach into the next element, so the last vertex goes through the scalar path.
+void interleaveVertices(const VertexStreams& streams, std::span<Vertex> dst)
+{
+    static_assert(sizeof(Vertex) == 8 * sizeof(float));
+    const auto& [positions, normals, uvs, flipV] = streams;
+    size_t idx = 0;
+
+#if defined(__SSE2__) || defined(_M_X64)
+    // v' = 1 - v where flipped, exact otherwise.
+    const __m128 uvScale = _mm_setr_ps(1.0f, flipV ? -1.0f : 1.0f, 1.0f, 1.0f);
+    const __m128 uvBias = _mm_setr_ps(0.0f, flipV ? 1.0f : 0.0f, 0.0f, 0.0f);
+    for (; idx + 1 < dst.size(); ++idx) {
+        const __m128 pos = positions.data ? _mm_loadu_ps(element(positions, idx)) : _mm_setzero_ps();
+        const __m128 nrm = normals.data ? _mm_loadu_ps(element(normals, idx)) : _mm_setzero_ps();
+        const __m128 uv = uvs.data
+            ? _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(element(uvs, idx)), uvScale), uvBias)
+            : _mm_setzero_ps();
+
+        // (pos.z, pos.z, nrm.x, nrm.x), so that one more shuffle completes (pos.xyz, nrm.x).
+        const __m128 seam = _mm_shuffle_ps(pos, nrm, _MM_SHUFFLE(0, 0, 2, 2));
+        float* out = &dst[idx].pos.x;
+        _mm_storeu_ps(out, _mm_shuffle_ps(pos, seam, _MM_SHUFFLE(2, 0, 1, 0)));
+        _mm_storeu_ps(out + 4, _mm_shuffle_ps(nrm, uv, _MM_SHUFFLE(1, 0, 2, 1)));
+    }
+#endif
+
+    for (; idx < dst.size(); ++idx) {
+        Vertex vertex{};
+        if (positions.data) vertex.pos = vec3At(positions, idx);
+        if (normals.data) vertex.nrm = vec3At(normals, idx);
+        if (uvs.data) vertex.uv = vec2At(uvs, idx);
+        if (uvs.data and flipV) vertex.uv.y = 1.0f - vertex.uv.y;
+        dst[idx] = vertex;
+    }
+}
+
+//------------------------------------------------------------------------
+
+void widenIndices(std::span<const uint16_t> src, std::span<GLuint> dst)
+{
+    size_t idx = 0;
+
+#if defined(__SSE2__) || defined(_M_X64)
+    const __m128i zero = _mm_setzero_si128();
+    for (; idx + 8 <= src.size(); idx += 8) {
+        const __m128i indices = _mm_loadu_si128(std::bit_cast<const __m128i*>(&src[idx]));
+        _mm_storeu_si128(std::bit_cast<__m128i*>(&dst[idx]), _mm_unpacklo_epi16(indices, zero));
+        _mm_storeu_si128(std::bit_cast<__m128i*>(&dst[idx + 4]), _mm_unpackhi_epi16(indices, zero));
+    }
+#endif
+
+    for (; idx < src.size(); ++idx) {
+        dst[idx] = src[idx];
+    }
+}
+
+//------------------------------------------------------------------------
+
+}  // namespace Zhade
+
+//------------------------------------------------------------------------
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "common.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+//------------------------------------------------------------------------
+
+namespace Zhade
+{
+
+//------------------------------------------------------------------------
+
+// Strided float vectors, e.g. one attribute of an interleaved buffer or an array of its own. Null if absent.
+struct VertexStream
+{
+    const std::byte* data = nullptr;
+    size_t stride = 0;  // At least the size of the vector.
+};
+
+struct VertexStreams
+{
+    VertexStream positions;  // 3 floats.
+    VertexStream normals;    // 3 floats.
+    VertexStream uvs;        // 2 floats.
+    bool flipV = false;      // For texture coordinates with their origin at the top, as images are flipped on load.
+};
+
+//------------------------------------------------------------------------
+
+// Into dst, one vertex per element, e.g. straight into a mapped buffer. Absent streams are written as zeros.
+void interleaveVertices(const VertexStreams& streams, std::span<Vertex> dst);
+
+// Into dst, which holds as many elements as src.
+void widenIndices(std::span<const uint16_t> src, std::span<GLuint> dst);
+
+//------------------------------------------------------------------------
+
+}  // namespace Zhade
+
+//------------------------------------------------------------------------
@@ -47,13 +47,35 @@ inline const fs::path SOURCE_PATH  = fs::path{".."} / "src";
 inline const fs::path SHADER_PATH  = SOURCE_PATH / "shaders";
 inline const fs::path TEXTURE_PATH = fs::path{".."} / "texture";
 inline const fs::path ASSET_PATH   = fs::path{".."} / "assets";
+inline const fs::path BENCH_PATH   = fs::path{".."} / "bench";
+inline const fs::path SPONZA_PATH  = ASSET_PATH / "crytek-sponza" / "sponza.obj";
+
+// Relative to the working directory, i.e. the build directory, which is also where the SPIR-V target writes to.
+inline const fs::path PROGRAM_CACHE_PATH = "program_cache";
+inline const fs::path SPIRV_PATH         = "spirv";
 
 inline constexpr int32_t ASSIMP_LOAD_FLAGS = aiProcess_Triangulate | aiProcess_GenSmoothNormals;
+inline constexpr size_t OBJ_MIN_CHUNK_BYTES = 256 * KIB_BYTES;  // Smaller files are not worth parsing on many threads.
 
 inline constexpr size_t OBJECT_POOL_INIT_SIZE         = 32;
+inline constexpr size_t OBJECT_POOL_CHUNK_SIZE        = 256;
+inline constexpr size_t OBJECT_POOL_MAX_CHUNKS        = 16384;
+inline constexpr size_t CACHE_LINE_BYTES              = 64;
 inline constexpr size_t DYNAMIC_STORAGE_GROWTH_FACTOR = 2;
 inline constexpr uint16_t LOCAL_CHAR_BUF_SIZE         = 2048;
 
+inline constexpr size_t FRAMES_IN_FLIGHT       = 3;
+inline constexpr size_t RING_BUFFER_FRAME_SIZE = 64 * KIB_BYTES;
+
+inline constexpr size_t PROFILER_QUERY_LATENCY    = 2;  // Frames between issuing a timestamp query and reading it.
+inline constexpr size_t PROFILER_HISTORY_SIZE     = 256;
+inline constexpr size_t PROFILER_MAX_TRACE_EVENTS = 1 << 16;
+
+inline constexpr float DYNAMIC_RESOLUTION_DEAD_BAND   = 0.05f;  // Fraction of the budget GPU times may deviate by.
+inline constexpr float DYNAMIC_RESOLUTION_DOWN_RATE   = 0.5f;   // Fraction of the way to the ideal scale per sample.
+inline constexpr float DYNAMIC_RESOLUTION_UP_RATE     = 0.1f;
+inline constexpr int32_t DYNAMIC_RESOLUTION_ALIGNMENT = 8;      // Pixels, so that scaled dims stay tile friendly.
+
 //------------------------------------------------------------------------
 
 }  // namespace Zhade
@@ -10,6 +10,16 @@
 #define DIRECTIONAL_LIGHT_PROPS_BINDING         6
 #define DIRECTIONAL_LIGHT_DEPTH_TEXTURE_BINDING 7
 #define DIRECTIONAL_LIGHT_SHADOW_MATRIX_BINDING 8
+#define DIRECTIONAL_LIGHT_SHADOW_FILTER_BINDING 9
+#define VERTEX_BINDING                          10
+#define INDEX_BINDING                           11
+#define LOCAL_LIGHTS_BINDING                    12
+#define LIGHT_CLUSTER_SETTINGS_BINDING          13
+#define LIGHT_CLUSTERS_BINDING                  14
+#define LIGHT_INDICES_BINDING                   15
+#define LIGHT_CLUSTER_COUNTS_BINDING            16
+#define LIGHT_CLUSTER_SLOTS_BINDING             17
+#define MESH_USAGE_BINDING                      18
 
 #define WORK_GROUP_LOCAL_SIZE_X 256
 #define WORK_GROUP_LOCAL_SIZE_Y   1
@@ -17,6 +27,50 @@
 
 #define MAX_DRAWS (1 << 24)
 
+#define SHADOW_FILTER_PCF  0
+#define SHADOW_FILTER_EVSM 1
+
+#define EVSM_BLUR_LOCAL_SIZE 16
+#define EVSM_BLUR_RADIUS      4
+
+// A visibility buffer texel packs the draw ID above the triangle ID, which leaves 12 bits for it. The last draw ID is
+// reserved, so that no covered texel reads as VISIBILITY_EMPTY, and scenes beyond either limit are drawn forward.
+#define VISIBILITY_TRIANGLE_BITS      20
+#define VISIBILITY_TRIANGLE_MASK      ((1u << VISIBILITY_TRIANGLE_BITS) - 1u)
+#define VISIBILITY_MAX_TRIANGLES      (VISIBILITY_TRIANGLE_MASK + 1u)  // Per draw.
+#define VISIBILITY_MAX_DRAWS          ((1u << (32 - VISIBILITY_TRIANGLE_BITS)) - 1u)
+#define VISIBILITY_EMPTY              0xFFFFFFFFu
+#define VISIBILITY_RESOLVE_LOCAL_SIZE 8
+#define VERTEX_NUM_FLOATS             8  // Position, normal and UV of a Vertex, read as floats by the resolve.
+
+#define LOCAL_LIGHT_POINT 0
+#define LOCAL_LIGHT_SPOT  1
+
+// Local lights are binned into a grid of froxels, tiled in screen space and sliced exponentially in view depth.
+#define MAX_LOCAL_LIGHTS           16384
+#define LIGHT_CLUSTER_GRID_X          16
+#define LIGHT_CLUSTER_GRID_Y           9
+#define LIGHT_CLUSTER_GRID_Z          24
+#define NUM_LIGHT_CLUSTERS         (LIGHT_CLUSTER_GRID_X * LIGHT_CLUSTER_GRID_Y * LIGHT_CLUSTER_GRID_Z)
+#define MAX_LIGHTS_PER_CLUSTER       256
+
+// Texture units of the fallback for drivers without bindless textures, which samples mesh textures from layers of
+// texture arrays, see TextureArrays, and the shadow maps from plain texture units.
+#define MAX_TEXTURE_ARRAYS          8
+#define TEXTURE_ARRAYS_UNIT         0  // The first of MAX_TEXTURE_ARRAYS consecutive units.
+#define SUN_DEPTH_TEXTURE_UNIT      8
+#define SHADOW_MOMENTS_TEXTURE_UNIT 9
+
+// Shading passes store the frame number, a uniform at this location, as the last use of each mesh they shade a pixel
+// of, which is what TextureResidency evicts textures by.
+#define MESH_USAGE_FRAME_LOCATION 2
+
+// The compute work group sizes are specialization constants in the offline SPIR-V modules, with the sizes above as
+// their defaults.
+#define LOCAL_SIZE_X_CONSTANT_ID 0
+#define LOCAL_SIZE_Y_CONSTANT_ID 1
+#define LOCAL_SIZE_Z_CONSTANT_ID 2
+
 #ifdef __cplusplus
 
 #include <glm/glm.hpp>
@@ -31,7 +85,8 @@ struct MeshTextures
     GLuint64 diffuse;
 };
 
-struct Mesh
+// Aligned so that the C++ array stride matches the std140 one in the mesh buffer.
+struct alignas(16) Mesh
 {
     GLuint numIndices;
     GLuint firstIndex;
@@ -73,11 +128,56 @@ struct ViewProjMatrices
     glm::mat4 projMat;
 };
 
+struct ShadowFilterSettings
+{
+    GLuint64 momentsTexture;
+    GLuint mode;
+    GLfloat positiveExponent;
+    GLfloat negativeExponent;
+    GLfloat lightBleedReduction;
+    GLfloat _1;
+    GLfloat _2;
+};
+
+// std140 rounds the block up to a multiple of 16 bytes, and the buffer is sized from this.
+static_assert(sizeof(ShadowFilterSettings) == 32);
+
+struct LocalLight
+{
+    glm::vec3 position;
+    GLfloat range;          // Distance at which the light has faded out completely.
+    glm::vec3 color;
+    GLfloat intensity;
+    glm::vec3 direction;    // Spot lights only, as are the cone angles.
+    GLfloat cosOuterAngle;
+    GLfloat cosInnerAngle;
+    GLuint type;
+    GLfloat _1;
+    GLfloat _2;
+};
+
+struct LightClusterSettings
+{
+    glm::vec2 tileSize;  // In pixels.
+    GLfloat zNear;
+    GLfloat zFar;
+    GLfloat sliceScale;  // Slice of a view depth d is log(d) * sliceScale + sliceBias.
+    GLfloat sliceBias;
+    GLuint numLights;
+};
+
+#else
+
+// Packed the same way as the GLuint64 handles on the C++ side, so that the layouts match.
+#ifdef USE_TEXTURE_ARRAYS
+#define TextureHandle uvec2  // Array and layer.
 #else
+#define TextureHandle uint64_t
+#endif
 
 struct MeshTextures
 {
-    uint64_t diffuse;
+    TextureHandle diffuse;
 };
 
 struct Mesh
@@ -122,6 +222,41 @@ struct ViewProjMatrices
     mat4 projMat;
 };
 
+struct ShadowFilterSettings
+{
+    TextureHandle momentsTexture;
+    uint mode;
+    float positiveExponent;
+    float negativeExponent;
+    float lightBleedReduction;
+    float _1;
+    float _2;
+};
+
+struct LocalLight
+{
+    vec3 position;
+    float range;
+    vec3 color;
+    float intensity;
+    vec3 direction;
+    float cosOuterAngle;
+    float cosInnerAngle;
+    uint type;
+    float _1;
+    float _2;
+};
+
+struct LightClusterSettings
+{
+    vec2 tileSize;
+    float zNear;
+    float zFar;
+    float sliceScale;
+    float sliceBias;
+    uint numLights;
+};
+
 #endif  // __cplusplus
 
 #endif  // COMMON_DEFS_H
@@ -0,0 +1,48 @@
+#ifndef LIGHT_CLUSTERS_GLSL
+#define LIGHT_CLUSTERS_GLSL
+
+// The froxel grid local lights are binned into, shared by the binning pass and the shading passes looking lights up.
+// Includers include common_defs.h first.
+
+//------------------------------------------------------------------------
+// Uniforms etc.
+
+layout (binding = LIGHT_CLUSTER_SETTINGS_BINDING, std140) uniform LightClusterSettingsBlock {
+    LightClusterSettings u_clusters;
+};
+
+layout (binding = LOCAL_LIGHTS_BINDING, std430) restrict readonly buffer LocalLightBlock {
+    LocalLight b_lights[];
+};
+
+//------------------------------------------------------------------------
+
+const uvec3 c_lightClusterGrid = uvec3(LIGHT_CLUSTER_GRID_X, LIGHT_CLUSTER_GRID_Y, LIGHT_CLUSTER_GRID_Z);
+
+// Slices are exponentially spaced, so that froxels stay roughly cubic at every depth.
+uint lightClusterSlice(float viewDepth)
+{
+    float slice = log(max(viewDepth, u_clusters.zNear)) * u_clusters.sliceScale + u_clusters.sliceBias;
+    return min(uint(max(slice, 0.0)), c_lightClusterGrid.z - 1u);
+}
+
+float lightClusterSliceDepth(uint slice)
+{
+    return u_clusters.zNear * pow(u_clusters.zFar / u_clusters.zNear, float(slice) / float(c_lightClusterGrid.z));
+}
+
+uint lightClusterIndex(uvec3 cluster)
+{
+    return (cluster.z * c_lightClusterGrid.y + cluster.y) * c_lightClusterGrid.x + cluster.x;
+}
+
+// pixel is in window coordinates, viewDepth the distance along the camera's view direction.
+uint lightClusterIndex(vec2 pixel, float viewDepth)
+{
+    uvec2 tile = min(uvec2(pixel / u_clusters.tileSize), c_lightClusterGrid.xy - 1u);
+    return lightClusterIndex(uvec3(tile, lightClusterSlice(viewDepth)));
+}
+
+//------------------------------------------------------------------------
+
+#endif  // LIGHT_CLUSTERS_GLSL
@@ -1,59 +1,64 @@
 #include "App.hpp"
-#include "Camera.hpp"
 #include "Renderer.hpp"
 #include "ResourceManager.hpp"
+#include "Simulation.hpp"
+
+#include <optional>
 
 //------------------------------------------------------------------------
 
-int main()
+int main(int argc, char* argv[])
 {
     using namespace Zhade;
 
-    ResourceManager mngr;
+    const LaunchOptions options = LaunchOptions::fromArgs(argc, argv);
 
     App app;
-    app.init();
+    if (not app.init(options)) return 1;
+
+    // Declared after the app, so that whatever is still alive is freed while its GL context is current.
+    ResourceManager mngr;
     {
-        Renderer renderer{{
-            .mngr = &mngr,
-            .sceneDesc = {
-                .mngr = &mngr,
-                .sunLightDesc = {
-                    .mngr = &mngr,
-                    .props = {
-                        .direction = glm::vec3{0.273005, -0.960278, 0.057737},
-                        .strength = 1.0f,
-                        .color = {1.0f, 1.0f, 1.0f},
-                        .ambient = {0.4f, 0.4f, 0.4f}
-                    },
-                    .shadowMapDims = {2048, 2048},
-                    .shadowPassDesc = {
-                        .vertPath = SHADER_PATH / "shadowMap.vert",
-                        .fragPath = SHADER_PATH / "passthrough.frag",
-                        .compPath = SHADER_PATH / "populateBuffers.comp"
-                    }
-                }
-            },
-            .cameraDesc = {
-                .mngr = &mngr,
-                .app = &app
-            },
-            .mainPassDesc = {
-                .vertPath = SHADER_PATH / "main.vert",
-                .fragPath = SHADER_PATH / "main.frag"
-            }
-        }};
+        RendererDescriptor rendererDesc = RendererDescriptor::makeDefault(&mngr, &app, options.headless);
+        if (options.textureBudgetMiB) {
+            rendererDesc.sceneDesc.textureResidencyDesc.budgetByteSize = *options.textureBudgetMiB * MIB_BYTES;
+        }
+
+        // Headless runs have no input to simulate. Declared before the renderer, which latches its poses.
+        std::optional<Simulation> simulation;
+        if (not app.isHeadless()) {
+            simulation.emplace(SimulationDescriptor{.app = &app, .cameraDesc = rendererDesc.cameraDesc});
+            rendererDesc.simulation = &*simulation;
+        }
+        Renderer renderer{rendererDesc};
 
-        renderer.scene().addModelFromFile(ASSET_PATH / "crytek-sponza" / "sponza.obj");
+        renderer.scene().addModelFromFile(SPONZA_PATH);
+
+        // Headless runs have nothing to stop them but the frame count.
+        const uint32_t numFrames = options.numFrames.value_or(options.headless ? 100 : UINT32_MAX);
+
+        for (uint32_t frame = 0; frame < numFrames; ++frame) {
+            // Waiting for the GPU before polling rather than after, so that the frame shows the freshest input.
+            renderer.waitForFrameSlot();
+            if (not app.isHeadless()) {
+                if (glfwWindowShouldClose(app.glCtx())) break;
+                glfwPollEvents();
+                app.publishInput();
+            }
 
-        while (not glfwWindowShouldClose(app.glCtx()))
-        {
-            glfwPollEvents();
-            renderer.camera().update();
             renderer.render();
-            app.updateAndRenderGUI();
+
+            if (app.isHeadless()) continue;
+
+            app.updateAndRenderGUI(renderer);
+            if (frame + 1 == numFrames) renderer.saveFrame(options.colorDumpPath, options.depthDumpPath);
             glfwSwapBuffers(app.glCtx());
         }
+
+        if (app.isHeadless()) {
+            glFinish();
+            renderer.saveFrame(options.colorDumpPath, options.depthDumpPath);
+        }
     }
 
     return 0;
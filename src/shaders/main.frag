@@ -1,11 +1,21 @@
 #version 460 core
+#ifndef USE_TEXTURE_ARRAYS
 #extension GL_ARB_bindless_texture : require
 #extension GL_ARB_gpu_shader_int64 : require
+#endif
+#ifdef GL_SPIRV
+#extension GL_GOOGLE_include_directive : require
+#else
 #extension GL_ARB_shading_language_include : require
+#endif
 
 #include "common_defs.h"
+#include "shading.glsl"
 
-#define makeSampler2D(textureType) sampler2D(b_meta[In.drawID].textures.textureType)
+//------------------------------------------------------------------------
+
+// Nothing discards or writes depth, so testing early changes no pixel, and only visible fragments mark their mesh used.
+layout (early_fragment_tests) in;
 
 //------------------------------------------------------------------------
 // Outputs.
@@ -17,6 +27,8 @@ layout (location = 0) out vec4 FragColor;
 
 in VERT_OUT {
     vec2 uv;
+    vec3 worldPos;
+    vec3 nrm;
     vec4 shadowCoord;
     flat uint drawID;
 } In;
@@ -28,21 +40,19 @@ layout (binding = DRAW_METADATA_BINDING, std430) restrict readonly buffer DrawMe
     DrawMetadata b_meta[];
 };
 
-layout (binding = DIRECTIONAL_LIGHT_PROPS_BINDING, std430) restrict readonly buffer SunLightBlock {
-    DirectionalLightProperties b_sunLight;
-};
-
-layout (binding = DIRECTIONAL_LIGHT_DEPTH_TEXTURE_BINDING, std140) uniform SunLightDepthTextureBlock {
-    sampler2DShadow u_sunLightDepthTexture;
-};
-
 //------------------------------------------------------------------------
 
 void main()
 {
-    vec4 diffuse = texture(makeSampler2D(diffuse), In.uv);
-    float shadowFactor = textureProj(u_sunLightDepthTexture, In.shadowCoord);
-    FragColor = shadowFactor * 0.7 * diffuse + vec4(b_sunLight.ambient, 1.0) * diffuse;
+    vec4 diffuse = sampleMeshTexture(b_meta[In.drawID].textures.diffuse, In.uv, dFdx(In.uv), dFdy(In.uv));
+    markMeshUsed(In.drawID);
+    vec2 shadowUV = In.shadowCoord.xy / In.shadowCoord.w;
+    float shadowFactor = sunShadowFactor(In.shadowCoord, dFdx(shadowUV), dFdy(shadowUV));
+    FragColor = shadeSunLit(diffuse, shadowFactor);
+
+    // The fragment's w is the reciprocal of its view depth under a perspective projection.
+    vec3 local = shadeLocalLights(diffuse.rgb, In.worldPos, normalize(In.nrm), gl_FragCoord.xy, 1.0 / gl_FragCoord.w);
+    FragColor.rgb += local;
 }
 
 //------------------------------------------------------------------------
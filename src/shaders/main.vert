@@ -1,6 +1,12 @@
 #version 460 core
+#ifndef USE_TEXTURE_ARRAYS
 #extension GL_ARB_gpu_shader_int64 : require
+#endif
+#ifdef GL_SPIRV
+#extension GL_GOOGLE_include_directive : require
+#else
 #extension GL_ARB_shading_language_include : require
+#endif
 
 #include "common_defs.h"
 
@@ -20,6 +26,8 @@ out gl_PerVertex {
 
 out VERT_OUT {
     vec2 uv;
+    vec3 worldPos;
+    vec3 nrm;
     vec4 shadowCoord;
     flat uint drawID;
 } Out;
@@ -50,6 +58,8 @@ void main()
     Out.uv = a_uv;
     Out.drawID = gl_DrawID;
     vec3 modelWorld = vec4(a_pos, 1.0) * b_meta[gl_DrawID].modelMatT;
+    Out.worldPos = modelWorld;
+    Out.nrm = b_meta[gl_DrawID].normalMat * a_nrm;
     vec3 viewModel = vec4(modelWorld, 1.0) * u_viewProj.viewMatT;
     Out.shadowCoord = u_shadowMat * vec4(modelWorld, 1.0);
     gl_Position = u_viewProj.projMat * vec4(viewModel, 1.0);
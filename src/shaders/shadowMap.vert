@@ -1,6 +1,12 @@
 #version 460 core
+#ifndef USE_TEXTURE_ARRAYS
 #extension GL_ARB_gpu_shader_int64 : require
+#endif
+#ifdef GL_SPIRV
+#extension GL_GOOGLE_include_directive : require
+#else
 #extension GL_ARB_shading_language_include : require
+#endif
 
 #include "common_defs.h"
 
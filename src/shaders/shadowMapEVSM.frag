@@ -0,0 +1,35 @@
+#version 460 core
+#ifndef USE_TEXTURE_ARRAYS
+#extension GL_ARB_gpu_shader_int64 : require
+#endif
+#ifdef GL_SPIRV
+#extension GL_GOOGLE_include_directive : require
+#else
+#extension GL_ARB_shading_language_include : require
+#endif
+
+#include "common_defs.h"
+
+//------------------------------------------------------------------------
+// Outputs.
+
+layout (location = 0) out vec4 Moments;
+
+//------------------------------------------------------------------------
+// Uniforms etc.
+
+layout (binding = DIRECTIONAL_LIGHT_SHADOW_FILTER_BINDING, std140) uniform ShadowFilterBlock {
+    ShadowFilterSettings u_shadowFilter;
+};
+
+//------------------------------------------------------------------------
+
+void main()
+{
+    float depth = 2.0 * gl_FragCoord.z - 1.0;
+    float pos = exp(u_shadowFilter.positiveExponent * depth);
+    float neg = -exp(-u_shadowFilter.negativeExponent * depth);
+    Moments = vec4(pos, pos * pos, neg, neg * neg);
+}
+
+//------------------------------------------------------------------------
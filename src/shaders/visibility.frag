@@ -0,0 +1,33 @@
+#version 460 core
+#ifndef USE_TEXTURE_ARRAYS
+#extension GL_ARB_gpu_shader_int64 : require
+#endif
+#ifdef GL_SPIRV
+#extension GL_GOOGLE_include_directive : require
+#else
+#extension GL_ARB_shading_language_include : require
+#endif
+
+#include "common_defs.h"
+
+//------------------------------------------------------------------------
+// Outputs.
+
+layout (location = 0) out uint Visibility;
+
+//------------------------------------------------------------------------
+// Inputs from previous pipeline stages.
+
+in VERT_OUT {
+    flat uint drawID;
+} In;
+
+//------------------------------------------------------------------------
+
+// gl_PrimitiveID restarts at zero for every draw of a multi-draw, so it indexes the triangles of the draw's command.
+void main()
+{
+    Visibility = (In.drawID << VISIBILITY_TRIANGLE_BITS) | (uint(gl_PrimitiveID) & VISIBILITY_TRIANGLE_MASK);
+}
+
+//------------------------------------------------------------------------
@@ -0,0 +1,162 @@
+#ifndef SHADING_GLSL
+#define SHADING_GLSL
+
+// Lighting shared by the forward main pass and the visibility buffer resolve. Includers enable
+// GL_ARB_bindless_texture unless USE_TEXTURE_ARRAYS is defined, and include common_defs.h first. Gradients are
+// explicit, as compute shaders have none.
+
+#include "lightClusters.glsl"
+
+//------------------------------------------------------------------------
+// Uniforms etc.
+
+layout (binding = DIRECTIONAL_LIGHT_PROPS_BINDING, std430) restrict readonly buffer SunLightBlock {
+    DirectionalLightProperties b_sunLight;
+};
+
+#ifdef USE_TEXTURE_ARRAYS
+layout (binding = TEXTURE_ARRAYS_UNIT) uniform sampler2DArray u_textureArrays[MAX_TEXTURE_ARRAYS];
+layout (binding = SUN_DEPTH_TEXTURE_UNIT) uniform sampler2DShadow u_sunLightDepthTexture;
+layout (binding = SHADOW_MOMENTS_TEXTURE_UNIT) uniform sampler2D u_shadowMoments;
+#else
+layout (binding = DIRECTIONAL_LIGHT_DEPTH_TEXTURE_BINDING, std140) uniform SunLightDepthTextureBlock {
+    sampler2DShadow u_sunLightDepthTexture;
+};
+#endif
+
+layout (binding = DIRECTIONAL_LIGHT_SHADOW_FILTER_BINDING, std140) uniform ShadowFilterBlock {
+    ShadowFilterSettings u_shadowFilter;
+};
+
+layout (binding = LIGHT_CLUSTERS_BINDING, std430) restrict readonly buffer LightClusterBlock {
+    uvec2 b_clusterLights[];
+};
+
+layout (binding = LIGHT_INDICES_BINDING, std430) restrict readonly buffer LightIndexBlock {
+    uint b_numLightIndices;
+    uint b_lightIndices[];
+};
+
+layout (binding = MESH_USAGE_BINDING, std430) restrict writeonly buffer MeshUsageBlock {
+    uint b_meshUsage[];
+};
+
+layout (location = MESH_USAGE_FRAME_LOCATION) uniform uint u_frame;
+
+//------------------------------------------------------------------------
+
+// Every invocation of a mesh stores the same value, so the races are benign.
+void markMeshUsed(uint drawID)
+{
+    b_meshUsage[drawID] = u_frame;
+}
+
+// Without bindless textures, the array is picked by a switch, as sampler arrays may only be indexed with dynamically
+// uniform expressions, which the draw ID of a pixel is not guaranteed to be.
+vec4 sampleMeshTexture(TextureHandle tex, vec2 uv, vec2 dx, vec2 dy)
+{
+#ifdef USE_TEXTURE_ARRAYS
+    vec3 coord = vec3(uv, float(tex.y));
+    switch (tex.x) {
+        case 0u: return textureGrad(u_textureArrays[0], coord, dx, dy);
+        case 1u: return textureGrad(u_textureArrays[1], coord, dx, dy);
+        case 2u: return textureGrad(u_textureArrays[2], coord, dx, dy);
+        case 3u: return textureGrad(u_textureArrays[3], coord, dx, dy);
+        case 4u: return textureGrad(u_textureArrays[4], coord, dx, dy);
+        case 5u: return textureGrad(u_textureArrays[5], coord, dx, dy);
+        case 6u: return textureGrad(u_textureArrays[6], coord, dx, dy);
+        case 7u: return textureGrad(u_textureArrays[7], coord, dx, dy);
+    }
+    return vec4(1.0);
+#else
+    return textureGrad(sampler2D(tex), uv, dx, dy);
+#endif
+}
+
+float chebyshevUpperBound(vec2 moments, float mean, float minVariance)
+{
+    if (mean <= moments.x) return 1.0;
+
+    float variance = max(moments.y - moments.x * moments.x, minVariance);
+    float d = mean - moments.x;
+    float pMax = variance / (variance + d * d);
+
+    // Cuts off the tail of the upper bound to hide light bleeding.
+    float bleed = u_shadowFilter.lightBleedReduction;
+    return clamp((pMax - bleed) / (1.0 - bleed), 0.0, 1.0);
+}
+
+// Exponential variance shadow maps as described by Lauritzen and McCool in "Layered Variance Shadow Maps" (2008).
+float evsmShadowFactor(vec4 shadowCoord, vec2 dx, vec2 dy)
+{
+    vec3 coord = shadowCoord.xyz / shadowCoord.w;
+    if (any(lessThan(coord, vec3(0.0))) || any(greaterThan(coord, vec3(1.0)))) return 1.0;
+
+#ifdef USE_TEXTURE_ARRAYS
+    vec4 moments = textureGrad(u_shadowMoments, coord.xy, dx, dy);
+#else
+    vec4 moments = textureGrad(sampler2D(u_shadowFilter.momentsTexture), coord.xy, dx, dy);
+#endif
+
+    float depth = 2.0 * coord.z - 1.0;
+    vec2 exponents = vec2(u_shadowFilter.positiveExponent, u_shadowFilter.negativeExponent);
+    vec2 warped = vec2(exp(exponents.x * depth), -exp(-exponents.y * depth));
+
+    // Scale the minimum variance by the derivative of the warp so both moments get a comparable bias.
+    vec2 minVariance = 0.0001 * exponents * abs(warped);
+    minVariance *= minVariance;
+
+    float pos = chebyshevUpperBound(moments.xy, warped.x, minVariance.x);
+    float neg = chebyshevUpperBound(moments.zw, warped.y, minVariance.y);
+    return min(pos, neg);
+}
+
+// dx and dy are the screen space derivatives of the projected shadow map coordinates.
+float sunShadowFactor(vec4 shadowCoord, vec2 dx, vec2 dy)
+{
+#ifdef USE_EVSM
+    return evsmShadowFactor(shadowCoord, dx, dy);
+#else
+    return textureProj(u_sunLightDepthTexture, shadowCoord);
+#endif
+}
+
+vec4 shadeSunLit(vec4 diffuse, float shadowFactor)
+{
+    return shadowFactor * 0.7 * diffuse + vec4(b_sunLight.ambient, 1.0) * diffuse;
+}
+
+// Inverse square falloff, windowed to reach zero at the light's range, as in "Real Shading in Unreal Engine 4" by
+// Karis (2013).
+float localLightAttenuation(LocalLight light, vec3 toLight)
+{
+    float distSq = dot(toLight, toLight);
+    float ratio = distSq / (light.range * light.range);
+    float window = clamp(1.0 - ratio * ratio, 0.0, 1.0);
+    float attenuation = window * window / max(distSq, 1.0);
+
+    if (light.type == LOCAL_LIGHT_SPOT) {
+        float cosAngle = dot(-normalize(toLight), light.direction);
+        attenuation *= smoothstep(light.cosOuterAngle, light.cosInnerAngle, cosAngle);
+    }
+    return attenuation;
+}
+
+// Lambertian lighting by the local lights of the pixel's froxel. pixel is in window coordinates.
+vec3 shadeLocalLights(vec3 diffuse, vec3 worldPos, vec3 normal, vec2 pixel, float viewDepth)
+{
+    uvec2 cluster = b_clusterLights[lightClusterIndex(pixel, viewDepth)];
+
+    vec3 radiance = vec3(0.0);
+    for (uint i = 0u; i < cluster.y; ++i) {
+        LocalLight light = b_lights[b_lightIndices[cluster.x + i]];
+        vec3 toLight = light.position - worldPos;
+        float nDotL = max(dot(normal, normalize(toLight)), 0.0);
+        radiance += light.color * light.intensity * localLightAttenuation(light, toLight) * nDotL;
+    }
+    return radiance * diffuse;
+}
+
+//------------------------------------------------------------------------
+
+#endif  // SHADING_GLSL
@@ -4,6 +4,8 @@
 
 #include <assimp/vector3.h>
 
+#include <string_view>
+
 //------------------------------------------------------------------------
 
 namespace Zhade
@@ -37,6 +39,18 @@ namespace util
 
 //------------------------------------------------------------------------
 
+// FNV-1a, which unlike std::hash is the same across runs and platforms, so it can key files on disk. Chain calls
+// through seed to hash several strings.
+[[nodiscard]] constexpr uint64_t hashFNV1a(std::string_view str, uint64_t seed = 0xcbf29ce484222325)
+{
+    for (char c : str) {
+        seed = (seed ^ static_cast<uint8_t>(c)) * 0x100000001b3;
+    }
+    return seed;
+}
+
+//------------------------------------------------------------------------
+
 [[nodiscard]] constexpr glm::vec3 makeUnitVec3x()
 {
     return glm::vec3{1, 0, 0};
@@ -0,0 +1,182 @@
+#include "ObjLoader.hpp"
+#include "common.hpp"
+
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//------------------------------------------------------------------------
+// Writes an OBJ file large enough to be split into 8 chunks, mixing materials, absolute and relative indices, faces
+// with and without texture coordinates and normals, polygons and a malformed face per block. Loading it on 8 threads
+// must give exactly what loading it on 1 thread gives, which in turn must have the expected number of vertices.
+// Exits with 1 if any check fails.
+
+namespace
+{
+
+//------------------------------------------------------------------------
+
+using namespace Zhade;
+
+inline constexpr uint32_t NUM_BLOCKS = 800;  // About 2.4 MB, enough for 8 chunks of at least OBJ_MIN_CHUNK_BYTES.
+inline constexpr uint32_t NUM_ATTRIBUTES_PER_BLOCK = 32;
+inline constexpr uint32_t NUM_FACES_PER_BLOCK = 16;
+inline constexpr uint32_t NUM_TRIANGLES_PER_BLOCK = 28;  // Four each of triangles, quads, triangles and pentagons.
+inline constexpr uint64_t RNG_SEED = 0x5eed;
+
+// The last one is not in the library, so that its faces fall back to the default material.
+inline constexpr std::array MATERIALS{"brick", "metal", "glass", "missing"};
+
+uint32_t g_numFailed = 0;
+
+void check(bool condition, std::string_view what)
+{
+    if (condition) [[likely]] return;
+    if (g_numFailed++ < 10) fmt::println("Failed: {}", what);
+}
+
+//------------------------------------------------------------------------
+
+void writeFile(const fs::path& path, std::string_view text)
+{
+    std::ofstream file{path, std::ios::binary};
+    file.write(text.data(), implicit_cast<std::streamsize>(text.size()));
+}
+
+// Returns the path of the OBJ file.
+fs::path writeScene(const fs::path& dir)
+{
+    fs::create_directories(dir);
+    writeFile(dir / "scene.mtl",
+        "newmtl brick\nmap_Kd textures/brick.png\n"
+        "newmtl metal\nKd 0.5 0.5 0.5\nmap_Kd -bm 0.5 metal.png\n"
+        "newmtl glass\nd 0.2\n");
+
+    std::mt19937_64 rng{RNG_SEED};
+    std::uniform_real_distribution<float> coord{-100.0f, 100.0f};
+    std::uniform_real_distribution<float> unit{0.0f, 1.0f};
+    std::string text = "# Generated by ZhadeObjLoaderTest\nmtllib scene.mtl\n";
+    auto out = std::back_inserter(text);
+
+    for (uint32_t block : stdv::iota(0u, NUM_BLOCKS)) {
+        fmt::format_to(out, "\nusemtl {}\n", MATERIALS[block % MATERIALS.size()]);
+        for ([[maybe_unused]] uint32_t attribute : stdv::iota(0u, NUM_ATTRIBUTES_PER_BLOCK)) {
+            fmt::format_to(out, "v {:.6f} {:g} {:.3e}\n", coord(rng), coord(rng), coord(rng));
+            fmt::format_to(out, "vt {:.5f} {:.5f}\n", unit(rng), unit(rng));
+            fmt::format_to(out, "vn {:.4f} {:.4f} {:.4f}\n", unit(rng), unit(rng), unit(rng));
+        }
+
+        // 1-based absolute indices of this block's first attributes, and relative ones counting back from its last.
+        const uint32_t first = block * NUM_ATTRIBUTES_PER_BLOCK + 1;
+        for (uint32_t face : stdv::iota(0u, NUM_FACES_PER_BLOCK)) {
+            const uint32_t a = face;
+            const uint32_t b = (face + 5) % NUM_ATTRIBUTES_PER_BLOCK;
+            const uint32_t c = (face + 11) % NUM_ATTRIBUTES_PER_BLOCK;
+            const uint32_t d = (face + 17) % NUM_ATTRIBUTES_PER_BLOCK;
+            const uint32_t e = (face + 23) % NUM_ATTRIBUTES_PER_BLOCK;
+            const auto relative = [](uint32_t idx) { return -implicit_cast<int64_t>(NUM_ATTRIBUTES_PER_BLOCK - idx); };
+            switch (face % 4) {
+            case 0:
+                fmt::format_to(out, "f {0}/{0}/{0} {1}/{1}/{1} {2}/{2}/{2}\n", first + a, first + b, first + c);
+                break;
+            case 1:
+                fmt::format_to(out, "f {0}//{0} {1}//{1} {2}//{2} {3}//{3}\n", relative(a), relative(b), relative(c),
+                    relative(d));
+                break;
+            case 2:
+                fmt::format_to(out, "f {} {} {}\n", first + a, first + b, first + c);
+                break;
+            default:
+                fmt::format_to(out, "f {0}/{0} {1}/{1} {2}/{2} {3}/{3} {4}/{4}\n", first + a, first + b, first + c,
+                    first + d, first + e);
+            }
+        }
+        fmt::format_to(out, "f 1 {} 2\n", NUM_BLOCKS * NUM_ATTRIBUTES_PER_BLOCK + 1);
+    }
+
+    const fs::path path = dir / "scene.obj";
+    writeFile(path, text);
+    return path;
+}
+
+//------------------------------------------------------------------------
+
+struct Loaded
+{
+    bool valid;
+    std::vector<ObjMesh> meshes;
+    std::vector<ObjMaterial> materials;
+    std::vector<Vertex> vertices;
+    std::vector<GLuint> indices;
+};
+
+Loaded load(const fs::path& path, uint32_t numThreads)
+{
+    ObjLoader loader{path, numThreads};
+    Loaded loaded{
+        .valid = loader.valid(),
+        .meshes = {loader.meshes().begin(), loader.meshes().end()},
+        .materials = {loader.materials().begin(), loader.materials().end()},
+        .vertices = std::vector<Vertex>(loader.numVertices()),
+        .indices = std::vector<GLuint>(loader.numVertices())
+    };
+    if (loaded.valid) loader.write(loaded.vertices, loaded.indices);
+    return loaded;
+}
+
+void testThreadCounts(const fs::path& path)
+{
+    const Loaded single = load(path, 1);
+    const Loaded multi = load(path, 8);
+
+    check(single.valid and multi.valid, "file loads");
+    check(single.vertices.size() == NUM_BLOCKS * NUM_TRIANGLES_PER_BLOCK * 3, "malformed faces are dropped");
+    check(single.materials.size() == 4 and single.materials[0].name == "brick"
+        and single.materials[0].diffusePath.filename() == "brick.png"
+        and single.materials[1].diffusePath.filename() == "metal.png"
+        and single.materials[2].diffusePath.empty(), "material library is parsed");
+
+    check(multi.meshes.size() == single.meshes.size(), "same number of meshes");
+    for (size_t idx : stdv::iota(0u, std::min(single.meshes.size(), multi.meshes.size()))) {
+        const ObjMesh& lhs = single.meshes[idx];
+        const ObjMesh& rhs = multi.meshes[idx];
+        check(lhs.firstVertex == rhs.firstVertex and lhs.numVertices == rhs.numVertices
+            and lhs.material == rhs.material, "same meshes");
+    }
+    check(multi.materials.size() == single.materials.size(), "same number of materials");
+    for (size_t idx : stdv::iota(0u, std::min(single.materials.size(), multi.materials.size()))) {
+        check(single.materials[idx].name == multi.materials[idx].name
+            and single.materials[idx].diffusePath == multi.materials[idx].diffusePath, "same materials");
+    }
+
+    // Smoothed normals are summed in file order either way, so even those must match bit for bit.
+    check(single.vertices.size() == multi.vertices.size() and std::memcmp(single.vertices.data(),
+        multi.vertices.data(), single.vertices.size() * sizeof(Vertex)) == 0, "same vertices");
+    check(single.indices == multi.indices, "same indices");
+}
+
+//------------------------------------------------------------------------
+
+}  // namespace
+
+//------------------------------------------------------------------------
+
+int main()
+{
+    const fs::path dir = fs::temp_directory_path() / "ZhadeObjLoaderTest";
+    testThreadCounts(writeScene(dir));
+    fs::remove_all(dir);
+
+    if (g_numFailed > 0) {
+        fmt::println("{} checks failed", g_numFailed);
+        return 1;
+    }
+    return 0;
+}
+
+//------------------------------------------------------------------------
@@ -0,0 +1,229 @@
+#include "Handle.hpp"
+#include "ObjectPool.hpp"
+#include "common.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+//------------------------------------------------------------------------
+// Checks ObjectPool's handle semantics on one thread, then churns a pool from several threads besides its owner, and
+// cancels reservations from other threads while the owner publishes them. Build with ZHADE_TEST_SANITIZER set
+// to thread or address to also catch races and use after free. Exits with 1 if any check fails.
+
+namespace
+{
+
+//------------------------------------------------------------------------
+
+using namespace Zhade;
+
+struct Payload
+{
+    uint64_t value = 0;
+};
+
+inline constexpr uint32_t NUM_CHURN_THREADS = 3;
+inline constexpr uint32_t NUM_CHURN_OPS = 50'000;
+inline constexpr uint32_t NUM_RESERVE_THREADS = 2;
+inline constexpr uint32_t NUM_RESERVATIONS = 25'000;
+
+std::atomic_uint32_t g_numFailed = 0;
+
+void check(bool condition, std::string_view what)
+{
+    if (condition) [[likely]] return;
+    if (g_numFailed++ < 10) fmt::println("Failed: {}", what);
+}
+
+//------------------------------------------------------------------------
+
+void testSingleThreaded()
+{
+    ObjectPool<Payload> pool;
+
+    // Like the vector the pool used to be, a default handle resolves to slot 0 until that is first allocated.
+    check(pool.get(Handle<Payload>{}) != nullptr, "default handle resolves before the first allocation");
+
+    Handle<Payload> first = pool.allocate(Payload{1});
+    check(first.isValid(), "allocated handle is valid");
+    check(pool.get(first) != nullptr and pool.get(first)->value == 1, "allocated object is constructed");
+    pool.deallocate(first);
+    check(pool.get(first) == nullptr, "deallocated handle is stale");
+    pool.deallocate(first);
+    check(pool.numAlive() == 0, "second deallocation is ignored");
+
+    const Handle<Payload> second = pool.allocate(Payload{2});
+    check(pool.get(first) == nullptr, "stale handle stays stale after its slot is reused");
+    check(pool.get(second)->value == 2, "reused slot holds the new object");
+
+    const Handle<Payload> reserved = pool.reserve();
+    check(pool.get(reserved) == nullptr and pool.isReserved(reserved), "reserved handle resolves once published");
+    check(pool.publish(reserved, Payload{3}), "reserved handle publishes");
+    check(not pool.isReserved(reserved) and pool.get(reserved)->value == 3, "published object is constructed");
+
+    const Handle<Payload> cancelled = pool.reserve();
+    pool.deallocate(cancelled);
+    check(not pool.isReserved(cancelled), "deallocating a reservation cancels it");
+    check(not pool.publish(cancelled, Payload{4}) and pool.get(cancelled) == nullptr, "cancelled handle stays stale");
+
+    // Grows past the first chunk, which must leave earlier objects in place.
+    const Payload* secondPtr = pool.get(second);
+    std::vector<Handle<Payload>> handles;
+    for (uint64_t value : stdv::iota(0u, 4 * OBJECT_POOL_CHUNK_SIZE)) handles.push_back(pool.allocate(Payload{value}));
+    check(pool.get(second) == secondPtr, "growing keeps objects in place");
+    check(pool.numAlive() == handles.size() + 2, "numAlive counts every live object");
+
+    uint64_t sum = 0;
+    for (const Payload& item : pool.alive()) sum += item.value;
+    const uint64_t expected = 2 + 3 + (4 * OBJECT_POOL_CHUNK_SIZE - 1) * 4 * OBJECT_POOL_CHUNK_SIZE / 2;
+    check(sum == expected, "alive visits every live object once");
+}
+
+//------------------------------------------------------------------------
+
+// Other threads allocate, look up and deallocate their own objects while the owner does the same, and then only
+// allocate while the owner iterates, as they may not deallocate meanwhile.
+void testConcurrentChurn()
+{
+    ObjectPool<Payload> pool{1};
+    std::vector<std::vector<Handle<Payload>>> threadHandles(NUM_CHURN_THREADS);
+    std::vector<std::jthread> threads;
+    for (uint32_t threadIdx : stdv::iota(0u, NUM_CHURN_THREADS)) {
+        threads.emplace_back([&pool, &handles = threadHandles[threadIdx], threadIdx] {
+            for (uint32_t op : stdv::iota(0u, NUM_CHURN_OPS)) {
+                handles.push_back(pool.allocate(Payload{uint64_t{threadIdx} << 32 | op}));
+                if (handles.size() <= 50) continue;
+                const size_t victim = op % handles.size();
+                const Payload* item = pool.get(handles[victim]);
+                check(item != nullptr and item->value >> 32 == threadIdx, "other thread's object survives churn");
+                pool.deallocate(handles[victim]);
+                check(pool.get(handles[victim]) == nullptr, "other thread's handle is stale once deallocated");
+                handles.erase(handles.begin() + implicit_cast<ptrdiff_t>(victim));
+            }
+        });
+    }
+    std::vector<Handle<Payload>> owned;
+    for ([[maybe_unused]] uint32_t op : stdv::iota(0u, 2 * NUM_CHURN_OPS)) {
+        owned.push_back(pool.allocate());
+        if (owned.size() > 100) {
+            pool.deallocate(owned.front());
+            owned.erase(owned.begin());
+        }
+    }
+    threads.clear();
+
+    for (uint32_t threadIdx : stdv::iota(0u, NUM_CHURN_THREADS)) {
+        threads.emplace_back([&pool, &handles = threadHandles[threadIdx], threadIdx] {
+            for (uint32_t op : stdv::iota(0u, NUM_CHURN_OPS / 10)) {
+                handles.push_back(pool.allocate(Payload{uint64_t{threadIdx} << 32 | op}));
+            }
+        });
+    }
+    for ([[maybe_unused]] uint32_t pass : stdv::iota(0u, 100u)) {
+        for (const Payload& item : pool.alive()) check(item.value >> 32 < NUM_CHURN_THREADS, "alive object is intact");
+    }
+    threads.clear();
+
+    size_t numExpected = owned.size();
+    for (const std::vector<Handle<Payload>>& handles : threadHandles) numExpected += handles.size();
+    check(pool.numAlive() == numExpected, "numAlive counts the objects of all threads");
+
+    std::unordered_set<const Payload*> alive;
+    for (const Payload& item : pool.alive()) alive.insert(&item);
+    for (const Handle<Payload>& handle : owned) {
+        check(alive.contains(pool.get(handle)), "alive lists the owner's objects");
+    }
+    for (const std::vector<Handle<Payload>>& handles : threadHandles) {
+        for (const Handle<Payload>& handle : handles) {
+            check(alive.contains(pool.get(handle)), "alive lists other threads' objects");
+            pool.deallocate(handle);
+        }
+    }
+    check(pool.numAlive() == owned.size(), "only the owner's objects remain");
+}
+
+//------------------------------------------------------------------------
+
+// As ResourceManager's createPending*() and finalizePending(): other threads reserve and cancel some, the owner
+// publishes whatever they queued.
+void testConcurrentReservations()
+{
+    ObjectPool<Payload> pool{1};
+    std::mutex queueMutex;
+    std::vector<Handle<Payload>> queue;
+    std::atomic_uint32_t numDone = 0;
+    std::atomic_uint32_t numCancelled = 0;
+
+    std::vector<std::jthread> threads;
+    for ([[maybe_unused]] uint32_t threadIdx : stdv::iota(0u, NUM_RESERVE_THREADS)) {
+        threads.emplace_back([&] {
+            for (uint32_t reservation : stdv::iota(0u, NUM_RESERVATIONS)) {
+                const Handle<Payload> handle = pool.reserve();
+                check(pool.get(handle) == nullptr and pool.isReserved(handle), "reservation is pending");
+                if (reservation % 3 == 0) {
+                    pool.deallocate(handle);
+                    ++numCancelled;
+                }
+                const std::scoped_lock lock{queueMutex};
+                queue.push_back(handle);
+            }
+            ++numDone;
+        });
+    }
+
+    uint32_t numPublished = 0;
+    std::vector<Handle<Payload>> published;
+    std::vector<Handle<Payload>> pending;
+    while (true) {
+        const bool isLastRound = numDone.load() == NUM_RESERVE_THREADS;
+        {
+            const std::scoped_lock lock{queueMutex};
+            std::swap(pending, queue);
+        }
+        if (pending.empty()) std::this_thread::yield();
+        for (const Handle<Payload>& handle : pending) {
+            if (pool.publish(handle, Payload{7})) {
+                ++numPublished;
+                check(pool.get(handle) != nullptr and pool.get(handle)->value == 7, "published object resolves");
+                published.push_back(handle);
+            } else {
+                check(pool.get(handle) == nullptr, "cancelled reservation stays stale");
+            }
+        }
+        pending.clear();
+        while (published.size() > 64) {
+            pool.deallocate(published.back());
+            published.pop_back();
+        }
+        if (isLastRound) break;
+    }
+    threads.clear();
+
+    check(numPublished + numCancelled == NUM_RESERVE_THREADS * NUM_RESERVATIONS, "every reservation is resolved");
+    check(pool.numAlive() == published.size(), "only published objects remain");
+}
+
+//------------------------------------------------------------------------
+
+}  // namespace
+
+//------------------------------------------------------------------------
+
+int main()
+{
+    testSingleThreaded();
+    testConcurrentChurn();
+    testConcurrentReservations();
+
+    if (g_numFailed > 0) {
+        fmt::println("{} checks failed", g_numFailed.load());
+        return 1;
+    }
+    return 0;
+}
+
+//------------------------------------------------------------------------
@@ -0,0 +1,257 @@
+#include "RenderGraph.hpp"
+#include "ResourceManager.hpp"
+#include "common.hpp"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+//------------------------------------------------------------------------
+// Compiles and executes small frames through a RenderGraph, checking which passes run and in which order, the barriers
+// placed before them, which transient resources share a GL object, and that GL objects a frame no longer uses are
+// released. Barriers are read from dump(), the order from the passes themselves. Needs a GL 4.6 context, which it
+// creates in a hidden window, and exits with SKIP_CODE if there is none. Exits with 1 if any check fails.
+
+namespace
+{
+
+//------------------------------------------------------------------------
+
+using namespace Zhade;
+
+inline constexpr int SKIP_CODE = 77;
+inline constexpr GLsizei BUFFER_BYTES = 256;
+
+uint32_t g_numFailed = 0;
+
+void check(bool condition, std::string_view what)
+{
+    if (condition) [[likely]] return;
+    if (g_numFailed++ < 10) fmt::println("Failed: {}", what);
+}
+
+//------------------------------------------------------------------------
+
+bool initContext()
+{
+    if (glfwInit() == GLFW_FALSE) return false;
+
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+    GLFWwindow* window = glfwCreateWindow(64, 64, "ZhadeRenderGraphTest", nullptr, nullptr);
+    if (window == nullptr) return false;
+    glfwMakeContextCurrent(window);
+
+    glewExperimental = GL_TRUE;
+    return glewInit() == GLEW_OK;
+}
+
+//------------------------------------------------------------------------
+
+// Records the names of the passes in the order they run.
+struct Recorder
+{
+    std::vector<std::string> ran;
+
+    [[nodiscard]] PassCallback operator()(std::string_view name)
+    {
+        return [this, name](RenderGraph&) { ran.emplace_back(name); };
+    }
+};
+
+[[nodiscard]] bool contains(const std::string& dot, std::string_view text)
+{
+    return dot.find(text) != std::string::npos;
+}
+
+// Matches the labels of dump(), where barriers follow the pass's name.
+[[nodiscard]] bool hasBarriers(const std::string& dot, std::string_view pass, std::string_view barriers)
+{
+    return contains(dot, barriers.empty()
+        ? fmt::format(": {}\"]", pass)
+        : fmt::format(": {}\\nbarrier: {}\"]", pass, barriers));
+}
+
+//------------------------------------------------------------------------
+
+void testCulling(ResourceManager& mngr)
+{
+    RenderGraph graph{{.mngr = &mngr}};
+    Recorder record;
+
+    const GraphResource data = graph.createBuffer("Data", BUFFER_BYTES, BufferUsage::STORAGE);
+    const GraphResource scratch = graph.createBuffer("Scratch", BUFFER_BYTES, BufferUsage::STORAGE);
+    const GraphResource result = graph.createBuffer("Result", BUFFER_BYTES, BufferUsage::STORAGE);
+    graph.markOutput(result);
+
+    graph.addPass({.name = "Produce", .writes = {{data, ResourceAccess::STORAGE}}, .execute = record("Produce")});
+    graph.addPass({.name = "Dead", .writes = {{scratch, ResourceAccess::STORAGE}}, .execute = record("Dead")});
+    graph.addPass({
+        .name = "Consume",
+        .reads = {{data, ResourceAccess::STORAGE}},
+        .execute = record("Consume"),
+        .sideEffects = true
+    });
+    graph.addPass({.name = "Output", .writes = {{result, ResourceAccess::STORAGE}}, .execute = record("Output")});
+    // Only reads what Dead writes, so that it keeps neither alive.
+    graph.addPass({
+        .name = "DeadReader",
+        .reads = {{scratch, ResourceAccess::STORAGE}},
+        .execute = record("DeadReader")
+    });
+
+    graph.compile();
+    graph.execute();
+    const std::string dot = graph.dump();
+
+    // Consume waits for a barrier, which Output does not need.
+    check(record.ran == std::vector<std::string>{"Produce", "Output", "Consume"}, "live passes run");
+    check(hasBarriers(dot, "Consume", "STORAGE"), "read of a shader write needs a barrier");
+    check(contains(dot, "Dead\\n(culled)") and contains(dot, "DeadReader\\n(culled)"), "dead passes are culled");
+    check(contains(dot, "Scratch\\ntransient, unused"), "culled passes' transients get no GL object");
+}
+
+//------------------------------------------------------------------------
+
+// The command buffer is written by a shader and read by the draw, while an independent clear needs no barrier and so
+// runs first. Barrier states carry over to the next frame, where the write after the draw's read needs one as well.
+void testBarriers(ResourceManager& mngr)
+{
+    RenderGraph graph{{.mngr = &mngr}};
+    const Handle<Buffer> commandsHandle = mngr.createBuffer({.byteSize = BUFFER_BYTES, .usage = BufferUsage::STORAGE});
+    const Handle<Buffer> countHandle = mngr.createBuffer({.byteSize = BUFFER_BYTES, .usage = BufferUsage::STORAGE});
+
+    for (uint32_t frame : {0u, 1u}) {
+        Recorder record;
+        graph.reset();
+        const GraphResource commands = graph.importBuffer("Commands", mngr.get(commandsHandle));
+        const GraphResource count = graph.importBuffer("Count", mngr.get(countHandle));
+
+        graph.addPass({
+            .name = "Populate",
+            .writes = {{commands, ResourceAccess::STORAGE}},
+            .execute = record("Populate")
+        });
+        graph.addPass({
+            .name = "Draw",
+            .reads = {{commands, ResourceAccess::INDIRECT}},
+            .execute = record("Draw"),
+            .sideEffects = true
+        });
+        graph.addPass({
+            .name = "Clear",
+            .writes = {{count, ResourceAccess::BUFFER_UPDATE}},
+            .execute = record("Clear"),
+            .sideEffects = true
+        });
+
+        graph.compile();
+        graph.execute();
+        const std::string dot = graph.dump();
+
+        if (frame == 0) {
+            check(record.ran == std::vector<std::string>{"Populate", "Clear", "Draw"}, "barrier-free pass runs first");
+            check(hasBarriers(dot, "Populate", ""), "first write needs no barrier");
+        } else {
+            check(record.ran == std::vector<std::string>{"Clear", "Populate", "Draw"}, "barrier-free pass runs first");
+            check(hasBarriers(dot, "Populate", "STORAGE"), "write after last frame's write needs a barrier");
+        }
+        check(hasBarriers(dot, "Clear", ""), "coherent write needs no barrier");
+        check(hasBarriers(dot, "Draw", "INDIRECT"), "indirect read of a shader write needs a barrier");
+    }
+
+    mngr.destroy(commandsHandle);
+    mngr.destroy(countHandle);
+}
+
+//------------------------------------------------------------------------
+
+// A chain of passes, each reading the texture the previous one wrote. A texture is free again once the pass after the
+// one writing it has run, so that the first and third share a GL object, and the second and fourth.
+void testAliasing(ResourceManager& mngr)
+{
+    RenderGraph graph{{.mngr = &mngr}};
+    const TextureDescriptor desc{.dims{64, 64}, .levels = 1};
+
+    std::vector<Texture*> textures;
+    std::vector<GraphResource> chain;
+    for (std::string_view name : {"A", "B", "C", "D"}) {
+        chain.push_back(graph.createTexture(name, desc));
+    }
+    const GraphResource unlike = graph.createTexture("Unlike", {.dims{32, 32}, .levels = 1});
+
+    graph.addPass({
+        .name = "Write A",
+        .writes = {{chain[0], ResourceAccess::ATTACHMENT}},
+        .execute = [&](RenderGraph& g) { textures.push_back(g.texture(chain[0])); }
+    });
+    for (size_t idx : stdv::iota(size_t{1}, chain.size())) {
+        graph.addPass({
+            .name = "Blur",
+            .reads = {{chain[idx - 1], ResourceAccess::TEXTURE}},
+            .writes = {{chain[idx], ResourceAccess::ATTACHMENT}},
+            .execute = [&, idx](RenderGraph& g) { textures.push_back(g.texture(chain[idx])); }
+        });
+    }
+    graph.addPass({
+        .name = "Present",
+        .reads = {{chain.back(), ResourceAccess::TEXTURE}, {unlike, ResourceAccess::TEXTURE}},
+        .execute = [](RenderGraph&) {},
+        .sideEffects = true
+    });
+
+    graph.compile();
+    graph.execute();
+
+    check(graph.numPhysicalTextures() == 3, "textures with disjoint lifetimes share GL objects");
+    check(textures.size() == 4 and textures[0] == textures[2] and textures[1] == textures[3]
+        and textures[0] != textures[1], "aliased textures resolve to the same GL object");
+
+    // The next frame only needs one of them.
+    graph.reset();
+    const GraphResource single = graph.createTexture("Single", desc);
+    graph.addPass({
+        .name = "Write",
+        .writes = {{single, ResourceAccess::ATTACHMENT}},
+        .execute = [](RenderGraph&) {},
+        .sideEffects = true
+    });
+    graph.compile();
+    graph.execute();
+
+    check(graph.numPhysicalTextures() == 1, "GL objects a frame no longer uses are released");
+}
+
+//------------------------------------------------------------------------
+
+}  // namespace
+
+//------------------------------------------------------------------------
+
+int main()
+{
+    if (not initContext()) {
+        fmt::println("No GL 4.6 context, skipping");
+        glfwTerminate();
+        return SKIP_CODE;
+    }
+
+    {
+        ResourceManager mngr;
+        testCulling(mngr);
+        testBarriers(mngr);
+        testAliasing(mngr);
+    }
+    glfwTerminate();
+
+    if (g_numFailed > 0) {
+        fmt::println("{} checks failed", g_numFailed);
+        return 1;
+    }
+    return 0;
+}
+
+//------------------------------------------------------------------------
@@ -0,0 +1,103 @@
+#include "TripleBuffer.hpp"
+#include "common.hpp"
+
+#include <algorithm>
+#include <array>
+#include <string_view>
+#include <thread>
+
+//------------------------------------------------------------------------
+// Checks TripleBuffer's handoff on one thread, then has a producer thread write a counter, with copies of it that a
+// torn read would tell apart, while the consumer reads until it has seen the last value. Build with
+// ZHADE_TEST_SANITIZER=thread to also catch races. Exits with 1 if any check fails.
+
+namespace
+{
+
+//------------------------------------------------------------------------
+
+using namespace Zhade;
+
+// Larger than any atomic write, so that reads of a slot being written would show mismatched elements.
+struct Sample
+{
+    std::array<uint64_t, 8> values{};
+
+    [[nodiscard]] static Sample of(uint64_t value)
+    {
+        Sample sample;
+        sample.values.fill(value);
+        return sample;
+    }
+
+    [[nodiscard]] bool isIntact() const { return stdr::all_of(values, [&](uint64_t v) { return v == values[0]; }); }
+};
+
+inline constexpr uint64_t NUM_WRITES = 200'000;
+
+uint32_t g_numFailed = 0;
+
+void check(bool condition, std::string_view what)
+{
+    if (condition) [[likely]] return;
+    if (g_numFailed++ < 10) fmt::println("Failed: {}", what);
+}
+
+//------------------------------------------------------------------------
+
+void testSingleThreaded()
+{
+    TripleBuffer<Sample> buffer;
+    check(buffer.read().values[0] == 0 and buffer.read().isIntact(), "read before any write is value-initialized");
+
+    buffer.write(Sample::of(1));
+    check(buffer.read().values[0] == 1, "read returns the written value");
+    check(buffer.read().values[0] == 1, "read without a new write returns the same value");
+
+    buffer.write(Sample::of(2));
+    buffer.write(Sample::of(3));
+    check(buffer.read().values[0] == 3, "read skips to the newest value");
+
+    for (uint64_t value : stdv::iota(4u, 10u)) {
+        buffer.write(Sample::of(value));
+        check(buffer.read().values[0] == value, "alternating writes and reads hand over every value");
+    }
+}
+
+//------------------------------------------------------------------------
+
+void testConcurrent()
+{
+    TripleBuffer<Sample> buffer;
+    std::jthread producer([&buffer] {
+        for (uint64_t value : stdv::iota(uint64_t{1}, NUM_WRITES + 1)) buffer.write(Sample::of(value));
+    });
+
+    uint64_t last = 0;
+    while (last < NUM_WRITES) {
+        const Sample& sample = buffer.read();
+        check(sample.isIntact(), "read value is not torn");
+        check(sample.values[0] >= last, "read values never go back");
+        last = sample.values[0];
+    }
+}
+
+//------------------------------------------------------------------------
+
+}  // namespace
+
+//------------------------------------------------------------------------
+
+int main()
+{
+    testSingleThreaded();
+    testConcurrent();
+
+    if (g_numFailed > 0) {
+        fmt::println("{} checks failed", g_numFailed);
+        return 1;
+    }
+    return 0;
+}
+
+//------------------------------------------------------------------------
@@ -0,0 +1,133 @@
+#include "VertexStreams.hpp"
+#include "common.hpp"
+
+#include <cstring>
+#include <span>
+#include <string_view>
+#include <vector>
+
+//------------------------------------------------------------------------
+// Checks interleaveVertices() and widenIndices() against a scalar reference, for every combination of present streams,
+// strides from tightly packed to interleaved, and counts on both sides of the SIMD paths' boundaries. Each stream has a
+// buffer of its own that ends right after its last element, so that builds with ZHADE_TEST_SANITIZER=address catch
+// reads past it. Exits with 1 if any check fails.
+
+namespace
+{
+
+//------------------------------------------------------------------------
+
+using namespace Zhade;
+
+inline constexpr std::array VERTEX_COUNTS{0u, 1u, 2u, 3u, 4u, 5u, 17u, 100u};
+inline constexpr std::array INDEX_COUNTS{0u, 1u, 7u, 8u, 9u, 15u, 16u, 33u};
+
+uint32_t g_numFailed = 0;
+
+void check(bool condition, std::string_view what)
+{
+    if (condition) [[likely]] return;
+    if (g_numFailed++ < 10) fmt::println("Failed: {}", what);
+}
+
+// numElements vectors of numFloats floats, stride bytes apart, with distinct values and no gap after the last one.
+std::vector<std::byte> makeStream(size_t numElements, size_t numFloats, size_t stride, float seed)
+{
+    const size_t size = numElements == 0 ? 0 : (numElements - 1) * stride + numFloats * sizeof(float);
+    std::vector<std::byte> bytes(size);
+    for (size_t idx : stdv::iota(0u, numElements)) {
+        for (size_t component : stdv::iota(0u, numFloats)) {
+            const float value = seed + 0.25f * implicit_cast<float>(idx * numFloats + component);
+            std::memcpy(bytes.data() + idx * stride + component * sizeof(float), &value, sizeof(float));
+        }
+    }
+    return bytes;
+}
+
+[[nodiscard]] float floatAt(const VertexStream& stream, size_t idx, size_t component)
+{
+    float value;
+    std::memcpy(&value, stream.data + idx * stream.stride + component * sizeof(float), sizeof(float));
+    return value;
+}
+
+Vertex referenceVertex(const VertexStreams& streams, size_t idx)
+{
+    Vertex vertex{};
+    if (streams.positions.data) {
+        vertex.pos = {floatAt(streams.positions, idx, 0), floatAt(streams.positions, idx, 1),
+            floatAt(streams.positions, idx, 2)};
+    }
+    if (streams.normals.data) {
+        vertex.nrm = {floatAt(streams.normals, idx, 0), floatAt(streams.normals, idx, 1),
+            floatAt(streams.normals, idx, 2)};
+    }
+    if (streams.uvs.data) {
+        vertex.uv = {floatAt(streams.uvs, idx, 0), floatAt(streams.uvs, idx, 1)};
+        if (streams.flipV) vertex.uv.y = 1.0f - vertex.uv.y;
+    }
+    return vertex;
+}
+
+//------------------------------------------------------------------------
+
+void testInterleave()
+{
+    for (uint32_t numVertices : VERTEX_COUNTS) {
+        // Packed, padded to 16 bytes, and a 32-byte interleaved vertex.
+        for (size_t stride : {0u, 16u, 32u}) {
+            for (uint32_t present : stdv::iota(0u, 8u)) {
+                for (bool flipV : {false, true}) {
+                    const std::vector<std::byte> positions = makeStream(numVertices, 3, stride ? stride : 12, 1.0f);
+                    const std::vector<std::byte> normals = makeStream(numVertices, 3, stride ? stride : 12, -2.0f);
+                    const std::vector<std::byte> uvs = makeStream(numVertices, 2, stride ? stride : 8, 0.5f);
+                    VertexStreams streams{.flipV = flipV};
+                    if (present & 1) streams.positions = {.data = positions.data(), .stride = stride ? stride : 12};
+                    if (present & 2) streams.normals = {.data = normals.data(), .stride = stride ? stride : 12};
+                    if (present & 4) streams.uvs = {.data = uvs.data(), .stride = stride ? stride : 8};
+
+                    std::vector<Vertex> vertices(numVertices);
+                    interleaveVertices(streams, vertices);
+                    for (size_t idx : stdv::iota(0u, numVertices)) {
+                        const Vertex expected = referenceVertex(streams, idx);
+                        check(vertices[idx].pos == expected.pos and vertices[idx].nrm == expected.nrm
+                            and vertices[idx].uv == expected.uv, "interleaved vertex matches the reference");
+                    }
+                }
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------
+
+void testWiden()
+{
+    for (uint32_t numIndices : INDEX_COUNTS) {
+        std::vector<uint16_t> src(numIndices);
+        for (size_t idx : stdv::iota(0u, numIndices)) src[idx] = implicit_cast<uint16_t>(UINT16_MAX - idx * 37);
+        std::vector<GLuint> dst(numIndices);
+        widenIndices(src, dst);
+        for (size_t idx : stdv::iota(0u, numIndices)) check(dst[idx] == src[idx], "widened index matches");
+    }
+}
+
+//------------------------------------------------------------------------
+
+}  // namespace
+
+//------------------------------------------------------------------------
+
+int main()
+{
+    testInterleave();
+    testWiden();
+
+    if (g_numFailed > 0) {
+        fmt::println("{} checks failed", g_numFailed);
+        return 1;
+    }
+    return 0;
+}
+
+//------------------------------------------------------------------------